@@ -20,9 +20,9 @@ then
     rm ../../bin/write_ndvi
 fi
 
-cc -lm ../../src/*.c ../../src/examples/write_bands.c -o ../../bin/write_bands
-cc -lm ../../src/*.c ../../src/examples/write_bitmask.c -o ../../bin/write_bitmask
-cc -lm ../../src/*.c ../../src/examples/write_ndvi.c -o ../../bin/write_ndvi
+cc -lm -lpthread ../../src/*.c ../../src/examples/write_bands.c -o ../../bin/write_bands
+cc -lm -lpthread ../../src/*.c ../../src/examples/write_bitmask.c -o ../../bin/write_bitmask
+cc -lm -lpthread ../../src/*.c ../../src/examples/write_ndvi.c -o ../../bin/write_ndvi
 
 if [ ! -f "../../bin/write_bands" ]
 then
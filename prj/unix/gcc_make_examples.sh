@@ -20,9 +20,9 @@ then
     rm ../../bin/write_ndvi
 fi
 
-gcc -lm ../../src/*.c ../../src/examples/write_bands.c -o ../../bin/write_bands
-gcc -lm ../../src/*.c ../../src/examples/write_bitmask.c -o ../../bin/write_bitmask
-gcc -lm ../../src/*.c ../../src/examples/write_ndvi.c -o ../../bin/write_ndvi
+gcc -lm -lpthread ../../src/*.c ../../src/examples/write_bands.c -o ../../bin/write_bands
+gcc -lm -lpthread ../../src/*.c ../../src/examples/write_bitmask.c -o ../../bin/write_bitmask
+gcc -lm -lpthread ../../src/*.c ../../src/examples/write_ndvi.c -o ../../bin/write_ndvi
 
 if [ ! -f "../../bin/write_bands" ]
 then
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_band.h"
+
+
+/* the number of full resolution lines decoded at once by an aggregated read */
+#define EPR_AGG_CHUNK_HEIGHT 64
+
+/**
+ * The state of one raster of an aggregated read: the block row currently
+ * being combined.
+ */
+typedef struct EPR_AggLevel {
+    EPR_SRaster* raster;
+    /* the combined value of each block of the row (sum, minimum or maximum) */
+    double* values;
+    /* the number of pixels added to each block of the row */
+    uint* counts;
+    /* the pixels of each block of the row, for the mode only */
+    double* block_values;
+} EPR_SAggLevel;
+
+struct EPR_Aggregator {
+    EPR_SAggLevel* levels;
+    uint num_levels;
+    EPR_EAggregationMethod method;
+    /* the index of the next line of the source region */
+    uint line_y;
+};
+
+
+static double epr_get_agg_value(const void* buffer, EPR_EDataTypeId data_type, uint index)
+{
+    switch (data_type) {
+    case e_tid_uchar:
+        return ((const uchar*) buffer)[index];
+    case e_tid_char:
+        return ((const char*) buffer)[index];
+    case e_tid_ushort:
+        return ((const ushort*) buffer)[index];
+    case e_tid_short:
+        return ((const short*) buffer)[index];
+    case e_tid_uint:
+        return ((const uint*) buffer)[index];
+    case e_tid_int:
+        return ((const int*) buffer)[index];
+    case e_tid_float:
+        return ((const float*) buffer)[index];
+    case e_tid_double:
+        return ((const double*) buffer)[index];
+    default:
+        return 0.0;
+    }
+}
+
+
+static void epr_set_agg_value(void* buffer, EPR_EDataTypeId data_type, uint index, double value)
+{
+    /* the mean of integers is rounded to the nearest integer */
+    double rounded = value < 0.0 ? ceil(value - 0.5) : floor(value + 0.5);
+
+    switch (data_type) {
+    case e_tid_uchar:
+        ((uchar*) buffer)[index] = (uchar) rounded;
+        break;
+    case e_tid_char:
+        ((char*) buffer)[index] = (char) rounded;
+        break;
+    case e_tid_ushort:
+        ((ushort*) buffer)[index] = (ushort) rounded;
+        break;
+    case e_tid_short:
+        ((short*) buffer)[index] = (short) rounded;
+        break;
+    case e_tid_uint:
+        ((uint*) buffer)[index] = (uint) rounded;
+        break;
+    case e_tid_int:
+        ((int*) buffer)[index] = (int) rounded;
+        break;
+    case e_tid_float:
+        ((float*) buffer)[index] = (float) value;
+        break;
+    case e_tid_double:
+        ((double*) buffer)[index] = value;
+        break;
+    default:
+        break;
+    }
+}
+
+
+static int epr_compare_agg_values(const void* value1, const void* value2)
+{
+    double v1 = *(const double*) value1;
+    double v2 = *(const double*) value2;
+    return v1 < v2 ? -1 : (v1 > v2 ? 1 : 0);
+}
+
+
+/* gets the most frequent value, the smallest one of equally frequent values */
+static double epr_get_agg_mode(double* values, uint count)
+{
+    double mode;
+    uint i, run = 1, max_run = 1;
+
+    qsort(values, count, sizeof (double), epr_compare_agg_values);
+    mode = values[0];
+    for (i = 1; i < count; i++) {
+        run = values[i] == values[i - 1] ? run + 1 : 1;
+        if (run > max_run) {
+            max_run = run;
+            mode = values[i];
+        }
+    }
+    return mode;
+}
+
+
+/* adds the valid pixels of a line of the source region to the current block
+ * row of the given raster, all pixels are valid if valid is NULL */
+static void epr_add_agg_line(EPR_SAggLevel* level, const double* line, const uchar* valid, uint line_y, EPR_EAggregationMethod method)
+{
+    EPR_SRaster* raster = level->raster;
+    uint block_size = raster->source_step_x * raster->source_step_y;
+    uint x, bx;
+
+    for (x = 0; x < raster->source_width; x++) {
+        if (valid != NULL && valid[x] == 0) {
+            continue;
+        }
+        bx = x / raster->source_step_x;
+        switch (method) {
+        case e_agg_mean:
+            level->values[bx] += line[x];
+            break;
+        case e_agg_min:
+            if (level->counts[bx] == 0 || line[x] < level->values[bx]) {
+                level->values[bx] = line[x];
+            }
+            break;
+        case e_agg_max:
+            if (level->counts[bx] == 0 || line[x] > level->values[bx]) {
+                level->values[bx] = line[x];
+            }
+            break;
+        case e_agg_mode:
+            level->block_values[bx * block_size + level->counts[bx]] = line[x];
+            break;
+        }
+        level->counts[bx]++;
+    }
+
+    /* the last line of a block row or of the source region completes the row */
+    if ((line_y + 1) % raster->source_step_y == 0 || line_y + 1 == raster->source_height) {
+        uint index = (line_y / raster->source_step_y) * raster->raster_width;
+        for (bx = 0; bx < raster->raster_width; bx++) {
+            double value;
+            if (level->counts[bx] == 0) {
+                /* like a masked pixel of epr_read_band_raster */
+                value = 0.0;
+            } else if (method == e_agg_mean) {
+                value = level->values[bx] / level->counts[bx];
+            } else if (method == e_agg_mode) {
+                value = epr_get_agg_mode(level->block_values + bx * block_size, level->counts[bx]);
+            } else {
+                value = level->values[bx];
+            }
+            epr_set_agg_value(raster->buffer, raster->data_type, index + bx, value);
+            level->values[bx] = 0.0;
+            level->counts[bx] = 0;
+        }
+    }
+}
+
+
+EPR_SAggregator* epr_create_aggregator(EPR_SRaster** levels, uint num_levels, EPR_EAggregationMethod method)
+{
+    EPR_SAggregator* aggregator;
+    EPR_SRaster* raster;
+    uint i;
+
+    aggregator = (EPR_SAggregator*) calloc(1, sizeof (EPR_SAggregator));
+    if (aggregator == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_create_aggregator: out of memory");
+        return NULL;
+    }
+    aggregator->num_levels = num_levels;
+    aggregator->method = method;
+    aggregator->levels = (EPR_SAggLevel*) calloc(num_levels, sizeof (EPR_SAggLevel));
+    if (aggregator->levels == NULL) {
+        epr_free_aggregator(aggregator);
+        epr_set_err(e_err_out_of_memory, "epr_create_aggregator: out of memory");
+        return NULL;
+    }
+    for (i = 0; i < num_levels; i++) {
+        raster = levels[i];
+        aggregator->levels[i].raster = raster;
+        aggregator->levels[i].values = (double*) calloc(raster->raster_width, sizeof (double));
+        aggregator->levels[i].counts = (uint*) calloc(raster->raster_width, sizeof (uint));
+        if (method == e_agg_mode) {
+            aggregator->levels[i].block_values = (double*) calloc(raster->raster_width * raster->source_step_x * raster->source_step_y,
+                                                                  sizeof (double));
+        }
+        if (aggregator->levels[i].values == NULL || aggregator->levels[i].counts == NULL
+                || (method == e_agg_mode && aggregator->levels[i].block_values == NULL)) {
+            epr_free_aggregator(aggregator);
+            epr_set_err(e_err_out_of_memory, "epr_create_aggregator: out of memory");
+            return NULL;
+        }
+    }
+    return aggregator;
+}
+
+
+void epr_aggregate_line(EPR_SAggregator* aggregator, const double* line, const uchar* valid)
+{
+    uint i;
+
+    for (i = 0; i < aggregator->num_levels; i++) {
+        epr_add_agg_line(&aggregator->levels[i], line, valid, aggregator->line_y, aggregator->method);
+    }
+    aggregator->line_y++;
+}
+
+
+void epr_free_aggregator(EPR_SAggregator* aggregator)
+{
+    uint i;
+
+    if (aggregator == NULL) {
+        return;
+    }
+    for (i = 0; aggregator->levels != NULL && i < aggregator->num_levels; i++) {
+        free(aggregator->levels[i].values);
+        free(aggregator->levels[i].counts);
+        free(aggregator->levels[i].block_values);
+    }
+    free(aggregator->levels);
+    free(aggregator);
+}
+
+
+int epr_read_band_pyramid(EPR_SBandId* band_id,
+                          int offset_x,
+                          int offset_y,
+                          EPR_SRaster** levels,
+                          uint num_levels,
+                          EPR_EAggregationMethod method)
+{
+    EPR_SAggregator* aggregator = NULL;
+    EPR_SRaster* chunk = NULL;
+    EPR_SRaster* bm_chunk = NULL;
+    EPR_SRaster chunk_window;
+    EPR_SRaster bm_window;
+    double* line = NULL;
+    uint source_width, source_height, chunk_y, y, x, i;
+    int errcode = e_err_none;
+
+    epr_clear_err();
+
+    if (band_id == NULL) {
+        epr_set_err(e_err_invalid_band,
+                    "epr_read_band_pyramid: band_id must not be NULL");
+        return epr_get_last_err_code();
+    }
+    if (levels == NULL || num_levels == 0) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_read_band_pyramid: levels must not be NULL or empty");
+        return epr_get_last_err_code();
+    }
+    if (method != e_agg_mean && method != e_agg_min && method != e_agg_max && method != e_agg_mode) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_read_band_pyramid: unknown aggregation method");
+        return epr_get_last_err_code();
+    }
+    for (i = 0; i < num_levels; i++) {
+        if (levels[i] == NULL || levels[i]->buffer == NULL) {
+            epr_set_err(e_err_invalid_raster,
+                        "epr_read_band_pyramid: raster must not be NULL");
+            return epr_get_last_err_code();
+        }
+        if (levels[i]->data_type != band_id->data_type) {
+            epr_set_err(e_err_illegal_data_type,
+                        "epr_read_band_pyramid: illegal raster data type");
+            return epr_get_last_err_code();
+        }
+        if (levels[i]->source_width != levels[0]->source_width
+                || levels[i]->source_height != levels[0]->source_height
+                || levels[i]->source_step_x == 0 || levels[i]->source_step_y == 0) {
+            epr_set_err(e_err_invalid_raster,
+                        "epr_read_band_pyramid: all rasters must have the same source region");
+            return epr_get_last_err_code();
+        }
+    }
+    source_width = levels[0]->source_width;
+    source_height = levels[0]->source_height;
+    if (source_width == 0 || source_height == 0) {
+        return e_err_none;
+    }
+
+    aggregator = epr_create_aggregator(levels, num_levels, method);
+    if (aggregator == NULL) {
+        return epr_get_last_err_code();
+    }
+    line = (double*) calloc(source_width, sizeof (double));
+    chunk = epr_create_compatible_raster(band_id, source_width,
+                                         source_height < EPR_AGG_CHUNK_HEIGHT ? source_height : EPR_AGG_CHUNK_HEIGHT,
+                                         1, 1);
+    if (chunk != NULL && band_id->bm_expr != NULL) {
+        bm_chunk = epr_create_raster(e_tid_uchar, source_width, chunk->raster_height, 1, 1);
+    }
+    if (line == NULL || chunk == NULL || (band_id->bm_expr != NULL && bm_chunk == NULL)) {
+        errcode = e_err_out_of_memory;
+        epr_set_err(e_err_out_of_memory, "epr_read_band_pyramid: out of memory");
+    }
+
+    /* the source region is decoded at full resolution, a chunk of lines at a time */
+    for (chunk_y = 0; errcode == e_err_none && chunk_y < source_height; chunk_y += chunk->raster_height) {
+        chunk_window = *chunk;
+        if (source_height - chunk_y < chunk->raster_height) {
+            chunk_window.source_height = chunk_window.raster_height = source_height - chunk_y;
+        }
+        /* the pixels failing the band's bit-mask expression are skipped, not combined as zeros */
+        if (epr_read_band_raster_unmasked(band_id, offset_x, offset_y + (int) chunk_y, &chunk_window) != e_err_none) {
+            errcode = epr_get_last_err_code();
+            break;
+        }
+        if (bm_chunk != NULL) {
+            bm_window = *bm_chunk;
+            bm_window.source_height = bm_window.raster_height = chunk_window.raster_height;
+            if (epr_read_bitmask_raster(band_id->product_id, band_id->bm_expr,
+                                        offset_x, offset_y + (int) chunk_y, &bm_window) != e_err_none) {
+                errcode = epr_get_last_err_code();
+                break;
+            }
+        }
+        for (y = 0; y < chunk_window.raster_height; y++) {
+            for (x = 0; x < source_width; x++) {
+                line[x] = epr_get_agg_value(chunk->buffer, chunk->data_type, y * source_width + x);
+            }
+            epr_aggregate_line(aggregator, line,
+                               bm_chunk != NULL ? (const uchar*) bm_chunk->buffer + y * source_width : NULL);
+        }
+    }
+
+    epr_free_aggregator(aggregator);
+    free(line);
+    epr_free_raster(bm_chunk);
+    epr_free_raster(chunk);
+    return errcode;
+}
+
+
+int epr_read_band_raster_aggregated(EPR_SBandId* band_id,
+                                    int offset_x,
+                                    int offset_y,
+                                    EPR_SRaster* raster,
+                                    EPR_EAggregationMethod method)
+{
+    return epr_read_band_pyramid(band_id, offset_x, offset_y, &raster, 1, method);
+}
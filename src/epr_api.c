@@ -26,6 +26,7 @@
 #include "epr_core.h"
 #include "epr_string.h"
 #include "epr_ptrarray.h"
+#include "epr_simd.h"
 #include "epr_swap.h"
 
 #include "epr_dddb.h"
@@ -61,8 +62,7 @@ int epr_init_api(EPR_ELogLevel   log_level,
     epr_api.log_level        = log_level;
     epr_api.log_handler      = log_handler;
     epr_api.err_handler      = err_handler;
-    epr_api.last_err_code    = e_err_none;
-    epr_api.last_err_message = NULL;
+    epr_api.cpu_features     = epr_detect_cpu_features();
     epr_api.init_flag        = TRUE;
 
     epr_log(e_log_info, EPR_PRODUCT_API_NAME_STR ", version " EPR_PRODUCT_API_VERSION_STR);
@@ -73,6 +73,13 @@ int epr_init_api(EPR_ELogLevel   log_level,
     } else {
         epr_log(e_log_debug, "running on a big endian order architecture");
     }
+    if (epr_api.cpu_features & EPR_CPU_AVX2) {
+        epr_log(e_log_debug, "using AVX2 line decoders");
+    } else if (epr_api.cpu_features & EPR_CPU_SSE2) {
+        epr_log(e_log_debug, "using SSE2 line decoders");
+    } else if (epr_api.cpu_features & EPR_CPU_NEON) {
+        epr_log(e_log_debug, "using NEON line decoders");
+    }
 
     return epr_get_last_err_code();
 }
@@ -93,8 +100,6 @@ void epr_close_api(void)
 
     if (epr_api.init_flag) {
         epr_log(e_log_info, "ENVISAT product reader API is being closed");
-        epr_api.last_err_code = e_err_none;
-        epr_free_and_null_string(&epr_api.last_err_message);
         epr_api.init_flag = FALSE;
     }
 }
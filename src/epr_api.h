@@ -62,6 +62,13 @@ enum EPR_DataTypeId
     e_tid_float   = 7,
     /** An array of 64-bit floating point numbers, C type is <code>double*</code> */
     e_tid_double  = 8,
+    /** An array of 16-bit (IEEE 754 half precision) floating point numbers, C type is <code>ushort*</code>.
+        Used for rasters only, it does not occur in product files. */
+    e_tid_half    = 9,
+    /** A packed bit-mask, one bit per pixel, C type is <code>ulong*</code>. Each raster line starts
+        with a new word of <code>EPR_BITMASK_WORD_BITS</code> pixels (32 or 64, depending on the
+        platform), see <code>EPR_BITMASK_LINE_WORDS</code>. Used for rasters only. */
+    e_tid_bit     = 10,
     /** A zero-terminated ASCII string, C type is <code>char*</code> */
     e_tid_string  = 11,
     /** An array of unsigned character, C type is <code>uchar*</code> */
@@ -150,6 +157,39 @@ enum EPR_ScalingMethod
     e_smid_log = 2
 };
 
+/**
+ * The <code>EPR_IOMode</code> enumeration lists the possible ways
+ * dataset records are read from an opened product file.
+ *
+ * @see epr_open_product_ex
+ */
+enum EPR_IOMode
+{
+    /** Records are read through the ANSI C input stream (<code>fseek</code>/<code>fread</code>). */
+    e_io_stdio = 0,
+    /** The product file is mapped read-only into memory and records are copied from the mapping. */
+    e_io_mmap  = 1
+};
+
+/**
+ * The <code>EPR_AggregationMethod</code> enumeration lists the ways the
+ * pixels of a <code>source_step_x</code> x <code>source_step_y</code> block
+ * are combined into a single raster element by an aggregated read.
+ *
+ * @see epr_read_band_raster_aggregated
+ */
+enum EPR_AggregationMethod
+{
+    /** The mean of the pixels, rounded to the nearest integer for integer data types. */
+    e_agg_mean = 0,
+    /** The minimum of the pixels. */
+    e_agg_min  = 1,
+    /** The maximum of the pixels. */
+    e_agg_max  = 2,
+    /** The most frequent pixel value, the smallest one of equally frequent values (e.g. for flags). */
+    e_agg_mode = 3
+};
+
 struct EPR_ProductId;
 struct EPR_DatasetId;
 struct EPR_BandId;
@@ -165,12 +205,24 @@ struct EPR_Flag;
 struct EPR_BandId;
 struct EPR_ParamElem;
 struct EPR_Time;
+struct EPR_BandReadPlan;
+struct EPR_ScalingLUT;
+struct EPR_TiePointGrid;
+struct EPR_BmCache;
+struct EPR_TileCache;
+struct EPR_Mutex;
+struct EPR_Batch;
+struct EPR_BandStats;
+struct EPR_BandMath;
+struct EPR_FlagStats;
 
 typedef enum   EPR_DataTypeId      EPR_EDataTypeId;
 typedef enum   EPR_ErrCode         EPR_EErrCode;
 typedef enum   EPR_LogLevel        EPR_ELogLevel;
 typedef enum   EPR_SampleModel     EPR_ESampleModel;
 typedef enum   EPR_ScalingMethod   EPR_EScalingMethod;
+typedef enum   EPR_IOMode          EPR_EIOMode;
+typedef enum   EPR_AggregationMethod EPR_EAggregationMethod;
 typedef struct EPR_ProductId       EPR_SProductId;
 typedef struct EPR_DatasetId       EPR_SDatasetId;
 typedef struct EPR_BandId          EPR_SBandId;
@@ -186,6 +238,10 @@ typedef struct EPR_Time            EPR_STime;
 typedef struct EPR_DatasetRef      EPR_SDatasetRef;
 typedef struct EPR_BitmaskTerm     EPR_SBitmaskTerm;
 typedef struct EPR_FlagSet         EPR_SFlagSet;
+typedef struct EPR_Batch           EPR_SBatch;
+typedef struct EPR_BandStats       EPR_SBandStats;
+typedef struct EPR_BandMath        EPR_SBandMath;
+typedef struct EPR_FlagStats       EPR_SFlagStats;
 typedef void (*EPR_FErrHandler)(EPR_EErrCode err_code, const char* err_message);
 typedef void (*EPR_FLogHandler)(EPR_ELogLevel log_level, const char* log_message);
 
@@ -196,6 +252,11 @@ typedef unsigned short ushort;
 typedef unsigned int   uint;
 typedef unsigned long  ulong;
 
+typedef void (*EPR_FTask)(void* task_data);
+typedef void (*EPR_FExecutor)(EPR_FTask task, void** task_data, uint num_tasks, void* executor_data);
+typedef int (*EPR_FBatchConsumer)(void* consumer_data, const char* product_file_path, EPR_SBandId* band_id, const EPR_SRaster* raster);
+typedef int (*EPR_FLineConsumer)(void* consumer_data, EPR_SBandId* band_id, uint y, const EPR_SRaster* line);
+
 
 typedef int EPR_Magic;
 
@@ -212,6 +273,26 @@ typedef int EPR_Magic;
 
 #define EPR_PRODUCT_ID_STRLEN    48
 
+/* the default size of the bitmask cache of a product, see epr_set_bitmask_cache_size() */
+#define EPR_DEFAULT_BM_CACHE_SIZE    (64 * 1024 * 1024)
+
+/* the number of pixels held by a word of a packed bit-mask raster (e_tid_bit),
+ * the width of an unsigned long: 64 on LP64 platforms, but 32 on 32-bit platforms
+ * and 64-bit Windows (LLP64). The layout of packed rasters is therefore platform
+ * dependent and must not be written to files or exchanged between platforms. */
+#define EPR_BITMASK_WORD_BITS    (8 * sizeof (ulong))
+
+/* the number of words of a line of a packed bit-mask raster, pixel x of a line is
+ * bit (x % EPR_BITMASK_WORD_BITS) of word (x / EPR_BITMASK_WORD_BITS) */
+#define EPR_BITMASK_LINE_WORDS(raster_width) (((raster_width) + EPR_BITMASK_WORD_BITS - 1) / EPR_BITMASK_WORD_BITS)
+
+/* the default number of blocks of records read ahead, see epr_set_read_ahead() */
+#define EPR_DEFAULT_READ_AHEAD_DEPTH 2
+
+/* the default tile size and tile cache size of a product, see epr_set_tile_cache() */
+#define EPR_DEFAULT_TILE_SIZE        256
+#define EPR_DEFAULT_TILE_CACHE_SIZE  (64 * 1024 * 1024)
+
 
 /*************************************************************************/
 /******************************** STRUCTURES *****************************/
@@ -317,6 +398,66 @@ struct EPR_ProductId
      * Contains and array of all band IDs for the product (type EPR_SBandId*)
      */
     EPR_SPtrArray* band_ids;
+
+    /**
+     * The I/O mode in use for this product. This is <code>e_io_stdio</code>
+     * if the product was opened in stdio mode or if mapping the file failed.
+     */
+    EPR_EIOMode io_mode;
+
+    /**
+     * The read-only memory mapping of the whole product file
+     * (<code>tot_size</code> bytes) if <code>io_mode</code> is
+     * <code>e_io_mmap</code>, <code>NULL</code> otherwise.
+     */
+    const uchar* mapped_data;
+
+    /**
+     * The cache of parsed bitmask expressions and flag rasters, created
+     * on the first bitmask read (for internal use only).
+     */
+    struct EPR_BmCache* bm_cache;
+
+    /**
+     * The lock serializing the creation of the data cached by the product
+     * and its bands, so that several threads can read the same product
+     * (for internal use only).
+     */
+    struct EPR_Mutex* lock;
+
+    /**
+     * The number of threads decoding a band raster, 0 or 1 if band
+     * rasters are decoded by the calling thread.
+     */
+    uint num_read_threads;
+
+    /**
+     * The executor running the strips of a band raster decoded by
+     * several threads, <code>NULL</code> to use threads started by the API.
+     */
+    EPR_FExecutor read_executor;
+
+    /**
+     * The data passed to each call of <code>read_executor</code>.
+     */
+    void* read_executor_data;
+
+    /**
+     * The number of bytes of records read at once by the read-ahead thread,
+     * 0 if records are not read ahead (see <code>epr_set_read_ahead</code>).
+     */
+    uint read_ahead_block_size;
+
+    /**
+     * The number of blocks of records read ahead.
+     */
+    uint read_ahead_depth;
+
+    /**
+     * The cache of decoded band tiles, created on the first tiled read
+     * (for internal use only).
+     */
+    struct EPR_TileCache* tile_cache;
 };
 
 
@@ -753,6 +894,24 @@ struct EPR_BandId
      * A short description of the band's contents
      */
     char* description;
+
+    /**
+     * The read plan for measurement bands, created on the first read
+     * (for internal use only).
+     */
+    struct EPR_BandReadPlan* read_plan;
+
+    /**
+     * The lookup table of log-scaled physical values, created on the first
+     * decode of a log-scaled band (for internal use only).
+     */
+    struct EPR_ScalingLUT* scaling_lut;
+
+    /**
+     * The tie point grid of annotation bands, created on the first read
+     * (for internal use only).
+     */
+    struct EPR_TiePointGrid* tie_point_grid;
 };
 
 /**
@@ -768,6 +927,85 @@ struct EPR_Time
     uint microseconds;
 };
 
+/**
+ * The statistics of the valid pixels of a band, computed by
+ * <code>epr_compute_band_stats</code>.
+ */
+struct EPR_BandStats
+{
+    /**
+     * The number of pixels visited.
+     */
+    uint num_pixels;
+
+    /**
+     * The number of valid pixels visited, i.e. pixels which are not masked
+     * out by the band's bit-mask expression and which are not NaN.
+     */
+    uint num_valid;
+
+    /**
+     * The minimum, maximum, mean and standard deviation of the valid pixels.
+     */
+    double min;
+    double max;
+    double mean;
+    double stddev;
+
+    /**
+     * The number of bins of the histogram, zero if no histogram was computed.
+     */
+    uint num_bins;
+
+    /**
+     * The value range of the histogram. The bin of a value <code>v</code> is
+     * <code>(v - hist_min) / (hist_max - hist_min) * num_bins</code>, the value
+     * <code>hist_max</code> falls into the last bin. Values outside of the range
+     * are not counted.
+     */
+    double hist_min;
+    double hist_max;
+
+    /**
+     * The number of valid pixels in each bin.
+     */
+    uint* histogram;
+};
+
+/**
+ * The number of pixels of a flag band which have each of the flags of the
+ * band's flag coding set, computed by <code>epr_compute_flag_stats</code>.
+ */
+struct EPR_FlagStats
+{
+    /**
+     * The number of pixels visited.
+     */
+    uint num_pixels;
+
+    /**
+     * The number of flags of the band's flag coding.
+     */
+    uint num_flags;
+
+    /**
+     * The flags, in the order of the flag coding. The flag definitions
+     * belong to the band.
+     */
+    const EPR_SFlagDef** flags;
+
+    /**
+     * The number of pixels which have all bits of <code>flags[i]->bit_mask</code> set.
+     */
+    uint* counts;
+
+    /**
+     * The packed bit-mask raster (e_tid_bit) of each flag, in which the pixels
+     * having the flag set are set, or <code>NULL</code> if not requested.
+     */
+    EPR_SRaster** bitplanes;
+};
+
 
 
 /*************************************************************************/
@@ -786,6 +1024,9 @@ struct EPR_Time
 /**
  * Initializes the ENVISAT product reader API.
  *
+ * <p>The API must be initialized before any other thread uses it. Afterwards
+ * different products can be opened, read and closed concurrently from
+ * several threads; the error state is kept separately for each thread.
  *
  * @param log_level the log level. All logging messages with a log level lower
  *        than the given one, will be suppressed
@@ -876,7 +1117,7 @@ void epr_set_err_handler(EPR_FErrHandler err_handler);
 
 /**
  * Gets the error code of the error that occurred during
- * the last API function call.
+ * the last API function call of the calling thread.
  *
  * @return the error code, <code>e_err_none</code> or zero if no error occurred
  */
@@ -884,14 +1125,14 @@ EPR_EErrCode epr_get_last_err_code(void);
 
 /**
  * Gets the error message of the error that occurred during
- * the last API function call.
+ * the last API function call of the calling thread.
  *
  * @return the error message, <code>NULL</code> if no error occurred
  */
 const char* epr_get_last_err_message(void);
 
 /**
- * Clears the last error. After calling this function, calling
+ * Clears the last error of the calling thread. After calling this function, calling
  * <code>epr_get_last_err_code</code> returns <code>e_err_none</code> or zero and
  * <code>epr_get_last_err_message</code> returns <code>NULL</code>.
  */
@@ -932,6 +1173,87 @@ void epr_clear_err(void);
  */
 EPR_SProductId* epr_open_product(const char* product_file_path);
 
+/**
+ * Opens the ENVISAT product file with the given file path using
+ * the given I/O mode. Apart from the I/O mode the function behaves
+ * exactly like <code>epr_open_product</code>.
+ *
+ * <p>If <code>e_io_mmap</code> is requested but the file cannot be mapped
+ * into memory (e.g. because the address space is exhausted), the product
+ * silently falls back to <code>e_io_stdio</code>. Use
+ * <code>epr_get_io_mode</code> to find out which mode is actually in use.
+ *
+ * @param product_file_path the path to the ENVISAT product file
+ * @param io_mode the requested I/O mode
+ * @return the product identifier, or <code>NULL</code> if the file
+ *         could not be opened.
+ */
+EPR_SProductId* epr_open_product_ex(const char* product_file_path, EPR_EIOMode io_mode);
+
+/**
+ * Gets the I/O mode actually used for the given product.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @return the I/O mode, <code>e_io_stdio</code> if an error occurred
+ */
+EPR_EIOMode epr_get_io_mode(const EPR_SProductId* product_id);
+
+/**
+ * Sets the number of threads decoding a band raster of the given product.
+ *
+ * <p>With more than one thread, <code>epr_read_band_raster</code> splits
+ * the raster of a measurement band into strips of lines which are read,
+ * decoded and mirrored independently, the call returns when all strips
+ * are complete. By default band rasters are decoded by the calling thread.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param num_threads the number of threads, 0 or 1 to decode band rasters
+ *        in the calling thread
+ * @return zero for success, an error code otherwise
+ */
+int epr_set_read_threads(EPR_SProductId* product_id, uint num_threads);
+
+/**
+ * Sets the executor running the strips of a band raster decoded by several
+ * threads, e.g. to use the thread pool of the application instead of
+ * threads started by the API (see <code>epr_set_read_threads</code>).
+ *
+ * <p>The executor must call <code>task(task_data[i])</code> once for each
+ * <code>i</code> in <code>[0, num_tasks)</code>, in any order and on any
+ * threads, and must return only when all calls have completed. The number
+ * of strips is derived from the thread count set by
+ * <code>epr_set_read_threads</code>.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param executor the executor, <code>NULL</code> to use threads started by the API
+ * @param executor_data passed unchanged to each call of the executor
+ * @return zero for success, an error code otherwise
+ */
+int epr_set_read_executor(EPR_SProductId* product_id, EPR_FExecutor executor, void* executor_data);
+
+/**
+ * Enables reading records ahead for the band rasters of the given product.
+ *
+ * <p>A background thread then reads blocks of the upcoming records of a band
+ * into a ring of buffers while the calling thread decodes the records of the
+ * current block, so that the latency of the reads (e.g. of a network file
+ * system) is hidden behind the decoding. Each block is read at once, and the
+ * operating system is told that the records are read sequentially. When the
+ * rows of a subsampled raster are far apart, they are read one by one instead.
+ * Read-ahead only applies to products in stdio mode (see <code>epr_get_io_mode</code>),
+ * and not to band rasters decoded in strips by several threads (see
+ * <code>epr_set_read_threads</code>), whose threads already overlap reading
+ * and decoding.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param block_size the number of bytes of records read at once, 0 to read
+ *        each record when it is decoded
+ * @param depth the number of blocks read ahead, 0 for <code>EPR_DEFAULT_READ_AHEAD_DEPTH</code>;
+ *        with a depth of 1 the blocks are read by the calling thread
+ * @return zero for success, an error code otherwise
+ */
+int epr_set_read_ahead(EPR_SProductId* product_id, uint block_size, uint depth);
+
 /**
  * Closes the ENVISAT product file determined by the given product identifier.
  *
@@ -1144,6 +1466,37 @@ EPR_SRecord* epr_read_record(EPR_SDatasetId* dataset_id,
                              uint record_index,
                              EPR_SRecord* record);
 
+/**
+ * Reads a range of consecutive records of a dataset specified by dataset_id.
+ * <p>
+ * The records are read with a single I/O call into one buffer and then
+ * swapped into the byte order of the host. This is much faster than calling
+ * <code>epr_read_record</code> for each record, e.g. when dumping all records
+ * of an annotation dataset. The buffer holds all records of the range at
+ * once, so large measurement datasets should be read in smaller ranges.
+ * <p>
+ * An array of <code>num_records</code> records, (pre-) created by the
+ * function <code>epr_create_record</code> or returned by a previous call,
+ * can be passed to this function. Missing (<code>NULL</code>) records of
+ * the array are created. If no array (<code>NULL</code>) is given, the
+ * function allocates a new one, which must be released with
+ * <code>epr_free_records</code>.
+ *
+ * @param dataset_id the dataset identifier, must not be <code>NULL</code>
+ * @param first_index the zero-based index of the first record
+ * @param num_records the number of records to be read, must be greater
+ *        than zero and not exceed the records following first_index
+ * @param records an array of num_records records to reduce memory
+ *        reallocation, can be <code>NULL</code> to let the function
+ *        allocate a new array
+ * @return the array of the records in which the data has been read into
+ *         or <code>NULL</code> if an error occurred.
+ */
+EPR_SRecord** epr_read_records(EPR_SDatasetId* dataset_id,
+                               uint first_index,
+                               uint num_records,
+                               EPR_SRecord** records);
+
 /**
  * Frees the memory allocated through the given record.
  *
@@ -1153,6 +1506,15 @@ EPR_SRecord* epr_read_record(EPR_SDatasetId* dataset_id,
  */
 void epr_free_record(EPR_SRecord* record);
 
+/**
+ * Frees the records of the given array and the array itself.
+ *
+ * @param records the array returned by <code>epr_read_records</code>,
+ *        can be <code>NULL</code>
+ * @param num_records the number of records of the array
+ */
+void epr_free_records(EPR_SRecord** records, uint num_records);
+
 /** @} */
 
 /*
@@ -1423,6 +1785,10 @@ EPR_SRaster* epr_create_bitmask_raster(uint source_width,
  * a raster. In this routine the coordinates are specified, where the source-region to be read starts.
  * The dimension of the region and the sub-sampling are attributes of the raster into which the data are
  * read.
+ * <p>The raster usually has the band's data type (see <code>epr_create_compatible_raster</code>). It may
+ * have any other numeric type, including <code>e_tid_half</code>: each line of values is then converted
+ * right after it has been decoded. Conversions into integer types round to the nearest integer and clip
+ * to the range of the type.
  *
  * @param band_id the identified of the band to be read into the raster.
  * @param offset_x across-track source coordinate in pixel coordinates (zero-based) of the upper right corner of the source-region
@@ -1439,6 +1805,117 @@ int epr_read_band_raster(EPR_SBandId* band_id,
                          int offset_y,
                          EPR_SRaster* raster);
 
+/**
+ * Reads (geo-)physical values of several bands of the same source-region at once.
+ * <p>Bands stored in the same measurement dataset whose rasters have the same
+ * dimension and sub-sampling are read in a single pass: each record is read
+ * only once and decoded for all of these bands. The result is the same as
+ * calling <code>epr_read_band_raster</code> for each band in turn.
+ *
+ * @param band_ids the identifiers of the bands to be read
+ * @param rasters the rasters into which the bands are read, <code>rasters[i]</code>
+ *        receives the values of <code>band_ids[i]</code>
+ * @param num_bands the number of bands and rasters
+ * @param offset_x across-track source coordinate in pixel coordinates (zero-based) of the upper right corner of the source-region
+ * @param offset_y along-track source coordinate in pixel coordinates (zero-based) of the upper right corner of the source-region
+ *
+ * @return zero for success, and error code otherwise
+ *
+ * @see epr_read_band_raster
+ */
+int epr_read_band_rasters(EPR_SBandId** band_ids,
+                          EPR_SRaster** rasters,
+                          uint num_bands,
+                          int offset_x,
+                          int offset_y);
+
+/**
+ * Reads the full scene of several bands of a product in a single sequential
+ * pass over the product file. The datasets of the bands are visited in the
+ * order of their offsets in the file and the records of each dataset are read
+ * front to back in large chunks, each record exactly once: measurement records
+ * are decoded for all bands of the dataset, annotation records fill the tie
+ * point grids of all bands of the dataset, which are then interpolated. All
+ * file accesses thus have increasing offsets, which suits slow sequential media
+ * and read-ahead.
+ * <p>Each line is passed to the consumer as soon as it is complete, as a raster
+ * of height one together with the index of its scene line. If <code>rasters[i]</code> is <code>NULL</code>, the lines of
+ * <code>band_ids[i]</code> are only passed to the consumer and are read at full
+ * resolution, otherwise the raster receives the band as with
+ * <code>epr_read_band_raster</code> for a source region covering the scene. Unlike
+ * <code>epr_read_band_raster</code>, bit-mask expressions of the bands are not
+ * applied, because evaluating them requires reading the flag datasets out of
+ * order; use <code>epr_read_bitmask_raster</code> and <code>epr_apply_bitmask</code>
+ * afterwards if needed.
+ *
+ * @param band_ids the identifiers of the bands to be read, all of the same product
+ * @param rasters the rasters into which the bands are read, the source region of
+ *        each raster must cover the scene, can be <code>NULL</code> if a consumer is given
+ * @param num_bands the number of bands and rasters
+ * @param consumer the function receiving the lines, can be <code>NULL</code> if all
+ *        rasters are given
+ * @param consumer_data passed unchanged to each call of the consumer
+ * @return zero for success, the value returned by the consumer if it returned a value
+ *         other than zero, which stops the pass, an error code otherwise
+ *
+ * @see epr_read_band_rasters
+ */
+int epr_read_product_sequentially(EPR_SBandId** band_ids,
+                                  EPR_SRaster** rasters,
+                                  uint num_bands,
+                                  EPR_FLineConsumer consumer,
+                                  void* consumer_data);
+
+/**
+ * Reads the raw counts of the given measurement band, i.e. the samples as
+ * stored in the product without scaling and without applying the band's
+ * bit-mask expression. Lines are mirrored as in <code>epr_read_band_raster</code>.
+ * <p>The raster of the raw counts needs much less memory than the one of the
+ * physical values if it has the data type returned by
+ * <code>epr_get_band_raw_data_type</code>, e.g. <code>e_tid_ushort</code> for
+ * MERIS radiances. Other numeric data types are converted to as in
+ * <code>epr_read_band_raster</code>.
+ *
+ * @param band_id the identifier of the measurement band to be read into the raster.
+ * @param offset_x across-track source coordinate in pixel coordinates (zero-based) of the upper right corner of the source-region
+ * @param offset_y along-track source coordinate in pixel coordinates (zero-based) of the upper right corner of the source-region
+ * @param raster the raster into which the counts are read
+ *
+ * @return zero for success, and error code otherwise
+ *
+ * @see epr_get_band_raw_data_type
+ */
+int epr_read_band_raw_raster(EPR_SBandId* band_id,
+                             int offset_x,
+                             int offset_y,
+                             EPR_SRaster* raster);
+
+/**
+ * Gets the data type of the raw counts of the given measurement band, as read
+ * by <code>epr_read_band_raw_raster</code>. The physical values are
+ * <code>scaling_offset + scaling_factor * count</code> for linearly scaled bands.
+ *
+ * @param band_id the identifier of the measurement band
+ * @return the data type or <code>e_tid_unknown</code> if the band has no raw counts.
+ */
+EPR_EDataTypeId epr_get_band_raw_data_type(EPR_SBandId* band_id);
+
+/**
+ * Converts all elements of a raster into another numeric data type at once,
+ * instead of getting them one by one with the <code>epr_get_pixel_as_*</code>
+ * functions. Conversions into integer types round to the nearest integer and
+ * clip to the range of the type, <code>e_tid_half</code> gives 16-bit floating
+ * point numbers.
+ *
+ * @param raster the raster to be converted, must not be <code>NULL</code>
+ * @param buffer the array receiving <code>raster_width * raster_height</code>
+ *        elements of the given data type
+ * @param data_type the data type of the elements of the array
+ *
+ * @return zero for success, and error code otherwise
+ */
+int epr_convert_raster(const EPR_SRaster* raster, void* buffer, EPR_EDataTypeId data_type);
+
 
 /**
  * @todo 1 se/nf - doku
@@ -1523,6 +2000,335 @@ const char* epr_get_band_name(EPR_SBandId* band_id);
  */
 void epr_free_raster(EPR_SRaster* raster);
 
+/**
+ * Reads the given window of a band like <code>epr_read_band_raster</code>,
+ * but assembles it from the decoded tiles in the tile cache of the product.
+ * <p>
+ * The scene is divided into tiles of a fixed size (see
+ * <code>epr_set_tile_cache</code>). Tiles which are not cached yet are read
+ * and decoded as a whole and kept in the cache, so that overlapping or
+ * neighbouring windows, as requested while panning and zooming over a scene,
+ * are copied from memory instead of being read from the file again.
+ * If the cache exceeds its size, the least recently used tiles are released.
+ * <p>
+ * In contrast to <code>epr_read_band_raster</code>, the window must lie
+ * within the scene.
+ *
+ * @param band_id the identifier of the band to be read
+ * @param offset_x the X-offset of the window in the scene
+ * @param offset_y the Y-offset of the window in the scene
+ * @param raster the raster receiving the data, its source region and steps
+ *        define the window
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_window(EPR_SBandId* band_id,
+                         int offset_x,
+                         int offset_y,
+                         EPR_SRaster* raster);
+
+/**
+ * Reads a single tile of a band from the tile cache of the product,
+ * reading and caching it if necessary (see <code>epr_read_band_window</code>).
+ * The raster must have the size of a tile and steps of 1; the pixels of the
+ * tiles in the last column and row of the grid which lie outside of the
+ * scene are set to zero.
+ *
+ * @param band_id the identifier of the band to be read
+ * @param tile_x the column of the tile, from 0 to <code>(scene_width - 1) / tile_width</code>
+ * @param tile_y the row of the tile, from 0 to <code>(scene_height - 1) / tile_height</code>
+ * @param raster the raster receiving the tile
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_tile(EPR_SBandId* band_id,
+                       uint tile_x,
+                       uint tile_y,
+                       EPR_SRaster* raster);
+
+/**
+ * Sets the tile size and the maximum number of bytes of decoded tiles kept
+ * in the tile cache of the given product. Changing the tile size releases
+ * all cached tiles. A size of zero disables the caching of tiles. The
+ * defaults are <code>EPR_DEFAULT_TILE_SIZE</code> and
+ * <code>EPR_DEFAULT_TILE_CACHE_SIZE</code>.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param tile_width the width of a tile in pixels, must not be zero
+ * @param tile_height the height of a tile in pixels, must not be zero
+ * @param max_bytes the maximum size of the cached tiles in bytes
+ * @return zero for success, an error code otherwise
+ */
+int epr_set_tile_cache(EPR_SProductId* product_id, uint tile_width, uint tile_height, uint max_bytes);
+
+/**
+ * Releases all tiles cached for the given product.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @return zero for success, an error code otherwise
+ */
+int epr_clear_tile_cache(EPR_SProductId* product_id);
+
+/**
+ * Reads a band raster like <code>epr_read_band_raster</code>, but instead of
+ * taking the first pixel of each <code>source_step_x</code> x
+ * <code>source_step_y</code> block of the source region, combines all pixels
+ * of the block with the given method. This gives quicklooks without the
+ * aliasing of the plain subsampling. The blocks of the last column and row
+ * are clipped to the source region.
+ * <p>
+ * The source region is decoded at full resolution a few lines at a time while
+ * the blocks are combined, so the memory used does not depend on its height.
+ * Pixels failing the band's bit-mask expression are left out of their block,
+ * like in <code>epr_compute_band_stats</code>; a block without valid pixels is
+ * set to zero, like a masked pixel of <code>epr_read_band_raster</code>.
+ *
+ * @param band_id the identifier of the band to be read
+ * @param offset_x the X-offset of the source region in the scene
+ * @param offset_y the Y-offset of the source region in the scene
+ * @param raster the raster receiving the data
+ * @param method the aggregation method
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_raster_aggregated(EPR_SBandId* band_id,
+                                    int offset_x,
+                                    int offset_y,
+                                    EPR_SRaster* raster,
+                                    EPR_EAggregationMethod method);
+
+/**
+ * Reads several aggregated rasters of the same source region of a band, e.g.
+ * the levels of an overview pyramid, in a single pass over the file. Each
+ * raster is filled like by <code>epr_read_band_raster_aggregated</code> with
+ * its own <code>source_step_x</code> and <code>source_step_y</code>; all
+ * rasters must have the same source region size.
+ * <p>
+ * Example, an overview pyramid with levels subsampled by 2, 4 and 8:
+ * <pre>
+ *   for (i = 0; i < 3; i++) {
+ *       levels[i] = epr_create_compatible_raster(band_id, width, height, 2 << i, 2 << i);
+ *   }
+ *   epr_read_band_pyramid(band_id, 0, 0, levels, 3, e_agg_mean);
+ * </pre>
+ *
+ * @param band_id the identifier of the band to be read
+ * @param offset_x the X-offset of the source region in the scene
+ * @param offset_y the Y-offset of the source region in the scene
+ * @param levels the rasters receiving the data
+ * @param num_levels the number of rasters
+ * @param method the aggregation method
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_pyramid(EPR_SBandId* band_id,
+                          int offset_x,
+                          int offset_y,
+                          EPR_SRaster** levels,
+                          uint num_levels,
+                          EPR_EAggregationMethod method);
+
+/**
+ * Computes the statistics and, optionally, the histogram of the valid pixels
+ * of a band without reading the whole band raster into memory. The band is
+ * read a few lines at a time through the usual decoders, so the memory used
+ * does not depend on the size of the scene. Pixels masked out by the band's
+ * bit-mask expression, and NaN values, are not counted.
+ * <p>
+ * With a <code>step</code> of 1 all pixels are visited, with a larger step
+ * only every step-th pixel of every step-th line, which gives approximate
+ * statistics at a fraction of the cost.
+ * <p>
+ * If <code>hist_min</code> is less than <code>hist_max</code>, the histogram
+ * is computed for that range in the same pass. Otherwise its range is the
+ * range of the valid pixels, which takes a second pass over the band.
+ *
+ * @param band_id the identifier of the band
+ * @param step the sampling step in both directions, 1 for exact statistics
+ * @param num_bins the number of bins of the histogram, zero for no histogram
+ * @param hist_min the lower bound of the histogram
+ * @param hist_max the upper bound of the histogram
+ * @return the statistics, or <code>NULL</code> if an error occurred; they must be
+ *         released with <code>epr_free_band_stats</code>
+ */
+EPR_SBandStats* epr_compute_band_stats(EPR_SBandId* band_id,
+                                       uint step,
+                                       uint num_bins,
+                                       double hist_min,
+                                       double hist_max);
+
+/**
+ * Releases the given band statistics.
+ *
+ * @param stats the statistics, can be <code>NULL</code>
+ */
+void epr_free_band_stats(EPR_SBandStats* stats);
+
+/**
+ * Counts the pixels of a flag band which have each of the flags of the
+ * band's flag coding set, in a single pass over the band. The band is read
+ * a few lines at a time, the flags of each word of pixels are packed into
+ * bits and counted with a population count. Optionally the packed bit-mask
+ * of each flag is kept. The band's bit-mask expression is not applied.
+ *
+ * @param band_id the flag band, must have a flag coding
+ * @param step the sub-sampling in X and Y, 1 to visit all pixels
+ * @param with_bitplanes whether the packed bit-mask raster of each flag is kept
+ *        in <code>bitplanes</code>, their size is the one of a raster created
+ *        with <code>epr_create_packed_bitmask_raster(scene_width, scene_height, step, step)</code>
+ * @return the flag statistics, to be released with <code>epr_free_flag_stats</code>,
+ *         or <code>NULL</code> if an error occurred.
+ */
+EPR_SFlagStats* epr_compute_flag_stats(EPR_SBandId* band_id, uint step, epr_boolean with_bitplanes);
+
+/**
+ * Releases the given flag statistics and their bit-mask rasters.
+ *
+ * @param stats the flag statistics, may be <code>NULL</code>
+ */
+void epr_free_flag_stats(EPR_SFlagStats* stats);
+
+/**
+ * Compiles a band-math expression over the bands of the given product, e.g.
+ * <code>(radiance_13 - radiance_7) / (radiance_13 + radiance_7)</code>.
+ *
+ * <blockquote>
+ * <p><i>expression :=</i> <i>or-expression</i> [ <b><code>?</code></b> <i>expression</i> <b><code>:</code></b> <i>expression</i> ]
+ * <p><i>or-expression :=</i> <i>and-expression</i> { ( <b><code>or</code></b> | <b><code>||</code></b> ) <i>and-expression</i> }
+ * <p><i>and-expression :=</i> <i>not-expression</i> { ( <b><code>and</code></b> | <b><code>&&</code></b> ) <i>not-expression</i> }
+ * <p><i>not-expression :=</i> ( <b><code>not</code></b> | <b><code>!</code></b> ) <i>not-expression</i> | <i>comparison</i>
+ * <p><i>comparison :=</i> <i>sum</i> [ ( <b><code>&lt; &lt;= &gt; &gt;= == !=</code></b> ) <i>sum</i> ]
+ * <p><i>sum :=</i> <i>product</i> { ( <b><code>+</code></b> | <b><code>-</code></b> ) <i>product</i> }
+ * <p><i>product :=</i> <i>unary</i> { ( <b><code>*</code></b> | <b><code>/</code></b> ) <i>unary</i> }
+ * <p><i>unary :=</i> ( <b><code>-</code></b> | <b><code>+</code></b> ) <i>unary</i> | <i>primary</i> [ <b><code>^</code></b> <i>unary</i> ]
+ * <p><i>primary :=</i> <i>number</i> | <i>band-name</i> | <i>band-name</i><b><code>.</code></b><i>flag-name</i>
+ *     | <i>function</i><b><code>(</code></b> <i>expression</i> [ <b><code>,</code></b> <i>expression</i> ] <b><code>)</code></b>
+ *     | <b><code>(</code></b> <i>expression</i> <b><code>)</code></b>
+ * </blockquote>
+ *
+ * <p>A flag reference like <code>l1_flags.INVALID</code> is 1 where the flag is
+ * set and 0 elsewhere, comparisons and logical operators give 1 or 0 as well, so
+ * bit-mask terms can be used in conditions, e.g.
+ * <code>l1_flags.INVALID ? NaN : radiance_13 / radiance_7</code>. The constants
+ * <code>PI</code>, <code>E</code> and <code>NaN</code> and the functions
+ * <code>sqrt exp log log10 abs floor ceil sin cos tan asin acos atan</code> and
+ * <code>atan2 pow min max</code> (with two arguments) are known. Names are
+ * resolved case-insensitively and must not be longer than 80 characters; a
+ * longer name is an <code>e_err_invalid_value</code> error naming it in full.
+ * Constant sub-expressions are computed once.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param expr the band-math expression, must not be <code>NULL</code>
+ * @return the compiled expression or <code>NULL</code> if the expression is
+ *         invalid; it must be released with <code>epr_free_band_math</code>
+ */
+EPR_SBandMath* epr_compile_band_math(EPR_SProductId* product_id, const char* expr);
+
+/**
+ * Evaluates a compiled band-math expression for the source region of the given
+ * raster. The bands used by the expression are read a few lines at a time,
+ * with the raster's subsampling, and the expression is evaluated for a whole
+ * line at once, so no full scene rasters are held in memory. The values of the
+ * bands are those of <code>epr_read_band_raster</code>, except that pixels
+ * failing a band's bit-mask expression are <code>NaN</code> instead of zero:
+ * arithmetic with them gives <code>NaN</code> and comparisons with them are
+ * false, so e.g. <code>algal_1 &gt; 0 ? 1 : 0</code> is 0 for those pixels.
+ * <p>
+ * The same compiled expression can be evaluated by several threads at a time.
+ *
+ * @param band_math the compiled expression
+ * @param offset_x the X-offset of the source region in the scene
+ * @param offset_y the Y-offset of the source region in the scene
+ * @param raster the raster receiving the values, of type <code>float</code> or
+ *        <code>double</code>
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_math_raster(EPR_SBandMath* band_math,
+                              int offset_x,
+                              int offset_y,
+                              EPR_SRaster* raster);
+
+/**
+ * Releases a compiled band-math expression.
+ *
+ * @param band_math the compiled expression, can be <code>NULL</code>
+ */
+void epr_free_band_math(EPR_SBandMath* band_math);
+
+/** @} */
+
+/*
+ * ============================ (6.1a) Batch Processing =========================
+ */
+
+/**
+ * @ingroup IO
+ * @defgroup BATCH Batch Processing
+ * A batch reads the full rasters of the bands of many products with a pool of
+ * worker threads. Each worker keeps its own queue of tasks (opening a product,
+ * reading a band) and idle workers steal tasks from the others, so that a few
+ * large products do not leave threads without work. The number of products open
+ * at the same time and the number of rasters read but not yet consumed are
+ * bounded, which keeps the memory in use independent of the size of the batch.
+ * @{
+ */
+
+/**
+ * Creates a new, empty batch.
+ *
+ * @param num_threads the number of worker threads, zero for one thread
+ * @param max_open_products the maximum number of products open at the same time,
+ *        zero for <code>num_threads + 1</code>
+ * @param max_pending_rasters the maximum number of rasters read but not yet passed
+ *        to the consumer, zero for <code>2 * num_threads</code>
+ * @param io_mode the I/O mode the products are opened with
+ * @return the batch or <code>NULL</code> if an error occurred
+ */
+EPR_SBatch* epr_create_batch(uint num_threads,
+                             uint max_open_products,
+                             uint max_pending_rasters,
+                             EPR_EIOMode io_mode);
+
+/**
+ * Adds a product to the given batch. Products are opened in the order they are added.
+ *
+ * @param batch the batch, must not be <code>NULL</code>
+ * @param product_file_path the path of the product file, must not be <code>NULL</code>
+ * @param band_names the comma separated names of the bands to be read,
+ *        <code>NULL</code> for all bands of the product
+ * @return zero for success, an error code otherwise
+ */
+int epr_add_batch_product(EPR_SBatch* batch, const char* product_file_path, const char* band_names);
+
+/**
+ * Reads the bands of all products of the given batch and passes each raster to
+ * the given consumer as soon as it is read. The consumer is never called by two
+ * threads at the same time, but it may be called by any of the worker threads.
+ * The raster is released when the consumer returns. If the consumer returns a
+ * value other than zero, the remaining tasks of the batch are discarded.
+ * <p>
+ * A product which cannot be opened, or a band which cannot be read, is logged
+ * and counted (see <code>epr_get_batch_num_failed</code>); the other products
+ * are processed nevertheless.
+ *
+ * @param batch the batch, must not be <code>NULL</code>
+ * @param consumer the function receiving the rasters, must not be <code>NULL</code>
+ * @param consumer_data passed unchanged to each call of the consumer
+ * @return zero for success, an error code if any of the products failed
+ */
+int epr_run_batch(EPR_SBatch* batch, EPR_FBatchConsumer consumer, void* consumer_data);
+
+/**
+ * Gets the number of products of the given batch which failed in the last run.
+ *
+ * @param batch the batch
+ * @return the number of failed products
+ */
+uint epr_get_batch_num_failed(const EPR_SBatch* batch);
+
+/**
+ * Releases the given batch.
+ *
+ * @param batch the batch, can be <code>NULL</code>
+ */
+void epr_free_batch(EPR_SBatch* batch);
+
 /** @} */
 
 /*
@@ -1574,7 +2380,8 @@ double epr_get_pixel_as_double(const EPR_SRaster* raster, int x, int y);
  *                 "flags.LAND OR flags.CLOUD" or "NOT flags.WATER AND flags.TURBID_S".
  * @param offset_x across-track coordinate in pixel coordinates (zero-based) of the upper right corner of the source-region
  * @param offset_y along-track coordinate in pixel coordinates (zero-based) of the upper right corner of the source-region
- * @param raster the raster for the bit-mask. The data type of the raster must be either e_tid_uchar or e_tid_char.
+ * @param raster the raster for the bit-mask. The data type of the raster must be either e_tid_uchar, e_tid_char
+ *                 or e_tid_bit for a packed bit-mask.
  *
  * @return zero for success, an error code otherwise
  *
@@ -1586,6 +2393,84 @@ int epr_read_bitmask_raster(EPR_SProductId* product_id,
                             int offset_y,
                             EPR_SRaster* raster);
 
+/**
+ * Sets the maximum number of bytes of flag rasters kept in the bitmask
+ * cache of the given product.
+ *
+ * <p>Flag rasters read while evaluating bit-mask expressions are cached per
+ * flag band and source region, so that e.g. reading several bands which
+ * share the same flags band for the same region decodes the flags only once.
+ * The parsed bit-mask expressions are cached as well. If the cache exceeds
+ * its size, the least recently used flag rasters are released. A size of
+ * zero disables the caching of flag rasters. The default size is
+ * <code>EPR_DEFAULT_BM_CACHE_SIZE</code>.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param max_bytes the maximum size of the cached flag rasters in bytes
+ * @return zero for success, an error code otherwise
+ */
+int epr_set_bitmask_cache_size(EPR_SProductId* product_id, uint max_bytes);
+
+/**
+ * Releases all flag rasters and parsed bit-mask expressions cached for the
+ * given product.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @return zero for success, an error code otherwise
+ */
+int epr_clear_bitmask_cache(EPR_SProductId* product_id);
+
+/**
+ * Creates a packed bit-mask raster, which stores one bit per pixel instead of
+ * the byte of the rasters created by <code>epr_create_bitmask_raster</code>.
+ * The data type of the raster is <code>e_tid_bit</code>.
+ *
+ * @param source_width the width (across track dimension) of the source to be read into the raster.
+ * @param source_height the height (along track dimension) of the source to be read into the raster.
+ * @param source_step_x the subsampling step across track of the source when reading into the raster.
+ * @param source_step_y the subsampling step along track of the source when reading into the raster.
+ * @return the new raster instance
+ *         or <code>NULL</code> if an error occurred.
+ */
+EPR_SRaster* epr_create_packed_bitmask_raster(uint source_width,
+                                              uint source_height,
+                                              uint source_step_x,
+                                              uint source_step_y);
+
+/**
+ * Counts the valid pixels, i.e. the set pixels, of the given bit-mask raster.
+ *
+ * @param bm_raster the bit-mask raster of type e_tid_bit, e_tid_uchar or e_tid_char
+ * @return the number of valid pixels, zero if an error occurred.
+ */
+uint epr_count_valid_pixels(const EPR_SRaster* bm_raster);
+
+/**
+ * This group of functions combines packed bit-mask rasters a word at a time.
+ * <code>epr_and_bitmask_rasters</code> and <code>epr_or_bitmask_rasters</code> store the
+ * pixel-wise AND respectively OR of both rasters in the target raster,
+ * <code>epr_not_bitmask_raster</code> inverts the given raster. All rasters
+ * must be of type e_tid_bit and have the same size.
+ *
+ * @return zero for success, an error code otherwise
+ */
+/** @{ */
+int epr_and_bitmask_rasters(EPR_SRaster* target_raster, const EPR_SRaster* source_raster);
+int epr_or_bitmask_rasters(EPR_SRaster* target_raster, const EPR_SRaster* source_raster);
+int epr_not_bitmask_raster(EPR_SRaster* raster);
+/** @} */
+
+/**
+ * Sets the pixels of the given raster which are invalid according to the
+ * given bit-mask raster to zero. With a packed bit-mask, whole words of
+ * valid or invalid pixels are handled at once.
+ *
+ * @param raster the raster, of any numeric data type
+ * @param bm_raster the bit-mask raster of the same size, of type e_tid_bit, e_tid_uchar or e_tid_char
+ * @return zero for success, an error code otherwise
+ */
+int epr_apply_bitmask(EPR_SRaster* raster, const EPR_SRaster* bm_raster);
+
 /** @} */
 
 /*
@@ -17,6 +17,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,9 +35,15 @@
 #include "epr_msph.h"
 #include "epr_band.h"
 #include "epr_bitmask.h"
+#include "epr_io.h"
+#include "epr_thread.h"
+#include "epr_simd.h"
 
 #include "epr_dddb.h"
 
+/* the minimum number of lines of a strip of a band raster read by its own thread */
+#define EPR_MIN_STRIP_HEIGHT 16
+
 /**
  * Obtains all bands infos from the dddb.
  */
@@ -319,6 +326,10 @@ void epr_free_band_id(EPR_SBandId* band_id) {
 
     band_id->lines_mirrored = FALSE;
 
+    epr_free_band_read_plan(band_id);
+    epr_free_log_scaling_lut(band_id);
+    epr_free_tie_point_grid(band_id);
+
     free(band_id);
 }
 
@@ -542,7 +553,12 @@ EPR_SRaster* epr_create_raster(EPR_EDataTypeId data_type,
 
     num_elems = raster->raster_width * raster->raster_height;
 
-    raster->buffer = calloc(raster->elem_size, num_elems);
+    /* the lines of packed bit-masks start with a new word */
+    if (data_type == e_tid_bit) {
+        raster->buffer = calloc(sizeof (ulong), EPR_BITMASK_LINE_WORDS(raster->raster_width) * raster->raster_height);
+    } else {
+        raster->buffer = calloc(raster->elem_size, num_elems);
+    }
     if (raster->buffer == NULL) {
         epr_free_raster(raster);
         epr_set_err(e_err_out_of_memory, "epr_create_raster: out of memory");
@@ -604,23 +620,28 @@ void epr_free_raster(EPR_SRaster* raster) {
 
 
 
-int epr_read_band_raster(EPR_SBandId* band_id,
-                         int offset_x,
-                         int offset_y,
-                         EPR_SRaster* raster/*, EPR_SRaster** bitmask_raster*/) {
-
-    EPR_SProductId* product_id = NULL;
-    EPR_SDatasetId* dataset_id = NULL;
-    char* rec_type;
-
-    epr_clear_err();
-
+/**
+ * Checks the arguments of <code>epr_read_band_raster</code>. Unless
+ * <code>any_type</code> is set, the raster must have the band's data type.
+ *
+ * @return zero if the arguments are valid, an error code otherwise
+ */
+static int check_band_raster_args(EPR_SBandId* band_id,
+                                  int offset_x,
+                                  int offset_y,
+                                  EPR_SRaster* raster,
+                                  epr_boolean any_type) {
     if (band_id == NULL) {
         epr_set_err(e_err_invalid_band,
                     "epr_read_band_raster: band_id must not be NULL");
         return epr_get_last_err_code();
     }
-    if (band_id->data_type != raster->data_type) {
+    if (raster == NULL) {
+        epr_set_err(e_err_invalid_raster,
+                    "epr_read_band_raster: raster must not be NULL");
+        return epr_get_last_err_code();
+    }
+    if (any_type ? !epr_is_raster_data_type(raster->data_type) : band_id->data_type != raster->data_type) {
         epr_set_err(e_err_illegal_data_type,
                     "epr_read_band_raster: illegal raster data type");
         return epr_get_last_err_code();
@@ -635,6 +656,80 @@ int epr_read_band_raster(EPR_SBandId* band_id,
                     "epr_read_band_raster: all digit parameter must be positive");
         return epr_get_last_err_code();
     }
+    return e_err_none;
+}
+
+/**
+ * Evaluates the band's bit-mask expression for the source region of the
+ * raster into a packed bit-mask raster. The mask is applied to each line
+ * while it is decoded, instead of in a separate pass over the raster.
+ *
+ * @return the bit-mask raster or <code>NULL</code> if an error occurred
+ */
+static EPR_SRaster* read_band_bitmask(EPR_SBandId* band_id,
+                                      int offset_x,
+                                      int offset_y,
+                                      const EPR_SRaster* raster) {
+    EPR_SRaster* bm_raster;
+    /* int rd_bm; */
+
+    bm_raster = epr_create_raster(e_tid_bit,
+                                  raster->source_width,
+                                  raster->source_height,
+                                  raster->source_step_x,
+                                  raster->source_step_y);
+    if (bm_raster == NULL) {
+        return NULL;
+    }
+
+    /* rd_bm = */ epr_read_bitmask_raster(band_id->product_id,
+                                    band_id->bm_expr,
+                                    offset_x,
+                                    offset_y,
+                                    bm_raster);
+    return bm_raster;
+}
+
+/**
+ * Frees a bit-mask raster read by <code>read_band_bitmask</code>, unlike
+ * <code>epr_free_raster</code> the last error is kept.
+ */
+static void free_band_bitmask(EPR_SRaster* bm_raster) {
+    if (bm_raster != NULL) {
+        free(bm_raster->buffer);
+        free(bm_raster);
+    }
+}
+
+
+static int read_band_measurement_data(EPR_SBandId* band_id,
+                                      int offset_x,
+                                      int offset_y,
+                                      EPR_SRaster* raster,
+                                      epr_boolean raw,
+                                      const EPR_SRaster* bm_raster);
+
+
+/**
+ * Reads a band raster, the pixels of measurement data are masked with the
+ * band's bit-mask expression if <code>masked</code> is set.
+ *
+ * @return zero for success, an error code otherwise
+ */
+static int read_band_raster(EPR_SBandId* band_id,
+                            int offset_x,
+                            int offset_y,
+                            EPR_SRaster* raster,
+                            epr_boolean masked) {
+
+    EPR_SDatasetId* dataset_id = NULL;
+    char* rec_type;
+
+    epr_clear_err();
+
+    if (check_band_raster_args(band_id, offset_x, offset_y, raster, TRUE) != e_err_none) {
+        return epr_get_last_err_code();
+    }
     /*  removed because the source_step_x can truly be greater than raster_width.
     if ((raster->source_step_x>raster->raster_width) || (raster->source_step_y>raster->raster_height)) {
         epr_set_err(e_err_invalid_value,
@@ -642,40 +737,31 @@ int epr_read_band_raster(EPR_SBandId* band_id,
         return epr_get_last_err_code();
     }
     */
-    product_id = band_id->product_id;
     dataset_id = band_id->dataset_ref.dataset_id;
     rec_type = dataset_id->dsd->ds_type;
     if (strcmp(rec_type, "M") == 0) {
-        if (epr_read_band_measurement_data(band_id,
-                                           offset_x,
-                                           offset_y,
-                                           raster) != 0) {
+        EPR_SRaster* bm_raster = NULL;
+        int errcode;
+
+        if (masked && band_id->bm_expr != NULL) {
+            bm_raster = read_band_bitmask(band_id, offset_x, offset_y, raster);
+            if (bm_raster == NULL) {
+                return epr_get_last_err_code();
+            }
+        }
+        errcode = read_band_measurement_data(band_id,
+                                             offset_x,
+                                             offset_y,
+                                             raster,
+                                             FALSE,
+                                             bm_raster);
+        free_band_bitmask(bm_raster);
+        if (errcode != 0) {
             /* Do not shadow the original error message that appears to be more informative
             epr_set_err(e_err_file_read_error,
                         "epr_read_band_raster: unsuccessfully reading band measurement data");
             */
-            return epr_get_last_err_code();
-        }
-        if (band_id->bm_expr != NULL) {
-            EPR_SRaster* bm_raster;
-            /* int rd_bm; */
-
-            bm_raster = epr_create_raster(e_tid_uchar, /*was char*/
-                                          raster->source_width,
-                                          raster->source_height,
-                                          raster->source_step_x,
-                                          raster->source_step_y);
-
-            /* rd_bm = */ epr_read_bitmask_raster(product_id,
-                                            band_id->bm_expr,
-                                            offset_x,
-                                            offset_y,
-                                            bm_raster);
-
-            epr_zero_invalid_pixels(raster, bm_raster);
-
-            epr_free_raster(bm_raster);
-
+            return errcode;
         }
     } else if (strcmp(rec_type, "A") == 0) {
         if (epr_read_band_annotation_data
@@ -692,97 +778,270 @@ int epr_read_band_raster(EPR_SBandId* band_id,
     return e_err_none;
 }
 
+
+int epr_read_band_raster(EPR_SBandId* band_id,
+                         int offset_x,
+                         int offset_y,
+                         EPR_SRaster* raster/*, EPR_SRaster** bitmask_raster*/) {
+    return read_band_raster(band_id, offset_x, offset_y, raster, TRUE);
+}
+
+
+int epr_read_band_raster_unmasked(EPR_SBandId* band_id,
+                                  int offset_x,
+                                  int offset_y,
+                                  EPR_SRaster* raster) {
+    return read_band_raster(band_id, offset_x, offset_y, raster, FALSE);
+}
+
+
+
 /**
- * Reads the measurement data and converts its into physical values.
+ * Gets the lookup table of log-scaled physical values of the given band for
+ * the given raw data type, the table is built on the first call.
  *
- * @param band_id the information about properties and quantities of ENVISAT data.
- * @param offset_x X-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
- * @param offset_y Y-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
- * @param raster the instance to the buffer information was used
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param raw_type the 8 or 16 bit raw data type
+ * @return the table or <code>NULL</code> if an error occurred.
+ */
+static const float* get_log_scaling_lut(EPR_SBandId* band_id, EPR_EDataTypeId raw_type) {
+    EPR_SScalingLUT* lut = band_id->scaling_lut;
+    int is_signed, v;
+    uint i;
+
+    if (lut != NULL && lut->raw_type == raw_type) {
+        return lut->values;
+    }
+    epr_free_log_scaling_lut(band_id);
+
+    lut = (EPR_SScalingLUT*) calloc(1, sizeof (EPR_SScalingLUT));
+    if (lut == NULL) {
+        return NULL;
+    }
+    lut->raw_type = raw_type;
+    switch (raw_type) {
+        case e_tid_uchar:
+        case e_tid_char:
+            lut->size = 256;
+            break;
+        case e_tid_ushort:
+        case e_tid_short:
+            lut->size = 65536;
+            break;
+        default:
+            free(lut);
+            return NULL;
+    }
+    lut->values = (float*) malloc(lut->size * sizeof (float));
+    if (lut->values == NULL) {
+        free(lut);
+        return NULL;
+    }
+
+    /* the decoders read plain char, which may be signed or unsigned */
+    is_signed = raw_type == e_tid_short || (raw_type == e_tid_char && CHAR_MIN < 0);
+    for (i = 0; i < lut->size; i++) {
+        v = (int) i;
+        if (is_signed && i >= lut->size / 2) {
+            v -= (int) lut->size;
+        }
+        /* same expression as in the decoders to get bit-identical values */
+        lut->values[i] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * v);
+    }
+
+    band_id->scaling_lut = lut;
+    return lut->values;
+}
+
+const float* epr_get_log_scaling_lut(EPR_SBandId* band_id, EPR_EDataTypeId raw_type) {
+    const EPR_SScalingLUT* lut = band_id->scaling_lut;
+    const float* values;
+
+    /* the table is built with the read plan, before any line of the band is
+     * decoded, so the line decoders of several threads don't need the lock */
+    if (lut != NULL && lut->raw_type == raw_type) {
+        return lut->values;
+    }
+    epr_lock_mutex(band_id->product_id->lock);
+    values = get_log_scaling_lut(band_id, raw_type);
+    epr_unlock_mutex(band_id->product_id->lock);
+    return values;
+}
+
+/**
+ * Releases the lookup table of log-scaled values of the given band, if any.
  *
- * @return zero for success, an error code otherwise
+ * @param band_id the band identifier, must not be <code>NULL</code>
  */
-int epr_read_band_measurement_data(EPR_SBandId* band_id,
-                                   int offset_x,
-                                   int offset_y,
-                                   EPR_SRaster* raster) {
-    EPR_SProductId* product_id = NULL;
-    const EPR_SField* field = NULL;
-    EPR_SFieldInfo* field_info = NULL;
+void epr_free_log_scaling_lut(EPR_SBandId* band_id) {
+    if (band_id->scaling_lut == NULL) {
+        return;
+    }
+    free(band_id->scaling_lut->values);
+    free(band_id->scaling_lut);
+    band_id->scaling_lut = NULL;
+}
+
+/**
+ * Gets the read plan of the given measurement band, the plan is created
+ * on the first call.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @return the read plan or <code>NULL</code> if an error occurred.
+ */
+static const EPR_SBandReadPlan* get_band_read_plan(EPR_SBandId* band_id) {
     EPR_SDatasetId* dataset_id = NULL;
-    EPR_SRecord* record = NULL;
-    EPR_SRecord* sph_record = NULL;
-    EPR_EDataTypeId band_datatype, datatype_id;
-    EPR_ESampleModel band_smod;
-    /* uint rec_size; */
-    uint rec_numb;
-    int iY, raster_pos, delta_raster_pos;
-    int offset_x_mirrored = 0;
-    uint scan_line_length;
-    EPR_FLineDecoder decode_func;
-    uint scene_width;
+    EPR_SRecordInfo* record_info = NULL;
+    EPR_SFieldInfo* field_info = NULL;
+    EPR_SBandReadPlan* plan = NULL;
+    uint field_offset = 0;
+    int field_index;
+    int i;
 
-    product_id = band_id->product_id;
+    if (band_id->read_plan != NULL) {
+        return band_id->read_plan;
+    }
+
+    dataset_id = band_id->dataset_ref.dataset_id;
+    if (dataset_id->record_info == NULL) {
+        dataset_id->record_info = epr_get_record_info(dataset_id);
+    }
+    record_info = dataset_id->record_info;
+    if (record_info == NULL) {
+        epr_set_err(e_err_invalid_record_name,
+                    "epr_get_band_read_plan: invalid record name");
+        return NULL;
+    }
+    if (record_info->tot_size != dataset_id->dsd->dsr_size) {
+        epr_set_err(e_err_invalid_data_format,
+                    "epr_get_band_read_plan: wrong record size");
+        return NULL;
+    }
+
+    field_index = band_id->dataset_ref.field_index - 1;
+    if (field_index < 0 || field_index >= (int)record_info->field_infos->length) {
+        epr_set_err(e_err_index_out_of_range,
+                    "epr_get_band_read_plan: field index out of range");
+        return NULL;
+    }
+    for (i = 0; i < field_index; i++) {
+        field_info = (EPR_SFieldInfo*)epr_get_ptr_array_elem_at(record_info->field_infos, i);
+        field_offset += field_info->tot_size;
+    }
+    field_info = (EPR_SFieldInfo*)epr_get_ptr_array_elem_at(record_info->field_infos, field_index);
+
+    plan = (EPR_SBandReadPlan*) calloc(1, sizeof (EPR_SBandReadPlan));
+    if (plan == NULL) {
+        epr_set_err(e_err_out_of_memory,
+                    "epr_get_band_read_plan: out of memory");
+        return NULL;
+    }
+    plan->field_offset = field_offset;
+    plan->field_size = field_info->tot_size;
+    plan->raw_type = field_info->data_type_id;
+    plan->elem_size = epr_get_data_type_size(plan->raw_type);
+    plan->sample_model = band_id->sample_model;
+    switch (plan->sample_model) {
+        case e_smod_1OF2:
+        case e_smod_2OF2:
+        case e_smod_2TOF:
+            plan->pixel_size = 2 * plan->elem_size;
+            break;
+        case e_smod_3TOI:
+            plan->pixel_size = 3 * plan->elem_size;
+            break;
+        default:
+            plan->pixel_size = plan->elem_size;
+    }
+    plan->decode_func = select_raw_line_decode_function(band_id->data_type, plan->sample_model, plan->raw_type);
+    if (plan->decode_func == NULL || plan->pixel_size == 0) {
+        free(plan);
+        epr_set_err(e_err_illegal_data_type,
+                    "epr_get_band_read_plan: internal error: unknown data type");
+        return NULL;
+    }
+    plan->num_pixels = (field_info->num_elems * plan->elem_size) / plan->pixel_size;
+
+    /* the two bytes of the 2TOF model and the three of 3TOI form one count */
+    switch (plan->sample_model) {
+        case e_smod_2TOF:
+            plan->count_type = e_tid_ushort;
+            break;
+        case e_smod_3TOI:
+            plan->count_type = e_tid_uint;
+            break;
+        default:
+            plan->count_type = plan->raw_type;
+    }
+    plan->count_decode_func = select_raw_line_decode_function(plan->count_type, plan->sample_model, plan->raw_type);
+
+    /* build the table looked up by the log-scaling line decoders */
+    if (band_id->scaling_method == e_smid_log && band_id->data_type == e_tid_float) {
+        get_log_scaling_lut(band_id, plan->sample_model == e_smod_2TOF ? e_tid_ushort : plan->raw_type);
+    }
+
+    band_id->read_plan = plan;
+    return plan;
+}
+
+const EPR_SBandReadPlan* epr_get_band_read_plan(EPR_SBandId* band_id) {
+    const EPR_SBandReadPlan* plan;
+
+    epr_lock_mutex(band_id->product_id->lock);
+    plan = get_band_read_plan(band_id);
+    epr_unlock_mutex(band_id->product_id->lock);
+    return plan;
+}
+
+/**
+ * Releases the read plan of the given band, if any.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ */
+void epr_free_band_read_plan(EPR_SBandId* band_id) {
+    if (band_id->read_plan == NULL) {
+        return;
+    }
+    free(band_id->read_plan);
+    band_id->read_plan = NULL;
+}
+
+/**
+ * Gets the number of pixels of a scan line of the given product.
+ *
+ * @return zero for success, an error code otherwise
+ */
+static int get_scan_line_length(EPR_SProductId* product_id, uint* scan_line_length) {
+    const EPR_SField* field = NULL;
 
     if (strncmp(EPR_ENVISAT_PRODUCT_MERIS, product_id->id_string, 3) == 0) {
-        sph_record = product_id->sph_record;
-        field = epr_get_field(sph_record, "LINE_LENGTH");
-        scan_line_length = epr_get_field_elem_as_uint(field, 0);
+        field = epr_get_field(product_id->sph_record, "LINE_LENGTH");
+        *scan_line_length = epr_get_field_elem_as_uint(field, 0);
     } else if (strncmp(EPR_ENVISAT_PRODUCT_AATSR, product_id->id_string, 3) == 0) {
-        scan_line_length = EPR_ATS_LINE_LENGTH;
+        *scan_line_length = EPR_ATS_LINE_LENGTH;
     } else if (strncmp(EPR_ERS2_PRODUCT_ATSR2, product_id->id_string, 3) == 0) {
-        scan_line_length = EPR_AT2_LINE_LENGTH;
+        *scan_line_length = EPR_AT2_LINE_LENGTH;
     } else if (strncmp(EPR_ENVISAT_PRODUCT_ASAR, product_id->id_string, 3) == 0) {
-        scan_line_length = epr_get_scene_width(product_id);
+        *scan_line_length = epr_get_scene_width(product_id);
     } else if (strncmp(EPR_ENVISAT_PRODUCT_SAR, product_id->id_string, 3) == 0) {
-        scan_line_length = epr_get_scene_width(product_id);
+        *scan_line_length = epr_get_scene_width(product_id);
     } else {
         epr_set_err(e_err_illegal_arg,
                     "epr_read_band_measurement_data: scan line length unknown");
         return epr_get_last_err_code();
     }
+    return e_err_none;
+}
 
-    dataset_id = band_id->dataset_ref.dataset_id;
-    /*the length of measurement record size*/
-    /* rec_size = dataset_id->dsd->dsr_size; */
-    /*the number of measurement records*/
-    rec_numb = dataset_id->dsd->num_dsr;
-    /*data type in the band*/
-    band_datatype = band_id->data_type;
-    /*data model in the band*/
-    band_smod = band_id->sample_model;
-    record = epr_create_record(dataset_id);
-    field_info = (EPR_SFieldInfo*)epr_get_ptr_array_elem_at(record->info->field_infos, band_id->dataset_ref.field_index - 1);
-    datatype_id = field_info->data_type_id;
-
-    /* if the user raster (or part of) is outside bbox in source coordinates*/
-    if (offset_x + raster->source_width > (int)scan_line_length) {
-        epr_free_record(record);
-        epr_set_err(e_err_illegal_arg,
-                    "epr_read_band_measurement_data: raster x coordinates out of bounds");
-        return epr_get_last_err_code();
-    }
-    if (offset_y + raster->source_height > (int)(rec_numb)) {
-        epr_free_record(record);
-        epr_set_err(e_err_illegal_arg,
-                    "epr_read_band_measurement_data: raster y coordinates out of bounds");
-        return epr_get_last_err_code();
-    }
-    raster_pos = 0;
-    delta_raster_pos = (int)floor((raster->source_width - 1) / raster->source_step_x) + 1;
-
-    /*select the correspondent function to scaling and transform data type*/
-    decode_func = select_line_decode_function(band_datatype, band_smod, datatype_id);
-    if (decode_func == NULL) {
-        epr_free_record(record);
-        epr_set_err(e_err_illegal_data_type,
-                    "epr_read_band_measurement_data: internal error: unknown data type");
-        return epr_get_last_err_code();
-    }
+/**
+ * Gets the X-offset of the source region within the records of the band,
+ * which differs from <code>offset_x</code> if the lines are mirrored.
+ */
+int epr_get_mirrored_offset_x(const EPR_SBandId* band_id, int offset_x, const EPR_SRaster* raster) {
+    int offset_x_mirrored;
 
-    scene_width = band_id->product_id->scene_width;
     if (band_id->lines_mirrored) {
-        offset_x_mirrored = (scene_width - 1) - (offset_x + raster->source_width - 1);
+        offset_x_mirrored = (band_id->product_id->scene_width - 1) - (offset_x + raster->source_width - 1);
         /* the extra offset is used to accommodate the the effect of sampling step
          * greater than one in case of mirrored lines */
         {
@@ -792,101 +1051,706 @@ int epr_read_band_measurement_data(EPR_SBandId* band_id,
     } else {
         offset_x_mirrored = offset_x;
     }
-
-    for (iY = offset_y; (uint)iY < offset_y + raster->source_height; iY += raster->source_step_y ) {
-
-        /*get the next record by the given name*/
-        record = epr_read_record(dataset_id, iY, record);
-        if (record == NULL) {
-            return epr_get_last_err_code();
-        }
-        /*get the field at its number*/
-        field = epr_get_field_at(record, band_id->dataset_ref.field_index - 1);
-        /*get the scaled "line" of physical values*/
-        decode_func(field->elems, band_id, offset_x_mirrored, raster->source_width, raster->source_step_x, raster->buffer, raster_pos);
-        /*locate "data point" for the next "line"*/
-        raster_pos += delta_raster_pos;
-    }
-
-    if (band_id->lines_mirrored) {
-        if (band_datatype == e_tid_float) {
-            mirror_float_array((float*)raster->buffer, raster->raster_width, raster->raster_height);
-        } else if (band_datatype == e_tid_uchar || band_datatype == e_tid_char) {
-            mirror_uchar_array((uchar*)raster->buffer, raster->raster_width, raster->raster_height);
-        } else if (band_datatype == e_tid_ushort || band_datatype == e_tid_short) {
-            mirror_ushort_array((ushort*)raster->buffer, raster->raster_width, raster->raster_height);
-        } else if (band_datatype == e_tid_uint || band_datatype == e_tid_int) {
-            mirror_uint_array((uint*)raster->buffer, raster->raster_width, raster->raster_height);
-        } else {
-            epr_free_record(record);
-            epr_set_err(e_err_illegal_data_type,
-                        "epr_read_band_measurement_data: internal error: unknown data type");
-            return epr_get_last_err_code();
-        }
-    }
-
-    epr_free_record(record);
-
-    return 0;
+    return offset_x_mirrored;
 }
 
-
 /**
- * Reads the annotation data and converts its into physical values.
- *
- * @param band_id the information about properties and quantities of ENVISAT data.
- * @param offset_x X-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
- * @param offset_y Y-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
- * @param raster the instance to the buffer information was used
+ * Mirrors the lines of a raster read from a band with mirrored lines.
  *
  * @return zero for success, an error code otherwise
  */
-int epr_read_band_annotation_data(EPR_SBandId* band_id,
-                                  int offset_x,
-                                  int offset_y,
-                                  EPR_SRaster* raster) {
+static int mirror_band_raster(EPR_SRaster* raster, uint first_row, uint num_rows) {
+    EPR_EDataTypeId raster_datatype = raster->data_type;
+    uint first_pos = first_row * raster->raster_width;
+
+    if (raster_datatype == e_tid_float) {
+        mirror_float_array((float*)raster->buffer + first_pos, raster->raster_width, num_rows);
+    } else if (raster_datatype == e_tid_uchar || raster_datatype == e_tid_char) {
+        mirror_uchar_array((uchar*)raster->buffer + first_pos, raster->raster_width, num_rows);
+    } else if (raster_datatype == e_tid_ushort || raster_datatype == e_tid_short || raster_datatype == e_tid_half) {
+        mirror_ushort_array((ushort*)raster->buffer + first_pos, raster->raster_width, num_rows);
+    } else if (raster_datatype == e_tid_uint || raster_datatype == e_tid_int) {
+        mirror_uint_array((uint*)raster->buffer + first_pos, raster->raster_width, num_rows);
+    } else if (raster_datatype == e_tid_double) {
+        mirror_double_array((double*)raster->buffer + first_pos, raster->raster_width, num_rows);
+    } else {
+        epr_set_err(e_err_illegal_data_type,
+                    "epr_read_band_measurement_data: internal error: unknown data type");
+        return epr_get_last_err_code();
+    }
+    return e_err_none;
+}
+
+/**
+ * Finishes a decoded line of a band raster while it is still in the cache:
+ * mirrors it if the band's lines are mirrored and sets the pixels which are
+ * invalid according to the packed bit-mask raster (if any) to zero.
+ *
+ * @return zero for success, an error code otherwise
+ */
+int epr_finish_band_line(const EPR_SBandId* band_id,
+                         EPR_SRaster* raster,
+                         uint row,
+                         const EPR_SRaster* bm_raster) {
+    if (band_id->lines_mirrored && mirror_band_raster(raster, row, 1) != e_err_none) {
+        return epr_get_last_err_code();
+    }
+    if (bm_raster != NULL) {
+        epr_zero_invalid_line_packed((uchar*) raster->buffer + row * raster->raster_width * raster->elem_size,
+                                     raster->raster_width,
+                                     raster->elem_size,
+                                     (const ulong*) bm_raster->buffer + row * EPR_BITMASK_LINE_WORDS(bm_raster->raster_width));
+    }
+    return e_err_none;
+}
+
+/**
+ * Gets the raw (big endian) pixels of a band's field in a dataset record,
+ * either straight from the memory-mapped file or read into the given
+ * line buffer.
+ *
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_line(EPR_SBandId* band_id,
+                       const EPR_SBandReadPlan* plan,
+                       uint record_index,
+                       uint offset_x,
+                       uint width,
+                       void* line_buffer,
+                       const uchar** line_data) {
+    const EPR_SDSD* dsd = band_id->dataset_ref.dataset_id->dsd;
+    uint num_bytes = width * plan->pixel_size;
+    uint offset;
+
+    if (record_index >= dsd->num_dsr) {
+        epr_set_err(e_err_invalid_value,
+                    "epr_read_band_line: invalid record_index parameter, must be >=0 and <num_dsr");
+        return epr_get_last_err_code();
+    }
+    if (offset_x + width > plan->num_pixels) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_read_band_line: pixel range out of bounds");
+        return epr_get_last_err_code();
+    }
+
+    offset = dsd->ds_offset + dsd->dsr_size * record_index + plan->field_offset + plan->pixel_size * offset_x;
+    *line_data = epr_get_mapped_bytes(band_id->product_id, offset, num_bytes);
+    if (*line_data != NULL) {
+        return e_err_none;
+    }
+    if (epr_read_product_bytes(band_id->product_id, offset, line_buffer, num_bytes) != e_err_none) {
+        return epr_get_last_err_code();
+    }
+    *line_data = (const uchar*) line_buffer;
+    return e_err_none;
+}
+
+/**
+ * A strip of lines of a band raster, which can be read independently of
+ * the other strips of the raster.
+ */
+typedef struct EPR_BandStrip {
+    EPR_SBandId* band_id;
+    const EPR_SBandReadPlan* plan;
+    /* the decoder and the data type of the samples it produces, which are
+     * converted into the data type of the raster if it differs */
+    EPR_FLineDecoder decode_func;
+    EPR_EDataTypeId decode_type;
+    EPR_SRaster* raster;
+    /* the packed bit-mask raster applied to the lines, may be NULL */
+    const EPR_SRaster* bm_raster;
+    int offset_x_mirrored;
+    int read_width;
+    int offset_y;
+    /* the raster lines of the strip */
+    uint first_row;
+    uint num_rows;
+    /* whether the lines are read ahead, which is left to the threads reading
+     * the strips if there are several */
+    epr_boolean read_ahead;
+    /* the error which occurred while reading the strip */
+    int err_code;
+    char* err_message;
+} EPR_SBandStrip;
+
+/**
+ * Reads, decodes, mirrors and masks the lines of a strip of a band raster,
+ * each line is finished before the next one is read.
+ *
+ * @return zero for success, an error code otherwise
+ */
+static int read_band_strip(EPR_SBandStrip* strip) {
+    EPR_SBandId* band_id = strip->band_id;
+    const EPR_SBandReadPlan* plan = strip->plan;
+    EPR_SRaster* raster = strip->raster;
+    const EPR_SDSD* dsd = band_id->dataset_ref.dataset_id->dsd;
+    int iY, raster_pos, delta_raster_pos;
+    uint row;
+    void* line_buffer = NULL;
+    void* decoded_line = NULL;
+    const uchar* line_data = NULL;
+    EPR_SReadAhead* read_ahead = NULL;
+
+    delta_raster_pos = (int)floor((raster->source_width - 1) / raster->source_step_x) + 1;
+    raster_pos = strip->first_row * delta_raster_pos;
+    iY = strip->offset_y + strip->first_row * raster->source_step_y;
+
+    if (strip->read_ahead && epr_is_read_ahead_enabled(band_id->product_id) && strip->num_rows > 0) {
+        if (strip->offset_x_mirrored + strip->read_width > (int) plan->num_pixels) {
+            epr_set_err(e_err_illegal_arg,
+                        "epr_read_band_line: pixel range out of bounds");
+            return epr_get_last_err_code();
+        }
+        read_ahead = epr_start_read_ahead(band_id->product_id,
+                                          dsd->ds_offset + dsd->dsr_size * iY + plan->field_offset
+                                          + plan->pixel_size * strip->offset_x_mirrored,
+                                          strip->read_width * plan->pixel_size,
+                                          dsd->dsr_size * raster->source_step_y,
+                                          strip->num_rows);
+        if (read_ahead == NULL) {
+            return epr_get_last_err_code();
+        }
+    } else {
+        line_buffer = malloc(strip->read_width * plan->pixel_size);
+    }
+    if (strip->decode_type != raster->data_type) {
+        decoded_line = malloc(delta_raster_pos * epr_get_data_type_size(strip->decode_type));
+    }
+    if ((read_ahead == NULL && line_buffer == NULL) || (strip->decode_type != raster->data_type && decoded_line == NULL)) {
+        free(line_buffer);
+        epr_stop_read_ahead(read_ahead);
+        epr_set_err(e_err_out_of_memory,
+                    "epr_read_band_measurement_data: out of memory");
+        return epr_get_last_err_code();
+    }
+
+    for (row = 0; row < strip->num_rows; row++, iY += raster->source_step_y) {
+
+        /*get the raw pixels of the next line*/
+        if (read_ahead != NULL) {
+            line_data = epr_next_read_ahead_record(read_ahead);
+        } else if (epr_read_band_line(band_id, plan, iY, strip->offset_x_mirrored, strip->read_width, line_buffer, &line_data) != e_err_none) {
+            line_data = NULL;
+        }
+        if (line_data == NULL) {
+            free(line_buffer);
+            free(decoded_line);
+            epr_stop_read_ahead(read_ahead);
+            return epr_get_last_err_code();
+        }
+        /*swap, extract and scale the "line" of physical values in one pass*/
+        if (decoded_line == NULL) {
+            strip->decode_func((void*) line_data, band_id, 0, strip->read_width, raster->source_step_x, raster->buffer, raster_pos);
+        } else {
+            strip->decode_func((void*) line_data, band_id, 0, strip->read_width, raster->source_step_x, decoded_line, 0);
+            epr_convert_array(decoded_line, strip->decode_type,
+                              (uchar*) raster->buffer + raster_pos * raster->elem_size, raster->data_type,
+                              delta_raster_pos);
+        }
+        if (epr_finish_band_line(band_id, raster, strip->first_row + row, strip->bm_raster) != e_err_none) {
+            free(line_buffer);
+            free(decoded_line);
+            epr_stop_read_ahead(read_ahead);
+            return epr_get_last_err_code();
+        }
+        /*locate "data point" for the next "line"*/
+        raster_pos += delta_raster_pos;
+    }
+
+    free(line_buffer);
+    free(decoded_line);
+    epr_stop_read_ahead(read_ahead);
+    return e_err_none;
+}
+
+/**
+ * Reads a strip of a band raster on a thread of the read executor, the
+ * error is kept in the strip for the thread which requested the raster.
+ */
+static void run_band_strip(void* task_data) {
+    EPR_SBandStrip* strip = (EPR_SBandStrip*) task_data;
+
+    if (read_band_strip(strip) != e_err_none) {
+        strip->err_code = epr_get_last_err_code();
+        epr_assign_string(&strip->err_message, epr_get_last_err_message());
+    }
+}
+
+/**
+ * Reads the measurement data and converts its into physical values or,
+ * if <code>raw</code> is set, into the unscaled counts. The pixels which
+ * are invalid according to the packed bit-mask raster <code>bm_raster</code>
+ * are set to zero, unless it is <code>NULL</code>.
+ */
+static int read_band_measurement_data(EPR_SBandId* band_id,
+                                      int offset_x,
+                                      int offset_y,
+                                      EPR_SRaster* raster,
+                                      epr_boolean raw,
+                                      const EPR_SRaster* bm_raster) {
+    EPR_SProductId* product_id = NULL;
+    EPR_SDatasetId* dataset_id = NULL;
+    const EPR_SBandReadPlan* plan = NULL;
+    EPR_SBandStrip* strips = NULL;
+    void** task_data = NULL;
+    uint rec_numb;
+    uint num_strips, s;
+    int offset_x_mirrored = 0;
+    int read_width;
+    uint scan_line_length;
+    int errcode = e_err_none;
+
+    product_id = band_id->product_id;
+
+    if (get_scan_line_length(product_id, &scan_line_length) != e_err_none) {
+        return epr_get_last_err_code();
+    }
+
+    dataset_id = band_id->dataset_ref.dataset_id;
+    /*the number of measurement records*/
+    rec_numb = dataset_id->dsd->num_dsr;
+
+    /*get the field location, sample model and decode function of the band*/
+    plan = epr_get_band_read_plan(band_id);
+    if (plan == NULL) {
+        return epr_get_last_err_code();
+    }
+    if (raw && plan->count_decode_func == NULL) {
+        epr_set_err(e_err_illegal_data_type,
+                    "epr_read_band_raw_raster: the band has no raw counts");
+        return epr_get_last_err_code();
+    }
+
+    /* if the user raster (or part of) is outside bbox in source coordinates*/
+    if (offset_x + raster->source_width > (int)scan_line_length) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_read_band_measurement_data: raster x coordinates out of bounds");
+        return epr_get_last_err_code();
+    }
+    if (offset_y + raster->source_height > (int)(rec_numb)) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_read_band_measurement_data: raster y coordinates out of bounds");
+        return epr_get_last_err_code();
+    }
+
+    /* the pixels between the first and the last sample actually used */
+    read_width = (raster->raster_width - 1) * raster->source_step_x + 1;
+
+    offset_x_mirrored = epr_get_mirrored_offset_x(band_id, offset_x, raster);
+
+    /* several strips per thread balance strips of different cost */
+    num_strips = 1;
+    if (product_id->num_read_threads > 1) {
+        num_strips = 4 * product_id->num_read_threads;
+        if (num_strips > raster->raster_height / EPR_MIN_STRIP_HEIGHT) {
+            num_strips = raster->raster_height / EPR_MIN_STRIP_HEIGHT;
+        }
+        if (num_strips < 1) {
+            num_strips = 1;
+        }
+    }
+
+    strips = (EPR_SBandStrip*) calloc(num_strips, sizeof (EPR_SBandStrip));
+    task_data = (void**) calloc(num_strips, sizeof (void*));
+    if (strips == NULL || task_data == NULL) {
+        free(strips);
+        free(task_data);
+        epr_set_err(e_err_out_of_memory,
+                    "epr_read_band_measurement_data: out of memory");
+        return epr_get_last_err_code();
+    }
+    for (s = 0; s < num_strips; s++) {
+        strips[s].band_id = band_id;
+        strips[s].plan = plan;
+        strips[s].decode_func = raw ? plan->count_decode_func : plan->decode_func;
+        strips[s].decode_type = raw ? plan->count_type : band_id->data_type;
+        strips[s].raster = raster;
+        strips[s].bm_raster = bm_raster;
+        strips[s].offset_x_mirrored = offset_x_mirrored;
+        strips[s].read_width = read_width;
+        strips[s].offset_y = offset_y;
+        strips[s].first_row = (uint) ((double) s * raster->raster_height / num_strips);
+        strips[s].num_rows = (uint) ((double) (s + 1) * raster->raster_height / num_strips) - strips[s].first_row;
+        strips[s].read_ahead = num_strips == 1;
+        task_data[s] = &strips[s];
+    }
+
+    if (num_strips == 1) {
+        errcode = read_band_strip(&strips[0]);
+    } else {
+        if (product_id->read_executor != NULL) {
+            product_id->read_executor(run_band_strip, task_data, num_strips, product_id->read_executor_data);
+        } else {
+            epr_run_tasks(run_band_strip, task_data, num_strips, product_id->num_read_threads);
+        }
+        /* report the error of the first failed strip in the calling thread */
+        for (s = 0; s < num_strips; s++) {
+            if (strips[s].err_code != e_err_none && errcode == e_err_none) {
+                epr_set_err((EPR_EErrCode) strips[s].err_code, strips[s].err_message);
+                errcode = strips[s].err_code;
+            }
+            epr_free_string(strips[s].err_message);
+        }
+    }
+
+    free(strips);
+    free(task_data);
+    return errcode;
+}
+
+/**
+ * Reads the measurement data and converts its into physical values.
+ *
+ * <p>Only the bytes of the requested pixels are read from each record,
+ * as described by the band's read plan.
+ *
+ * @param band_id the information about properties and quantities of ENVISAT data.
+ * @param offset_x X-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
+ * @param offset_y Y-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
+ * @param raster the instance to the buffer information was used
+ *
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_measurement_data(EPR_SBandId* band_id,
+                                   int offset_x,
+                                   int offset_y,
+                                   EPR_SRaster* raster) {
+    return read_band_measurement_data(band_id, offset_x, offset_y, raster, FALSE, NULL);
+}
+
+
+int epr_read_band_raw_raster(EPR_SBandId* band_id,
+                             int offset_x,
+                             int offset_y,
+                             EPR_SRaster* raster) {
+    epr_clear_err();
+
+    if (check_band_raster_args(band_id, offset_x, offset_y, raster, TRUE) != e_err_none) {
+        return epr_get_last_err_code();
+    }
+    if (strcmp(band_id->dataset_ref.dataset_id->dsd->ds_type, "M") != 0) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_read_band_raw_raster: only measurement bands have raw counts");
+        return epr_get_last_err_code();
+    }
+    return read_band_measurement_data(band_id, offset_x, offset_y, raster, TRUE, NULL);
+}
+
+
+EPR_EDataTypeId epr_get_band_raw_data_type(EPR_SBandId* band_id) {
+    const EPR_SBandReadPlan* plan;
+
+    epr_clear_err();
+
+    if (band_id == NULL) {
+        epr_set_err(e_err_invalid_band,
+                    "epr_get_band_raw_data_type: band_id must not be NULL");
+        return e_tid_unknown;
+    }
+    if (strcmp(band_id->dataset_ref.dataset_id->dsd->ds_type, "M") != 0) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_get_band_raw_data_type: only measurement bands have raw counts");
+        return e_tid_unknown;
+    }
+    plan = epr_get_band_read_plan(band_id);
+    if (plan == NULL || plan->count_decode_func == NULL) {
+        return e_tid_unknown;
+    }
+    return plan->count_type;
+}
+
+
+/**
+ * Reads the measurement data of several bands stored in the same dataset
+ * and converts them into physical values. Each record is read only once:
+ * the bytes spanning the requested pixels of all bands are read and every
+ * band's decoder is run on them.
+ *
+ * @param band_ids the bands, all from the same measurement dataset
+ * @param rasters the rasters, all with the same source region and sub-sampling
+ * @param bm_rasters the packed bit-mask rasters applied to the rasters, an element is <code>NULL</code> for a band without bit-mask
+ * @param num_bands the number of bands
+ * @param offset_x X-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
+ * @param offset_y Y-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
+ *
+ * @return zero for success, an error code otherwise
+ */
+static int read_band_group_measurement_data(EPR_SBandId** band_ids,
+                                            EPR_SRaster** rasters,
+                                            EPR_SRaster** bm_rasters,
+                                            uint num_bands,
+                                            int offset_x,
+                                            int offset_y) {
+    EPR_SProductId* product_id = band_ids[0]->product_id;
+    const EPR_SDSD* dsd = band_ids[0]->dataset_ref.dataset_id->dsd;
+    const EPR_SRaster* raster = rasters[0];
+    const EPR_SBandReadPlan** plans = NULL;
+    uint* byte_offsets = NULL;
+    uint span_begin = 0, span_end = 0;
+    uint scan_line_length;
+    uint b, offset_x_mirrored;
+    int iY, raster_pos, delta_raster_pos;
+    int read_width;
+    uint row;
+    uchar* line_buffer = NULL;
+    const uchar* line_data = NULL;
+    EPR_SReadAhead* read_ahead = NULL;
+    int errcode = e_err_none;
+
+    if (get_scan_line_length(product_id, &scan_line_length) != e_err_none) {
+        return epr_get_last_err_code();
+    }
+    if (offset_x + raster->source_width > (int)scan_line_length) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_read_band_rasters: raster x coordinates out of bounds");
+        return epr_get_last_err_code();
+    }
+    if (offset_y + raster->source_height > (int)(dsd->num_dsr)) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_read_band_rasters: raster y coordinates out of bounds");
+        return epr_get_last_err_code();
+    }
+
+    plans = (const EPR_SBandReadPlan**) calloc(num_bands, sizeof (EPR_SBandReadPlan*));
+    byte_offsets = (uint*) calloc(num_bands, sizeof (uint));
+    if (plans == NULL || byte_offsets == NULL) {
+        free((void*) plans);
+        free(byte_offsets);
+        epr_set_err(e_err_out_of_memory,
+                    "epr_read_band_rasters: out of memory");
+        return epr_get_last_err_code();
+    }
+
+    /* the pixels between the first and the last sample actually used */
+    read_width = (raster->raster_width - 1) * raster->source_step_x + 1;
+
+    /* the byte range of the record covering the requested pixels of all bands */
+    for (b = 0; b < num_bands; b++) {
+        plans[b] = epr_get_band_read_plan(band_ids[b]);
+        if (plans[b] == NULL) {
+            errcode = epr_get_last_err_code();
+            break;
+        }
+        offset_x_mirrored = (uint) epr_get_mirrored_offset_x(band_ids[b], offset_x, rasters[b]);
+        if (offset_x_mirrored + read_width > plans[b]->num_pixels) {
+            epr_set_err(e_err_illegal_arg,
+                        "epr_read_band_rasters: pixel range out of bounds");
+            errcode = epr_get_last_err_code();
+            break;
+        }
+        byte_offsets[b] = plans[b]->field_offset + plans[b]->pixel_size * offset_x_mirrored;
+        if (b == 0 || byte_offsets[b] < span_begin) {
+            span_begin = byte_offsets[b];
+        }
+        if (b == 0 || byte_offsets[b] + read_width * plans[b]->pixel_size > span_end) {
+            span_end = byte_offsets[b] + read_width * plans[b]->pixel_size;
+        }
+    }
+    if (errcode == e_err_none && epr_is_read_ahead_enabled(product_id) && raster->raster_height > 0) {
+        read_ahead = epr_start_read_ahead(product_id,
+                                          dsd->ds_offset + dsd->dsr_size * offset_y + span_begin,
+                                          span_end - span_begin,
+                                          dsd->dsr_size * raster->source_step_y,
+                                          raster->raster_height);
+        if (read_ahead == NULL) {
+            errcode = epr_get_last_err_code();
+        }
+    } else if (errcode == e_err_none) {
+        line_buffer = (uchar*) malloc(span_end - span_begin);
+        if (line_buffer == NULL) {
+            epr_set_err(e_err_out_of_memory,
+                        "epr_read_band_rasters: out of memory");
+            errcode = epr_get_last_err_code();
+        }
+    }
+
+    raster_pos = 0;
+    row = 0;
+    delta_raster_pos = (int)floor((raster->source_width - 1) / raster->source_step_x) + 1;
+
+    for (iY = offset_y; errcode == e_err_none && (uint)iY < offset_y + raster->source_height; iY += raster->source_step_y, row++) {
+        uint offset = dsd->ds_offset + dsd->dsr_size * iY + span_begin;
+
+        /*get the raw pixels of all bands of the next line*/
+        if (read_ahead != NULL) {
+            line_data = epr_next_read_ahead_record(read_ahead);
+            if (line_data == NULL) {
+                errcode = epr_get_last_err_code();
+                break;
+            }
+        } else {
+            line_data = epr_get_mapped_bytes(product_id, offset, span_end - span_begin);
+        }
+        if (line_data == NULL) {
+            if (epr_read_product_bytes(product_id, offset, line_buffer, span_end - span_begin) != e_err_none) {
+                errcode = epr_get_last_err_code();
+                break;
+            }
+            line_data = line_buffer;
+        }
+        /*swap, extract and scale the "line" of physical values of each band*/
+        for (b = 0; b < num_bands; b++) {
+            plans[b]->decode_func((void*) (line_data + byte_offsets[b] - span_begin), band_ids[b],
+                                  0, read_width, raster->source_step_x, rasters[b]->buffer, raster_pos);
+            if (epr_finish_band_line(band_ids[b], rasters[b], row, bm_rasters[b]) != e_err_none) {
+                errcode = epr_get_last_err_code();
+                break;
+            }
+        }
+        /*locate "data point" for the next "line"*/
+        raster_pos += delta_raster_pos;
+    }
+
+    free(line_buffer);
+    epr_stop_read_ahead(read_ahead);
+    free((void*) plans);
+    free(byte_offsets);
+    return errcode;
+}
+
+
+/**
+ * Tests whether two bands can be read in a single pass, i.e. whether they
+ * are measurement bands of the same dataset read into rasters with the same
+ * source region and sub-sampling.
+ */
+static int can_read_bands_together(const EPR_SBandId* band_id1, const EPR_SRaster* raster1,
+                                   const EPR_SBandId* band_id2, const EPR_SRaster* raster2) {
+    return band_id1->dataset_ref.dataset_id == band_id2->dataset_ref.dataset_id
+           && strcmp(band_id1->dataset_ref.dataset_id->dsd->ds_type, "M") == 0
+           && raster1->source_width == raster2->source_width
+           && raster1->source_height == raster2->source_height
+           && raster1->source_step_x == raster2->source_step_x
+           && raster1->source_step_y == raster2->source_step_y
+           && raster1->raster_width == raster2->raster_width
+           && raster1->raster_height == raster2->raster_height;
+}
+
+
+int epr_read_band_rasters(EPR_SBandId** band_ids,
+                          EPR_SRaster** rasters,
+                          uint num_bands,
+                          int offset_x,
+                          int offset_y) {
+    EPR_SBandId** group_band_ids = NULL;
+    EPR_SRaster** group_rasters = NULL;
+    EPR_SRaster** group_bm_rasters = NULL;
+    char* done = NULL;
+    uint i, j, num_group;
+    int errcode = e_err_none;
+
+    epr_clear_err();
+
+    if (band_ids == NULL || rasters == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_read_band_rasters: band_ids or rasters must not be NULL");
+        return epr_get_last_err_code();
+    }
+    for (i = 0; i < num_bands; i++) {
+        if (check_band_raster_args(band_ids[i], offset_x, offset_y, rasters[i], FALSE) != e_err_none) {
+            return epr_get_last_err_code();
+        }
+    }
+    if (num_bands == 0) {
+        return e_err_none;
+    }
+
+    group_band_ids = (EPR_SBandId**) calloc(num_bands, sizeof (EPR_SBandId*));
+    group_rasters = (EPR_SRaster**) calloc(num_bands, sizeof (EPR_SRaster*));
+    group_bm_rasters = (EPR_SRaster**) calloc(num_bands, sizeof (EPR_SRaster*));
+    done = (char*) calloc(num_bands, sizeof (char));
+    if (group_band_ids == NULL || group_rasters == NULL || group_bm_rasters == NULL || done == NULL) {
+        free(group_band_ids);
+        free(group_rasters);
+        free(group_bm_rasters);
+        free(done);
+        epr_set_err(e_err_out_of_memory,
+                    "epr_read_band_rasters: out of memory");
+        return epr_get_last_err_code();
+    }
+
+    for (i = 0; i < num_bands && errcode == e_err_none; i++) {
+        if (done[i]) {
+            continue;
+        }
+        num_group = 0;
+        group_band_ids[num_group] = band_ids[i];
+        group_rasters[num_group] = rasters[i];
+        num_group++;
+        for (j = i + 1; j < num_bands; j++) {
+            if (!done[j] && can_read_bands_together(band_ids[i], rasters[i], band_ids[j], rasters[j])) {
+                group_band_ids[num_group] = band_ids[j];
+                group_rasters[num_group] = rasters[j];
+                num_group++;
+                done[j] = 1;
+            }
+        }
+        done[i] = 1;
+
+        if (num_group == 1) {
+            errcode = epr_read_band_raster(band_ids[i], offset_x, offset_y, rasters[i]);
+            continue;
+        }
+        /* the bit-masks are applied while the lines are decoded */
+        for (j = 0; j < num_group && errcode == e_err_none; j++) {
+            group_bm_rasters[j] = NULL;
+            if (group_band_ids[j]->bm_expr != NULL) {
+                group_bm_rasters[j] = read_band_bitmask(group_band_ids[j], offset_x, offset_y, group_rasters[j]);
+                if (group_bm_rasters[j] == NULL) {
+                    errcode = epr_get_last_err_code();
+                }
+            }
+        }
+        if (errcode == e_err_none) {
+            errcode = read_band_group_measurement_data(group_band_ids, group_rasters, group_bm_rasters,
+                                                       num_group, offset_x, offset_y);
+        }
+        for (j = 0; j < num_group; j++) {
+            free_band_bitmask(group_bm_rasters[j]);
+            group_bm_rasters[j] = NULL;
+        }
+    }
+
+    free(group_band_ids);
+    free(group_rasters);
+    free(group_bm_rasters);
+    free(done);
+    return errcode;
+}
+
+
+/**
+ * Gets the tie point grid of the given annotation band, the grid is created
+ * on the first call.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @return the tie point grid or <code>NULL</code> if an error occurred.
+ */
+static EPR_STiePointGrid* get_tie_point_grid(EPR_SBandId* band_id) {
     EPR_SProductId* product_id = NULL;
     const EPR_SField* field = NULL;
-    const EPR_SField* field_beg = NULL;
-    const EPR_SField* field_end = NULL;
     EPR_SFieldInfo* field_info = NULL;
     EPR_SDatasetId* dataset_id = NULL;
     EPR_SRecord* record = NULL;
-    EPR_SRecord* record_beg = NULL;
-    EPR_SRecord* record_end = NULL;
     EPR_SRecord* sph_record = NULL;
-    EPR_EDataTypeId band_datatype = 0, datatype_id = 0;
-    /* EPR_ESampleModel band_smod = 0; */
-    /* uint rec_size = 0; */
-    uint rec_numb = 0;
+    EPR_STiePointGrid* grid = NULL;
     uint lines_per_tie_pt, samples_per_tie_pt, scan_line_length;
-    int iY, raster_pos, delta_raster_pos;
-    EPR_FArrayTransformer transform_array_func = NULL;
-    int y_beg, y_end, y_beg_old, y_end_old;
-    int offset_x_mirrored = 0;
     uint num_elems = 0;
-    float y_mod = 0;
     float scan_offset_x = 0;
     float scan_offset_y = 0;
-    void* line_beg_buffer = NULL;
-    void* line_end_buffer = NULL;
-    uint scene_width = 0;
+    EPR_FArrayTransformer transform_array_func = NULL;
 
-    product_id = band_id->product_id;
+    if (band_id->tie_point_grid != NULL) {
+        return band_id->tie_point_grid;
+    }
 
+    product_id = band_id->product_id;
     dataset_id = band_id->dataset_ref.dataset_id;
-    /*the length of annotation record size*/
-    /* rec_size = dataset_id->dsd->dsr_size; */
-    /*the number of annotation records*/
-    rec_numb = dataset_id->dsd->num_dsr;
-    /*data type in the band*/
-    band_datatype = band_id->data_type;
-    /*data model in the band*/
-    /* band_smod = band_id->sample_model; */
     record = epr_create_record(dataset_id);
+    if (record == NULL) {
+        return NULL;
+    }
     field_info = (EPR_SFieldInfo*)epr_get_ptr_array_elem_at(record->info->field_infos, band_id->dataset_ref.field_index - 1);
-    datatype_id = field_info->data_type_id;
-
 
     /*find LINES_PER_TIE_PT & SAMPLES_PER_TIE_PT for different products*/
     if (strncmp(EPR_ENVISAT_PRODUCT_MERIS, product_id->id_string, 3) == 0) {
@@ -915,7 +1779,7 @@ int epr_read_band_annotation_data(EPR_SBandId* band_id,
         } else {
             epr_free_record(record);
             epr_set_err(e_err_invalid_value, "epr_read_band_annotation_data: internal error: illegal value for samples_per_tie_pt");
-            return epr_get_last_err_code();
+            return NULL;
         }
     } else if (strncmp(EPR_ERS2_PRODUCT_ATSR2, product_id->id_string, 3) == 0) {
         scan_offset_y = -0.5F;
@@ -931,7 +1795,7 @@ int epr_read_band_annotation_data(EPR_SBandId* band_id,
         } else {
             epr_free_record(record);
             epr_set_err(e_err_invalid_value, "epr_read_band_annotation_data: internal error: illegal value for samples_per_tie_pt");
-            return epr_get_last_err_code();
+            return NULL;
         }
     } else if ((strncmp(EPR_ENVISAT_PRODUCT_ASAR, product_id->id_string, 3) == 0) ||
                (strncmp(EPR_ENVISAT_PRODUCT_SAR, product_id->id_string, 3) == 0)) {
@@ -949,37 +1813,231 @@ int epr_read_band_annotation_data(EPR_SBandId* band_id,
         epr_free_record(record);
         epr_set_err(e_err_illegal_arg,
                     "epr_read_band_annotation_data: unhandled ENVISAT product type");
-        return epr_get_last_err_code();
+        return NULL;
+    }
+
+    /*select the correspondent function to scaling and transform data type*/
+    transform_array_func = select_transform_array_function(band_id->data_type, field_info->data_type_id);
+    if (transform_array_func == NULL) {
+        epr_free_record(record);
+        epr_set_err(e_err_illegal_data_type,
+                    "epr_read_band_annotation_data: internal error: illegal data type");
+        return NULL;
     }
 
-    /*memory allocate for the increasingly begin tie point line*/
-    line_beg_buffer = calloc(sizeof(float), num_elems);
-    if (line_beg_buffer == NULL) {
+    grid = (EPR_STiePointGrid*) calloc(1, sizeof (EPR_STiePointGrid));
+    if (grid == NULL) {
         epr_free_record(record);
         epr_set_err(e_err_out_of_memory, "epr_read_band_annotation_data: out of memory");
-        return epr_get_last_err_code();
+        return NULL;
     }
-    /*memory allocate for the increasingly end tie point line*/
-    line_end_buffer = calloc(sizeof(float), num_elems);
-    if (line_end_buffer == NULL)  {
+    grid->num_rows = dataset_id->dsd->num_dsr;
+    grid->rows = (float**) calloc(grid->num_rows, sizeof (float*));
+    if (grid->rows == NULL) {
+        free(grid);
         epr_free_record(record);
-        free(line_beg_buffer);
         epr_set_err(e_err_out_of_memory, "epr_read_band_annotation_data: out of memory");
+        return NULL;
+    }
+    grid->num_elems = num_elems;
+    grid->lines_per_tie_pt = lines_per_tie_pt;
+    grid->samples_per_tie_pt = samples_per_tie_pt;
+    grid->scan_line_length = scan_line_length;
+    grid->scan_offset_x = scan_offset_x;
+    grid->scan_offset_y = scan_offset_y;
+    grid->is_longitude = strncmp(band_id->band_name, EPR_LONGI_BAND_NAME, strlen(EPR_LONGI_BAND_NAME)) == 0;
+    grid->transform_func = transform_array_func;
+    grid->record = record;
+
+    band_id->tie_point_grid = grid;
+    return grid;
+}
+
+EPR_STiePointGrid* epr_get_tie_point_grid(EPR_SBandId* band_id) {
+    EPR_STiePointGrid* grid;
+
+    epr_lock_mutex(band_id->product_id->lock);
+    grid = get_tie_point_grid(band_id);
+    epr_unlock_mutex(band_id->product_id->lock);
+    return grid;
+}
+
+/**
+ * Gets a row of the tie point grid of the given band transformed into
+ * physical values. The row is read on the first call only.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param grid the band's tie point grid, must not be <code>NULL</code>
+ * @param row_index the zero-based index of the row
+ * @return the <code>grid->num_elems</code> values of the row or
+ *         <code>NULL</code> if an error occurred.
+ */
+const float* epr_get_tie_point_row(EPR_SBandId* band_id, EPR_STiePointGrid* grid, uint row_index) {
+    const float* row = NULL;
+
+    epr_lock_mutex(band_id->product_id->lock);
+    row = grid->rows[row_index];
+    if (row == NULL &&
+            epr_read_record(band_id->dataset_ref.dataset_id, row_index, grid->record) != NULL) {
+        row = epr_set_tie_point_row(band_id, grid, row_index, grid->record);
+    }
+    epr_unlock_mutex(band_id->product_id->lock);
+    return row;
+}
+
+/**
+ * Sets a row of the tie point grid of the given band from a record of the
+ * band's annotation dataset, unless the row is already known.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param grid the band's tie point grid, must not be <code>NULL</code>
+ * @param row_index the zero-based index of the row
+ * @param record the record <code>row_index</code> of the annotation dataset
+ * @return the <code>grid->num_elems</code> values of the row or
+ *         <code>NULL</code> if an error occurred.
+ */
+const float* epr_set_tie_point_row(EPR_SBandId* band_id, EPR_STiePointGrid* grid, uint row_index, const EPR_SRecord* record) {
+    const EPR_SField* field = NULL;
+    float* row = NULL;
+
+    epr_lock_mutex(band_id->product_id->lock);
+    if (grid->rows[row_index] == NULL) {
+        row = (float*) calloc(grid->num_elems, sizeof (float));
+        if (row != NULL) {
+            field = epr_get_field_at(record, band_id->dataset_ref.field_index - 1);
+            grid->transform_func(field->elems, band_id, row, grid->num_elems);
+            grid->rows[row_index] = row;
+        } else {
+            epr_set_err(e_err_out_of_memory, "epr_read_band_annotation_data: out of memory");
+        }
+    }
+    row = grid->rows[row_index];
+    epr_unlock_mutex(band_id->product_id->lock);
+    return row;
+}
+
+/**
+ * Releases the tie point grid of the given band, if any.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ */
+void epr_free_tie_point_grid(EPR_SBandId* band_id) {
+    EPR_STiePointGrid* grid = band_id->tie_point_grid;
+    uint i;
+
+    if (grid == NULL) {
+        return;
+    }
+    for (i = 0; i < grid->num_rows; i++) {
+        free(grid->rows[i]);
+    }
+    free(grid->rows);
+    epr_free_record(grid->record);
+    free(grid);
+    band_id->tie_point_grid = NULL;
+}
+
+
+/**
+ * Unwraps the longitudes of two tie point rows at the date line, so that
+ * they can be interpolated. The cells are visited in the order of the
+ * raster columns, exactly as <code>decode_tiepoint_band</code> does.
+ *
+ * @param row_beg the tie point row "before" the raster line, modified in place
+ * @param row_end the tie point row "after" the raster line, modified in place
+ * @param knots the tie point index left of each raster column
+ * @param num_cols the number of raster columns
+ *
+ * @return the index of the first column which may need to be wrapped back
+ *         after interpolation, <code>num_cols</code> if there is none
+ */
+static uint unwrap_tie_point_longitudes(float* row_beg,
+                                        float* row_end,
+                                        const uint* knots,
+                                        uint num_cols) {
+    uint i, k;
+    uint wrap_start = num_cols;
+    float circle = EPR_LONGI_ABS_MAX - EPR_LONGI_ABS_MIN;
+    float half_circle = 0.5F * circle;
+    float null_point = 0.5F * (EPR_LONGI_ABS_MAX + EPR_LONGI_ABS_MIN);
+
+    for (i = 0; i < num_cols; i++) {
+        k = knots[i];
+        if (fabs((float)(row_beg[k + 1] - row_beg[k])) > half_circle ||
+                fabs((float)(row_beg[k] - row_end[k])) > half_circle ||
+                fabs((float)(row_end[k] - row_end[k + 1])) > half_circle ||
+                fabs((float)(row_end[k + 1] - row_beg[k + 1])) > half_circle) {
+            if (wrap_start == num_cols) {
+                wrap_start = i;
+            }
+            if (row_beg[k] < (float)null_point) {
+                row_beg[k] += circle;
+            }
+            if (row_beg[k + 1] < (float)null_point) {
+                row_beg[k + 1] += circle;
+            }
+            if (row_end[k] < (float)null_point) {
+                row_end[k] += circle;
+            }
+            if (row_end[k + 1] < (float)null_point) {
+                row_end[k + 1] += circle;
+            }
+        }
+    }
+    return wrap_start;
+}
+
+
+/**
+ * Reads the annotation data and converts its into physical values.
+ *
+ * <p>The interpolation is separable: the tie point knots and weights of the
+ * raster columns are computed once per raster, the column terms of the
+ * bilinear interpolation once per pair of tie point rows, so that each
+ * raster line only needs the vertical weight.
+ *
+ * @param band_id the information about properties and quantities of ENVISAT data.
+ * @param offset_x X-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
+ * @param offset_y Y-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
+ * @param raster the instance to the buffer information was used
+ *
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_annotation_data(EPR_SBandId* band_id,
+                                  int offset_x,
+                                  int offset_y,
+                                  EPR_SRaster* raster) {
+    EPR_STiePointGrid* grid = NULL;
+    const float* row_beg = NULL;
+    const float* row_end = NULL;
+    int iY, raster_pos, delta_raster_pos;
+    int y_beg, y_end, y_beg_old;
+    int offset_x_mirrored = 0;
+    uint num_cols, i, k;
+    uint wrap_start = 0;
+    float x_mod, y_mod = 0;
+    float circle = EPR_LONGI_ABS_MAX - EPR_LONGI_ABS_MIN;
+    uint* knots = NULL;
+    float* weights = NULL;
+    float* terms = NULL;
+    float* unwrapped = NULL;
+    float* out = NULL;
+    /* the interpolated line, converted into the raster unless it is a float raster */
+    float* line = NULL;
+    uint scene_width = 0;
+
+    grid = epr_get_tie_point_grid(band_id);
+    if (grid == NULL) {
         return epr_get_last_err_code();
     }
+
     /* if the user raster (or its part) is outside of orbit in source coordinates*/
-    if (offset_x + raster->raster_width > (int)scan_line_length) {
-        epr_free_record(record);
-        free(line_beg_buffer);
-        free(line_end_buffer);
+    if (offset_x + raster->raster_width > (int)grid->scan_line_length) {
         epr_set_err(e_err_illegal_arg,
                     "epr_read_band_data: raster x coordinates out of bounds");
         return epr_get_last_err_code();
     }
-    if (offset_y + raster->raster_height > (int)(rec_numb * lines_per_tie_pt)) {
-        epr_free_record(record);
-        free(line_beg_buffer);
-        free(line_end_buffer);
+    if (offset_y + raster->raster_height > (int)(grid->num_rows * grid->lines_per_tie_pt)) {
         epr_set_err(e_err_illegal_arg,
                     "epr_read_band_data: raster y coordinates out of bounds");
         return epr_get_last_err_code();
@@ -987,19 +2045,29 @@ int epr_read_band_annotation_data(EPR_SBandId* band_id,
     raster_pos = 0;
 
     delta_raster_pos = (int)floor((raster->source_width - 1) / raster->source_step_x) + 1;
-
-    /*select the correspondent function to scaling and transform data type*/
-    transform_array_func = select_transform_array_function(band_datatype, datatype_id);
-    if (transform_array_func == NULL) {
-        epr_free_record(record);
-        free(line_beg_buffer);
-        free(line_end_buffer);
-        epr_set_err(e_err_illegal_data_type,
-                    "epr_read_band_annotation_data: internal error: illegal data type");
+    num_cols = (uint)delta_raster_pos;
+
+    /* column knots and weights, the three column terms of the interpolation
+     * and the unwrapped longitude rows */
+    knots = (uint*) calloc(num_cols, sizeof (uint));
+    weights = (float*) calloc(num_cols, sizeof (float));
+    terms = (float*) calloc(3 * num_cols, sizeof (float));
+    if (grid->is_longitude) {
+        unwrapped = (float*) calloc(2 * grid->num_elems, sizeof (float));
+    }
+    if (raster->data_type != e_tid_float) {
+        line = (float*) calloc(num_cols, sizeof (float));
+    }
+    if (knots == NULL || weights == NULL || terms == NULL || (grid->is_longitude && unwrapped == NULL)
+            || (raster->data_type != e_tid_float && line == NULL)) {
+        free(knots);
+        free(weights);
+        free(terms);
+        free(unwrapped);
+        free(line);
+        epr_set_err(e_err_out_of_memory, "epr_read_band_annotation_data: out of memory");
         return epr_get_last_err_code();
     }
-    y_beg_old = 9999;
-    y_end_old = 9999;
 
     scene_width = band_id->product_id->scene_width;
     if (band_id->lines_mirrored) {
@@ -1014,57 +2082,94 @@ int epr_read_band_annotation_data(EPR_SBandId* band_id,
         offset_x_mirrored = offset_x;
     }
 
+    for (i = 0; i < num_cols; i++) {
+        x_mod = (offset_x_mirrored + (int)i * raster->source_step_x - grid->scan_offset_x) / grid->samples_per_tie_pt;
+        if (x_mod >= 0.0F) {
+            knots[i] = (uint)x_mod;
+            if (knots[i] >= grid->num_elems - 1) {
+                knots[i] = grid->num_elems - 2;
+            }
+        } else {
+            knots[i] = (uint)0;
+        }
+        weights[i] = x_mod - knots[i];
+    }
+
+    y_beg_old = -1;
     for (iY = offset_y; (uint)iY < offset_y + raster->source_height; iY += raster->source_step_y ) {
 
         /*find the increasing neighbour begin and end tie point lines*/
-        y_mod = ((float)iY - scan_offset_y) / lines_per_tie_pt;
+        y_mod = ((float)iY - grid->scan_offset_y) / grid->lines_per_tie_pt;
         y_beg = (uint)floor(y_mod);
 
         if (y_beg < 0) {
             y_beg = 0;
         }
-        if ((uint)y_beg > dataset_id->dsd->num_dsr - 2) {
-            y_beg = dataset_id->dsd->num_dsr - 2;
+        if ((uint)y_beg > grid->num_rows - 2) {
+            y_beg = grid->num_rows - 2;
         }
 
         y_mod -= y_beg;
         y_end = y_beg + 1;
 
-        /*as long as between increasing neighbour tie point lines, not to change them*/
+        /*as long as between increasing neighbour tie point lines, the column terms do not change*/
         if (y_beg_old != y_beg) {
-            record_beg = epr_read_record(dataset_id, y_beg, record_beg);
+            row_beg = epr_get_tie_point_row(band_id, grid, y_beg);
+            row_end = epr_get_tie_point_row(band_id, grid, y_end);
+            if (row_beg == NULL || row_end == NULL) {
+                break;
+            }
+            if (grid->is_longitude) {
+                memcpy(unwrapped, row_beg, grid->num_elems * sizeof (float));
+                memcpy(unwrapped + grid->num_elems, row_end, grid->num_elems * sizeof (float));
+                row_beg = unwrapped;
+                row_end = unwrapped + grid->num_elems;
+                wrap_start = unwrap_tie_point_longitudes(unwrapped, unwrapped + grid->num_elems, knots, num_cols);
+            }
+            /* same terms as in epr_interpolate2D() to get bit-identical results */
+            for (i = 0; i < num_cols; i++) {
+                k = knots[i];
+                terms[i] = row_beg[k] + weights[i] * (row_beg[k + 1] - row_beg[k]);
+                terms[num_cols + i] = row_end[k] - row_beg[k];
+                terms[2 * num_cols + i] = row_end[k + 1] + row_beg[k] - row_end[k] - row_beg[k + 1];
+            }
             y_beg_old = y_beg;
         }
-        if (y_end_old != y_end) {
-            record_end = epr_read_record(dataset_id, y_end, record_end);
-            y_end_old = y_end;
-        }
-
-        /*get the values for the increasing neighbour tie point lines*/
-        field_beg = epr_get_field_at(record_beg, band_id->dataset_ref.field_index - 1);
-        field_end = epr_get_field_at(record_end, band_id->dataset_ref.field_index - 1);
-
-        /*transform and scale the values for the increasing neighbour tie point lines*/
-        transform_array_func(field_beg->elems, band_id, line_beg_buffer, num_elems);
-        transform_array_func(field_end->elems, band_id, line_end_buffer, num_elems);
 
         /*get the "line" of interpolated physical values from tie point data*/
-        decode_tiepoint_band(line_beg_buffer, line_end_buffer,
-                             samples_per_tie_pt, num_elems, band_id, offset_x_mirrored, scan_offset_x, y_mod,
-                             raster->source_width, raster->source_step_x, raster->buffer, raster_pos);
+        out = line != NULL ? line : (float*)raster->buffer + raster_pos;
+        epr_interpolate_tie_point_line(terms, terms + num_cols, terms + 2 * num_cols, weights, y_mod, num_cols, out);
+        if (grid->is_longitude) {
+            for (i = wrap_start; i < num_cols; i++) {
+                if (out[i] > EPR_LONGI_ABS_MAX) {
+                    out[i] -= circle;
+                }
+            }
+        }
+        if (line != NULL) {
+            if (band_id->lines_mirrored) {
+                mirror_float_array(line, num_cols, 1);
+            }
+            epr_convert_array(line, e_tid_float,
+                              (uchar*) raster->buffer + raster_pos * raster->elem_size, raster->data_type,
+                              num_cols);
+        }
         /*locate "data point" for the next "line"*/
         raster_pos += delta_raster_pos;
     }
 
-    if (band_id->lines_mirrored) {
-        mirror_float_array((float*)raster->buffer, raster->raster_width, raster->raster_height);
+    free(knots);
+    free(weights);
+    free(terms);
+    free(unwrapped);
+    free(line);
+    if ((uint)iY < offset_y + raster->source_height) {
+        return epr_get_last_err_code();
     }
 
-    epr_free_record(record_beg);
-    epr_free_record(record_end);
-    epr_free_record(record);
-    free(line_beg_buffer);
-    free(line_end_buffer);
+    if (band_id->lines_mirrored && raster->data_type == e_tid_float) {
+        mirror_float_array((float*)raster->buffer, raster->raster_width, raster->raster_height);
+    }
     return 0;
 }
 
@@ -1118,7 +2223,7 @@ uint epr_get_raster_height(EPR_SRaster* raster) {
 }
 
 /******************************************************************/
-EPR_FLineDecoder select_line_decode_function(EPR_EDataTypeId band_tid,
+static EPR_FLineDecoder select_scalar_line_decode_function(EPR_EDataTypeId band_tid,
         EPR_ESampleModel band_smod,
         EPR_EDataTypeId raw_tid) {
     EPR_FLineDecoder decode_func;
@@ -1178,12 +2283,61 @@ EPR_FLineDecoder select_line_decode_function(EPR_EDataTypeId band_tid,
              && band_smod == e_smod_3TOI
              && raw_tid == e_tid_uchar)
         decode_func = decode_line_uchar_3_to_i_to_uint;
+    else if ((band_tid == e_tid_short || band_tid == e_tid_ushort)
+             && band_smod == e_smod_1OF2
+             && (raw_tid == e_tid_short || raw_tid == e_tid_ushort))
+        decode_func = decode_line_ushort_1_of_2_to_ushort;
+    else if ((band_tid == e_tid_short || band_tid == e_tid_ushort)
+             && band_smod == e_smod_2OF2
+             && (raw_tid == e_tid_short || raw_tid == e_tid_ushort))
+        decode_func = decode_line_ushort_2_of_2_to_ushort;
+    else if (band_tid == e_tid_ushort
+             && band_smod == e_smod_2TOF
+             && raw_tid == e_tid_uchar)
+        decode_func = decode_line_uchar_2_to_f_to_ushort;
     else {
         return NULL;
     }
     return decode_func;
 }
 
+EPR_FLineDecoder select_line_decode_function(EPR_EDataTypeId band_tid,
+        EPR_ESampleModel band_smod,
+        EPR_EDataTypeId raw_tid) {
+    EPR_FLineDecoder decode_func = select_scalar_line_decode_function(band_tid, band_smod, raw_tid);
+    if (decode_func == NULL) {
+        return NULL;
+    }
+    return epr_select_simd_line_decoder(decode_func, epr_api.cpu_features);
+}
+
+EPR_FLineDecoder select_raw_line_decode_function(EPR_EDataTypeId band_tid,
+        EPR_ESampleModel band_smod,
+        EPR_EDataTypeId raw_tid) {
+    EPR_FLineDecoder decode_func = select_scalar_line_decode_function(band_tid, band_smod, raw_tid);
+    if (decode_func == NULL) {
+        return NULL;
+    }
+    /* only the decoders of 16 bit samples depend on the byte order */
+    if (epr_api.little_endian_order) {
+        if (decode_func == decode_line_ushort_1_of_1_to_float)
+            decode_func = decode_line_ushort_1_of_1_be_to_float;
+        else if (decode_func == decode_line_short_1_of_1_to_float)
+            decode_func = decode_line_short_1_of_1_be_to_float;
+        else if (decode_func == decode_line_short_1_of_2_to_float)
+            decode_func = decode_line_short_1_of_2_be_to_float;
+        else if (decode_func == decode_line_short_2_of_2_to_float)
+            decode_func = decode_line_short_2_of_2_be_to_float;
+        else if (decode_func == decode_line_ushort_1_of_1_to_ushort)
+            decode_func = decode_line_ushort_1_of_1_be_to_ushort;
+        else if (decode_func == decode_line_ushort_1_of_2_to_ushort)
+            decode_func = decode_line_ushort_1_of_2_be_to_ushort;
+        else if (decode_func == decode_line_ushort_2_of_2_to_ushort)
+            decode_func = decode_line_ushort_2_of_2_be_to_ushort;
+    }
+    return epr_select_simd_line_decoder(decode_func, epr_api.cpu_features);
+}
+
 
 EPR_FArrayTransformer select_transform_array_function(EPR_EDataTypeId band_tid,
         EPR_EDataTypeId raw_tid) {
@@ -1215,12 +2369,17 @@ void decode_line_uchar_1_of_1_to_float(void* source_array,
     int x, x1, x2;
     uchar* sa = (uchar*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
-        for (x = x1; x <= x2; x += step_x)  {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_uchar)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[sa[x]];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
+        for (x = x1; x <= x2; x += step_x) {
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * sa[x]);
         }
     } else if (band_id->scaling_method == e_smid_lin) {
@@ -1245,12 +2404,17 @@ void decode_line_char_1_of_1_to_float(void* source_array,
     int x, x1, x2;
     char* sa = (char*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
-        for (x = x1; x <= x2; x += step_x)  {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_char)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[(uchar) sa[x]];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
+        for (x = x1; x <= x2; x += step_x) {
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * sa[x]);
         }
     } else if (band_id->scaling_method == e_smid_lin) {
@@ -1275,11 +2439,16 @@ void decode_line_ushort_1_of_1_to_float(void* source_array,
     int x, x1, x2;
     ushort* sa = (ushort*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_ushort)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[sa[x]];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
         for (x = x1; x <= x2; x += step_x) {
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * sa[x]);
         }
@@ -1305,12 +2474,17 @@ void decode_line_short_1_of_1_to_float(void* source_array,
     int x, x1, x2;
     short* sa = (short*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
-        for (x = x1; x <= x2; x += step_x)  {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_short)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[(ushort) sa[x]];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
+        for (x = x1; x <= x2; x += step_x) {
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * sa[x]);
         }
     } else if (band_id->scaling_method == e_smid_lin) {
@@ -1334,12 +2508,17 @@ void decode_line_short_1_of_2_to_float(void* source_array,
     int x, x1, x2;
     short* sa = (short*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
-        for (x = x1; x <= x2; x += step_x)  {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_short)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[(ushort) sa[2 * x]];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
+        for (x = x1; x <= x2; x += step_x) {
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * sa[2 * x]);
         }
     } else if (band_id->scaling_method == e_smid_lin) {
@@ -1364,11 +2543,16 @@ void decode_line_short_2_of_2_to_float(void* source_array,
     int x, x1, x2;
     short* sa = (short*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_short)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[(ushort) sa[2 * x + 1]];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
         for (x = x1; x <= x2; x += step_x) {
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * sa[2 * x + 1]);
         }
@@ -1461,6 +2645,213 @@ void decode_line_ushort_1_of_1_to_ushort(void* source_array,
     }
 }
 
+void decode_line_ushort_1_of_2_to_ushort(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    int x, x1, x2;
+    ushort* sa = (ushort*) source_array;
+    ushort* buf = (ushort*) raster_buffer;
+
+    x1 = offset_x;
+    x2 = x1 + raster_width - 1;
+
+    for (x = x1; x <= x2; x += step_x)  {
+        buf[raster_pos++] = sa[2 * x];
+    }
+}
+
+void decode_line_ushort_2_of_2_to_ushort(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    int x, x1, x2;
+    ushort* sa = (ushort*) source_array;
+    ushort* buf = (ushort*) raster_buffer;
+
+    x1 = offset_x;
+    x2 = x1 + raster_width - 1;
+
+    for (x = x1; x <= x2; x += step_x)  {
+        buf[raster_pos++] = sa[2 * x + 1];
+    }
+}
+
+/* gets the unsigned 16 bit value of two big endian bytes */
+#define EPR_BE_USHORT(p) ((ushort) (((p)[0] << 8) | (p)[1]))
+
+void decode_line_ushort_1_of_1_be_to_float(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    int x, x1, x2;
+    uchar* sa = (uchar*) source_array;
+    float* buf = (float*) raster_buffer;
+    const float* lut;
+
+    x1 = offset_x;
+    x2 = x1 + raster_width - 1;
+
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_ushort)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[EPR_BE_USHORT(sa + 2 * x)];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * EPR_BE_USHORT(sa + 2 * x));
+        }
+    } else if (band_id->scaling_method == e_smid_lin) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = band_id->scaling_offset + band_id->scaling_factor * EPR_BE_USHORT(sa + 2 * x);
+        }
+    } else {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = EPR_BE_USHORT(sa + 2 * x);
+        }
+    }
+}
+
+/*
+ * Decodes every sample_step-th big endian short starting with the given
+ * sample, shared by the 1OF1, 1OF2 and 2OF2 decoders below.
+ */
+static void decode_line_short_be_to_float(uchar* sa,
+        int sample_step,
+        int sample_index,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        float* buf,
+        int raster_pos) {
+    int x, x1, x2;
+    short s;
+    const float* lut;
+
+    x1 = offset_x;
+    x2 = x1 + raster_width - 1;
+
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_short)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[EPR_BE_USHORT(sa + 2 * (sample_step * x + sample_index))];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
+        for (x = x1; x <= x2; x += step_x) {
+            s = (short) EPR_BE_USHORT(sa + 2 * (sample_step * x + sample_index));
+            buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * s);
+        }
+    } else if (band_id->scaling_method == e_smid_lin) {
+        for (x = x1; x <= x2; x += step_x) {
+            s = (short) EPR_BE_USHORT(sa + 2 * (sample_step * x + sample_index));
+            buf[raster_pos++] = band_id->scaling_offset + band_id->scaling_factor * s;
+        }
+    } else {
+        for (x = x1; x <= x2; x += step_x) {
+            s = (short) EPR_BE_USHORT(sa + 2 * (sample_step * x + sample_index));
+            buf[raster_pos++] = (float)s;
+        }
+    }
+}
+
+void decode_line_short_1_of_1_be_to_float(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    decode_line_short_be_to_float((uchar*) source_array, 1, 0, band_id, offset_x, raster_width, step_x,
+                                  (float*) raster_buffer, raster_pos);
+}
+
+void decode_line_short_1_of_2_be_to_float(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    decode_line_short_be_to_float((uchar*) source_array, 2, 0, band_id, offset_x, raster_width, step_x,
+                                  (float*) raster_buffer, raster_pos);
+}
+
+void decode_line_short_2_of_2_be_to_float(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    decode_line_short_be_to_float((uchar*) source_array, 2, 1, band_id, offset_x, raster_width, step_x,
+                                  (float*) raster_buffer, raster_pos);
+}
+
+void decode_line_ushort_1_of_1_be_to_ushort(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    int x, x1, x2;
+    uchar* sa = (uchar*) source_array;
+    ushort* buf = (ushort*) raster_buffer;
+
+    x1 = offset_x;
+    x2 = x1 + raster_width - 1;
+
+    for (x = x1; x <= x2; x += step_x)  {
+        buf[raster_pos++] = EPR_BE_USHORT(sa + 2 * x);
+    }
+}
+
+void decode_line_ushort_1_of_2_be_to_ushort(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    int x, x1, x2;
+    uchar* sa = (uchar*) source_array;
+    ushort* buf = (ushort*) raster_buffer;
+
+    x1 = offset_x;
+    x2 = x1 + raster_width - 1;
+
+    for (x = x1; x <= x2; x += step_x)  {
+        buf[raster_pos++] = EPR_BE_USHORT(sa + 4 * x);
+    }
+}
+
+void decode_line_ushort_2_of_2_be_to_ushort(void* source_array,
+        EPR_SBandId* band_id,
+        int offset_x,
+        int raster_width,
+        int step_x,
+        void* raster_buffer,
+        int raster_pos) {
+    int x, x1, x2;
+    uchar* sa = (uchar*) source_array;
+    ushort* buf = (ushort*) raster_buffer;
+
+    x1 = offset_x;
+    x2 = x1 + raster_width - 1;
+
+    for (x = x1; x <= x2; x += step_x)  {
+        buf[raster_pos++] = EPR_BE_USHORT(sa + 4 * x + 2);
+    }
+}
+
 void decode_line_uchar_2_to_f_to_float(void* source_array,
                                        EPR_SBandId* band_id,
                                        int offset_x,
@@ -1471,11 +2862,17 @@ void decode_line_uchar_2_to_f_to_float(void* source_array,
     int x, x1, x2, shi;
     uchar* sa = (uchar*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_ushort)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            shi = (((sa[2 * x] & 0xff)) | ((sa[2 * x + 1] & 0xff) << 8)) & 0xffff;
+            buf[raster_pos++] = lut[shi];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
         for (x = x1; x <= x2; x += step_x)  {
             shi = (((sa[2 * x] & 0xff)) | ((sa[2 * x + 1] & 0xff) << 8)) & 0xffff;
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * shi);
@@ -1493,6 +2890,25 @@ void decode_line_uchar_2_to_f_to_float(void* source_array,
     }
 }
 
+void decode_line_uchar_2_to_f_to_ushort(void* source_array,
+                                        EPR_SBandId* band_id,
+                                        int offset_x,
+                                        int raster_width,
+                                        int step_x,
+                                        void* raster_buffer,
+                                        int raster_pos) {
+    int x, x1, x2;
+    uchar* sa = (uchar*) source_array;
+    ushort* buf = (ushort*) raster_buffer;
+
+    x1 = offset_x;
+    x2 = x1 + raster_width - 1;
+
+    for (x = x1; x <= x2; x += step_x)  {
+        buf[raster_pos++] = (ushort) ((sa[2 * x] & 0xff) | ((sa[2 * x + 1] & 0xff) << 8));
+    }
+}
+
 void decode_line_uchar_1_of_2_to_float(void* source_array,
                                        EPR_SBandId* band_id,
                                        int offset_x,
@@ -1503,12 +2919,17 @@ void decode_line_uchar_1_of_2_to_float(void* source_array,
     int x, x1, x2;
     uchar* sa = (uchar*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
-        for (x = x1; x <= x2; x += step_x)  {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_uchar)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[sa[2 * x]];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
+        for (x = x1; x <= x2; x += step_x) {
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * (sa[2 * x] & 0xff));
         }
     } else if (band_id->scaling_method == e_smid_lin) {
@@ -1534,11 +2955,16 @@ void decode_line_uchar_2_of_2_to_float(void* source_array,
     int x, x1, x2;
     uchar* sa = (uchar*) source_array;
     float* buf = (float*) raster_buffer;
+    const float* lut;
 
     x1 = offset_x;
     x2 = x1 + raster_width - 1;
 
-    if (band_id->scaling_method == e_smid_log) {
+    if (band_id->scaling_method == e_smid_log && (lut = epr_get_log_scaling_lut(band_id, e_tid_uchar)) != NULL) {
+        for (x = x1; x <= x2; x += step_x) {
+            buf[raster_pos++] = lut[sa[2 * x + 1]];
+        }
+    } else if (band_id->scaling_method == e_smid_log) {
         for (x = x1; x <= x2; x += step_x) {
             buf[raster_pos++] = (float)pow(10, band_id->scaling_offset + band_id->scaling_factor * (sa[2 * x + 1] & 0xff));
         }
@@ -1804,12 +3230,33 @@ void mirror_uint_array(uint* raster_buffer, uint raster_width, uint raster_heigh
     }
 }
 
+void mirror_double_array(double* raster_buffer, uint raster_width, uint raster_height) {
+    uint h;
+    double tmp;
+    double* start;
+    double* end;
+
+    for (h = 0; h < raster_height; h++) {
+        start = raster_buffer + h * raster_width;
+        end = start + raster_width - 1;
+        while (start < end) {
+            tmp = *start;
+            *start++ = *end;
+            *end-- = tmp;
+        }
+    }
+}
+
 void epr_zero_invalid_pixels(EPR_SRaster* raster, EPR_SRaster* bm_raster) {
 
     uchar* bm_pixels;
     uint bm_pos = 0;
     uint bm_len = raster->raster_width * raster->raster_height;
 
+    if (bm_raster->data_type == e_tid_bit) {
+        epr_zero_invalid_pixels_packed(raster, bm_raster);
+        return;
+    }
     assert(bm_raster->data_type == e_tid_char
            || bm_raster->data_type == e_tid_uchar);
 
@@ -1827,7 +3274,8 @@ void epr_zero_invalid_pixels(EPR_SRaster* raster, EPR_SRaster* bm_raster) {
         }
         break;
         case e_tid_short:
-        case e_tid_ushort: {
+        case e_tid_ushort:
+        case e_tid_half: {
             short* pixels = (short*) raster->buffer;
             for (bm_pos = 0; bm_pos < bm_len; bm_pos++) {
                 if (bm_pixels[bm_pos] == 0) {
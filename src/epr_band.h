@@ -85,7 +85,9 @@ float epr_get_scaling_params(EPR_SProductId* product_id,  const char* str);
 int epr_read_band_measurement_data(EPR_SBandId* band_id, int offset_x, int offset_y, EPR_SRaster* raster);
 
 /**
- * Reads the annotation data and converts its in physical values.
+ * Reads the annotation data and converts its in physical values. The values
+ * are interpolated as floats, a raster of another data type receives them
+ * converted a line at a time.
  *
  * @param band_id the information about properties and quantities of ENVISAT data.
  * @param offset_x X-coordinate in pixel coordinates (zero-based) of the upper right corner raster to search
@@ -129,6 +131,25 @@ void decode_line_uchar_1_of_2_to_float   (void* sourceArray, EPR_SBandId* band_i
 void decode_line_uchar_2_of_2_to_float   (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
 void decode_line_uchar_2_to_f_to_float   (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
 void decode_line_uchar_3_to_i_to_uint   (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_ushort_1_of_2_to_ushort (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_ushort_2_of_2_to_ushort (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_uchar_2_to_f_to_ushort  (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+/*@}*/
+
+/**
+ * This group of functions decodes 16 bit samples straight from the raw
+ * big endian (BE) bytes of a product file. Byte swapping, sample extraction
+ * and scaling are done in a single pass. The parameters are the same as
+ * for the functions above.
+ */
+/*@{*/
+void decode_line_ushort_1_of_1_be_to_float  (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_short_1_of_1_be_to_float   (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_short_1_of_2_be_to_float   (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_short_2_of_2_be_to_float   (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_ushort_1_of_1_be_to_ushort (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_ushort_1_of_2_be_to_ushort (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
+void decode_line_ushort_2_of_2_be_to_ushort (void* sourceArray, EPR_SBandId* band_id, int xo, int raster_width, int s_x, void* raster_buffer, int raster_pos);
 /*@}*/
 
 /**
@@ -163,6 +184,7 @@ void mirror_float_array  (float*  raster_buffer, uint raster_width, uint raster_
 void mirror_uchar_array  (uchar*  raster_buffer, uint raster_width, uint raster_height);
 void mirror_ushort_array (ushort* raster_buffer, uint raster_width, uint raster_height);
 void mirror_uint_array  (uint*  raster_buffer, uint raster_width, uint raster_height);
+void mirror_double_array (double* raster_buffer, uint raster_width, uint raster_height);
 /*@}*/
 
 /**
@@ -217,19 +239,371 @@ typedef void (*EPR_FLineDecoder)(void* sourceArray,
 
 /**
  * Selects the line decode function, depended on measurement data type.
+ * If the CPU supports it, the SIMD variant of the decoder is returned.
  */
 EPR_FLineDecoder select_line_decode_function(EPR_EDataTypeId band_daty, EPR_ESampleModel band_smod, EPR_EDataTypeId daty_id);
 
+/**
+ * Selects the line decode function for raw samples as stored in the product
+ * file, i.e. in big endian order. On little endian hosts the functions
+ * which swap the bytes while decoding are returned.
+ */
+EPR_FLineDecoder select_raw_line_decode_function(EPR_EDataTypeId band_daty, EPR_ESampleModel band_smod, EPR_EDataTypeId daty_id);
+
 typedef void (*EPR_FArrayTransformer)(void* sourceArray,
                                      EPR_SBandId* band_id,
                                      float* raster_buffer,
                                      uint nel);
 
+/**
+ * The <code>EPR_BandReadPlan</code> structure describes where the raw
+ * samples of a measurement band are located within the records of its
+ * dataset. It is built once per band on the first read and allows reading
+ * only the bytes of the requested pixels instead of full records.
+ */
+struct EPR_BandReadPlan
+{
+    /**
+     * The offset in bytes of the band's field within a dataset record.
+     */
+    uint field_offset;
+
+    /**
+     * The total size in bytes of the band's field.
+     */
+    uint field_size;
+
+    /**
+     * The size in bytes of a single raw field element.
+     */
+    uint elem_size;
+
+    /**
+     * The number of bytes occupied by one pixel according to the sample model.
+     */
+    uint pixel_size;
+
+    /**
+     * The number of pixels stored in the band's field.
+     */
+    uint num_pixels;
+
+    /**
+     * The data type of the raw field elements.
+     */
+    EPR_EDataTypeId raw_type;
+
+    /**
+     * The sample model of the band.
+     */
+    EPR_ESampleModel sample_model;
+
+    /**
+     * The function used to decode a line of raw (big endian) pixels.
+     */
+    EPR_FLineDecoder decode_func;
+
+    /**
+     * The data type of the unscaled samples, i.e. the raw counts of the
+     * band. Differs from <code>raw_type</code> for the sample models
+     * combining several field elements into one sample.
+     */
+    EPR_EDataTypeId count_type;
+
+    /**
+     * The function used to decode a line of raw (big endian) pixels into
+     * unscaled samples of <code>count_type</code>, <code>NULL</code> if
+     * the raw counts of the band cannot be read.
+     */
+    EPR_FLineDecoder count_decode_func;
+};
+
+typedef struct EPR_BandReadPlan EPR_SBandReadPlan;
+
+/**
+ * The <code>EPR_ScalingLUT</code> structure holds the log-scaled physical
+ * values of all possible raw values of an 8 or 16 bit raw data type.
+ * The table is indexed by the bit pattern of the raw value, i.e. by the
+ * raw value cast to <code>uchar</code> or <code>ushort</code>.
+ */
+struct EPR_ScalingLUT
+{
+    /**
+     * The raw data type the table was built for.
+     */
+    EPR_EDataTypeId raw_type;
+
+    /**
+     * The number of table entries, 256 or 65536.
+     */
+    uint size;
+
+    /**
+     * The physical values.
+     */
+    float* values;
+};
+
+typedef struct EPR_ScalingLUT EPR_SScalingLUT;
+
+/**
+ * Gets the lookup table of log-scaled physical values of the given band for
+ * the given raw data type. The table is built on the first call and cached
+ * in the band identifier, so that log-scaled lines are decoded by table
+ * lookups instead of a <code>pow()</code> call per pixel.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param raw_type one of <code>e_tid_uchar</code>, <code>e_tid_char</code>,
+ *        <code>e_tid_ushort</code> or <code>e_tid_short</code>
+ * @return the table or <code>NULL</code> if the type is not supported
+ *         or the table could not be allocated
+ */
+const float* epr_get_log_scaling_lut(EPR_SBandId* band_id, EPR_EDataTypeId raw_type);
+
+/**
+ * Releases the lookup table of log-scaled values of the given band, if any.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ */
+void epr_free_log_scaling_lut(EPR_SBandId* band_id);
+
+/**
+ * Gets the read plan of the given measurement band, the plan is created
+ * on the first call.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @return the read plan or <code>NULL</code> if an error occurred.
+ */
+const EPR_SBandReadPlan* epr_get_band_read_plan(EPR_SBandId* band_id);
+
+/**
+ * Releases the read plan of the given band, if any.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ */
+void epr_free_band_read_plan(EPR_SBandId* band_id);
+
+/**
+ * Gets the raw pixels <code>[offset_x, offset_x + width)</code> of the band's
+ * field in the given dataset record. The bytes are left in the big endian
+ * order of the product file, so that they can be passed to the plan's line
+ * decoder with an X-offset of zero.
+ *
+ * <p>If the product is memory-mapped, <code>line_data</code> points into the
+ * mapping and nothing is copied. Otherwise the bytes are read into
+ * <code>line_buffer</code> and <code>line_data</code> points to it.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param plan the band's read plan, must not be <code>NULL</code>
+ * @param record_index the zero-based index of the dataset record (line)
+ * @param offset_x the zero-based index of the first pixel within the record
+ * @param width the number of pixels to be read
+ * @param line_buffer the buffer used for reading, must provide at least
+ *        <code>width * plan->pixel_size</code> bytes
+ * @param line_data receives the address of the first raw byte
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_line(EPR_SBandId* band_id,
+                       const EPR_SBandReadPlan* plan,
+                       uint record_index,
+                       uint offset_x,
+                       uint width,
+                       void* line_buffer,
+                       const uchar** line_data);
+
+/**
+ * Gets the X-offset of the source region of a raster within the records
+ * of the band, which differs from <code>offset_x</code> if the lines are mirrored.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param offset_x the X-offset of the source region in scene coordinates
+ * @param raster the raster giving the size and sub-sampling of the region
+ * @return the zero-based index of the first pixel read from each record
+ */
+int epr_get_mirrored_offset_x(const EPR_SBandId* band_id, int offset_x, const EPR_SRaster* raster);
+
+/**
+ * Combines the lines of a source region into aggregated rasters, see
+ * <code>epr_read_band_pyramid</code>.
+ */
+typedef struct EPR_Aggregator EPR_SAggregator;
+
+/**
+ * Creates an aggregator filling the given rasters, which must all have the
+ * same source region, with the given method.
+ *
+ * @param levels the rasters receiving the aggregated pixels
+ * @param num_levels the number of rasters
+ * @param method the aggregation method
+ * @return the aggregator or <code>NULL</code> if an error occurred
+ */
+EPR_SAggregator* epr_create_aggregator(EPR_SRaster** levels, uint num_levels, EPR_EAggregationMethod method);
+
+/**
+ * Adds the next line of the source region, the rasters are complete when
+ * all <code>source_height</code> lines have been added.
+ *
+ * @param aggregator the aggregator, must not be <code>NULL</code>
+ * @param line the <code>source_width</code> pixels of the line
+ * @param valid the validity of each pixel of the line, pixels which are zero
+ *        are left out of their blocks; all pixels are valid if <code>NULL</code>
+ */
+void epr_aggregate_line(EPR_SAggregator* aggregator, const double* line, const uchar* valid);
+
+/**
+ * Releases an aggregator, the rasters are not released.
+ *
+ * @param aggregator the aggregator, can be <code>NULL</code>
+ */
+void epr_free_aggregator(EPR_SAggregator* aggregator);
+
+/**
+ * Reads a band raster like <code>epr_read_band_raster</code>, but without
+ * masking its pixels with the band's bit-mask expression. Used by readers
+ * evaluating the bit-mask themselves, which then skip the invalid pixels
+ * instead of seeing them as zeros.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param offset_x the X-offset of the source region in scene coordinates
+ * @param offset_y the Y-offset of the source region in scene coordinates
+ * @param raster the raster receiving the data
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_band_raster_unmasked(EPR_SBandId* band_id,
+                                  int offset_x,
+                                  int offset_y,
+                                  EPR_SRaster* raster);
+
+/**
+ * Finishes a decoded line of a band raster: mirrors it if the band's lines
+ * are mirrored and applies the packed bit-mask raster, if any.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param raster the raster containing the line
+ * @param row the zero-based index of the line within the raster
+ * @param bm_raster the packed bit-mask raster of the raster, can be <code>NULL</code>
+ * @return zero for success, an error code otherwise
+ */
+int epr_finish_band_line(const EPR_SBandId* band_id,
+                         EPR_SRaster* raster,
+                         uint row,
+                         const EPR_SRaster* bm_raster);
+
 /**
  * Selects the transform array function, dependent on annotation data type.
  */
 EPR_FArrayTransformer select_transform_array_function(EPR_EDataTypeId band_daty, EPR_EDataTypeId daty_id);
 
+/**
+ * The <code>EPR_TiePointGrid</code> structure describes the tie point grid
+ * of an annotation band. It is built once per band on the first read. Each
+ * row of tie points is read and transformed into physical values only once,
+ * the transformed rows are kept until the band is released.
+ */
+struct EPR_TiePointGrid
+{
+    /**
+     * The number of tie point rows, i.e. records of the annotation dataset.
+     */
+    uint num_rows;
+
+    /**
+     * The number of tie points in a row.
+     */
+    uint num_elems;
+
+    /**
+     * The distance in scene lines between two tie point rows.
+     */
+    uint lines_per_tie_pt;
+
+    /**
+     * The distance in scene pixels between two tie points of a row.
+     */
+    uint samples_per_tie_pt;
+
+    /**
+     * The number of pixels of a scene line covered by the grid.
+     */
+    uint scan_line_length;
+
+    /**
+     * The X-position of the first tie point in scene pixels.
+     */
+    float scan_offset_x;
+
+    /**
+     * The Y-position of the first tie point row in scene lines.
+     */
+    float scan_offset_y;
+
+    /**
+     * Whether the band holds longitudes, which must be unwrapped at the
+     * date line before interpolation.
+     */
+    epr_boolean is_longitude;
+
+    /**
+     * The function transforming a row of raw tie points into physical values.
+     */
+    EPR_FArrayTransformer transform_func;
+
+    /**
+     * The record used for reading the tie point rows.
+     */
+    EPR_SRecord* record;
+
+    /**
+     * The transformed tie point rows, an entry is <code>NULL</code> until
+     * the row has been read.
+     */
+    float** rows;
+};
+
+typedef struct EPR_TiePointGrid EPR_STiePointGrid;
+
+/**
+ * Gets the tie point grid of the given annotation band, the grid is created
+ * on the first call.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @return the tie point grid or <code>NULL</code> if an error occurred.
+ */
+EPR_STiePointGrid* epr_get_tie_point_grid(EPR_SBandId* band_id);
+
+/**
+ * Gets a row of the tie point grid of the given band transformed into
+ * physical values. The row is read on the first call only.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param grid the band's tie point grid, must not be <code>NULL</code>
+ * @param row_index the zero-based index of the row
+ * @return the <code>grid->num_elems</code> values of the row or
+ *         <code>NULL</code> if an error occurred.
+ */
+const float* epr_get_tie_point_row(EPR_SBandId* band_id, EPR_STiePointGrid* grid, uint row_index);
+
+/**
+ * Sets a row of the tie point grid of the given band from a record of the
+ * band's annotation dataset, unless the row is already known. Allows to fill
+ * the grids of several bands of a dataset from a single read of each record.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ * @param grid the band's tie point grid, must not be <code>NULL</code>
+ * @param row_index the zero-based index of the row
+ * @param record the record <code>row_index</code> of the annotation dataset
+ * @return the <code>grid->num_elems</code> values of the row or
+ *         <code>NULL</code> if an error occurred.
+ */
+const float* epr_set_tie_point_row(EPR_SBandId* band_id, EPR_STiePointGrid* grid, uint row_index, const EPR_SRecord* record);
+
+/**
+ * Releases the tie point grid of the given band, if any.
+ *
+ * @param band_id the band identifier, must not be <code>NULL</code>
+ */
+void epr_free_tie_point_grid(EPR_SBandId* band_id);
+
 /**
  * Masks the band information out.
  * The band information will be masked dependent on bit mask filter for the same
@@ -240,6 +614,37 @@ EPR_FArrayTransformer select_transform_array_function(EPR_EDataTypeId band_daty,
  */
 void epr_zero_invalid_pixels(EPR_SRaster* raster, EPR_SRaster* bm_raster);
 
+/**
+ * Tests whether rasters can have the given data type, i.e. whether it is
+ * a numeric type.
+ */
+epr_boolean epr_is_raster_data_type(EPR_EDataTypeId data_type);
+
+/**
+ * Converts an array of raster elements into another data type. Values are
+ * rounded to the nearest integer and clipped to the range of integer types,
+ * NaN gives zero.
+ *
+ * @param source the elements to be converted
+ * @param source_type the data type of the elements to be converted
+ * @param target the array receiving the converted elements
+ * @param target_type the data type of the converted elements
+ * @param num_elems the number of elements
+ */
+void epr_convert_array(const void* source, EPR_EDataTypeId source_type,
+                       void* target, EPR_EDataTypeId target_type,
+                       uint num_elems);
+
+/**
+ * Converts a 16 bit half precision floating point number (the elements of
+ * <code>e_tid_half</code> rasters) into a float and back. The conversion
+ * into half precision rounds to the nearest value.
+ */
+/*@{*/
+float epr_half_to_float(ushort half);
+ushort epr_float_to_half(float value);
+/*@}*/
+
 /**
  * Release the memory allocated through a band ID.
  *
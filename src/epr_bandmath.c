@@ -0,0 +1,1047 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_string.h"
+#include "epr_ptrarray.h"
+#include "epr_band.h"
+
+
+/* the number of raster lines of the source bands read at once */
+#define EPR_BMATH_CHUNK_HEIGHT 64
+
+/* the maximum length of a name in a band-math expression */
+#define EPR_BMATH_MAX_NAME_LEN 80
+
+
+/**
+ * The operations of band-math expressions, both in the parsed expression
+ * tree and in the compiled program.
+ */
+enum EPR_BmathOp {
+    BMX_CONST = 0,
+    BMX_BAND,
+    BMX_FLAG,
+    BMX_NEG,
+    BMX_NOT,
+    BMX_ADD,
+    BMX_SUB,
+    BMX_MUL,
+    BMX_DIV,
+    BMX_POW,
+    BMX_LT,
+    BMX_LE,
+    BMX_GT,
+    BMX_GE,
+    BMX_EQ,
+    BMX_NE,
+    BMX_AND,
+    BMX_OR,
+    BMX_FUNC1,
+    BMX_FUNC2,
+    BMX_SELECT
+};
+
+typedef double (*EPR_FBmathFunc1)(double x);
+typedef double (*EPR_FBmathFunc2)(double x, double y);
+
+/**
+ * A node of a parsed band-math expression.
+ */
+typedef struct EPR_BmathNode {
+    enum EPR_BmathOp op;
+    /* BMX_CONST: the value */
+    double value;
+    /* BMX_BAND and BMX_FLAG: the index of the source */
+    uint source_index;
+    /* BMX_FLAG: the mask of the flag bits which must all be set */
+    uint flag_mask;
+    /* BMX_FUNC1 and BMX_FUNC2: the function */
+    EPR_FBmathFunc1 func1;
+    EPR_FBmathFunc2 func2;
+    /* the operands */
+    struct EPR_BmathNode* args[3];
+} EPR_SBmathNode;
+
+/**
+ * A single instruction of a compiled band-math program. Each instruction
+ * processes a whole line: the operands are the lines on top of the stack,
+ * the result replaces them.
+ */
+typedef struct EPR_BmathInstr {
+    enum EPR_BmathOp op;
+    double value;
+    uint source_index;
+    uint flag_mask;
+    EPR_FBmathFunc1 func1;
+    EPR_FBmathFunc2 func2;
+} EPR_SBmathInstr;
+
+/**
+ * A band read by a band-math program, either for its values or, if
+ * <code>flags</code> is set, for its flag words.
+ */
+typedef struct EPR_BmathSource {
+    EPR_SBandId* band_id;
+    epr_boolean flags;
+} EPR_SBmathSource;
+
+struct EPR_BandMath {
+    EPR_SProductId* product_id;
+    uint num_sources;
+    EPR_SBmathSource* sources;
+    uint num_instrs;
+    EPR_SBmathInstr* instrs;
+    /* the maximum number of lines on the stack */
+    uint stack_size;
+};
+
+/**
+ * The state of the parser.
+ */
+typedef struct EPR_BmathParser {
+    EPR_SProductId* product_id;
+    const char* expr;
+    uint pos;
+    EPR_SPtrArray* sources;
+    epr_boolean failed;
+} EPR_SBmathParser;
+
+
+static double epr_bmath_min(double x, double y)
+{
+    return x < y ? x : y;
+}
+
+static double epr_bmath_max(double x, double y)
+{
+    return x > y ? x : y;
+}
+
+static const struct {
+    const char* name;
+    EPR_FBmathFunc1 func1;
+    EPR_FBmathFunc2 func2;
+} epr_bmath_funcs[] = {
+    {"sqrt", sqrt, NULL},
+    {"exp", exp, NULL},
+    {"log", log, NULL},
+    {"log10", log10, NULL},
+    {"abs", fabs, NULL},
+    {"floor", floor, NULL},
+    {"ceil", ceil, NULL},
+    {"sin", sin, NULL},
+    {"cos", cos, NULL},
+    {"tan", tan, NULL},
+    {"asin", asin, NULL},
+    {"acos", acos, NULL},
+    {"atan", atan, NULL},
+    {"atan2", NULL, atan2},
+    {"pow", NULL, pow},
+    {"min", NULL, epr_bmath_min},
+    {"max", NULL, epr_bmath_max}
+};
+
+#define EPR_BMATH_NUM_FUNCS (sizeof (epr_bmath_funcs) / sizeof (epr_bmath_funcs[0]))
+
+
+/* applies an operation with constant operands, also used for constant folding */
+static double epr_apply_bmath_op(enum EPR_BmathOp op, EPR_FBmathFunc1 func1, EPR_FBmathFunc2 func2,
+                                 double a, double b, double c)
+{
+    switch (op) {
+    case BMX_NEG:
+        return -a;
+    case BMX_NOT:
+        return a == 0.0 ? 1.0 : 0.0;
+    case BMX_ADD:
+        return a + b;
+    case BMX_SUB:
+        return a - b;
+    case BMX_MUL:
+        return a * b;
+    case BMX_DIV:
+        return a / b;
+    case BMX_POW:
+        return pow(a, b);
+    case BMX_LT:
+        return a < b ? 1.0 : 0.0;
+    case BMX_LE:
+        return a <= b ? 1.0 : 0.0;
+    case BMX_GT:
+        return a > b ? 1.0 : 0.0;
+    case BMX_GE:
+        return a >= b ? 1.0 : 0.0;
+    case BMX_EQ:
+        return a == b ? 1.0 : 0.0;
+    case BMX_NE:
+        return a != b ? 1.0 : 0.0;
+    case BMX_AND:
+        return a != 0.0 && b != 0.0 ? 1.0 : 0.0;
+    case BMX_OR:
+        return a != 0.0 || b != 0.0 ? 1.0 : 0.0;
+    case BMX_FUNC1:
+        return func1(a);
+    case BMX_FUNC2:
+        return func2(a, b);
+    case BMX_SELECT:
+        return a != 0.0 ? b : c;
+    default:
+        return 0.0;
+    }
+}
+
+
+static void epr_free_bmath_node(EPR_SBmathNode* node)
+{
+    uint i;
+
+    if (node == NULL) {
+        return;
+    }
+    for (i = 0; i < 3; i++) {
+        epr_free_bmath_node(node->args[i]);
+    }
+    free(node);
+}
+
+
+static void epr_set_bmath_error(EPR_SBmathParser* parser, const char* message)
+{
+    char buffer[256];
+
+    if (!parser->failed) {
+        parser->failed = TRUE;
+        sprintf(buffer, "epr_compile_band_math: %.160s at position %u", message, parser->pos);
+        epr_set_err(e_err_invalid_value, buffer);
+    }
+}
+
+
+static EPR_SBmathNode* epr_create_bmath_node(EPR_SBmathParser* parser, enum EPR_BmathOp op)
+{
+    EPR_SBmathNode* node = (EPR_SBmathNode*) calloc(1, sizeof (EPR_SBmathNode));
+
+    if (node == NULL) {
+        epr_set_bmath_error(parser, "out of memory");
+        return NULL;
+    }
+    node->op = op;
+    return node;
+}
+
+
+/**
+ * Creates an operation node with the given operands. The operands are
+ * released if the node cannot be created.
+ */
+static EPR_SBmathNode* epr_create_bmath_op(EPR_SBmathParser* parser, enum EPR_BmathOp op, uint num_args,
+                                           EPR_SBmathNode* arg1, EPR_SBmathNode* arg2, EPR_SBmathNode* arg3)
+{
+    EPR_SBmathNode* args[3];
+    EPR_SBmathNode* node;
+    uint i;
+
+    args[0] = arg1;
+    args[1] = arg2;
+    args[2] = arg3;
+    for (i = 0; i < num_args; i++) {
+        if (args[i] == NULL) {
+            epr_free_bmath_node(arg1);
+            epr_free_bmath_node(arg2);
+            epr_free_bmath_node(arg3);
+            return NULL;
+        }
+    }
+    node = epr_create_bmath_node(parser, op);
+    if (node == NULL) {
+        epr_free_bmath_node(arg1);
+        epr_free_bmath_node(arg2);
+        epr_free_bmath_node(arg3);
+        return NULL;
+    }
+    for (i = 0; i < num_args; i++) {
+        node->args[i] = args[i];
+    }
+    return node;
+}
+
+
+/* folds the given operation node into a constant if all of its operands are constant */
+static EPR_SBmathNode* epr_fold_bmath_node(EPR_SBmathNode* node)
+{
+    uint i;
+
+    if (node == NULL || node->op == BMX_CONST || node->op == BMX_BAND || node->op == BMX_FLAG) {
+        return node;
+    }
+    for (i = 0; i < 3; i++) {
+        if (node->args[i] != NULL && node->args[i]->op != BMX_CONST) {
+            return node;
+        }
+    }
+    node->value = epr_apply_bmath_op(node->op, node->func1, node->func2,
+                                     node->args[0] != NULL ? node->args[0]->value : 0.0,
+                                     node->args[1] != NULL ? node->args[1]->value : 0.0,
+                                     node->args[2] != NULL ? node->args[2]->value : 0.0);
+    for (i = 0; i < 3; i++) {
+        epr_free_bmath_node(node->args[i]);
+        node->args[i] = NULL;
+    }
+    node->op = BMX_CONST;
+    return node;
+}
+
+
+static void epr_skip_bmath_spaces(EPR_SBmathParser* parser)
+{
+    while (isspace((uchar) parser->expr[parser->pos])) {
+        parser->pos++;
+    }
+}
+
+
+/* consumes the given operator or keyword if it is next in the expression */
+static epr_boolean epr_accept_bmath_token(EPR_SBmathParser* parser, const char* token)
+{
+    uint length = (uint) strlen(token);
+    const char* next;
+
+    epr_skip_bmath_spaces(parser);
+    next = parser->expr + parser->pos;
+    if (isalpha((uchar) token[0])) {
+        uint i;
+        for (i = 0; i < length; i++) {
+            if (tolower((uchar) next[i]) != token[i]) {
+                return FALSE;
+            }
+        }
+        if (isalnum((uchar) next[length]) || next[length] == '_') {
+            return FALSE;
+        }
+        parser->pos += length;
+        return TRUE;
+    }
+    if (strncmp(next, token, length) == 0) {
+        /* '<' must not match the beginning of '<=' and so on */
+        if (length == 1 && (token[0] == '<' || token[0] == '>' || token[0] == '!') && next[1] == '=') {
+            return FALSE;
+        }
+        parser->pos += length;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+
+/* reads a name, returns FALSE if there is none or if it is too long */
+static epr_boolean epr_read_bmath_name(EPR_SBmathParser* parser, char* name)
+{
+    uint start, length;
+    char* message;
+
+    epr_skip_bmath_spaces(parser);
+    if (!isalpha((uchar) parser->expr[parser->pos]) && parser->expr[parser->pos] != '_') {
+        return FALSE;
+    }
+    start = parser->pos;
+    while (isalnum((uchar) parser->expr[parser->pos]) || parser->expr[parser->pos] == '_') {
+        parser->pos++;
+    }
+    length = parser->pos - start;
+    if (length > EPR_BMATH_MAX_NAME_LEN) {
+        /* the whole name is reported, it would be cut by epr_set_bmath_error */
+        if (!parser->failed) {
+            parser->failed = TRUE;
+            message = (char*) malloc(length + 128);
+            if (message != NULL) {
+                sprintf(message, "epr_compile_band_math: the name '%.*s' at position %u is longer than %d characters",
+                        (int) length, parser->expr + start, start, EPR_BMATH_MAX_NAME_LEN);
+                epr_set_err(e_err_invalid_value, message);
+                free(message);
+            } else {
+                epr_set_err(e_err_invalid_value, "epr_compile_band_math: name too long");
+            }
+        }
+        return FALSE;
+    }
+    memcpy(name, parser->expr + start, length);
+    name[length] = '\0';
+    return TRUE;
+}
+
+
+/* gets the index of the source reading the given band, adding it if necessary */
+static uint epr_get_bmath_source(EPR_SBmathParser* parser, EPR_SBandId* band_id, epr_boolean flags)
+{
+    EPR_SBmathSource* source;
+    uint i;
+
+    for (i = 0; i < parser->sources->length; i++) {
+        source = (EPR_SBmathSource*) parser->sources->elems[i];
+        if (source->band_id == band_id && source->flags == flags) {
+            return i;
+        }
+    }
+    source = (EPR_SBmathSource*) calloc(1, sizeof (EPR_SBmathSource));
+    if (source == NULL) {
+        epr_set_bmath_error(parser, "out of memory");
+        return 0;
+    }
+    source->band_id = band_id;
+    source->flags = flags;
+    epr_add_ptr_array_elem(parser->sources, source);
+    return parser->sources->length - 1;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_expr(EPR_SBmathParser* parser);
+static EPR_SBmathNode* epr_parse_bmath_unary(EPR_SBmathParser* parser);
+
+
+/* parses a band or flag reference, a constant or a function call */
+static EPR_SBmathNode* epr_parse_bmath_name(EPR_SBmathParser* parser, const char* name)
+{
+    char flag_name[EPR_BMATH_MAX_NAME_LEN + 1];
+    EPR_SBmathNode* node;
+    EPR_SBmathNode* arg1;
+    EPR_SBmathNode* arg2 = NULL;
+    EPR_SBandId* band_id;
+    uint i;
+
+    if (epr_accept_bmath_token(parser, "(")) {
+        for (i = 0; i < EPR_BMATH_NUM_FUNCS; i++) {
+            if (epr_equal_names(epr_bmath_funcs[i].name, name)) {
+                break;
+            }
+        }
+        if (i == EPR_BMATH_NUM_FUNCS) {
+            epr_set_bmath_error(parser, "unknown function");
+            return NULL;
+        }
+        arg1 = epr_parse_bmath_expr(parser);
+        if (arg1 != NULL && epr_bmath_funcs[i].func2 != NULL) {
+            if (!epr_accept_bmath_token(parser, ",")) {
+                epr_free_bmath_node(arg1);
+                epr_set_bmath_error(parser, "',' expected");
+                return NULL;
+            }
+            arg2 = epr_parse_bmath_expr(parser);
+        }
+        if (!epr_accept_bmath_token(parser, ")")) {
+            epr_free_bmath_node(arg1);
+            epr_free_bmath_node(arg2);
+            epr_set_bmath_error(parser, "')' expected");
+            return NULL;
+        }
+        node = epr_create_bmath_op(parser, epr_bmath_funcs[i].func2 != NULL ? BMX_FUNC2 : BMX_FUNC1,
+                                   epr_bmath_funcs[i].func2 != NULL ? 2 : 1, arg1, arg2, NULL);
+        if (node != NULL) {
+            node->func1 = epr_bmath_funcs[i].func1;
+            node->func2 = epr_bmath_funcs[i].func2;
+        }
+        return epr_fold_bmath_node(node);
+    }
+
+    if (epr_equal_names(name, "PI") || epr_equal_names(name, "E") || epr_equal_names(name, "NaN")) {
+        node = epr_create_bmath_node(parser, BMX_CONST);
+        if (node != NULL) {
+            node->value = epr_equal_names(name, "PI") ? 3.14159265358979323846
+                          : (epr_equal_names(name, "E") ? 2.71828182845904523536 : sqrt(-1.0));
+            if (epr_equal_names(name, "NaN")) {
+                /* sqrt(-1.0) may be negative NaN, both are NaN */
+                node->value = fabs(node->value);
+            }
+        }
+        return node;
+    }
+
+    band_id = epr_get_band_id(parser->product_id, name);
+    if (band_id == NULL) {
+        epr_clear_err();
+        epr_set_bmath_error(parser, "unknown band");
+        return NULL;
+    }
+    if (epr_accept_bmath_token(parser, ".")) {
+        EPR_SFlagDef* flag_def = NULL;
+        if (!epr_read_bmath_name(parser, flag_name)) {
+            epr_set_bmath_error(parser, "flag name expected");
+            return NULL;
+        }
+        for (i = 0; band_id->flag_coding != NULL && i < band_id->flag_coding->length; i++) {
+            if (epr_equal_names(((EPR_SFlagDef*) band_id->flag_coding->elems[i])->name, flag_name)) {
+                flag_def = (EPR_SFlagDef*) band_id->flag_coding->elems[i];
+                break;
+            }
+        }
+        if (flag_def == NULL) {
+            epr_set_bmath_error(parser, "unknown flag");
+            return NULL;
+        }
+        node = epr_create_bmath_node(parser, BMX_FLAG);
+        if (node != NULL) {
+            node->source_index = epr_get_bmath_source(parser, band_id, TRUE);
+            node->flag_mask = flag_def->bit_mask;
+        }
+        return node;
+    }
+    node = epr_create_bmath_node(parser, BMX_BAND);
+    if (node != NULL) {
+        node->source_index = epr_get_bmath_source(parser, band_id, FALSE);
+    }
+    return node;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_primary(EPR_SBmathParser* parser)
+{
+    char name[EPR_BMATH_MAX_NAME_LEN + 1];
+    EPR_SBmathNode* node;
+    const char* start;
+    char* end;
+
+    if (epr_accept_bmath_token(parser, "(")) {
+        node = epr_parse_bmath_expr(parser);
+        if (node != NULL && !epr_accept_bmath_token(parser, ")")) {
+            epr_free_bmath_node(node);
+            epr_set_bmath_error(parser, "')' expected");
+            return NULL;
+        }
+        return node;
+    }
+    if (epr_read_bmath_name(parser, name)) {
+        return epr_parse_bmath_name(parser, name);
+    }
+    start = parser->expr + parser->pos;
+    if (isdigit((uchar) start[0]) || (start[0] == '.' && isdigit((uchar) start[1]))) {
+        node = epr_create_bmath_node(parser, BMX_CONST);
+        if (node != NULL) {
+            node->value = strtod(start, &end);
+            parser->pos += (uint) (end - start);
+        }
+        return node;
+    }
+    epr_set_bmath_error(parser, "operand expected");
+    return NULL;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_power(EPR_SBmathParser* parser)
+{
+    EPR_SBmathNode* node = epr_parse_bmath_primary(parser);
+
+    if (node != NULL && epr_accept_bmath_token(parser, "^")) {
+        /* right associative, binds tighter than the unary minus on its left */
+        node = epr_fold_bmath_node(epr_create_bmath_op(parser, BMX_POW, 2, node, epr_parse_bmath_unary(parser), NULL));
+    }
+    return node;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_unary(EPR_SBmathParser* parser)
+{
+    if (epr_accept_bmath_token(parser, "-")) {
+        return epr_fold_bmath_node(epr_create_bmath_op(parser, BMX_NEG, 1, epr_parse_bmath_unary(parser), NULL, NULL));
+    }
+    if (epr_accept_bmath_token(parser, "+")) {
+        return epr_parse_bmath_unary(parser);
+    }
+    return epr_parse_bmath_power(parser);
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_mul(EPR_SBmathParser* parser)
+{
+    EPR_SBmathNode* node = epr_parse_bmath_unary(parser);
+
+    while (node != NULL) {
+        if (epr_accept_bmath_token(parser, "*")) {
+            node = epr_create_bmath_op(parser, BMX_MUL, 2, node, epr_parse_bmath_unary(parser), NULL);
+        } else if (epr_accept_bmath_token(parser, "/")) {
+            node = epr_create_bmath_op(parser, BMX_DIV, 2, node, epr_parse_bmath_unary(parser), NULL);
+        } else {
+            break;
+        }
+        node = epr_fold_bmath_node(node);
+    }
+    return node;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_add(EPR_SBmathParser* parser)
+{
+    EPR_SBmathNode* node = epr_parse_bmath_mul(parser);
+
+    while (node != NULL) {
+        if (epr_accept_bmath_token(parser, "+")) {
+            node = epr_create_bmath_op(parser, BMX_ADD, 2, node, epr_parse_bmath_mul(parser), NULL);
+        } else if (epr_accept_bmath_token(parser, "-")) {
+            node = epr_create_bmath_op(parser, BMX_SUB, 2, node, epr_parse_bmath_mul(parser), NULL);
+        } else {
+            break;
+        }
+        node = epr_fold_bmath_node(node);
+    }
+    return node;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_compare(EPR_SBmathParser* parser)
+{
+    static const struct {
+        const char* token;
+        enum EPR_BmathOp op;
+    } ops[] = {
+        {"<=", BMX_LE}, {">=", BMX_GE}, {"==", BMX_EQ}, {"!=", BMX_NE}, {"<", BMX_LT}, {">", BMX_GT}
+    };
+    EPR_SBmathNode* node = epr_parse_bmath_add(parser);
+    uint i;
+
+    for (i = 0; node != NULL && i < sizeof (ops) / sizeof (ops[0]); i++) {
+        if (epr_accept_bmath_token(parser, ops[i].token)) {
+            node = epr_fold_bmath_node(epr_create_bmath_op(parser, ops[i].op, 2, node, epr_parse_bmath_add(parser), NULL));
+            break;
+        }
+    }
+    return node;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_not(EPR_SBmathParser* parser)
+{
+    if (epr_accept_bmath_token(parser, "not") || epr_accept_bmath_token(parser, "!")) {
+        return epr_fold_bmath_node(epr_create_bmath_op(parser, BMX_NOT, 1, epr_parse_bmath_not(parser), NULL, NULL));
+    }
+    return epr_parse_bmath_compare(parser);
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_and(EPR_SBmathParser* parser)
+{
+    EPR_SBmathNode* node = epr_parse_bmath_not(parser);
+
+    while (node != NULL && (epr_accept_bmath_token(parser, "and") || epr_accept_bmath_token(parser, "&&"))) {
+        node = epr_fold_bmath_node(epr_create_bmath_op(parser, BMX_AND, 2, node, epr_parse_bmath_not(parser), NULL));
+    }
+    return node;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_or(EPR_SBmathParser* parser)
+{
+    EPR_SBmathNode* node = epr_parse_bmath_and(parser);
+
+    while (node != NULL && (epr_accept_bmath_token(parser, "or") || epr_accept_bmath_token(parser, "||"))) {
+        node = epr_fold_bmath_node(epr_create_bmath_op(parser, BMX_OR, 2, node, epr_parse_bmath_and(parser), NULL));
+    }
+    return node;
+}
+
+
+static EPR_SBmathNode* epr_parse_bmath_expr(EPR_SBmathParser* parser)
+{
+    EPR_SBmathNode* node = epr_parse_bmath_or(parser);
+    EPR_SBmathNode* then_node;
+
+    if (node != NULL && epr_accept_bmath_token(parser, "?")) {
+        then_node = epr_parse_bmath_expr(parser);
+        if (then_node != NULL && !epr_accept_bmath_token(parser, ":")) {
+            epr_free_bmath_node(node);
+            epr_free_bmath_node(then_node);
+            epr_set_bmath_error(parser, "':' expected");
+            return NULL;
+        }
+        node = epr_fold_bmath_node(epr_create_bmath_op(parser, BMX_SELECT, 3, node, then_node,
+                                                       then_node != NULL ? epr_parse_bmath_expr(parser) : NULL));
+    }
+    return node;
+}
+
+
+/* counts the instructions of the given tree and the stack lines needed to evaluate it */
+static uint epr_count_bmath_instrs(const EPR_SBmathNode* node, uint* stack_size)
+{
+    uint i, num_instrs = 1, depth, max_depth = 1;
+
+    for (i = 0; i < 3 && node->args[i] != NULL; i++) {
+        num_instrs += epr_count_bmath_instrs(node->args[i], &depth);
+        /* the operands before this one occupy i lines */
+        if (i + depth > max_depth) {
+            max_depth = i + depth;
+        }
+    }
+    *stack_size = max_depth;
+    return num_instrs;
+}
+
+
+/* emits the instructions of the given tree in postfix order */
+static void epr_emit_bmath_instrs(const EPR_SBmathNode* node, EPR_SBmathInstr* instrs, uint* num_instrs)
+{
+    EPR_SBmathInstr* instr;
+    uint i;
+
+    for (i = 0; i < 3 && node->args[i] != NULL; i++) {
+        epr_emit_bmath_instrs(node->args[i], instrs, num_instrs);
+    }
+    instr = &instrs[(*num_instrs)++];
+    instr->op = node->op;
+    instr->value = node->value;
+    instr->source_index = node->source_index;
+    instr->flag_mask = node->flag_mask;
+    instr->func1 = node->func1;
+    instr->func2 = node->func2;
+}
+
+
+EPR_SBandMath* epr_compile_band_math(EPR_SProductId* product_id, const char* expr)
+{
+    EPR_SBmathParser parser;
+    EPR_SBmathNode* tree;
+    EPR_SBandMath* band_math = NULL;
+    uint i;
+
+    epr_clear_err();
+
+    if (product_id == NULL || expr == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_compile_band_math: product_id and expr must not be NULL");
+        return NULL;
+    }
+
+    parser.product_id = product_id;
+    parser.expr = expr;
+    parser.pos = 0;
+    parser.failed = FALSE;
+    parser.sources = epr_create_ptr_array(4);
+    if (parser.sources == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_compile_band_math: out of memory");
+        return NULL;
+    }
+
+    tree = epr_parse_bmath_expr(&parser);
+    epr_skip_bmath_spaces(&parser);
+    if (tree != NULL && expr[parser.pos] != '\0') {
+        epr_set_bmath_error(&parser, "unexpected character");
+    }
+    if (tree != NULL && !parser.failed) {
+        band_math = (EPR_SBandMath*) calloc(1, sizeof (EPR_SBandMath));
+        if (band_math != NULL) {
+            band_math->product_id = product_id;
+            band_math->num_sources = parser.sources->length;
+            band_math->sources = (EPR_SBmathSource*) calloc(parser.sources->length + 1, sizeof (EPR_SBmathSource));
+            band_math->instrs = (EPR_SBmathInstr*) calloc(epr_count_bmath_instrs(tree, &band_math->stack_size),
+                                                          sizeof (EPR_SBmathInstr));
+        }
+        if (band_math == NULL || band_math->sources == NULL || band_math->instrs == NULL) {
+            epr_free_band_math(band_math);
+            band_math = NULL;
+            epr_set_err(e_err_out_of_memory, "epr_compile_band_math: out of memory");
+        } else {
+            for (i = 0; i < parser.sources->length; i++) {
+                band_math->sources[i] = *(EPR_SBmathSource*) parser.sources->elems[i];
+            }
+            epr_emit_bmath_instrs(tree, band_math->instrs, &band_math->num_instrs);
+        }
+    }
+
+    for (i = 0; i < parser.sources->length; i++) {
+        free(parser.sources->elems[i]);
+    }
+    epr_free_ptr_array(parser.sources);
+    epr_free_bmath_node(tree);
+    return band_math;
+}
+
+
+void epr_free_band_math(EPR_SBandMath* band_math)
+{
+    if (band_math == NULL) {
+        return;
+    }
+    free(band_math->sources);
+    free(band_math->instrs);
+    free(band_math);
+}
+
+
+/* converts a line of a source raster into doubles or flag words */
+static void epr_load_bmath_line(const EPR_SRaster* raster, uint y, epr_boolean flags, void* line)
+{
+    uint x, width = raster->raster_width;
+    uint index = y * width;
+
+    if (flags) {
+        uint* words = (uint*) line;
+        for (x = 0; x < width; x++) {
+            words[x] = epr_get_pixel_as_uint(raster, (int) x, (int) y);
+        }
+        return;
+    }
+    switch (raster->data_type) {
+    case e_tid_float:
+        for (x = 0; x < width; x++) {
+            ((double*) line)[x] = ((const float*) raster->buffer)[index + x];
+        }
+        break;
+    case e_tid_double:
+        memcpy(line, (const double*) raster->buffer + index, width * sizeof (double));
+        break;
+    default:
+        for (x = 0; x < width; x++) {
+            ((double*) line)[x] = epr_get_pixel_as_double(raster, (int) x, (int) y);
+        }
+        break;
+    }
+}
+
+
+/* evaluates the program for one line, the result is left in the first stack line */
+static void epr_eval_bmath_line(const EPR_SBandMath* band_math, uint width, double** lines, double* stack)
+{
+    const EPR_SBmathInstr* instr;
+    double* a;
+    double* b;
+    double* c;
+    const uint* words;
+    uint i, x, sp = 0;
+
+    for (i = 0; i < band_math->num_instrs; i++) {
+        instr = &band_math->instrs[i];
+        a = stack + (sp >= 1 ? sp - 1 : 0) * width;
+        switch (instr->op) {
+        case BMX_CONST:
+            a = stack + sp++ * width;
+            for (x = 0; x < width; x++) {
+                a[x] = instr->value;
+            }
+            continue;
+        case BMX_BAND:
+            memcpy(stack + sp++ * width, lines[instr->source_index], width * sizeof (double));
+            continue;
+        case BMX_FLAG:
+            a = stack + sp++ * width;
+            words = (const uint*) lines[instr->source_index];
+            for (x = 0; x < width; x++) {
+                a[x] = (words[x] & instr->flag_mask) == instr->flag_mask ? 1.0 : 0.0;
+            }
+            continue;
+        case BMX_NEG:
+            for (x = 0; x < width; x++) {
+                a[x] = -a[x];
+            }
+            continue;
+        case BMX_NOT:
+            for (x = 0; x < width; x++) {
+                a[x] = a[x] == 0.0 ? 1.0 : 0.0;
+            }
+            continue;
+        case BMX_FUNC1:
+            for (x = 0; x < width; x++) {
+                a[x] = instr->func1(a[x]);
+            }
+            continue;
+        case BMX_SELECT:
+            sp -= 2;
+            a = stack + (sp - 1) * width;
+            b = a + width;
+            c = b + width;
+            for (x = 0; x < width; x++) {
+                a[x] = a[x] != 0.0 ? b[x] : c[x];
+            }
+            continue;
+        default:
+            break;
+        }
+
+        /* binary operations combine the two top lines */
+        sp--;
+        a = stack + (sp - 1) * width;
+        b = a + width;
+        switch (instr->op) {
+        case BMX_ADD:
+            for (x = 0; x < width; x++) {
+                a[x] += b[x];
+            }
+            break;
+        case BMX_SUB:
+            for (x = 0; x < width; x++) {
+                a[x] -= b[x];
+            }
+            break;
+        case BMX_MUL:
+            for (x = 0; x < width; x++) {
+                a[x] *= b[x];
+            }
+            break;
+        case BMX_DIV:
+            for (x = 0; x < width; x++) {
+                a[x] /= b[x];
+            }
+            break;
+        case BMX_FUNC2:
+            for (x = 0; x < width; x++) {
+                a[x] = instr->func2(a[x], b[x]);
+            }
+            break;
+        default:
+            for (x = 0; x < width; x++) {
+                a[x] = epr_apply_bmath_op(instr->op, NULL, NULL, a[x], b[x], 0.0);
+            }
+            break;
+        }
+    }
+}
+
+
+int epr_read_band_math_raster(EPR_SBandMath* band_math,
+                              int offset_x,
+                              int offset_y,
+                              EPR_SRaster* raster)
+{
+    EPR_SRaster** chunks = NULL;
+    EPR_SRaster** masks = NULL;
+    EPR_SRaster window;
+    EPR_SBandId* band_id;
+    double** lines = NULL;
+    double* stack = NULL;
+    double nan_value = fabs(sqrt(-1.0));
+    uint width, chunk_height, chunk_y, y, x, i;
+    int errcode = e_err_none;
+
+    epr_clear_err();
+
+    if (band_math == NULL || raster == NULL || raster->buffer == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_read_band_math_raster: band_math and raster must not be NULL");
+        return epr_get_last_err_code();
+    }
+    if (raster->data_type != e_tid_float && raster->data_type != e_tid_double) {
+        epr_set_err(e_err_illegal_data_type,
+                    "epr_read_band_math_raster: the raster must be of type float or double");
+        return epr_get_last_err_code();
+    }
+    width = raster->raster_width;
+    if (width == 0 || raster->raster_height == 0) {
+        return e_err_none;
+    }
+
+    chunk_height = EPR_BMATH_CHUNK_HEIGHT * raster->source_step_y;
+    if (chunk_height > raster->source_height) {
+        chunk_height = raster->source_height;
+    }
+    chunks = (EPR_SRaster**) calloc(band_math->num_sources + 1, sizeof (EPR_SRaster*));
+    masks = (EPR_SRaster**) calloc(band_math->num_sources + 1, sizeof (EPR_SRaster*));
+    lines = (double**) calloc(band_math->num_sources + 1, sizeof (double*));
+    stack = (double*) calloc(band_math->stack_size * width, sizeof (double));
+    if (chunks == NULL || masks == NULL || lines == NULL || stack == NULL) {
+        errcode = e_err_out_of_memory;
+    }
+    for (i = 0; errcode == e_err_none && i < band_math->num_sources; i++) {
+        band_id = band_math->sources[i].band_id;
+        chunks[i] = epr_create_compatible_raster(band_id,
+                                                 raster->source_width, chunk_height,
+                                                 raster->source_step_x, raster->source_step_y);
+        lines[i] = (double*) calloc(width, sizeof (double));
+        if (chunks[i] == NULL || lines[i] == NULL) {
+            errcode = e_err_out_of_memory;
+        }
+        /* pixels failing the bit-mask of a band are NaN, not 0 */
+        if (!band_math->sources[i].flags && band_id->bm_expr != NULL) {
+            masks[i] = epr_create_raster(e_tid_uchar,
+                                         raster->source_width, chunk_height,
+                                         raster->source_step_x, raster->source_step_y);
+            if (masks[i] == NULL) {
+                errcode = e_err_out_of_memory;
+            }
+        }
+    }
+    if (errcode != e_err_none) {
+        epr_set_err(e_err_out_of_memory, "epr_read_band_math_raster: out of memory");
+    }
+
+    for (chunk_y = 0; errcode == e_err_none && chunk_y < raster->source_height; chunk_y += chunk_height) {
+        uint source_height = raster->source_height - chunk_y < chunk_height ? raster->source_height - chunk_y : chunk_height;
+        uint num_lines = (source_height - 1) / raster->source_step_y + 1;
+        for (i = 0; i < band_math->num_sources; i++) {
+            band_id = band_math->sources[i].band_id;
+            window = *chunks[i];
+            window.source_height = source_height;
+            window.raster_height = num_lines;
+            if (masks[i] == NULL) {
+                errcode = epr_read_band_raster(band_id, offset_x, offset_y + (int) chunk_y, &window);
+            } else {
+                errcode = epr_read_band_raster_unmasked(band_id, offset_x, offset_y + (int) chunk_y, &window);
+                if (errcode == e_err_none) {
+                    window = *masks[i];
+                    window.source_height = source_height;
+                    window.raster_height = num_lines;
+                    errcode = epr_read_bitmask_raster(band_id->product_id, band_id->bm_expr,
+                                                      offset_x, offset_y + (int) chunk_y, &window);
+                }
+            }
+            if (errcode != e_err_none) {
+                errcode = epr_get_last_err_code();
+                break;
+            }
+        }
+        for (y = 0; errcode == e_err_none && y < num_lines; y++) {
+            uint index = (chunk_y / raster->source_step_y + y) * width;
+            for (i = 0; i < band_math->num_sources; i++) {
+                epr_load_bmath_line(chunks[i], y, band_math->sources[i].flags, lines[i]);
+                if (masks[i] != NULL) {
+                    const uchar* mask_line = (const uchar*) masks[i]->buffer + y * width;
+                    for (x = 0; x < width; x++) {
+                        if (mask_line[x] == 0) {
+                            lines[i][x] = nan_value;
+                        }
+                    }
+                }
+            }
+            epr_eval_bmath_line(band_math, width, lines, stack);
+            if (raster->data_type == e_tid_float) {
+                for (x = 0; x < width; x++) {
+                    ((float*) raster->buffer)[index + x] = (float) stack[x];
+                }
+            } else {
+                memcpy((double*) raster->buffer + index, stack, width * sizeof (double));
+            }
+        }
+    }
+
+    for (i = 0; i < band_math->num_sources; i++) {
+        if (chunks != NULL) {
+            epr_free_raster(chunks[i]);
+        }
+        if (masks != NULL) {
+            epr_free_raster(masks[i]);
+        }
+        if (lines != NULL) {
+            free(lines[i]);
+        }
+    }
+    free(chunks);
+    free(masks);
+    free(lines);
+    free(stack);
+    return errcode;
+}
@@ -0,0 +1,512 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_string.h"
+#include "epr_ptrarray.h"
+#include "epr_thread.h"
+
+
+/* the kinds of tasks of a batch */
+enum EPR_BatchTaskKind {
+    /* open a product and create the read tasks of its bands */
+    e_btk_open,
+    /* read the raster of a band */
+    e_btk_read
+};
+
+/**
+ * A product of a batch.
+ */
+typedef struct EPR_BatchProduct {
+    char* file_path;
+    /* the comma separated names of the bands to read, NULL for all bands */
+    char* band_names;
+    EPR_SProductId* product_id;
+    /* the bands whose raster has not been delivered or dropped yet */
+    uint num_bands_left;
+    epr_boolean failed;
+} EPR_SBatchProduct;
+
+/**
+ * A task of a batch: opening a product, reading a band raster or, once
+ * the raster is read, delivering it to the consumer.
+ */
+typedef struct EPR_BatchTask {
+    enum EPR_BatchTaskKind kind;
+    EPR_SBatchProduct* product;
+    EPR_SBandId* band_id;
+    EPR_SRaster* raster;
+    /* the next raster to be delivered */
+    struct EPR_BatchTask* next;
+} EPR_SBatchTask;
+
+/**
+ * A worker thread of a batch with its own double-ended task queue: the
+ * worker takes its newest task, idle workers steal the oldest one.
+ */
+typedef struct EPR_BatchWorker {
+    struct EPR_Batch* batch;
+    EPR_SPtrArray* tasks;
+} EPR_SBatchWorker;
+
+struct EPR_Batch {
+    uint num_threads;
+    uint max_open_products;
+    uint max_pending_rasters;
+    EPR_EIOMode io_mode;
+    EPR_SPtrArray* products;
+
+    /* the state of a run, guarded by mutex */
+    EPR_SMutex* mutex;
+    EPR_SCondition* condition;
+    EPR_SBatchWorker* workers;
+    EPR_FBatchConsumer consumer;
+    void* consumer_data;
+    /* the index of the next product to be opened */
+    uint next_product;
+    /* the products opened or being opened */
+    uint num_open;
+    /* the rasters being read or waiting for delivery */
+    uint num_pending;
+    /* the tasks being executed */
+    uint num_busy;
+    /* the rasters waiting for delivery, in the order they were read */
+    EPR_SBatchTask* first_delivery;
+    EPR_SBatchTask* last_delivery;
+    epr_boolean delivering;
+    epr_boolean cancelled;
+    uint num_failed;
+};
+
+
+EPR_SBatch* epr_create_batch(uint num_threads,
+                             uint max_open_products,
+                             uint max_pending_rasters,
+                             EPR_EIOMode io_mode)
+{
+    EPR_SBatch* batch;
+
+    epr_clear_err();
+
+    batch = (EPR_SBatch*) calloc(1, sizeof (EPR_SBatch));
+    if (batch == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_create_batch: out of memory");
+        return NULL;
+    }
+    batch->num_threads = num_threads > 0 ? num_threads : 1;
+    batch->max_open_products = max_open_products > 0 ? max_open_products : batch->num_threads + 1;
+    batch->max_pending_rasters = max_pending_rasters > 0 ? max_pending_rasters : 2 * batch->num_threads;
+    batch->io_mode = io_mode;
+    batch->products = epr_create_ptr_array(64);
+    if (batch->products == NULL) {
+        free(batch);
+        epr_set_err(e_err_out_of_memory, "epr_create_batch: out of memory");
+        return NULL;
+    }
+    return batch;
+}
+
+
+void epr_free_batch(EPR_SBatch* batch)
+{
+    uint i;
+
+    if (batch == NULL) {
+        return;
+    }
+    for (i = 0; i < batch->products->length; i++) {
+        EPR_SBatchProduct* product = (EPR_SBatchProduct*) batch->products->elems[i];
+        epr_free_string(product->file_path);
+        epr_free_string(product->band_names);
+        free(product);
+    }
+    epr_free_ptr_array(batch->products);
+    free(batch);
+}
+
+
+int epr_add_batch_product(EPR_SBatch* batch, const char* product_file_path, const char* band_names)
+{
+    EPR_SBatchProduct* product;
+
+    epr_clear_err();
+
+    if (batch == NULL || product_file_path == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_add_batch_product: batch and product_file_path must not be NULL");
+        return epr_get_last_err_code();
+    }
+    product = (EPR_SBatchProduct*) calloc(1, sizeof (EPR_SBatchProduct));
+    if (product == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_add_batch_product: out of memory");
+        return epr_get_last_err_code();
+    }
+    product->file_path = epr_clone_string(product_file_path);
+    product->band_names = band_names != NULL ? epr_clone_string(band_names) : NULL;
+    if (product->file_path == NULL || (band_names != NULL && product->band_names == NULL)) {
+        epr_free_string(product->file_path);
+        epr_free_string(product->band_names);
+        free(product);
+        epr_set_err(e_err_out_of_memory, "epr_add_batch_product: out of memory");
+        return epr_get_last_err_code();
+    }
+    epr_add_ptr_array_elem(batch->products, product);
+    return e_err_none;
+}
+
+
+uint epr_get_batch_num_failed(const EPR_SBatch* batch)
+{
+    return batch != NULL ? batch->num_failed : 0;
+}
+
+
+/* logs the failure of a product, the first one only is counted */
+static void epr_fail_batch_product(EPR_SBatch* batch, EPR_SBatchProduct* product, const char* what)
+{
+    char message[1024];
+
+    sprintf(message, "epr_run_batch: failed to %.32s %.700s: %.200s",
+            what, product->file_path,
+            epr_get_last_err_message() != NULL ? epr_get_last_err_message() : "unknown error");
+    epr_log(e_log_error, message);
+    if (!product->failed) {
+        product->failed = TRUE;
+        batch->num_failed++;
+    }
+}
+
+
+/* adds an open task for each product which may be opened now */
+static void epr_admit_batch_products(EPR_SBatch* batch, EPR_SBatchWorker* worker)
+{
+    EPR_SBatchTask* task;
+
+    while (!batch->cancelled
+            && batch->num_open < batch->max_open_products
+            && batch->next_product < batch->products->length) {
+        task = (EPR_SBatchTask*) calloc(1, sizeof (EPR_SBatchTask));
+        if (task == NULL) {
+            /* retried when the next product is closed */
+            return;
+        }
+        task->kind = e_btk_open;
+        task->product = (EPR_SBatchProduct*) batch->products->elems[batch->next_product++];
+        batch->num_open++;
+        epr_add_ptr_array_elem(worker->tasks, task);
+    }
+}
+
+
+/* closes the product if none of its bands is left, without holding the mutex */
+static void epr_finish_batch_band(EPR_SBatch* batch, EPR_SBatchWorker* worker, EPR_SBatchProduct* product)
+{
+    EPR_SProductId* product_id;
+
+    if (product->num_bands_left > 0) {
+        product->num_bands_left--;
+    }
+    if (product->num_bands_left == 0) {
+        product_id = product->product_id;
+        product->product_id = NULL;
+        epr_unlock_mutex(batch->mutex);
+        epr_close_product(product_id);
+        epr_lock_mutex(batch->mutex);
+        /* still counted while being closed, for the limit of open products */
+        batch->num_open--;
+        epr_admit_batch_products(batch, worker);
+    }
+}
+
+
+/* takes the next task the worker can execute now, NULL if there is none */
+static EPR_SBatchTask* epr_take_batch_task(EPR_SBatch* batch, EPR_SBatchWorker* worker)
+{
+    EPR_SBatchTask* task;
+    EPR_SPtrArray* tasks;
+    uint w, i, n;
+
+    /* the own newest task first, then the oldest one of the other workers */
+    for (w = 0; w < batch->num_threads; w++) {
+        tasks = batch->workers[(worker - batch->workers + w) % batch->num_threads].tasks;
+        n = tasks->length;
+        for (i = 0; i < n; i++) {
+            uint index = w == 0 ? n - 1 - i : i;
+            task = (EPR_SBatchTask*) tasks->elems[index];
+            /* the rasters not delivered yet limit the reads */
+            if (task->kind == e_btk_read && !batch->cancelled
+                    && batch->num_pending >= batch->max_pending_rasters) {
+                continue;
+            }
+            memmove(tasks->elems + index, tasks->elems + index + 1, (n - index - 1) * sizeof (void*));
+            tasks->length--;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+
+/* opens the product of the task and adds the read tasks of its bands */
+static void epr_open_batch_product(EPR_SBatch* batch, EPR_SBatchWorker* worker, EPR_SBatchProduct* product)
+{
+    EPR_SProductId* product_id;
+    EPR_SPtrArray* band_ids;
+    EPR_SBatchTask* task;
+    char* name;
+    int pos = 0;
+    uint i;
+
+    epr_unlock_mutex(batch->mutex);
+    product_id = epr_open_product_ex(product->file_path, batch->io_mode);
+    band_ids = epr_create_ptr_array(32);
+    if (product_id != NULL && band_ids != NULL) {
+        if (product->band_names == NULL) {
+            for (i = 0; i < epr_get_num_bands(product_id); i++) {
+                epr_add_ptr_array_elem(band_ids, epr_get_band_id_at(product_id, i));
+            }
+        } else {
+            /* several workers split their band lists at the same time */
+            while ((name = epr_str_tok(product->band_names, ",", &pos)) != NULL) {
+                if (name[0] != '\0') {
+                    EPR_SBandId* band_id = epr_get_band_id(product_id, epr_trim_string(name));
+                    if (band_id != NULL) {
+                        epr_add_ptr_array_elem(band_ids, band_id);
+                    } else {
+                        epr_lock_mutex(batch->mutex);
+                        epr_fail_batch_product(batch, product, "find band in");
+                        epr_unlock_mutex(batch->mutex);
+                    }
+                }
+                epr_free_string(name);
+            }
+        }
+    }
+    epr_lock_mutex(batch->mutex);
+
+    if (product_id == NULL) {
+        epr_fail_batch_product(batch, product, "open");
+        batch->num_open--;
+        epr_admit_batch_products(batch, worker);
+        epr_free_ptr_array(band_ids);
+        return;
+    }
+    product->product_id = product_id;
+    if (band_ids == NULL) {
+        epr_set_err(e_err_out_of_memory, "out of memory");
+        epr_fail_batch_product(batch, product, "read");
+    }
+    /* one more to keep the product open until all tasks are added */
+    product->num_bands_left = 1;
+    for (i = 0; band_ids != NULL && i < band_ids->length; i++) {
+        task = (EPR_SBatchTask*) calloc(1, sizeof (EPR_SBatchTask));
+        if (task == NULL) {
+            epr_set_err(e_err_out_of_memory, "out of memory");
+            epr_fail_batch_product(batch, product, "read");
+            break;
+        }
+        task->kind = e_btk_read;
+        task->product = product;
+        task->band_id = (EPR_SBandId*) band_ids->elems[i];
+        product->num_bands_left++;
+        epr_add_ptr_array_elem(worker->tasks, task);
+    }
+    epr_free_ptr_array(band_ids);
+    epr_finish_batch_band(batch, worker, product);
+}
+
+
+/* reads the raster of the task and queues it for delivery */
+static void epr_read_batch_band(EPR_SBatch* batch, EPR_SBatchWorker* worker, EPR_SBatchTask* task)
+{
+    EPR_SProductId* product_id = task->product->product_id;
+    EPR_SRaster* raster = NULL;
+    int errcode = e_err_none;
+
+    if (!batch->cancelled) {
+        batch->num_pending++;
+        epr_unlock_mutex(batch->mutex);
+        raster = epr_create_compatible_raster(task->band_id,
+                                              epr_get_scene_width(product_id),
+                                              epr_get_scene_height(product_id),
+                                              1, 1);
+        errcode = raster != NULL ? epr_read_band_raster(task->band_id, 0, 0, raster) : epr_get_last_err_code();
+        epr_lock_mutex(batch->mutex);
+        if (errcode == e_err_none) {
+            task->raster = raster;
+            task->next = NULL;
+            if (batch->last_delivery != NULL) {
+                batch->last_delivery->next = task;
+            } else {
+                batch->first_delivery = task;
+            }
+            batch->last_delivery = task;
+            return;
+        }
+        epr_fail_batch_product(batch, task->product, "read");
+        epr_free_raster(raster);
+        batch->num_pending--;
+    }
+    epr_finish_batch_band(batch, worker, task->product);
+    free(task);
+}
+
+
+/* delivers the oldest raster read to the consumer */
+static void epr_deliver_batch_band(EPR_SBatch* batch, EPR_SBatchWorker* worker)
+{
+    EPR_SBatchTask* task = batch->first_delivery;
+    int cancel;
+
+    batch->first_delivery = task->next;
+    if (batch->first_delivery == NULL) {
+        batch->last_delivery = NULL;
+    }
+    if (!batch->cancelled) {
+        batch->delivering = TRUE;
+        epr_unlock_mutex(batch->mutex);
+        cancel = batch->consumer(batch->consumer_data, task->product->file_path, task->band_id, task->raster);
+        epr_lock_mutex(batch->mutex);
+        batch->delivering = FALSE;
+        if (cancel != 0) {
+            batch->cancelled = TRUE;
+        }
+    }
+    epr_free_raster(task->raster);
+    batch->num_pending--;
+    epr_finish_batch_band(batch, worker, task->product);
+    free(task);
+}
+
+
+/* the main loop of a worker thread */
+static void epr_run_batch_worker(void* task_data)
+{
+    EPR_SBatchWorker* worker = (EPR_SBatchWorker*) task_data;
+    EPR_SBatch* batch = worker->batch;
+    EPR_SBatchTask* task;
+
+    epr_lock_mutex(batch->mutex);
+    for (;;) {
+        /* rasters are delivered one at a time, before new ones are read */
+        if (batch->first_delivery != NULL && !batch->delivering) {
+            batch->num_busy++;
+            epr_deliver_batch_band(batch, worker);
+            batch->num_busy--;
+            epr_signal_condition(batch->condition);
+            continue;
+        }
+        epr_admit_batch_products(batch, worker);
+        task = epr_take_batch_task(batch, worker);
+        if (task != NULL) {
+            batch->num_busy++;
+            if (task->kind == e_btk_open && batch->cancelled) {
+                batch->num_open--;
+                free(task);
+            } else if (task->kind == e_btk_open) {
+                epr_open_batch_product(batch, worker, task->product);
+                free(task);
+            } else {
+                epr_read_batch_band(batch, worker, task);
+            }
+            batch->num_busy--;
+            epr_signal_condition(batch->condition);
+            continue;
+        }
+        if (batch->num_busy == 0 && batch->first_delivery == NULL && batch->num_open == 0
+                && (batch->cancelled || batch->next_product >= batch->products->length)) {
+            break;
+        }
+        epr_wait_condition(batch->condition, batch->mutex);
+    }
+    epr_signal_condition(batch->condition);
+    epr_unlock_mutex(batch->mutex);
+}
+
+
+int epr_run_batch(EPR_SBatch* batch, EPR_FBatchConsumer consumer, void* consumer_data)
+{
+    void** task_data = NULL;
+    char message[80];
+    uint w;
+    int errcode = e_err_none;
+
+    epr_clear_err();
+
+    if (batch == NULL || consumer == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_run_batch: batch and consumer must not be NULL");
+        return epr_get_last_err_code();
+    }
+
+    batch->mutex = epr_create_mutex();
+    batch->condition = epr_create_condition();
+    batch->workers = (EPR_SBatchWorker*) calloc(batch->num_threads, sizeof (EPR_SBatchWorker));
+    task_data = (void**) calloc(batch->num_threads, sizeof (void*));
+    if (batch->mutex == NULL || batch->condition == NULL || batch->workers == NULL || task_data == NULL) {
+        errcode = e_err_out_of_memory;
+    }
+    for (w = 0; errcode == e_err_none && w < batch->num_threads; w++) {
+        batch->workers[w].batch = batch;
+        batch->workers[w].tasks = epr_create_ptr_array(32);
+        if (batch->workers[w].tasks == NULL) {
+            errcode = e_err_out_of_memory;
+        }
+        task_data[w] = &batch->workers[w];
+    }
+
+    if (errcode == e_err_none) {
+        batch->consumer = consumer;
+        batch->consumer_data = consumer_data;
+        batch->next_product = 0;
+        batch->num_open = 0;
+        batch->num_pending = 0;
+        batch->num_busy = 0;
+        batch->first_delivery = NULL;
+        batch->last_delivery = NULL;
+        batch->delivering = FALSE;
+        batch->cancelled = FALSE;
+        batch->num_failed = 0;
+        epr_run_tasks(epr_run_batch_worker, task_data, batch->num_threads, batch->num_threads);
+    }
+
+    for (w = 0; batch->workers != NULL && w < batch->num_threads; w++) {
+        epr_free_ptr_array(batch->workers[w].tasks);
+    }
+    free(batch->workers);
+    batch->workers = NULL;
+    free(task_data);
+    epr_free_condition(batch->condition);
+    batch->condition = NULL;
+    epr_free_mutex(batch->mutex);
+    batch->mutex = NULL;
+
+    if (errcode != e_err_none) {
+        epr_set_err(e_err_out_of_memory, "epr_run_batch: out of memory");
+        return epr_get_last_err_code();
+    }
+    if (batch->num_failed > 0) {
+        sprintf(message, "epr_run_batch: failed to read %u product(s)", batch->num_failed);
+        epr_set_err(e_err_file_read_error, message);
+        return epr_get_last_err_code();
+    }
+    return e_err_none;
+}
@@ -29,10 +29,12 @@
 #include "epr_msph.h"
 #include "epr_band.h"
 #include "epr_bitmask.h"
+#include "epr_thread.h"
 
 #include "epr_dddb.h"
 
 void epr_resolve_bm_ref(EPR_SBmEvalContext* context, EPR_SBmTerm* term);
+static void epr_reset_bm_refs(EPR_SBmTerm* term);
 
 
 
@@ -72,11 +74,11 @@ void epr_free_bm_eval_context(EPR_SBmEvalContext* context)
         for (flag_index = 0; flag_index < context->flag_band_ids->length; flag_index++) {
             /*
              * Note that the release of band ID's is handled by the epr_close_product() function,
-             * The rasters need to be released, because they are internally used by this
-             * context.
+             * The rasters are owned by the product's bitmask cache, they only need to be
+             * released by this context.
              */
             flag_raster = (EPR_SRaster*)context->flag_rasters->elems[flag_index];
-            epr_free_raster(flag_raster);
+            epr_release_cached_flag_raster(context->product_id, flag_raster);
         }
         epr_free_ptr_array(context->flag_band_ids);
         epr_free_ptr_array(context->flag_rasters);
@@ -104,15 +106,17 @@ int epr_read_bitmask_raster(EPR_SProductId* product_id,
 {
     EPR_SBmEvalContext* context;
     EPR_SBmTerm* term;
+    EPR_SBmProgram* program;
     uint x, y;
     uchar* bm_buffer = NULL;
+    uchar* bm_line = NULL;
     EPR_EErrCode errcode;
 
     epr_clear_err();
 
-    if (bm_raster->data_type != e_tid_uchar && bm_raster->data_type != e_tid_char) {
+    if (bm_raster->data_type != e_tid_uchar && bm_raster->data_type != e_tid_char && bm_raster->data_type != e_tid_bit) {
         epr_set_err(e_err_illegal_data_type,
-            "epr_read_bitmask_raster: illegal raster datatype; must be 'char' or 'uchar'");
+            "epr_read_bitmask_raster: illegal raster datatype; must be 'char', 'uchar' or 'bit'");
         return e_err_illegal_data_type;
     }
 
@@ -123,16 +127,29 @@ int epr_read_bitmask_raster(EPR_SProductId* product_id,
         return e_err_out_of_memory;
     }
 
+    /* the lines of a packed bit-mask are evaluated into bytes first */
+    if (bm_raster->data_type == e_tid_bit) {
+        bm_line = (uchar*) malloc(bm_raster->raster_width);
+        if (bm_line == NULL) {
+            epr_set_err(e_err_out_of_memory,
+                "epr_read_bitmask_raster: out of memory");
+            return e_err_out_of_memory;
+        }
+    }
+
     context = epr_create_bm_eval_context(product_id, offset_x, offset_y, bm_raster);
     if (context == NULL) {
+        free(bm_line);
          epr_set_err(e_err_illegal_arg,
              "epr_read_bitmask_raster: the context cannot be created");
         return e_err_illegal_arg;
     }
 
-    term = epr_parse_bm_expr_str(bm_expr);
+    term = epr_take_cached_bm_term(product_id, bm_expr);
 
     if (term == NULL) {
+         free(bm_line);
+         epr_free_bm_eval_context(context);
          epr_set_err(e_err_illegal_arg,
              "epr_read_bitmask_raster: the term was not build");
         return e_err_illegal_arg;
@@ -140,10 +157,37 @@ int epr_read_bitmask_raster(EPR_SProductId* product_id,
 
     epr_clear_err();
 
+    program = epr_compile_bm_term(context, term);
+    if (program != NULL) {
+        for (y = 0; y < bm_raster->raster_height; y++) {
+            if (bm_line != NULL) {
+                epr_eval_bm_program(context, program, y, bm_line);
+                epr_pack_bitmask_line(bm_line, bm_raster->raster_width,
+                                      (ulong*) bm_raster->buffer + y * EPR_BITMASK_LINE_WORDS(bm_raster->raster_width));
+            } else {
+                epr_eval_bm_program(context, program, y, bm_buffer);
+                bm_buffer += bm_raster->raster_width;
+            }
+        }
+        free(bm_line);
+        epr_free_bm_program(program);
+        epr_return_cached_bm_term(product_id, bm_expr, term);
+        epr_free_bm_eval_context(context);
+        return epr_get_last_err_code();
+    }
+
+    /*
+     * A flag reference could not be resolved: let the pixel interpreter
+     * report the error at the pixel where it is first evaluated.
+     */
+    epr_reset_bm_refs(term);
+    epr_clear_err();
+
     errcode = epr_get_last_err_code();
     for (y = 0; y < bm_raster->raster_height; y++) {
+        uchar* line = bm_line != NULL ? bm_line : bm_buffer + y * bm_raster->raster_width;
         for (x = 0; x < bm_raster->raster_width; x++) {
-            *bm_buffer++ = (uchar) epr_eval_bm_term(context, term, x, y);
+            line[x] = (uchar) epr_eval_bm_term(context, term, x, y);
             errcode = epr_get_last_err_code();
             if (errcode != 0) {
                 break;
@@ -152,9 +196,14 @@ int epr_read_bitmask_raster(EPR_SProductId* product_id,
         if (errcode != 0) {
             break;
         }
+        if (bm_line != NULL) {
+            epr_pack_bitmask_line(bm_line, bm_raster->raster_width,
+                                  (ulong*) bm_raster->buffer + y * EPR_BITMASK_LINE_WORDS(bm_raster->raster_width));
+        }
     }
 
-    epr_free_bm_term(term);
+    free(bm_line);
+    epr_return_cached_bm_term(product_id, bm_expr, term);
     epr_free_bm_eval_context(context);
 
     return errcode;
@@ -221,6 +270,278 @@ epr_boolean epr_eval_bm_term(EPR_SBmEvalContext* context, EPR_SBmTerm* term, int
 }
 
 
+/* counts the nodes of the given term */
+static uint epr_count_bm_terms(EPR_SBmTerm* term)
+{
+    if (term == NULL) {
+        return 0;
+    }
+    switch (term->op_code) {
+    case BMT_AND:
+    case BMT_OR:
+        return 1 + epr_count_bm_terms(term->op.binary.arg1) + epr_count_bm_terms(term->op.binary.arg2);
+    case BMT_NOT:
+        return 1 + epr_count_bm_terms(term->op.unary.arg);
+    default:
+        return 1;
+    }
+}
+
+
+/* marks all flag references of the given term as unresolved */
+static void epr_reset_bm_refs(EPR_SBmTerm* term)
+{
+    if (term == NULL) {
+        return;
+    }
+    switch (term->op_code) {
+    case BMT_REF:
+        term->op.ref.flag_raster = NULL;
+        term->op.ref.flag_mask = FLAG_MASK_NOT_COMPUTED;
+        break;
+    case BMT_AND:
+    case BMT_OR:
+        epr_reset_bm_refs(term->op.binary.arg1);
+        epr_reset_bm_refs(term->op.binary.arg2);
+        break;
+    case BMT_NOT:
+        epr_reset_bm_refs(term->op.unary.arg);
+        break;
+    default:
+        break;
+    }
+}
+
+
+/**
+ * Appends the instructions for the given term to the program.
+ *
+ * @return the number of stack lines needed by the term, zero if a flag
+ *         reference could not be resolved
+ */
+static uint epr_emit_bm_term(EPR_SBmEvalContext* context, EPR_SBmProgram* program, EPR_SBmTerm* term)
+{
+    EPR_SBmInstr* instr;
+    uint depth1, depth2, skip_index, flag_index;
+
+    if (term == NULL) {
+        return 0;
+    }
+
+    switch (term->op_code) {
+    case BMT_REF:
+        if (term->op.ref.flag_raster == NULL) {
+            epr_resolve_bm_ref(context, term);
+        }
+        if (term->op.ref.flag_raster == NULL || term->op.ref.flag_mask == FLAG_MASK_NOT_COMPUTED) {
+            return 0;
+        }
+        for (flag_index = 0; flag_index < context->flag_rasters->length; flag_index++) {
+            if (context->flag_rasters->elems[flag_index] == term->op.ref.flag_raster) {
+                break;
+            }
+        }
+        instr = &program->instrs[program->num_instrs++];
+        instr->code = BMI_REF;
+        instr->flag_index = flag_index;
+        instr->flag_mask = term->op.ref.flag_mask;
+        return 1;
+    case BMT_AND:
+    case BMT_OR:
+        depth1 = epr_emit_bm_term(context, program, term->op.binary.arg1);
+        if (depth1 == 0) {
+            return 0;
+        }
+        skip_index = program->num_instrs++;
+        program->instrs[skip_index].code = term->op_code == BMT_AND ? BMI_SKIP_IF_NONE : BMI_SKIP_IF_ALL;
+        depth2 = epr_emit_bm_term(context, program, term->op.binary.arg2);
+        if (depth2 == 0) {
+            return 0;
+        }
+        instr = &program->instrs[program->num_instrs++];
+        instr->code = term->op_code == BMT_AND ? BMI_AND : BMI_OR;
+        program->instrs[skip_index].skip_to = program->num_instrs;
+        return depth1 > depth2 + 1 ? depth1 : depth2 + 1;
+    case BMT_NOT:
+        depth1 = epr_emit_bm_term(context, program, term->op.unary.arg);
+        if (depth1 == 0) {
+            return 0;
+        }
+        instr = &program->instrs[program->num_instrs++];
+        instr->code = BMI_NOT;
+        return depth1;
+    default:
+        return 0;
+    }
+}
+
+
+EPR_SBmProgram* epr_compile_bm_term(EPR_SBmEvalContext* context, EPR_SBmTerm* term)
+{
+    EPR_SBmProgram* program;
+    uint width = context->bitmask_raster->raster_width;
+    uint num_flag_rasters;
+
+    program = (EPR_SBmProgram*) calloc(1, sizeof (EPR_SBmProgram));
+    if (program == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_compile_bm_term: out of memory");
+        return NULL;
+    }
+    /* each binary term needs a skip instruction in addition */
+    program->instrs = (EPR_SBmInstr*) calloc(2 * epr_count_bm_terms(term) + 1, sizeof (EPR_SBmInstr));
+    if (program->instrs == NULL) {
+        free(program);
+        epr_set_err(e_err_out_of_memory, "epr_compile_bm_term: out of memory");
+        return NULL;
+    }
+    program->stack_size = epr_emit_bm_term(context, program, term);
+    if (program->stack_size == 0) {
+        epr_free_bm_program(program);
+        return NULL;
+    }
+
+    /* all flag rasters have been read into the context now */
+    num_flag_rasters = context->flag_rasters->length;
+    program->width = width;
+    program->stack = (uchar*) malloc(program->stack_size * width + 1);
+    program->flag_words = (const uint**) calloc(num_flag_rasters, sizeof (uint*));
+    program->word_buffer = (uint*) malloc(num_flag_rasters * width * sizeof (uint) + 1);
+    if (program->stack == NULL || program->flag_words == NULL || program->word_buffer == NULL) {
+        epr_free_bm_program(program);
+        epr_set_err(e_err_out_of_memory, "epr_compile_bm_term: out of memory");
+        return NULL;
+    }
+    return program;
+}
+
+
+/* gets line y of the flag raster as uint values, converting them if necessary */
+static const uint* epr_get_flag_words(const EPR_SRaster* flag_raster, uint y, uint width, uint* buffer)
+{
+    uint offset = y * flag_raster->raster_width;
+    uint x;
+
+    switch (flag_raster->data_type) {
+    case e_tid_uint:
+    case e_tid_int:
+        return (const uint*) flag_raster->buffer + offset;
+    case e_tid_uchar:
+        for (x = 0; x < width; x++) {
+            buffer[x] = (uint) ((const uchar*) flag_raster->buffer)[offset + x];
+        }
+        break;
+    case e_tid_char:
+        for (x = 0; x < width; x++) {
+            buffer[x] = (uint) ((const char*) flag_raster->buffer)[offset + x];
+        }
+        break;
+    case e_tid_ushort:
+        for (x = 0; x < width; x++) {
+            buffer[x] = (uint) ((const ushort*) flag_raster->buffer)[offset + x];
+        }
+        break;
+    case e_tid_short:
+        for (x = 0; x < width; x++) {
+            buffer[x] = (uint) ((const short*) flag_raster->buffer)[offset + x];
+        }
+        break;
+    case e_tid_float:
+        for (x = 0; x < width; x++) {
+            buffer[x] = (uint) ((const float*) flag_raster->buffer)[offset + x];
+        }
+        break;
+    case e_tid_double:
+        for (x = 0; x < width; x++) {
+            buffer[x] = (uint) ((const double*) flag_raster->buffer)[offset + x];
+        }
+        break;
+    default:
+        memset(buffer, 0, width * sizeof (uint));
+        break;
+    }
+    return buffer;
+}
+
+
+void epr_eval_bm_program(EPR_SBmEvalContext* context,
+                         EPR_SBmProgram* program,
+                         uint y,
+                         uchar* bm_line)
+{
+    const EPR_SBmInstr* instr;
+    const uint* words;
+    uint width = program->width;
+    uchar* top = NULL;
+    uint sp = 0;
+    uint pc, x, flag_mask;
+
+    for (x = 0; x < context->flag_rasters->length; x++) {
+        program->flag_words[x] = NULL;
+    }
+
+    pc = 0;
+    while (pc < program->num_instrs) {
+        instr = &program->instrs[pc++];
+        switch (instr->code) {
+        case BMI_REF:
+            words = program->flag_words[instr->flag_index];
+            if (words == NULL) {
+                words = epr_get_flag_words((const EPR_SRaster*) context->flag_rasters->elems[instr->flag_index],
+                                           y, width, program->word_buffer + instr->flag_index * width);
+                program->flag_words[instr->flag_index] = words;
+            }
+            flag_mask = instr->flag_mask;
+            top = program->stack + width * sp++;
+            for (x = 0; x < width; x++) {
+                top[x] = (uchar) ((words[x] & flag_mask) == flag_mask);
+            }
+            break;
+        case BMI_AND:
+            top = program->stack + width * (--sp - 1);
+            for (x = 0; x < width; x++) {
+                top[x] &= top[width + x];
+            }
+            break;
+        case BMI_OR:
+            top = program->stack + width * (--sp - 1);
+            for (x = 0; x < width; x++) {
+                top[x] |= top[width + x];
+            }
+            break;
+        case BMI_NOT:
+            for (x = 0; x < width; x++) {
+                top[x] ^= 1;
+            }
+            break;
+        case BMI_SKIP_IF_NONE:
+            if (memchr(top, 1, width) == NULL) {
+                pc = instr->skip_to;
+            }
+            break;
+        case BMI_SKIP_IF_ALL:
+            if (memchr(top, 0, width) == NULL) {
+                pc = instr->skip_to;
+            }
+            break;
+        }
+    }
+    memcpy(bm_line, program->stack, width);
+}
+
+
+void epr_free_bm_program(EPR_SBmProgram* program)
+{
+    if (program == NULL) {
+        return;
+    }
+    free(program->instrs);
+    free(program->stack);
+    free(program->flag_words);
+    free(program->word_buffer);
+    free(program);
+}
+
+
 void epr_resolve_bm_ref(EPR_SBmEvalContext* context, EPR_SBmTerm* term) {
     const char* band_name = term->op.ref.band_name;
     const char* flag_name = term->op.ref.flag_name;
@@ -249,15 +570,8 @@ void epr_resolve_bm_ref(EPR_SBmEvalContext* context, EPR_SBmTerm* term) {
         /* Not found: get flag_band_id from product and load the corresponding raster */
         flag_band_id = epr_get_band_id(context->product_id, band_name);
         if (flag_band_id != NULL) {
-            flag_raster = epr_create_compatible_raster(flag_band_id,
-                                            context->bitmask_raster->source_width,
-                                            context->bitmask_raster->source_height,
-                                            context->bitmask_raster->source_step_x,
-                                            context->bitmask_raster->source_step_y);
-            if (epr_read_band_raster(flag_band_id,
-                                     context->offset_x,
-                                     context->offset_y,
-                                     flag_raster) != 0) {
+            flag_raster = epr_get_cached_flag_raster(context, flag_band_id);
+            if (flag_raster == NULL) {
                 return;
             }
 
@@ -295,6 +609,351 @@ void epr_resolve_bm_ref(EPR_SBmEvalContext* context, EPR_SBmTerm* term) {
     term->op.ref.flag_raster = flag_raster;
 }
 
+/* gets the bitmask cache of the given product, creating it if necessary */
+static EPR_SBmCache* epr_get_bm_cache(EPR_SProductId* product_id)
+{
+    EPR_SBmCache* cache = product_id->bm_cache;
+
+    if (cache != NULL) {
+        return cache;
+    }
+    cache = (EPR_SBmCache*) calloc(1, sizeof (EPR_SBmCache));
+    if (cache == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_get_bm_cache: out of memory");
+        return NULL;
+    }
+    cache->max_bytes = EPR_DEFAULT_BM_CACHE_SIZE;
+    cache->entries = epr_create_ptr_array(4);
+    cache->exprs = epr_create_ptr_array(4);
+    cache->terms = epr_create_ptr_array(4);
+    cache->loaded = epr_create_condition();
+    if (cache->entries == NULL || cache->exprs == NULL || cache->terms == NULL || cache->loaded == NULL) {
+        epr_free_bm_cache(cache);
+        epr_set_err(e_err_out_of_memory, "epr_get_bm_cache: out of memory");
+        return NULL;
+    }
+    product_id->bm_cache = cache;
+    return cache;
+}
+
+
+/* removes the element at the given index, the last element takes its place */
+static void epr_remove_ptr_array_elem_at(EPR_SPtrArray* ptr_array, uint index)
+{
+    ptr_array->length--;
+    ptr_array->elems[index] = ptr_array->elems[ptr_array->length];
+}
+
+
+/* releases least recently used flag rasters until the cache fits into its size */
+static void epr_shrink_bm_cache(EPR_SBmCache* cache)
+{
+    EPR_SBmCacheEntry* entry;
+    uint i, lru_index;
+
+    while (cache->num_bytes > cache->max_bytes) {
+        lru_index = (uint) -1;
+        for (i = 0; i < cache->entries->length; i++) {
+            entry = (EPR_SBmCacheEntry*) cache->entries->elems[i];
+            if (entry->use_count == 0 &&
+                    (lru_index == (uint) -1 ||
+                     entry->last_use < ((EPR_SBmCacheEntry*) cache->entries->elems[lru_index])->last_use)) {
+                lru_index = i;
+            }
+        }
+        if (lru_index == (uint) -1) {
+            /* all rasters are in use */
+            break;
+        }
+        entry = (EPR_SBmCacheEntry*) cache->entries->elems[lru_index];
+        epr_remove_ptr_array_elem_at(cache->entries, lru_index);
+        cache->num_bytes -= entry->num_bytes;
+        epr_free_raster(entry->flag_raster);
+        free(entry);
+    }
+}
+
+
+/* releases the use of an entry whose flag raster could not be read, the entry
+ * is removed when the last thread waiting for it has seen the failure */
+static void epr_drop_failed_bm_entry(EPR_SBmCache* cache, EPR_SBmCacheEntry* entry)
+{
+    uint i;
+
+    if (--entry->use_count > 0) {
+        return;
+    }
+    for (i = 0; i < cache->entries->length; i++) {
+        if (cache->entries->elems[i] == entry) {
+            epr_remove_ptr_array_elem_at(cache->entries, i);
+            break;
+        }
+    }
+    free(entry);
+}
+
+
+EPR_SRaster* epr_get_cached_flag_raster(EPR_SBmEvalContext* context, EPR_SBandId* flag_band_id)
+{
+    EPR_SProductId* product_id = context->product_id;
+    const EPR_SRaster* bm_raster = context->bitmask_raster;
+    EPR_SBmCache* cache;
+    EPR_SBmCacheEntry* entry = NULL;
+    EPR_SBmCacheEntry* candidate;
+    EPR_SRaster* flag_raster;
+    int err_code = e_err_none;
+    char* err_message = NULL;
+    uint i;
+
+    epr_lock_mutex(product_id->lock);
+    cache = epr_get_bm_cache(product_id);
+    if (cache == NULL) {
+        epr_unlock_mutex(product_id->lock);
+        return NULL;
+    }
+
+    for (i = 0; i < cache->entries->length; i++) {
+        candidate = (EPR_SBmCacheEntry*) cache->entries->elems[i];
+        if (candidate->flag_band_id == flag_band_id &&
+                candidate->offset_x == context->offset_x &&
+                candidate->offset_y == context->offset_y &&
+                candidate->source_width == bm_raster->source_width &&
+                candidate->source_height == bm_raster->source_height &&
+                candidate->source_step_x == bm_raster->source_step_x &&
+                candidate->source_step_y == bm_raster->source_step_y &&
+                (candidate->loading || candidate->flag_raster != NULL)) {
+            entry = candidate;
+            break;
+        }
+    }
+
+    if (entry != NULL) {
+        /* the use count keeps the entry while another thread reads its raster */
+        entry->use_count++;
+        while (entry->loading) {
+            epr_wait_condition(cache->loaded, product_id->lock);
+        }
+        flag_raster = entry->flag_raster;
+        if (flag_raster == NULL) {
+            epr_drop_failed_bm_entry(cache, entry);
+            epr_unlock_mutex(product_id->lock);
+            epr_set_err(e_err_file_read_error,
+                        "epr_get_cached_flag_raster: the flag raster could not be read");
+            return NULL;
+        }
+        entry->last_use = ++cache->use_clock;
+        epr_unlock_mutex(product_id->lock);
+        return flag_raster;
+    }
+
+    entry = (EPR_SBmCacheEntry*) calloc(1, sizeof (EPR_SBmCacheEntry));
+    if (entry == NULL) {
+        epr_unlock_mutex(product_id->lock);
+        epr_set_err(e_err_out_of_memory, "epr_get_cached_flag_raster: out of memory");
+        return NULL;
+    }
+    entry->flag_band_id = flag_band_id;
+    entry->offset_x = context->offset_x;
+    entry->offset_y = context->offset_y;
+    entry->source_width = bm_raster->source_width;
+    entry->source_height = bm_raster->source_height;
+    entry->source_step_x = bm_raster->source_step_x;
+    entry->source_step_y = bm_raster->source_step_y;
+    entry->loading = TRUE;
+    entry->use_count = 1;
+    epr_add_ptr_array_elem(cache->entries, entry);
+    epr_unlock_mutex(product_id->lock);
+
+    /* the raster is read without the lock, so that the other readers of the
+     * product go on; threads needing the same raster wait for this one */
+    flag_raster = epr_create_compatible_raster(flag_band_id,
+                                               bm_raster->source_width,
+                                               bm_raster->source_height,
+                                               bm_raster->source_step_x,
+                                               bm_raster->source_step_y);
+    if (flag_raster != NULL && epr_read_band_raster(flag_band_id,
+                                                    context->offset_x,
+                                                    context->offset_y,
+                                                    flag_raster) != 0) {
+        /* epr_free_raster clears the error */
+        err_code = epr_get_last_err_code();
+        epr_assign_string(&err_message, epr_get_last_err_message());
+        epr_free_raster(flag_raster);
+        flag_raster = NULL;
+    }
+
+    epr_lock_mutex(product_id->lock);
+    entry->loading = FALSE;
+    entry->flag_raster = flag_raster;
+    epr_signal_condition(cache->loaded);
+    if (flag_raster == NULL) {
+        epr_drop_failed_bm_entry(cache, entry);
+    } else {
+        entry->num_bytes = flag_raster->raster_width * flag_raster->raster_height * flag_raster->elem_size;
+        entry->last_use = ++cache->use_clock;
+        cache->num_bytes += entry->num_bytes;
+        epr_shrink_bm_cache(cache);
+    }
+    epr_unlock_mutex(product_id->lock);
+
+    if (err_code != e_err_none) {
+        epr_set_err((EPR_EErrCode) err_code, err_message);
+        epr_free_string(err_message);
+    }
+    return flag_raster;
+}
+
+
+void epr_release_cached_flag_raster(EPR_SProductId* product_id, EPR_SRaster* flag_raster)
+{
+    EPR_SBmCache* cache;
+    EPR_SBmCacheEntry* entry;
+    uint i;
+
+    epr_lock_mutex(product_id->lock);
+    cache = product_id->bm_cache;
+    if (cache != NULL) {
+        for (i = 0; i < cache->entries->length; i++) {
+            entry = (EPR_SBmCacheEntry*) cache->entries->elems[i];
+            if (entry->flag_raster == flag_raster) {
+                if (entry->use_count > 0) {
+                    entry->use_count--;
+                }
+                break;
+            }
+        }
+        epr_shrink_bm_cache(cache);
+    }
+    epr_unlock_mutex(product_id->lock);
+}
+
+
+EPR_SBmTerm* epr_take_cached_bm_term(EPR_SProductId* product_id, const char* bm_expr)
+{
+    EPR_SBmCache* cache;
+    EPR_SBmTerm* term = NULL;
+    uint i;
+
+    epr_lock_mutex(product_id->lock);
+    cache = epr_get_bm_cache(product_id);
+    if (cache != NULL) {
+        for (i = 0; i < cache->exprs->length; i++) {
+            if (strcmp((const char*) cache->exprs->elems[i], bm_expr) == 0) {
+                term = (EPR_SBmTerm*) cache->terms->elems[i];
+                epr_free_string((char*) cache->exprs->elems[i]);
+                epr_remove_ptr_array_elem_at(cache->exprs, i);
+                epr_remove_ptr_array_elem_at(cache->terms, i);
+                break;
+            }
+        }
+    }
+    epr_unlock_mutex(product_id->lock);
+    if (term != NULL) {
+        return term;
+    }
+    return epr_parse_bm_expr_str(bm_expr);
+}
+
+
+void epr_return_cached_bm_term(EPR_SProductId* product_id, const char* bm_expr, EPR_SBmTerm* term)
+{
+    EPR_SBmCache* cache;
+    char* expr;
+
+    /* the flag rasters of the references belong to the evaluation context */
+    epr_reset_bm_refs(term);
+    epr_lock_mutex(product_id->lock);
+    cache = product_id->bm_cache;
+    if (cache == NULL || (expr = epr_clone_string(bm_expr)) == NULL) {
+        epr_free_bm_term(term);
+    } else {
+        epr_add_ptr_array_elem(cache->exprs, expr);
+        epr_add_ptr_array_elem(cache->terms, term);
+    }
+    epr_unlock_mutex(product_id->lock);
+}
+
+
+void epr_free_bm_cache(EPR_SBmCache* cache)
+{
+    uint i;
+
+    if (cache == NULL) {
+        return;
+    }
+    if (cache->entries != NULL) {
+        for (i = 0; i < cache->entries->length; i++) {
+            EPR_SBmCacheEntry* entry = (EPR_SBmCacheEntry*) cache->entries->elems[i];
+            epr_free_raster(entry->flag_raster);
+            free(entry);
+        }
+        epr_free_ptr_array(cache->entries);
+    }
+    if (cache->terms != NULL) {
+        for (i = 0; i < cache->terms->length; i++) {
+            epr_free_bm_term((EPR_SBmTerm*) cache->terms->elems[i]);
+        }
+        epr_free_ptr_array(cache->terms);
+    }
+    if (cache->exprs != NULL) {
+        epr_free_char_ptr_array(cache->exprs);
+    }
+    epr_free_condition(cache->loaded);
+    free(cache);
+}
+
+
+int epr_set_bitmask_cache_size(EPR_SProductId* product_id, uint max_bytes)
+{
+    EPR_SBmCache* cache;
+
+    epr_clear_err();
+    if (product_id == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_set_bitmask_cache_size: product_id must not be NULL");
+        return epr_get_last_err_code();
+    }
+    epr_lock_mutex(product_id->lock);
+    cache = epr_get_bm_cache(product_id);
+    if (cache != NULL) {
+        cache->max_bytes = max_bytes;
+        epr_shrink_bm_cache(cache);
+    }
+    epr_unlock_mutex(product_id->lock);
+    return cache != NULL ? e_err_none : epr_get_last_err_code();
+}
+
+
+int epr_clear_bitmask_cache(EPR_SProductId* product_id)
+{
+    EPR_SBmCache* cache;
+    uint max_bytes;
+
+    epr_clear_err();
+    if (product_id == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_clear_bitmask_cache: product_id must not be NULL");
+        return epr_get_last_err_code();
+    }
+    epr_lock_mutex(product_id->lock);
+    cache = product_id->bm_cache;
+    if (cache != NULL) {
+        max_bytes = cache->max_bytes;
+        cache->max_bytes = 0;
+        epr_shrink_bm_cache(cache);
+        cache->max_bytes = max_bytes;
+        while (cache->terms->length > 0) {
+            epr_free_bm_term((EPR_SBmTerm*) cache->terms->elems[cache->terms->length - 1]);
+            epr_free_string((char*) cache->exprs->elems[cache->exprs->length - 1]);
+            cache->terms->length--;
+            cache->exprs->length--;
+        }
+    }
+    epr_unlock_mutex(product_id->lock);
+    return e_err_none;
+}
+
+
 /**
  * Parses the bit-mask expression given as character string.
  *
@@ -609,7 +1268,7 @@ void epr_push_back_bm_expr_token(EPR_SParseInfo* parse_info) {
 }
 
 void epr_set_bm_expr_error(EPR_SParseInfo* parse_info, const char* message) {
-    static char msg_buf[2048];
+    char msg_buf[2048];
 
     epr_push_back_bm_expr_token(parse_info);
 
@@ -753,6 +1412,10 @@ uint epr_get_pixel_as_uint(const EPR_SRaster* raster, int x, int y)
           return (uint) ((float*)raster->buffer)[y * raster->raster_width + x];
     case (e_tid_double) :
           return (uint) ((double*)raster->buffer)[y * raster->raster_width + x];
+    case (e_tid_half) :
+          return (uint) epr_half_to_float(((ushort*)raster->buffer)[y * raster->raster_width + x]);
+    case (e_tid_bit) :
+          return (uint) epr_get_packed_bit(raster, x, y);
     default:
           return 0;
     }
@@ -779,6 +1442,10 @@ int epr_get_pixel_as_int(const EPR_SRaster* raster, int x, int y)
           return (int) ((float*)raster->buffer)[y * raster->raster_width + x];
     case (e_tid_double) :
           return (int) ((double*)raster->buffer)[y * raster->raster_width + x];
+    case (e_tid_half) :
+          return (int) epr_half_to_float(((ushort*)raster->buffer)[y * raster->raster_width + x]);
+    case (e_tid_bit) :
+          return (int) epr_get_packed_bit(raster, x, y);
     default:
           return 0;
     }
@@ -806,6 +1473,10 @@ float epr_get_pixel_as_float(const EPR_SRaster* raster, int x, int y)
           return (float) ((float*)raster->buffer)[y * raster->raster_width + x];
     case (e_tid_double) :
           return (float) ((double*)raster->buffer)[y * raster->raster_width + x];
+    case (e_tid_half) :
+          return (float) epr_half_to_float(((ushort*)raster->buffer)[y * raster->raster_width + x]);
+    case (e_tid_bit) :
+          return (float) epr_get_packed_bit(raster, x, y);
     default:
           return 0;
     }
@@ -832,6 +1503,10 @@ double epr_get_pixel_as_double(const EPR_SRaster* raster, int x, int y)
           return (double) ((float*)raster->buffer)[y * raster->raster_width + x];
     case (e_tid_double) :
           return (double) ((double*)raster->buffer)[y * raster->raster_width + x];
+    case (e_tid_half) :
+          return (double) epr_half_to_float(((ushort*)raster->buffer)[y * raster->raster_width + x]);
+    case (e_tid_bit) :
+          return (double) epr_get_packed_bit(raster, x, y);
     default:
           return 0;
     }
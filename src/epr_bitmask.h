@@ -29,7 +29,12 @@ extern "C"
 typedef struct EPR_BmTerm               EPR_SBmTerm;
 typedef struct EPR_BmEvalContext        EPR_SBmEvalContext;
 typedef struct EPR_BmFlagDataset        EPR_SBmFlagDataset;
+typedef struct EPR_BmInstr              EPR_SBmInstr;
+typedef struct EPR_BmProgram            EPR_SBmProgram;
+typedef struct EPR_BmCacheEntry         EPR_SBmCacheEntry;
+typedef struct EPR_BmCache              EPR_SBmCache;
 typedef enum   EPR_BmOpCode             EPR_EBmOpCode;
+typedef enum   EPR_BmInstrCode          EPR_EBmInstrCode;
 
 
 /* private implementations */
@@ -44,6 +49,19 @@ enum EPR_BmOpCode {
 };
 
 
+/**
+ * The instruction codes of compiled bitmask programs, see <code>EPR_BmProgram</code>.
+ */
+enum EPR_BmInstrCode {
+    BMI_REF = 0,
+    BMI_AND,
+    BMI_OR,
+    BMI_NOT,
+    BMI_SKIP_IF_NONE,
+    BMI_SKIP_IF_ALL
+};
+
+
 enum EPR_Tok {
     BME_UNKNOWN = 0,
     BME_EOS,
@@ -126,6 +144,178 @@ struct EPR_BmEvalContext
 };
 
 
+/**
+ * A single instruction of a compiled bitmask program.
+ */
+struct EPR_BmInstr {
+    /**
+     * The instruction code.
+     */
+    EPR_EBmInstrCode code;
+
+    /**
+     * <code>BMI_REF</code>: the index of the flag raster in the evaluation context.
+     */
+    uint flag_index;
+
+    /**
+     * <code>BMI_REF</code>: the mask of the flag bits which must all be set.
+     */
+    uint flag_mask;
+
+    /**
+     * <code>BMI_SKIP_IF_NONE</code> and <code>BMI_SKIP_IF_ALL</code>: the index
+     * of the instruction to continue with if the line on top of the stack is
+     * all zero or all one respectively.
+     */
+    uint skip_to;
+};
+
+
+/**
+ * The <code>EPR_BmProgram</code> structure is a bitmask term compiled into a
+ * flat program which evaluates a whole raster line at once. The instructions
+ * operate on a stack of lines holding 0/1 values: <code>BMI_REF</code> pushes
+ * the evaluated flag reference, <code>BMI_AND</code>, <code>BMI_OR</code> and
+ * <code>BMI_NOT</code> combine the top lines. The skip instructions implement
+ * the short-circuit evaluation of <code>and</code> and <code>or</code>: the
+ * second operand is not evaluated if the first one already determines the
+ * result for the complete line. It is used internally only.
+ */
+struct EPR_BmProgram {
+    /**
+     * The number of instructions.
+     */
+    uint num_instrs;
+
+    /**
+     * The instructions.
+     */
+    EPR_SBmInstr* instrs;
+
+    /**
+     * The maximum number of lines on the stack.
+     */
+    uint stack_size;
+
+    /**
+     * The number of pixels in a line.
+     */
+    uint width;
+
+    /**
+     * The stack of lines, <code>stack_size * width</code> values.
+     */
+    uchar* stack;
+
+    /**
+     * The flag words of the current line for each flag raster of the evaluation
+     * context, <code>NULL</code> if not yet loaded.
+     */
+    const uint** flag_words;
+
+    /**
+     * The buffers used to convert flag rasters which are not of type
+     * <code>uint</code> or <code>int</code>, one line per flag raster.
+     */
+    uint* word_buffer;
+};
+
+
+/**
+ * A flag raster held in the bitmask cache of a product.
+ */
+struct EPR_BmCacheEntry {
+    /**
+     * The flags band the raster was read from.
+     */
+    EPR_SBandId* flag_band_id;
+
+    /**
+     * The source region of the raster.
+     */
+    int offset_x;
+    int offset_y;
+    uint source_width;
+    uint source_height;
+    uint source_step_x;
+    uint source_step_y;
+
+    /**
+     * The flag raster, <code>NULL</code> while it is being read or if
+     * reading it failed.
+     */
+    EPR_SRaster* flag_raster;
+
+    /**
+     * Set while a thread reads the flag raster without holding the product's
+     * lock, other threads needing the raster wait for <code>loaded</code>
+     * of the cache.
+     */
+    epr_boolean loading;
+
+    /**
+     * The size of the raster's buffer in bytes.
+     */
+    uint num_bytes;
+
+    /**
+     * The number of evaluation contexts currently using the raster,
+     * the entry is not released as long as this is not zero.
+     */
+    uint use_count;
+
+    /**
+     * The time stamp of the last use, for the LRU replacement.
+     */
+    uint last_use;
+};
+
+
+/**
+ * The <code>EPR_BmCache</code> structure holds the parsed bitmask expressions
+ * and the flag rasters read while evaluating them for a product. It is used
+ * internally only.
+ */
+struct EPR_BmCache {
+    /**
+     * The maximum size of the cached flag rasters in bytes.
+     */
+    uint max_bytes;
+
+    /**
+     * The current size of the cached flag rasters in bytes.
+     */
+    uint num_bytes;
+
+    /**
+     * The counter providing the time stamps of the entries.
+     */
+    uint use_clock;
+
+    /**
+     * The cached flag rasters, <code>EPR_SBmCacheEntry</code> instances.
+     */
+    EPR_SPtrArray* entries;
+
+    /**
+     * Signalled when a flag raster has been read, see <code>loading</code>
+     * of the entries. Waited for with the product's lock.
+     */
+    struct EPR_Condition* loaded;
+
+    /**
+     * The bitmask expressions of the parsed terms.
+     */
+    EPR_SPtrArray* exprs;
+
+    /**
+     * The parsed terms, with unresolved flag references.
+     */
+    EPR_SPtrArray* terms;
+};
+
+
 /**
  * Represents a flag-field within a flag-record.
  *
@@ -242,6 +432,89 @@ epr_boolean epr_eval_bm_term(EPR_SBmEvalContext* context,
 
 
 
+/**
+ * Compiles the given bitmask term into a program which evaluates whole
+ * raster lines. All flag references of the term are resolved, i.e. the
+ * flag rasters are read into the evaluation context.
+ *
+ * @param context the bitmask evaluation context
+ * @param term the bitmask term
+ * @return the program or <code>NULL</code> if a flag reference could not
+ *         be resolved or memory could not be allocated
+ */
+EPR_SBmProgram* epr_compile_bm_term(EPR_SBmEvalContext* context, EPR_SBmTerm* term);
+
+/**
+ * Evaluates a compiled bitmask program for a line of the bitmask raster.
+ *
+ * @param context the bitmask evaluation context the program was compiled for
+ * @param program the bitmask program
+ * @param y the line index in the bitmask raster
+ * @param bm_line receives the 0/1 values of the line
+ */
+void epr_eval_bm_program(EPR_SBmEvalContext* context,
+                         EPR_SBmProgram* program,
+                         uint y,
+                         uchar* bm_line);
+
+/**
+ * Releases a compiled bitmask program.
+ *
+ * @param program the bitmask program, may be <code>NULL</code>
+ */
+void epr_free_bm_program(EPR_SBmProgram* program);
+
+
+/**
+ * Gets the flag raster of the given flags band for the source region of the
+ * given evaluation context from the product's bitmask cache. The raster is
+ * read if it is not cached yet. It must be released with
+ * <code>epr_release_cached_flag_raster</code>.
+ *
+ * @param context the bitmask evaluation context
+ * @param flag_band_id the flags band
+ * @return the flag raster or <code>NULL</code> if it could not be read
+ */
+EPR_SRaster* epr_get_cached_flag_raster(EPR_SBmEvalContext* context, EPR_SBandId* flag_band_id);
+
+/**
+ * Releases a flag raster obtained from <code>epr_get_cached_flag_raster</code>.
+ *
+ * @param product_id the product identifier
+ * @param flag_raster the flag raster
+ */
+void epr_release_cached_flag_raster(EPR_SProductId* product_id, EPR_SRaster* flag_raster);
+
+/**
+ * Takes the parsed term of the given bitmask expression out of the product's
+ * bitmask cache, the expression is parsed if it is not cached. The term must
+ * be handed back with <code>epr_return_cached_bm_term</code>.
+ *
+ * @param product_id the product identifier
+ * @param bm_expr the bitmask expression
+ * @return the term with unresolved flag references, or <code>NULL</code> if
+ *         the expression could not be parsed
+ */
+EPR_SBmTerm* epr_take_cached_bm_term(EPR_SProductId* product_id, const char* bm_expr);
+
+/**
+ * Hands a term obtained from <code>epr_take_cached_bm_term</code> back to the
+ * product's bitmask cache.
+ *
+ * @param product_id the product identifier
+ * @param bm_expr the bitmask expression of the term
+ * @param term the term
+ */
+void epr_return_cached_bm_term(EPR_SProductId* product_id, const char* bm_expr, EPR_SBmTerm* term);
+
+/**
+ * Releases the given bitmask cache.
+ *
+ * @param cache the bitmask cache, may be <code>NULL</code>
+ */
+void epr_free_bm_cache(EPR_SBmCache* cache);
+
+
 /**
  * Parses a bitmask expression string.
  *
@@ -483,6 +756,43 @@ void epr_free_flag_def(EPR_SFlagDef* flag_def);
  */
 void epr_free_flag_coding(EPR_SPtrArray* flag_coding);
 
+/**
+ * Packs a line of a byte bit-mask into the words of a line of a packed
+ * bit-mask raster (<code>e_tid_bit</code>), the padding bits are cleared.
+ *
+ * @param line the pixels, non-zero for valid pixels
+ * @param width the number of pixels
+ * @param words the <code>EPR_BITMASK_LINE_WORDS(width)</code> words receiving the bits
+ */
+void epr_pack_bitmask_line(const uchar* line, uint width, ulong* words);
+
+/**
+ * Counts the set bits of the given word of a packed bit-mask raster.
+ */
+uint epr_count_bits(ulong word);
+
+/**
+ * Gets the bit of a pixel of a packed bit-mask raster.
+ */
+uint epr_get_packed_bit(const EPR_SRaster* raster, int x, int y);
+
+/**
+ * Sets the pixels of the given raster which are invalid according to the
+ * given packed bit-mask raster to zero, a word of the bit-mask at a time.
+ */
+void epr_zero_invalid_pixels_packed(EPR_SRaster* raster, const EPR_SRaster* bm_raster);
+
+/**
+ * Sets the pixels of a raster line which are invalid according to the given
+ * words of a line of a packed bit-mask raster to zero.
+ *
+ * @param line the pixels of the line
+ * @param width the number of pixels of the line
+ * @param elem_size the size of a pixel in bytes
+ * @param words the words of the bit-mask line
+ */
+void epr_zero_invalid_line_packed(void* line, uint width, uint elem_size, const ulong* words);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_band.h"
+#include "epr_bitmask.h"
+
+
+/* the words of the line y of a packed bit-mask raster */
+#define EPR_BITMASK_LINE(raster, y) ((ulong*) (raster)->buffer + (y) * EPR_BITMASK_LINE_WORDS((raster)->raster_width))
+
+
+uint epr_count_bits(ulong word)
+{
+#if defined(__GNUC__)
+    return (uint) __builtin_popcountl(word);
+#else
+    uint count = 0;
+    while (word != 0) {
+        word &= word - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+
+/* gets the bits of the last word of a line which belong to pixels */
+static ulong epr_get_last_word_mask(uint raster_width)
+{
+    uint num_bits = raster_width % EPR_BITMASK_WORD_BITS;
+    return num_bits == 0 ? ~0UL : (1UL << num_bits) - 1;
+}
+
+
+void epr_pack_bitmask_line(const uchar* line, uint width, ulong* words)
+{
+    uint x, w;
+    ulong word;
+
+    for (w = 0; w < EPR_BITMASK_LINE_WORDS(width); w++) {
+        word = 0;
+        for (x = w * EPR_BITMASK_WORD_BITS; x < width && x < (w + 1) * EPR_BITMASK_WORD_BITS; x++) {
+            if (line[x] != 0) {
+                word |= 1UL << (x % EPR_BITMASK_WORD_BITS);
+            }
+        }
+        words[w] = word;
+    }
+}
+
+
+uint epr_get_packed_bit(const EPR_SRaster* raster, int x, int y)
+{
+    const ulong* words = EPR_BITMASK_LINE(raster, y);
+    return (uint) ((words[x / EPR_BITMASK_WORD_BITS] >> (x % EPR_BITMASK_WORD_BITS)) & 1);
+}
+
+
+void epr_zero_invalid_line_packed(void* line, uint width, uint elem_size, const ulong* words)
+{
+    uchar* pixels = (uchar*) line;
+    uint x, w, b, n;
+    ulong word;
+
+    for (w = 0; w < EPR_BITMASK_LINE_WORDS(width); w++) {
+        word = words[w];
+        x = w * EPR_BITMASK_WORD_BITS;
+        n = width - x < EPR_BITMASK_WORD_BITS ? width - x : EPR_BITMASK_WORD_BITS;
+        if (word == ~0UL || (n < EPR_BITMASK_WORD_BITS && word == (1UL << n) - 1)) {
+            continue;
+        }
+        if (word == 0) {
+            memset(pixels + x * elem_size, 0, n * elem_size);
+            continue;
+        }
+        for (b = 0; b < n; b++) {
+            if ((word & (1UL << b)) == 0) {
+                memset(pixels + (x + b) * elem_size, 0, elem_size);
+            }
+        }
+    }
+}
+
+
+void epr_zero_invalid_pixels_packed(EPR_SRaster* raster, const EPR_SRaster* bm_raster)
+{
+    uint y;
+
+    for (y = 0; y < raster->raster_height; y++) {
+        epr_zero_invalid_line_packed((uchar*) raster->buffer + y * raster->raster_width * raster->elem_size,
+                                     raster->raster_width, raster->elem_size, EPR_BITMASK_LINE(bm_raster, y));
+    }
+}
+
+
+EPR_SRaster* epr_create_packed_bitmask_raster(uint source_width,
+                                              uint source_height,
+                                              uint source_step_x,
+                                              uint source_step_y)
+{
+    return epr_create_raster(e_tid_bit,
+                             source_width,
+                             source_height,
+                             source_step_x,
+                             source_step_y);
+}
+
+
+uint epr_count_valid_pixels(const EPR_SRaster* bm_raster)
+{
+    uint count = 0;
+    uint num_words, x, y, w;
+    const uchar* pixels;
+    const ulong* words;
+
+    epr_clear_err();
+
+    if (bm_raster == NULL || bm_raster->buffer == NULL) {
+        epr_set_err(e_err_invalid_raster,
+                    "epr_count_valid_pixels: raster must not be NULL");
+        return 0;
+    }
+    if (bm_raster->data_type == e_tid_bit) {
+        num_words = EPR_BITMASK_LINE_WORDS(bm_raster->raster_width);
+        for (y = 0; y < bm_raster->raster_height; y++) {
+            words = EPR_BITMASK_LINE(bm_raster, y);
+            for (w = 0; w < num_words; w++) {
+                count += epr_count_bits(words[w]);
+            }
+        }
+        return count;
+    }
+    if (bm_raster->data_type == e_tid_uchar || bm_raster->data_type == e_tid_char) {
+        pixels = (const uchar*) bm_raster->buffer;
+        for (x = 0; x < bm_raster->raster_width * bm_raster->raster_height; x++) {
+            if (pixels[x] != 0) {
+                count++;
+            }
+        }
+        return count;
+    }
+    epr_set_err(e_err_illegal_data_type,
+                "epr_count_valid_pixels: illegal raster data type");
+    return 0;
+}
+
+
+/* the operations combining packed bit-mask rasters */
+typedef enum EPR_BitmaskOp {
+    e_bmop_and,
+    e_bmop_or,
+    e_bmop_not
+} EPR_EBitmaskOp;
+
+
+static int epr_combine_bitmask_rasters(EPR_SRaster* target_raster,
+                                       const EPR_SRaster* source_raster,
+                                       EPR_EBitmaskOp op,
+                                       const char* func_name)
+{
+    char message[128];
+    uint num_words, y, w;
+    ulong last_word_mask;
+    ulong* target;
+    const ulong* source;
+
+    if (target_raster == NULL || target_raster->buffer == NULL
+            || (op != e_bmop_not && (source_raster == NULL || source_raster->buffer == NULL))) {
+        sprintf(message, "%s: raster must not be NULL", func_name);
+        epr_set_err(e_err_invalid_raster, message);
+        return epr_get_last_err_code();
+    }
+    if (target_raster->data_type != e_tid_bit || (op != e_bmop_not && source_raster->data_type != e_tid_bit)) {
+        sprintf(message, "%s: illegal raster data type, must be e_tid_bit", func_name);
+        epr_set_err(e_err_illegal_data_type, message);
+        return epr_get_last_err_code();
+    }
+    if (op != e_bmop_not && (source_raster->raster_width != target_raster->raster_width
+                             || source_raster->raster_height != target_raster->raster_height)) {
+        sprintf(message, "%s: rasters must have the same size", func_name);
+        epr_set_err(e_err_invalid_raster, message);
+        return epr_get_last_err_code();
+    }
+
+    num_words = EPR_BITMASK_LINE_WORDS(target_raster->raster_width);
+    last_word_mask = epr_get_last_word_mask(target_raster->raster_width);
+    for (y = 0; y < target_raster->raster_height; y++) {
+        target = EPR_BITMASK_LINE(target_raster, y);
+        switch (op) {
+        case e_bmop_and:
+            source = EPR_BITMASK_LINE(source_raster, y);
+            for (w = 0; w < num_words; w++) {
+                target[w] &= source[w];
+            }
+            break;
+        case e_bmop_or:
+            source = EPR_BITMASK_LINE(source_raster, y);
+            for (w = 0; w < num_words; w++) {
+                target[w] |= source[w];
+            }
+            break;
+        case e_bmop_not:
+            for (w = 0; w < num_words; w++) {
+                target[w] = ~target[w];
+            }
+            /* the padding bits stay cleared for the valid pixel count */
+            if (num_words > 0) {
+                target[num_words - 1] &= last_word_mask;
+            }
+            break;
+        }
+    }
+    return e_err_none;
+}
+
+
+int epr_and_bitmask_rasters(EPR_SRaster* target_raster, const EPR_SRaster* source_raster)
+{
+    epr_clear_err();
+    return epr_combine_bitmask_rasters(target_raster, source_raster, e_bmop_and, "epr_and_bitmask_rasters");
+}
+
+
+int epr_or_bitmask_rasters(EPR_SRaster* target_raster, const EPR_SRaster* source_raster)
+{
+    epr_clear_err();
+    return epr_combine_bitmask_rasters(target_raster, source_raster, e_bmop_or, "epr_or_bitmask_rasters");
+}
+
+
+int epr_not_bitmask_raster(EPR_SRaster* raster)
+{
+    epr_clear_err();
+    return epr_combine_bitmask_rasters(raster, NULL, e_bmop_not, "epr_not_bitmask_raster");
+}
+
+
+int epr_apply_bitmask(EPR_SRaster* raster, const EPR_SRaster* bm_raster)
+{
+    epr_clear_err();
+
+    if (raster == NULL || raster->buffer == NULL || bm_raster == NULL || bm_raster->buffer == NULL) {
+        epr_set_err(e_err_invalid_raster,
+                    "epr_apply_bitmask: raster must not be NULL");
+        return epr_get_last_err_code();
+    }
+    if (!epr_is_raster_data_type(raster->data_type)
+            || (bm_raster->data_type != e_tid_bit && bm_raster->data_type != e_tid_uchar && bm_raster->data_type != e_tid_char)) {
+        epr_set_err(e_err_illegal_data_type,
+                    "epr_apply_bitmask: illegal raster data type");
+        return epr_get_last_err_code();
+    }
+    if (raster->raster_width != bm_raster->raster_width || raster->raster_height != bm_raster->raster_height) {
+        epr_set_err(e_err_invalid_raster,
+                    "epr_apply_bitmask: rasters must have the same size");
+        return epr_get_last_err_code();
+    }
+    epr_zero_invalid_pixels(raster, (EPR_SRaster*) bm_raster);
+    return e_err_none;
+}
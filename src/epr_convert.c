@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_band.h"
+
+
+/* the number of elements converted at once through an intermediate array of doubles */
+#define EPR_CONVERT_BLOCK_SIZE 256
+
+/* the bits of a 32-bit float */
+typedef union EPR_FloatBits {
+    float f;
+    uint u;
+} EPR_UFloatBits;
+
+
+float epr_half_to_float(ushort half)
+{
+    EPR_UFloatBits bits;
+    uint sign = (uint) (half & 0x8000) << 16;
+    uint exponent = (half >> 10) & 0x1f;
+    uint mantissa = half & 0x3ff;
+
+    if (exponent == 0) {
+        /* zero or subnormal, both exactly representable as float */
+        float value = (float) ldexp((double) mantissa, -24);
+        return sign != 0 ? -value : value;
+    }
+    if (exponent == 0x1f) {
+        bits.u = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits.u = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    return bits.f;
+}
+
+
+ushort epr_float_to_half(float value)
+{
+    EPR_UFloatBits bits;
+    uint sign, mantissa, remainder, halfway, shift;
+    int exponent;
+    ushort half;
+
+    bits.f = value;
+    sign = (bits.u >> 16) & 0x8000;
+    exponent = (int) ((bits.u >> 23) & 0xff);
+    mantissa = bits.u & 0x7fffff;
+
+    if (exponent == 0xff) {
+        /* infinity or NaN, NaNs are kept quiet */
+        return (ushort) (sign | 0x7c00 | (mantissa != 0 ? 0x200 | (mantissa >> 13) : 0));
+    }
+    exponent = exponent - 127 + 15;
+    if (exponent >= 0x1f) {
+        return (ushort) (sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        /* too small for a normal half, rounded to a subnormal or zero */
+        if (exponent < -10) {
+            return (ushort) sign;
+        }
+        mantissa |= 0x800000;
+        shift = (uint) (14 - exponent);
+        half = (ushort) (mantissa >> shift);
+        remainder = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        half = (ushort) (((uint) exponent << 10) | (mantissa >> 13));
+        remainder = mantissa & 0x1fff;
+        halfway = 0x1000;
+    }
+    /* round to nearest even, a carry into the exponent gives the right result */
+    if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) {
+        half++;
+    }
+    return (ushort) (sign | half);
+}
+
+
+epr_boolean epr_is_raster_data_type(EPR_EDataTypeId data_type)
+{
+    switch (data_type) {
+    case e_tid_uchar:
+    case e_tid_char:
+    case e_tid_ushort:
+    case e_tid_short:
+    case e_tid_uint:
+    case e_tid_int:
+    case e_tid_float:
+    case e_tid_double:
+    case e_tid_half:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+
+static void epr_get_values_as_double(const void* array, EPR_EDataTypeId data_type, uint offset, uint num_elems, double* values)
+{
+    uint i;
+
+    switch (data_type) {
+    case e_tid_uchar:
+        for (i = 0; i < num_elems; i++) values[i] = ((const uchar*) array)[offset + i];
+        break;
+    case e_tid_char:
+        for (i = 0; i < num_elems; i++) values[i] = ((const char*) array)[offset + i];
+        break;
+    case e_tid_ushort:
+        for (i = 0; i < num_elems; i++) values[i] = ((const ushort*) array)[offset + i];
+        break;
+    case e_tid_short:
+        for (i = 0; i < num_elems; i++) values[i] = ((const short*) array)[offset + i];
+        break;
+    case e_tid_uint:
+        for (i = 0; i < num_elems; i++) values[i] = ((const uint*) array)[offset + i];
+        break;
+    case e_tid_int:
+        for (i = 0; i < num_elems; i++) values[i] = ((const int*) array)[offset + i];
+        break;
+    case e_tid_float:
+        for (i = 0; i < num_elems; i++) values[i] = ((const float*) array)[offset + i];
+        break;
+    case e_tid_double:
+        for (i = 0; i < num_elems; i++) values[i] = ((const double*) array)[offset + i];
+        break;
+    case e_tid_half:
+        for (i = 0; i < num_elems; i++) values[i] = epr_half_to_float(((const ushort*) array)[offset + i]);
+        break;
+    default:
+        break;
+    }
+}
+
+
+/* rounds to the nearest integer within the given range, NaN gives zero */
+static double epr_round_to_range(double value, double min_value, double max_value)
+{
+    if (value != value) {
+        return 0.0;
+    }
+    value = value < 0.0 ? ceil(value - 0.5) : floor(value + 0.5);
+    return value < min_value ? min_value : (value > max_value ? max_value : value);
+}
+
+
+static void epr_set_values_from_double(void* array, EPR_EDataTypeId data_type, uint offset, uint num_elems, const double* values)
+{
+    uint i;
+
+    switch (data_type) {
+    case e_tid_uchar:
+        for (i = 0; i < num_elems; i++) ((uchar*) array)[offset + i] = (uchar) epr_round_to_range(values[i], 0, UCHAR_MAX);
+        break;
+    case e_tid_char:
+        for (i = 0; i < num_elems; i++) ((char*) array)[offset + i] = (char) epr_round_to_range(values[i], SCHAR_MIN, SCHAR_MAX);
+        break;
+    case e_tid_ushort:
+        for (i = 0; i < num_elems; i++) ((ushort*) array)[offset + i] = (ushort) epr_round_to_range(values[i], 0, USHRT_MAX);
+        break;
+    case e_tid_short:
+        for (i = 0; i < num_elems; i++) ((short*) array)[offset + i] = (short) epr_round_to_range(values[i], SHRT_MIN, SHRT_MAX);
+        break;
+    case e_tid_uint:
+        for (i = 0; i < num_elems; i++) ((uint*) array)[offset + i] = (uint) epr_round_to_range(values[i], 0, UINT_MAX);
+        break;
+    case e_tid_int:
+        for (i = 0; i < num_elems; i++) ((int*) array)[offset + i] = (int) epr_round_to_range(values[i], INT_MIN, INT_MAX);
+        break;
+    case e_tid_float:
+        for (i = 0; i < num_elems; i++) ((float*) array)[offset + i] = (float) values[i];
+        break;
+    case e_tid_double:
+        for (i = 0; i < num_elems; i++) ((double*) array)[offset + i] = values[i];
+        break;
+    case e_tid_half:
+        for (i = 0; i < num_elems; i++) ((ushort*) array)[offset + i] = epr_float_to_half((float) values[i]);
+        break;
+    default:
+        break;
+    }
+}
+
+
+void epr_convert_array(const void* source, EPR_EDataTypeId source_type,
+                       void* target, EPR_EDataTypeId target_type,
+                       uint num_elems)
+{
+    double values[EPR_CONVERT_BLOCK_SIZE];
+    uint offset, n;
+
+    if (source_type == target_type) {
+        memcpy(target, source, num_elems * epr_get_data_type_size(source_type));
+        return;
+    }
+    /* the most frequent conversions don't need the intermediate doubles */
+    if (source_type == e_tid_float && target_type == e_tid_double) {
+        for (offset = 0; offset < num_elems; offset++) {
+            ((double*) target)[offset] = ((const float*) source)[offset];
+        }
+        return;
+    }
+    if (source_type == e_tid_float && target_type == e_tid_half) {
+        for (offset = 0; offset < num_elems; offset++) {
+            ((ushort*) target)[offset] = epr_float_to_half(((const float*) source)[offset]);
+        }
+        return;
+    }
+    for (offset = 0; offset < num_elems; offset += n) {
+        n = num_elems - offset < EPR_CONVERT_BLOCK_SIZE ? num_elems - offset : EPR_CONVERT_BLOCK_SIZE;
+        epr_get_values_as_double(source, source_type, offset, n, values);
+        epr_set_values_from_double(target, target_type, offset, n, values);
+    }
+}
+
+
+int epr_convert_raster(const EPR_SRaster* raster, void* buffer, EPR_EDataTypeId data_type)
+{
+    epr_clear_err();
+
+    if (raster == NULL || raster->buffer == NULL) {
+        epr_set_err(e_err_invalid_raster,
+                    "epr_convert_raster: raster must not be NULL");
+        return epr_get_last_err_code();
+    }
+    if (buffer == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_convert_raster: buffer must not be NULL");
+        return epr_get_last_err_code();
+    }
+    if (!epr_is_raster_data_type(raster->data_type) || !epr_is_raster_data_type(data_type)) {
+        epr_set_err(e_err_illegal_data_type,
+                    "epr_convert_raster: illegal data type");
+        return epr_get_last_err_code();
+    }
+    epr_convert_array(raster->buffer, raster->data_type, buffer, data_type,
+                      raster->raster_width * raster->raster_height);
+    return e_err_none;
+}
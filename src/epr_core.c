@@ -42,6 +42,22 @@
  */
 EPR_SAPI epr_api;
 
+/**
+ * The error code of the last error occurred in the current thread.
+ */
+static EPR_THREAD_LOCAL EPR_EErrCode epr_last_err_code = e_err_none;
+
+/**
+ * The error message of the last error occurred in the current thread, a
+ * fixed buffer so that no memory is left behind when the thread exits.
+ */
+static EPR_THREAD_LOCAL char epr_last_err_message[EPR_MAX_ERR_MESSAGE_LEN];
+
+/**
+ * Whether <code>epr_last_err_message</code> holds a message.
+ */
+static EPR_THREAD_LOCAL epr_boolean epr_has_last_err_message = FALSE;
+
 /*
    Function:    epr_str_to_data_type_id
    Access:      private API implementation helper
@@ -121,6 +137,10 @@ const char* epr_data_type_id_to_str(EPR_EDataTypeId data_type_id)
             return "float";
         case e_tid_double:
             return "double";
+        case e_tid_half:
+            return "half";
+        case e_tid_bit:
+            return "bit";
         case e_tid_string:
             return "string";
         case e_tid_spare:
@@ -165,6 +185,8 @@ uint epr_get_data_type_size(EPR_EDataTypeId data_type_id)
             return sizeof(float);
         case e_tid_double:
             return sizeof(double);
+        case e_tid_half:
+            return sizeof(ushort);
         case e_tid_string:
             return sizeof(char);
         case e_tid_spare:
@@ -220,8 +242,14 @@ void epr_log(EPR_ELogLevel log_level, const char* log_message)
  */
 void epr_set_err(EPR_EErrCode err_code, const char* err_message)
 {
-    epr_api.last_err_code = err_code;
-    epr_assign_string(&epr_api.last_err_message, err_message);
+    epr_last_err_code = err_code;
+    if (err_message != NULL) {
+        strncpy(epr_last_err_message, err_message, EPR_MAX_ERR_MESSAGE_LEN - 1);
+        epr_last_err_message[EPR_MAX_ERR_MESSAGE_LEN - 1] = '\0';
+        epr_has_last_err_message = TRUE;
+    } else {
+        epr_has_last_err_message = FALSE;
+    }
 
     if (epr_api.log_handler != NULL)
     {
@@ -246,12 +274,8 @@ void epr_set_err(EPR_EErrCode err_code, const char* err_message)
  */
 void epr_clear_err(void)
 {
-    if (epr_api.last_err_code != e_err_none)
-    {
-        epr_api.last_err_code = e_err_none;
-        epr_free_string(epr_api.last_err_message);
-        epr_api.last_err_message = NULL;
-    }
+    epr_last_err_code = e_err_none;
+    epr_has_last_err_message = FALSE;
 }
 
 /*
@@ -267,7 +291,7 @@ void epr_clear_err(void)
  */
 EPR_EErrCode epr_get_last_err_code(void)
 {
-    return epr_api.last_err_code;
+    return epr_last_err_code;
 }
 
 /*
@@ -283,7 +307,7 @@ EPR_EErrCode epr_get_last_err_code(void)
  */
 const char* epr_get_last_err_message(void)
 {
-    return epr_api.last_err_message;
+    return epr_has_last_err_message ? epr_last_err_message : NULL;
 }
 
 /**
@@ -35,6 +35,27 @@ typedef struct EPR_API EPR_SAPI;
 typedef struct EPR_Parameter EPR_SParameter;
 
 
+/*
+ * Storage class specifier for data kept separately for each thread. The last
+ * error must not be shared by threads, so compilers without thread-local
+ * storage are rejected rather than silently sharing it; on such a compiler
+ * EPR_THREAD_LOCAL can be defined on the command line instead.
+ */
+#if defined(EPR_THREAD_LOCAL)
+/* defined by the build */
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define EPR_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define EPR_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__) || defined(__INTEL_COMPILER) || defined(__SUNPRO_C)
+#define EPR_THREAD_LOCAL __thread
+#else
+#error "no thread-local storage known for this compiler, define EPR_THREAD_LOCAL"
+#endif
+
+/* Maximum length of an error message, longer messages are truncated */
+#define EPR_MAX_ERR_MESSAGE_LEN          1024
+
 #define EPR_ENVISAT_PRODUCT_MERIS        "MER"
 #define EPR_ENVISAT_PRODUCT_ASAR         "ASA"
 #define EPR_ENVISAT_PRODUCT_SAR          "SAR"
@@ -106,11 +127,6 @@ struct EPR_API
      */
     int little_endian_order;
 
-    /**
-     * A unsigned int value indicating head length
-     */
-    uint epr_head_size;
-
     /**
      * The directory path to the record info database.
      */
@@ -127,26 +143,24 @@ struct EPR_API
      */
     EPR_FLogHandler log_handler;
 
-    /**
-     * The error code of the last error occurred.
-     */
-    EPR_EErrCode last_err_code;
-
-    /**
-     * The error message of the last error occurred.
-     */
-    char* last_err_message;
-
     /**
      * The error handler (function pointer) for the ENVISAT API.
      * Can be <code>NULL</code>.
      */
     EPR_FErrHandler err_handler;
+
+    /**
+     * The SIMD instruction sets usable by the line decoders,
+     * a combination of the <code>EPR_CPU_</code> flags in epr_simd.h.
+     */
+    uint cpu_features;
 };
 
 
 /**
- * The one and only ENVISAT API instance.
+ * The one and only ENVISAT API instance. It is only modified by
+ * <code>epr_init_api</code> and the functions setting handlers and
+ * log levels, the last error is kept per thread in epr_core.c.
  */
 extern EPR_SAPI epr_api;
 
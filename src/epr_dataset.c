@@ -35,6 +35,8 @@
 #include "epr_msph.h"
 #include "epr_band.h"
 #include "epr_bitmask.h"
+#include "epr_io.h"
+#include "epr_thread.h"
 
 #include "epr_dddb.h"
 
@@ -265,9 +267,11 @@ EPR_SRecord* epr_create_record(EPR_SDatasetId* dataset_id)
                     "epr_create_record: dataset ID must not be NULL");
         return NULL;
     }
+    epr_lock_mutex(dataset_id->product_id->lock);
     if (dataset_id->record_info == NULL) {
         dataset_id->record_info = epr_get_record_info(dataset_id);
     }
+    epr_unlock_mutex(dataset_id->product_id->lock);
 
     record = epr_create_record_from_info(dataset_id->record_info);
     if (record == NULL) {
@@ -279,6 +283,43 @@ EPR_SRecord* epr_create_record(EPR_SDatasetId* dataset_id)
 }
 
 
+/**
+ * Sets the fields of a record from the bytes of a dataset record as stored
+ * in the product file.
+ */
+void epr_set_record_data(EPR_SRecord* record, const uchar* src)
+{
+    uint field_index;
+    uint data_type_size;
+    uint elements_to_read;
+    EPR_SField* field = NULL;
+
+    for (field_index = 0; field_index < record->num_fields; field_index++) {
+        field = record->fields[field_index];
+        elements_to_read = field->info->num_elems;
+        data_type_size = epr_get_data_type_size(field->info->data_type_id);
+        assert(data_type_size != 0);
+        assert(field->elems != NULL);
+
+        if (elements_to_read * data_type_size != field->info->tot_size) {
+            /*epr_log(e_log_info, "Spare");*/
+            data_type_size = field->info->tot_size / elements_to_read;
+        }
+
+        memcpy(field->elems, src, elements_to_read * data_type_size);
+        src += elements_to_read * data_type_size;
+
+        /*
+         * SWAP bytes on little endian (LE) order architectures (I368, Pentium Processors).
+         * ENVISAT products are stored in big endian (BE) order.
+         */
+        if (epr_api.little_endian_order) {
+            epr_swap_endian_order(field);
+        }
+    }
+}
+
+
 /**
  * Reads a full record from ENVISAT product file.
  */
@@ -286,13 +327,10 @@ EPR_SRecord* epr_read_record(EPR_SDatasetId* dataset_id,
                              uint record_index,
                              EPR_SRecord* record)
 {
-    uint field_index;
     uint dsd_offset;
     uint record_size;
-    uint data_type_size;
-    uint elements_to_read;
-    uint elements_read;
-    EPR_SField* field = NULL;
+    const uchar* src;
+    uchar* buffer = NULL;
 
     epr_clear_err();
 
@@ -322,9 +360,6 @@ EPR_SRecord* epr_read_record(EPR_SDatasetId* dataset_id,
         return NULL;
     }
 
-    /*READ FILE with: dataset_id->product_id->istream after the setting it to begin*/
-    rewind(dataset_id->product_id->istream);
-
     /*GET OFFSET*/
     dsd_offset = dataset_id->dsd->ds_offset;
 
@@ -335,39 +370,134 @@ EPR_SRecord* epr_read_record(EPR_SDatasetId* dataset_id,
         return NULL;
     }
 
-    /* Set file pointer to begin of demanded record */
-    if (fseek(dataset_id->product_id->istream, dsd_offset + record_size * record_index, SEEK_SET) != 0) {
-        epr_set_err(e_err_file_access_denied,
-            "epr_read_record: file seek failed");
+    /* In mmap mode the fields are copied straight from the mapped file,
+     * otherwise the record is read at its file position in one piece */
+    src = epr_get_mapped_bytes(dataset_id->product_id, dsd_offset + record_size * record_index, record_size);
+    if (src == NULL) {
+        if (dataset_id->product_id->mapped_data == NULL) {
+            buffer = (uchar*) malloc(record_size);
+            if (buffer == NULL) {
+                epr_set_err(e_err_out_of_memory,
+                    "epr_read_record: out of memory");
+                return NULL;
+            }
+        }
+        if (buffer == NULL ||
+                epr_read_product_bytes(dataset_id->product_id, dsd_offset + record_size * record_index,
+                                       buffer, record_size) != e_err_none) {
+            free(buffer);
+            epr_set_err(e_err_file_read_error,
+                "epr_read_record: file read failed");
+            return NULL;
+        }
+        src = buffer;
+    }
+
+    epr_set_record_data(record, src);
+    free(buffer);
+    return record;
+}
+
+
+/**
+ * Reads a range of consecutive records from ENVISAT product file with
+ * a single read.
+ */
+EPR_SRecord** epr_read_records(EPR_SDatasetId* dataset_id,
+                               uint first_index,
+                               uint num_records,
+                               EPR_SRecord** records)
+{
+    EPR_SRecord** result = records;
+    uint record_index;
+    uint offset;
+    uint record_size;
+    const uchar* src;
+    uchar* buffer = NULL;
+
+    epr_clear_err();
+
+    if (dataset_id == NULL) {
+        epr_set_err(e_err_invalid_dataset_name,
+                    "epr_read_records: invalid dataset name");
+        return NULL;
+    }
+    if (num_records == 0 || first_index >= dataset_id->dsd->num_dsr
+            || num_records > dataset_id->dsd->num_dsr - first_index) {
+        epr_set_err(e_err_invalid_value,
+                    "epr_read_records: invalid record range, must be within 0 and num_dsr");
         return NULL;
     }
 
-    for (field_index = 0; field_index < record->num_fields; field_index++) {
-        field = record->fields[field_index];
-        elements_to_read = field->info->num_elems ;
-        data_type_size = epr_get_data_type_size(field->info->data_type_id);
-        assert(data_type_size != 0);
-        assert(field->elems != NULL);
+    if (result == NULL) {
+        result = (EPR_SRecord**) calloc(num_records, sizeof (EPR_SRecord*));
+        if (result == NULL) {
+            epr_set_err(e_err_out_of_memory,
+                        "epr_read_records: out of memory");
+            return NULL;
+        }
+    }
+    for (record_index = 0; record_index < num_records; record_index++) {
+        if (result[record_index] == NULL) {
+            result[record_index] = epr_create_record(dataset_id);
+            if (result[record_index] == NULL) {
+                if (records == NULL) {
+                    epr_free_records(result, num_records);
+                }
+                epr_set_err(e_err_invalid_record_name,
+                            "epr_read_records: unable to create a new record");
+                return NULL;
+            }
+        } else if (result[record_index]->info != dataset_id->record_info) {
+            epr_set_err(e_err_invalid_record_name,
+                        "epr_read_records: invalid record name");
+            return NULL;
+        }
+    }
 
-        if (elements_to_read * data_type_size != field->info->tot_size) {
-            /*epr_log(e_log_info, "Spare");*/
-            data_type_size = field->info->tot_size / elements_to_read;
+    record_size = result[0]->info->tot_size;
+    if (record_size != dataset_id->dsd->dsr_size) {
+        if (records == NULL) {
+            epr_free_records(result, num_records);
         }
+        epr_set_err(e_err_invalid_data_format,
+                    "epr_read_records: wrong record size");
+        return NULL;
+    }
 
-        elements_read = fread(field->elems, data_type_size, elements_to_read, dataset_id->product_id->istream);
-        if (elements_read != elements_to_read) {
+    /* the records are stored back to back, so that they are read in one
+     * piece and swapped field by field out of the same buffer */
+    offset = dataset_id->dsd->ds_offset + record_size * first_index;
+    src = epr_get_mapped_bytes(dataset_id->product_id, offset, record_size * num_records);
+    if (src == NULL) {
+        if (dataset_id->product_id->mapped_data == NULL) {
+            buffer = (uchar*) malloc(record_size * num_records);
+            if (buffer == NULL) {
+                if (records == NULL) {
+                    epr_free_records(result, num_records);
+                }
+                epr_set_err(e_err_out_of_memory,
+                            "epr_read_records: out of memory");
+                return NULL;
+            }
+        }
+        if (buffer == NULL ||
+                epr_read_product_bytes(dataset_id->product_id, offset,
+                                       buffer, record_size * num_records) != e_err_none) {
+            free(buffer);
+            if (records == NULL) {
+                epr_free_records(result, num_records);
+            }
             epr_set_err(e_err_file_read_error,
-                "epr_read_record: file read failed");
+                        "epr_read_records: file read failed");
             return NULL;
         }
+        src = buffer;
+    }
 
-        /*
-         * SWAP bytes on little endian (LE) order architectures (I368, Pentium Processors).
-         * ENVISAT products are stored in big endian (BE) order.
-         */
-        if (epr_api.little_endian_order) {
-            epr_swap_endian_order(field);
-        }
+    for (record_index = 0; record_index < num_records; record_index++) {
+        epr_set_record_data(result[record_index], src + record_size * record_index);
     }
-    return record;
+    free(buffer);
+    return result;
 }
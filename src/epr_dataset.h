@@ -44,6 +44,15 @@ void epr_free_dataset_id(EPR_SDatasetId* dataset_id);
 
 EPR_SPtrArray* epr_create_dataset_ids(EPR_SProductId* product_id);
 
+/**
+ * Sets the fields of a record from the bytes of a dataset record as stored
+ * in the product file, swapping them into the byte order of the host.
+ *
+ * @param record the record, must not be <code>NULL</code>
+ * @param src the <code>record->info->tot_size</code> bytes of the record
+ */
+void epr_set_record_data(EPR_SRecord* record, const uchar* src);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
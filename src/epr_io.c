@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/* fileno(), mmap() and pread() are POSIX, not ANSI-C */
+#if !defined(WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_io.h"
+
+
+epr_boolean epr_map_product_file(EPR_SProductId* product_id)
+{
+    void* addr = NULL;
+
+    assert(product_id != NULL);
+    assert(product_id->istream != NULL);
+
+    product_id->io_mode = e_io_stdio;
+    product_id->mapped_data = NULL;
+
+    if (product_id->tot_size == 0) {
+        return FALSE;
+    }
+
+#ifdef WIN32
+    {
+        HANDLE file_handle = (HANDLE) _get_osfhandle(_fileno(product_id->istream));
+        HANDLE mapping_handle;
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            return FALSE;
+        }
+        mapping_handle = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping_handle == NULL) {
+            return FALSE;
+        }
+        addr = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, product_id->tot_size);
+        /* the view keeps a reference to the mapping object */
+        CloseHandle(mapping_handle);
+        if (addr == NULL) {
+            return FALSE;
+        }
+    }
+#else
+    addr = mmap(NULL, product_id->tot_size, PROT_READ, MAP_PRIVATE, fileno(product_id->istream), 0);
+    if (addr == MAP_FAILED) {
+        return FALSE;
+    }
+#endif
+
+    product_id->mapped_data = (const uchar*) addr;
+    product_id->io_mode = e_io_mmap;
+    return TRUE;
+}
+
+
+void epr_unmap_product_file(EPR_SProductId* product_id)
+{
+    assert(product_id != NULL);
+
+    if (product_id->mapped_data == NULL) {
+        return;
+    }
+#ifdef WIN32
+    UnmapViewOfFile((LPCVOID) product_id->mapped_data);
+#else
+    munmap((void*) product_id->mapped_data, product_id->tot_size);
+#endif
+    product_id->mapped_data = NULL;
+    product_id->io_mode = e_io_stdio;
+}
+
+
+const uchar* epr_get_mapped_bytes(const EPR_SProductId* product_id, uint offset, uint num_bytes)
+{
+    if (product_id->mapped_data == NULL) {
+        return NULL;
+    }
+    if (offset > product_id->tot_size || num_bytes > product_id->tot_size - offset) {
+        return NULL;
+    }
+    return product_id->mapped_data + offset;
+}
+
+
+int epr_read_product_bytes(EPR_SProductId* product_id, uint offset, void* buffer, uint num_bytes)
+{
+    if (product_id->mapped_data != NULL) {
+        const uchar* src = epr_get_mapped_bytes(product_id, offset, num_bytes);
+        if (src == NULL) {
+            epr_set_err(e_err_file_read_error,
+                        "epr_read_product_bytes: file read failed");
+            return epr_get_last_err_code();
+        }
+        memcpy(buffer, src, num_bytes);
+        return e_err_none;
+    }
+
+    /* positional reads leave the file position alone, so that several
+     * threads can read the same product */
+#ifdef WIN32
+    {
+        HANDLE file_handle = (HANDLE) _get_osfhandle(_fileno(product_id->istream));
+        OVERLAPPED overlapped;
+        DWORD num_read = 0;
+
+        memset(&overlapped, 0, sizeof (overlapped));
+        overlapped.Offset = offset;
+        if (file_handle == INVALID_HANDLE_VALUE
+                || !ReadFile(file_handle, buffer, num_bytes, &num_read, &overlapped)
+                || num_read != num_bytes) {
+            epr_set_err(e_err_file_read_error,
+                        "epr_read_product_bytes: file read failed");
+            return epr_get_last_err_code();
+        }
+    }
+#else
+    {
+        int fd = fileno(product_id->istream);
+        uchar* dst = (uchar*) buffer;
+        ssize_t num_read;
+
+        while (num_bytes > 0) {
+            num_read = pread(fd, dst, num_bytes, (off_t) offset);
+            if (num_read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (num_read <= 0) {
+                epr_set_err(e_err_file_read_error,
+                            "epr_read_product_bytes: file read failed");
+                return epr_get_last_err_code();
+            }
+            dst += num_read;
+            offset += (uint) num_read;
+            num_bytes -= (uint) num_read;
+        }
+    }
+#endif
+    return e_err_none;
+}
+
+
+void epr_advise_product_range(EPR_SProductId* product_id, uint offset, uint num_bytes, epr_boolean will_need)
+{
+#if !defined(WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fileno(product_id->istream), (off_t) offset, (off_t) num_bytes,
+                  will_need ? POSIX_FADV_WILLNEED : POSIX_FADV_SEQUENTIAL);
+#else
+    /* the platform offers no hints */
+    (void) product_id;
+    (void) offset;
+    (void) num_bytes;
+    (void) will_need;
+#endif
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef EPR_IO_H_INCL
+#define EPR_IO_H_INCL
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "epr_api.h"
+
+
+/**
+ * Maps the whole product file of the given product identifier read-only
+ * into memory. On success <code>product_id->mapped_data</code> points to
+ * the first byte of the file and <code>product_id->io_mode</code> is set to
+ * <code>e_io_mmap</code>.
+ *
+ * <p>A failure is not reported as an error: the product identifier is left
+ * in stdio mode and the caller simply continues with the input stream.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @return <code>TRUE</code> if the file could be mapped, <code>FALSE</code> otherwise
+ */
+epr_boolean epr_map_product_file(EPR_SProductId* product_id);
+
+/**
+ * Releases the memory mapping created by <code>epr_map_product_file</code>.
+ * The function does nothing if the product is not mapped.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ */
+void epr_unmap_product_file(EPR_SProductId* product_id);
+
+/**
+ * Gets a pointer to <code>num_bytes</code> bytes of the mapped product file
+ * starting at the given file offset.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param offset the file offset in bytes
+ * @param num_bytes the number of bytes which must be accessible
+ * @return the address of the first byte, or <code>NULL</code> if the product is
+ *         not mapped or the requested range exceeds the file size
+ */
+const uchar* epr_get_mapped_bytes(const EPR_SProductId* product_id, uint offset, uint num_bytes);
+
+/**
+ * Copies <code>num_bytes</code> bytes of the product file starting at the
+ * given file offset into <code>buffer</code>. Depending on the I/O mode of
+ * the product the bytes are taken from the memory mapping or read from the
+ * file of the input stream by a positional read, which does not move the
+ * stream's file position. Several threads may read the same product.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param offset the file offset in bytes
+ * @param buffer the destination buffer, must not be <code>NULL</code>
+ * @param num_bytes the number of bytes to be read
+ * @return zero for success, an error code otherwise
+ */
+int epr_read_product_bytes(EPR_SProductId* product_id, uint offset, void* buffer, uint num_bytes);
+
+/**
+ * Tells the operating system how a range of the product file is going to be
+ * accessed, if the platform supports such hints. A failure is ignored.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param offset the file offset in bytes
+ * @param num_bytes the number of bytes of the range
+ * @param will_need <code>TRUE</code> if the range is read soon, <code>FALSE</code>
+ *        if the range is read sequentially
+ */
+void epr_advise_product_range(EPR_SProductId* product_id, uint offset, uint num_bytes, epr_boolean will_need);
+
+
+/**
+ * Records of a dataset read ahead in blocks by a background thread, see
+ * <code>epr_set_read_ahead</code>.
+ */
+typedef struct EPR_ReadAhead EPR_SReadAhead;
+
+/**
+ * Tests whether the records read from the given product are read ahead,
+ * i.e. whether read-ahead is enabled and the product is not memory-mapped.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @return <code>TRUE</code> if records are read ahead
+ */
+epr_boolean epr_is_read_ahead_enabled(const EPR_SProductId* product_id);
+
+/**
+ * Starts reading records ahead: <code>num_records</code> ranges of
+ * <code>record_size</code> bytes, <code>record_stride</code> bytes apart,
+ * the first one at the file offset <code>offset</code>. A background thread
+ * reads blocks of consecutive records into a ring of
+ * <code>product_id->read_ahead_depth</code> buffers while the caller decodes
+ * the records of the current block. Without threads each block is read by
+ * the caller when its first record is requested. A block is read at once,
+ * unless the gaps between its records are larger than the records, then
+ * the records are read one by one.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param offset the file offset of the first record
+ * @param record_size the number of bytes of each record
+ * @param record_stride the distance in bytes between the starts of two records
+ * @param num_records the number of records
+ * @return the read-ahead or <code>NULL</code> if an error occurred
+ */
+EPR_SReadAhead* epr_start_read_ahead(EPR_SProductId* product_id,
+                                     uint offset,
+                                     uint record_size,
+                                     uint record_stride,
+                                     uint num_records);
+
+/**
+ * Gets the next record of a read-ahead, waiting until it has been read.
+ * The record is valid until the next call.
+ *
+ * @param read_ahead the read-ahead, must not be <code>NULL</code>
+ * @return the <code>record_size</code> bytes of the record or <code>NULL</code>
+ *         if an error occurred
+ */
+const uchar* epr_next_read_ahead_record(EPR_SReadAhead* read_ahead);
+
+/**
+ * Stops reading records ahead, also before all records have been read,
+ * and releases the read-ahead.
+ *
+ * @param read_ahead the read-ahead, can be <code>NULL</code>
+ */
+void epr_stop_read_ahead(EPR_SReadAhead* read_ahead);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EPR_IO_H_INCL */
@@ -125,7 +125,6 @@ EPR_SRecord* epr_read_sph(EPR_SProductId* product_id)
         return NULL;
     }
 
-    epr_api.epr_head_size = sph_length + EPR_MPH_SIZE;
     if (fseek(product_id->istream, EPR_MPH_SIZE, SEEK_SET) != 0) {
         epr_set_err(e_err_file_access_denied,
                     "epr_read_sph: file seek failed");
@@ -535,7 +534,9 @@ void epr_set_header_field_values(EPR_SRecord* record, EPR_SPtrArray* header_valu
 uint epr_compare_param(EPR_SProductId* product_id)
 {
     EPR_SDSD* dsd = NULL;
+    const EPR_SField* field;
     uint dsd_index = 0;
+    uint head_size;
 
     epr_clear_err();
 
@@ -550,8 +551,10 @@ uint epr_compare_param(EPR_SProductId* product_id)
           break;
     }
 
-    if (dsd->ds_offset == epr_api.epr_head_size)
-        return epr_api.epr_head_size;
+    field = epr_get_field(product_id->mph_record, "SPH_SIZE");
+    head_size = ((uint*) field->elems)[0] + EPR_MPH_SIZE;
+    if (dsd->ds_offset == head_size)
+        return head_size;
 
     return 0UL;
 }
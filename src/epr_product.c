@@ -35,6 +35,9 @@
 #include "epr_msph.h"
 #include "epr_band.h"
 #include "epr_bitmask.h"
+#include "epr_tile.h"
+#include "epr_io.h"
+#include "epr_thread.h"
 
 #include "epr_dddb.h"
 
@@ -52,6 +55,18 @@ uint epr_compute_scene_height(const EPR_SProductId* product_id);
  * Opens the ENVISAT product file with the given file path
  */
 EPR_SProductId* epr_open_product(const char* product_file_path) {
+    return epr_open_product_ex(product_file_path, e_io_stdio);
+}
+
+
+/*
+   Function:    epr_open_product_ex
+   Access:      public API
+ */
+/**
+ * Opens the ENVISAT product file with the given file path and I/O mode
+ */
+EPR_SProductId* epr_open_product_ex(const char* product_file_path, EPR_EIOMode io_mode) {
     EPR_SProductId* product_id = NULL;
     char message_buffer[80];
     int s_par;
@@ -76,9 +91,16 @@ EPR_SProductId* epr_open_product(const char* product_file_path) {
     }
     product_id->magic = EPR_MAGIC_PRODUCT_ID;
 
+    product_id->lock = epr_create_mutex();
+    if (product_id->lock == NULL) {
+        free(product_id);
+        return NULL;
+    }
+
     epr_assign_string(&product_id->file_path, product_file_path);
 
     if (product_id->file_path == NULL) {
+        epr_free_mutex(product_id->lock);
         free(product_id);
         epr_set_err(e_err_out_of_memory,
                     "epr_open_product: out of memory");
@@ -178,6 +200,14 @@ EPR_SProductId* epr_open_product(const char* product_file_path) {
         return NULL;
     }
 
+    if (io_mode == e_io_mmap) {
+        if (epr_map_product_file(product_id)) {
+            epr_log(e_log_debug, "product file mapped into memory");
+        } else {
+            epr_log(e_log_warning, "failed to map product file into memory, using stdio");
+        }
+    }
+
     product_id->record_info_cache = epr_create_ptr_array(32);
     product_id->param_table = epr_create_param_table();
 
@@ -251,6 +281,7 @@ int epr_close_product(EPR_SProductId* product_id) {
     }
 
     assert(product_id->istream != NULL);
+    epr_unmap_product_file(product_id);
     if (fclose(product_id->istream) != 0) {
         epr_set_err(e_err_file_close_failed,
                     "epr_close_product: product file close failed");
@@ -291,6 +322,15 @@ void epr_free_product_id(EPR_SProductId* product_id) {
     epr_free_param_table(product_id->param_table);
     product_id->param_table = NULL;
 
+    epr_free_bm_cache(product_id->bm_cache);
+    product_id->bm_cache = NULL;
+
+    epr_free_tile_cache(product_id->tile_cache);
+    product_id->tile_cache = NULL;
+
+    epr_free_mutex(product_id->lock);
+    product_id->lock = NULL;
+
     if (product_id->record_info_cache != NULL) {
         EPR_SRecordInfo* record_info = NULL;
         uint record_info_index = 0;
@@ -393,6 +433,88 @@ uint epr_get_scene_height(const EPR_SProductId* product_id) {
     return product_id->scene_height;
 }
 
+/**
+ * Gets the I/O mode actually used for the product.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @return the I/O mode, or <code>e_io_stdio</code> if an error occurred.
+ */
+EPR_EIOMode epr_get_io_mode(const EPR_SProductId* product_id) {
+    epr_clear_err();
+
+    if (product_id == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_get_io_mode: product_id must not be NULL");
+        return e_io_stdio;
+    }
+    return product_id->io_mode;
+}
+
+
+/**
+ * Sets the number of threads decoding a band raster of the product.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param num_threads the number of threads, 0 or 1 to decode in the calling thread
+ * @return zero for success, an error code otherwise
+ */
+int epr_set_read_threads(EPR_SProductId* product_id, uint num_threads) {
+    epr_clear_err();
+
+    if (product_id == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_set_read_threads: product_id must not be NULL");
+        return epr_get_last_err_code();
+    }
+    product_id->num_read_threads = num_threads;
+    return e_err_none;
+}
+
+
+/**
+ * Sets the executor running the strips of a band raster of the product.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param executor the executor, <code>NULL</code> to use threads started by the API
+ * @param executor_data passed to each call of the executor
+ * @return zero for success, an error code otherwise
+ */
+int epr_set_read_executor(EPR_SProductId* product_id, EPR_FExecutor executor, void* executor_data) {
+    epr_clear_err();
+
+    if (product_id == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_set_read_executor: product_id must not be NULL");
+        return epr_get_last_err_code();
+    }
+    product_id->read_executor = executor;
+    product_id->read_executor_data = executor_data;
+    return e_err_none;
+}
+
+
+/**
+ * Sets the block size and depth of the records read ahead for the band
+ * rasters of the product.
+ *
+ * @param product_id the product identifier, must not be <code>NULL</code>
+ * @param block_size the number of bytes of records read at once, 0 to disable read-ahead
+ * @param depth the number of blocks read ahead, 0 for the default
+ * @return zero for success, an error code otherwise
+ */
+int epr_set_read_ahead(EPR_SProductId* product_id, uint block_size, uint depth) {
+    epr_clear_err();
+
+    if (product_id == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_set_read_ahead: product_id must not be NULL");
+        return epr_get_last_err_code();
+    }
+    product_id->read_ahead_block_size = block_size;
+    product_id->read_ahead_depth = depth > 0 ? depth : EPR_DEFAULT_READ_AHEAD_DEPTH;
+    return e_err_none;
+}
+
 
 /*********************************** RECORD ***********************************/
 
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_string.h"
+#include "epr_io.h"
+#include "epr_thread.h"
+
+/* the largest gap between two records which is read along with them,
+ * as a multiple of the record size */
+#define EPR_MAX_READ_AHEAD_GAP 1
+
+
+struct EPR_ReadAhead {
+    EPR_SProductId* product_id;
+    /* the records, num_records ranges of record_size bytes record_stride bytes apart */
+    uint offset;
+    uint record_size;
+    uint record_stride;
+    uint num_records;
+    /* the distance of the records in the buffers, record_size if the gaps
+     * between the records are too large to be read with them */
+    uint buffer_stride;
+    /* the blocks of consecutive records and the ring of their buffers */
+    uint block_records;
+    uint num_blocks;
+    uint depth;
+    uchar** buffers;
+    /* the thread reading the blocks, NULL if the caller reads them */
+    EPR_SThread* thread;
+
+    /* the state shared with the thread, guarded by mutex */
+    EPR_SMutex* mutex;
+    EPR_SCondition* condition;
+    /* the blocks read and the blocks released by the caller */
+    uint num_read;
+    uint num_released;
+    epr_boolean stopped;
+    /* the error which occurred while reading a block */
+    int err_code;
+    char* err_message;
+
+    /* the index of the next record requested by the caller */
+    uint next_record;
+};
+
+
+epr_boolean epr_is_read_ahead_enabled(const EPR_SProductId* product_id)
+{
+    return product_id->read_ahead_block_size > 0 && product_id->mapped_data == NULL;
+}
+
+
+/* reads the given block into its buffer of the ring */
+static int epr_read_ahead_block(EPR_SReadAhead* read_ahead, uint block)
+{
+    uint first = block * read_ahead->block_records;
+    uint num = read_ahead->num_records - first < read_ahead->block_records
+               ? read_ahead->num_records - first : read_ahead->block_records;
+
+    uchar* buffer = read_ahead->buffers[block % read_ahead->depth];
+    uint i;
+
+    if (read_ahead->buffer_stride == read_ahead->record_stride) {
+        /* a single read spanning the records of the block, gaps included */
+        return epr_read_product_bytes(read_ahead->product_id,
+                                      read_ahead->offset + first * read_ahead->record_stride,
+                                      buffer,
+                                      (num - 1) * read_ahead->record_stride + read_ahead->record_size);
+    }
+    /* the records are packed into the buffer, the gaps are not read */
+    for (i = 0; i < num; i++) {
+        if (epr_read_product_bytes(read_ahead->product_id,
+                                   read_ahead->offset + (first + i) * read_ahead->record_stride,
+                                   buffer + i * read_ahead->buffer_stride,
+                                   read_ahead->record_size) != e_err_none) {
+            return epr_get_last_err_code();
+        }
+    }
+    return e_err_none;
+}
+
+
+/* tells the file system that the given block is read soon */
+static void epr_advise_read_ahead_block(EPR_SReadAhead* read_ahead, uint block)
+{
+    uint first = block * read_ahead->block_records;
+
+    /* a hint for the records of a sparse block would also cover its gaps */
+    if (block < read_ahead->num_blocks && read_ahead->buffer_stride == read_ahead->record_stride) {
+        epr_advise_product_range(read_ahead->product_id,
+                                 read_ahead->offset + first * read_ahead->record_stride,
+                                 read_ahead->block_records * read_ahead->record_stride,
+                                 TRUE);
+    }
+}
+
+
+/* the task of the thread reading the blocks ahead of the caller */
+static void epr_run_read_ahead(void* task_data)
+{
+    EPR_SReadAhead* read_ahead = (EPR_SReadAhead*) task_data;
+    uint block;
+
+    for (block = 0; block < read_ahead->num_blocks; block++) {
+        epr_lock_mutex(read_ahead->mutex);
+        while (!read_ahead->stopped && block - read_ahead->num_released >= read_ahead->depth) {
+            epr_wait_condition(read_ahead->condition, read_ahead->mutex);
+        }
+        if (read_ahead->stopped) {
+            epr_unlock_mutex(read_ahead->mutex);
+            return;
+        }
+        epr_unlock_mutex(read_ahead->mutex);
+
+        /* the next block is requested from the file system while this one is read */
+        epr_advise_read_ahead_block(read_ahead, block + 1);
+        if (epr_read_ahead_block(read_ahead, block) != e_err_none) {
+            epr_lock_mutex(read_ahead->mutex);
+            read_ahead->err_code = epr_get_last_err_code();
+            epr_assign_string(&read_ahead->err_message, epr_get_last_err_message());
+            epr_signal_condition(read_ahead->condition);
+            epr_unlock_mutex(read_ahead->mutex);
+            return;
+        }
+
+        epr_lock_mutex(read_ahead->mutex);
+        read_ahead->num_read++;
+        epr_signal_condition(read_ahead->condition);
+        epr_unlock_mutex(read_ahead->mutex);
+    }
+}
+
+
+EPR_SReadAhead* epr_start_read_ahead(EPR_SProductId* product_id,
+                                     uint offset,
+                                     uint record_size,
+                                     uint record_stride,
+                                     uint num_records)
+{
+    EPR_SReadAhead* read_ahead;
+    uint block_bytes, i;
+
+    read_ahead = (EPR_SReadAhead*) calloc(1, sizeof (EPR_SReadAhead));
+    if (read_ahead == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_start_read_ahead: out of memory");
+        return NULL;
+    }
+    read_ahead->product_id = product_id;
+    read_ahead->offset = offset;
+    read_ahead->record_size = record_size;
+    read_ahead->record_stride = record_stride > record_size ? record_stride : record_size;
+    read_ahead->num_records = num_records;
+    if (read_ahead->record_stride - record_size > EPR_MAX_READ_AHEAD_GAP * record_size) {
+        read_ahead->buffer_stride = record_size > 0 ? record_size : 1;
+    } else {
+        read_ahead->buffer_stride = read_ahead->record_stride;
+    }
+    read_ahead->block_records = product_id->read_ahead_block_size / read_ahead->buffer_stride;
+    if (read_ahead->block_records < 1) {
+        read_ahead->block_records = 1;
+    }
+    if (read_ahead->block_records > num_records && num_records > 0) {
+        read_ahead->block_records = num_records;
+    }
+    read_ahead->num_blocks = (num_records + read_ahead->block_records - 1) / read_ahead->block_records;
+    read_ahead->depth = product_id->read_ahead_depth;
+    if (read_ahead->depth > read_ahead->num_blocks) {
+        read_ahead->depth = read_ahead->num_blocks > 0 ? read_ahead->num_blocks : 1;
+    }
+
+    block_bytes = (read_ahead->block_records - 1) * read_ahead->buffer_stride + record_size;
+    read_ahead->buffers = (uchar**) calloc(read_ahead->depth, sizeof (uchar*));
+    read_ahead->mutex = epr_create_mutex();
+    read_ahead->condition = epr_create_condition();
+    if (read_ahead->buffers == NULL || read_ahead->mutex == NULL || read_ahead->condition == NULL) {
+        epr_stop_read_ahead(read_ahead);
+        epr_set_err(e_err_out_of_memory, "epr_start_read_ahead: out of memory");
+        return NULL;
+    }
+    for (i = 0; i < read_ahead->depth; i++) {
+        read_ahead->buffers[i] = (uchar*) malloc(block_bytes);
+        if (read_ahead->buffers[i] == NULL) {
+            epr_stop_read_ahead(read_ahead);
+            epr_set_err(e_err_out_of_memory, "epr_start_read_ahead: out of memory");
+            return NULL;
+        }
+    }
+
+    if (read_ahead->buffer_stride == read_ahead->record_stride) {
+        epr_advise_product_range(product_id, offset, num_records * read_ahead->record_stride, FALSE);
+    }
+    if (read_ahead->depth > 1) {
+        read_ahead->thread = epr_start_thread(epr_run_read_ahead, read_ahead);
+    }
+    if (read_ahead->thread == NULL) {
+        /* the caller reads each block into the first buffer */
+        for (i = 1; i < read_ahead->depth; i++) {
+            free(read_ahead->buffers[i]);
+        }
+        read_ahead->depth = 1;
+    }
+    return read_ahead;
+}
+
+
+const uchar* epr_next_read_ahead_record(EPR_SReadAhead* read_ahead)
+{
+    uint record = read_ahead->next_record;
+    uint block = record / read_ahead->block_records;
+    epr_boolean is_first = record % read_ahead->block_records == 0;
+    int err_code;
+
+    if (record >= read_ahead->num_records) {
+        epr_set_err(e_err_index_out_of_range, "epr_next_read_ahead_record: no more records");
+        return NULL;
+    }
+
+    if (read_ahead->thread == NULL) {
+        if (is_first && epr_read_ahead_block(read_ahead, block) != e_err_none) {
+            return NULL;
+        }
+    } else {
+        epr_lock_mutex(read_ahead->mutex);
+        if (is_first && block > 0) {
+            /* the previous block is not used anymore */
+            read_ahead->num_released++;
+            epr_signal_condition(read_ahead->condition);
+        }
+        while (read_ahead->num_read <= block && read_ahead->err_code == e_err_none) {
+            epr_wait_condition(read_ahead->condition, read_ahead->mutex);
+        }
+        err_code = read_ahead->num_read <= block ? read_ahead->err_code : e_err_none;
+        epr_unlock_mutex(read_ahead->mutex);
+        if (err_code != e_err_none) {
+            epr_set_err((EPR_EErrCode) err_code, read_ahead->err_message);
+            return NULL;
+        }
+    }
+
+    read_ahead->next_record++;
+    return read_ahead->buffers[block % read_ahead->depth]
+           + (record - block * read_ahead->block_records) * read_ahead->buffer_stride;
+}
+
+
+void epr_stop_read_ahead(EPR_SReadAhead* read_ahead)
+{
+    uint i;
+
+    if (read_ahead == NULL) {
+        return;
+    }
+    if (read_ahead->thread != NULL) {
+        epr_lock_mutex(read_ahead->mutex);
+        read_ahead->stopped = TRUE;
+        epr_signal_condition(read_ahead->condition);
+        epr_unlock_mutex(read_ahead->mutex);
+        epr_join_thread(read_ahead->thread);
+    }
+    if (read_ahead->buffers != NULL) {
+        for (i = 0; i < read_ahead->depth; i++) {
+            free(read_ahead->buffers[i]);
+        }
+        free(read_ahead->buffers);
+    }
+    epr_free_condition(read_ahead->condition);
+    epr_free_mutex(read_ahead->mutex);
+    epr_free_string(read_ahead->err_message);
+    free(read_ahead);
+}
@@ -435,3 +435,28 @@ void epr_free_record(EPR_SRecord* record)
 
     free(record);
 }
+
+
+/**
+ * Frees the records of an array returned by <code>epr_read_records</code>
+ * and the array itself.
+ *
+ * @param records the records to be released, if <code>NULL</code>
+ *        the function immediately returns
+ * @param num_records the number of elements of the array
+ */
+void epr_free_records(EPR_SRecord** records, uint num_records)
+{
+    uint record_index;
+
+    epr_clear_err();
+
+    if (records == NULL)
+        return;
+
+    for (record_index = 0; record_index < num_records; record_index++)
+    {
+        epr_free_record(records[record_index]);
+    }
+    free(records);
+}
@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_band.h"
+#include "epr_dataset.h"
+#include "epr_io.h"
+
+
+/* the number of bytes of records read at once by a sequential pass */
+#define EPR_SEQUENTIAL_CHUNK_SIZE (4 * 1024 * 1024)
+
+/* a band read by a sequential pass */
+typedef struct EPR_SequentialBand {
+    EPR_SBandId* band_id;
+    /* the raster receiving the band or, if the caller gave none, the line
+     * passed to the consumer */
+    EPR_SRaster* raster;
+    epr_boolean owns_raster;
+    /* measurement bands only */
+    const EPR_SBandReadPlan* plan;
+    uint offset_x_mirrored;
+    uint read_width;
+    /* annotation bands only */
+    EPR_STiePointGrid* grid;
+} EPR_SSequentialBand;
+
+
+/* passes the line row of the band's raster, the scene line y, to the consumer */
+static int epr_deliver_sequential_line(EPR_SSequentialBand* band, uint row, uint y,
+                                       EPR_FLineConsumer consumer, void* consumer_data)
+{
+    EPR_SRaster line;
+
+    if (consumer == NULL) {
+        return 0;
+    }
+    line = *band->raster;
+    line.buffer = (uchar*) band->raster->buffer + row * band->raster->raster_width * band->raster->elem_size;
+    line.raster_height = 1;
+    line.source_height = 1;
+    return consumer(consumer_data, band->band_id, y, &line);
+}
+
+
+/* gets num_records records of a dataset starting at first_record, straight
+ * from the mapped file or read into the buffer */
+static const uchar* epr_get_sequential_records(EPR_SDatasetId* dataset_id, uint first_record, uint num_records, uchar* buffer)
+{
+    const EPR_SDSD* dsd = dataset_id->dsd;
+    uint offset = dsd->ds_offset + dsd->dsr_size * first_record;
+    const uchar* data;
+
+    data = epr_get_mapped_bytes(dataset_id->product_id, offset, dsd->dsr_size * num_records);
+    if (data != NULL) {
+        return data;
+    }
+    if (epr_read_product_bytes(dataset_id->product_id, offset, buffer, dsd->dsr_size * num_records) != e_err_none) {
+        return NULL;
+    }
+    return buffer;
+}
+
+
+/* the number of records of a dataset read at once */
+static uint epr_get_sequential_chunk_records(const EPR_SDatasetId* dataset_id)
+{
+    uint num_records = EPR_SEQUENTIAL_CHUNK_SIZE / dataset_id->dsd->dsr_size;
+    return num_records > 0 ? num_records : 1;
+}
+
+
+/* decodes the records of a measurement dataset for its bands, num_lines records front to back */
+static int epr_read_sequential_measurement(EPR_SDatasetId* dataset_id,
+                                           EPR_SSequentialBand** bands,
+                                           uint num_bands,
+                                           uint num_lines,
+                                           EPR_FLineConsumer consumer,
+                                           void* consumer_data)
+{
+    uint chunk_records = epr_get_sequential_chunk_records(dataset_id);
+    uint dsr_size = dataset_id->dsd->dsr_size;
+    uint first, num, r, b, row;
+    const uchar* data;
+    const uchar* line_data;
+    uchar* buffer = NULL;
+    EPR_SSequentialBand* band;
+    EPR_SRaster* raster;
+    int result = e_err_none;
+
+    for (b = 0; b < num_bands; b++) {
+        band = bands[b];
+        band->plan = epr_get_band_read_plan(band->band_id);
+        if (band->plan == NULL) {
+            return epr_get_last_err_code();
+        }
+        band->read_width = (band->raster->raster_width - 1) * band->raster->source_step_x + 1;
+        band->offset_x_mirrored = (uint) epr_get_mirrored_offset_x(band->band_id, 0, band->raster);
+        if (band->offset_x_mirrored + band->read_width > band->plan->num_pixels) {
+            epr_set_err(e_err_illegal_arg,
+                        "epr_read_product_sequentially: pixel range out of bounds");
+            return epr_get_last_err_code();
+        }
+    }
+
+    if (dataset_id->product_id->mapped_data == NULL) {
+        buffer = (uchar*) malloc(chunk_records * dsr_size);
+        if (buffer == NULL) {
+            epr_set_err(e_err_out_of_memory,
+                        "epr_read_product_sequentially: out of memory");
+            return epr_get_last_err_code();
+        }
+    }
+
+    for (first = 0; first < num_lines && result == e_err_none; first += num) {
+        num = num_lines - first < chunk_records ? num_lines - first : chunk_records;
+        data = epr_get_sequential_records(dataset_id, first, num, buffer);
+        if (data == NULL) {
+            result = epr_get_last_err_code();
+            break;
+        }
+        for (r = first; r < first + num && result == e_err_none; r++) {
+            for (b = 0; b < num_bands && result == e_err_none; b++) {
+                band = bands[b];
+                raster = band->raster;
+                if (band->owns_raster) {
+                    row = 0;
+                } else if (r % raster->source_step_y != 0 || r / raster->source_step_y >= raster->raster_height) {
+                    continue;
+                } else {
+                    row = r / raster->source_step_y;
+                }
+                /*swap, extract and scale the "line" of physical values of the band*/
+                line_data = data + (r - first) * dsr_size + band->plan->field_offset
+                            + band->plan->pixel_size * band->offset_x_mirrored;
+                band->plan->decode_func((void*) line_data, band->band_id, 0, band->read_width,
+                                        raster->source_step_x, raster->buffer, row * raster->raster_width);
+                if (epr_finish_band_line(band->band_id, raster, row, NULL) != e_err_none) {
+                    result = epr_get_last_err_code();
+                    break;
+                }
+                result = epr_deliver_sequential_line(band, row, r, consumer, consumer_data);
+            }
+        }
+    }
+
+    free(buffer);
+    return result;
+}
+
+
+/* fills the tie point grids of the bands of an annotation dataset, reading
+ * each record once, and interpolates the bands */
+static int epr_read_sequential_annotation(EPR_SDatasetId* dataset_id,
+                                          EPR_SSequentialBand** bands,
+                                          uint num_bands,
+                                          uint num_lines,
+                                          EPR_FLineConsumer consumer,
+                                          void* consumer_data)
+{
+    uint chunk_records = epr_get_sequential_chunk_records(dataset_id);
+    uint num_records = dataset_id->dsd->num_dsr;
+    uint first, num, r, b, y;
+    const uchar* data;
+    uchar* buffer = NULL;
+    EPR_SRecord* record = NULL;
+    EPR_SSequentialBand* band;
+    epr_boolean failed = FALSE;
+    int result = e_err_none;
+
+    for (b = 0; b < num_bands; b++) {
+        bands[b]->grid = epr_get_tie_point_grid(bands[b]->band_id);
+        if (bands[b]->grid == NULL) {
+            return epr_get_last_err_code();
+        }
+    }
+
+    record = epr_create_record(dataset_id);
+    if (record == NULL) {
+        return epr_get_last_err_code();
+    }
+    if (dataset_id->product_id->mapped_data == NULL) {
+        buffer = (uchar*) malloc(chunk_records * dataset_id->dsd->dsr_size);
+        if (buffer == NULL) {
+            epr_free_record(record);
+            epr_set_err(e_err_out_of_memory,
+                        "epr_read_product_sequentially: out of memory");
+            return epr_get_last_err_code();
+        }
+    }
+
+    for (first = 0; first < num_records && result == e_err_none; first += num) {
+        num = num_records - first < chunk_records ? num_records - first : chunk_records;
+        data = epr_get_sequential_records(dataset_id, first, num, buffer);
+        if (data == NULL) {
+            result = epr_get_last_err_code();
+            break;
+        }
+        for (r = first; r < first + num && result == e_err_none; r++) {
+            epr_set_record_data(record, data + (r - first) * dataset_id->dsd->dsr_size);
+            for (b = 0; b < num_bands; b++) {
+                if (epr_set_tie_point_row(bands[b]->band_id, bands[b]->grid, r, record) == NULL) {
+                    result = epr_get_last_err_code();
+                    break;
+                }
+            }
+        }
+    }
+    free(buffer);
+    epr_free_record(record);
+
+    /* the grids are complete, the interpolation does not read the file anymore */
+    for (b = 0; b < num_bands && result == e_err_none; b++) {
+        band = bands[b];
+        if (band->owns_raster) {
+            for (y = 0; y < num_lines && result == e_err_none; y++) {
+                failed = epr_read_band_annotation_data(band->band_id, 0, (int) y, band->raster) != 0;
+                if (failed) {
+                    break;
+                }
+                result = epr_deliver_sequential_line(band, 0, y, consumer, consumer_data);
+            }
+        } else {
+            failed = epr_read_band_annotation_data(band->band_id, 0, 0, band->raster) != 0;
+            for (y = 0; !failed && y < band->raster->raster_height && result == e_err_none; y++) {
+                result = epr_deliver_sequential_line(band, y, y * band->raster->source_step_y, consumer, consumer_data);
+            }
+        }
+        if (failed) {
+            epr_set_err(e_err_file_read_error,
+                        "epr_read_product_sequentially: unsuccessfully reading band annotation data");
+            result = epr_get_last_err_code();
+        }
+    }
+    return result;
+}
+
+
+/* checks a band and its raster, NULL if the lines are only passed to the consumer */
+static int epr_check_sequential_band(EPR_SBandId* band_id, EPR_SRaster* raster,
+                                     EPR_SProductId* product_id, EPR_FLineConsumer consumer)
+{
+    const char* ds_type;
+
+    if (band_id == NULL || band_id->product_id != product_id) {
+        epr_set_err(e_err_invalid_band,
+                    "epr_read_product_sequentially: bands must not be NULL and of the same product");
+        return epr_get_last_err_code();
+    }
+    ds_type = band_id->dataset_ref.dataset_id->dsd->ds_type;
+    if (strcmp(ds_type, "M") != 0 && strcmp(ds_type, "A") != 0) {
+        epr_set_err(e_err_invalid_value,
+                    "epr_read_product_sequentially: illegat DS-TYPE; 'A' or'M' will be accepted");
+        return epr_get_last_err_code();
+    }
+    if (raster == NULL) {
+        if (consumer == NULL) {
+            epr_set_err(e_err_invalid_raster,
+                        "epr_read_product_sequentially: raster must not be NULL without a consumer");
+            return epr_get_last_err_code();
+        }
+        return e_err_none;
+    }
+    if (raster->buffer == NULL || raster->data_type != band_id->data_type) {
+        epr_set_err(e_err_illegal_data_type,
+                    "epr_read_product_sequentially: illegal raster data type");
+        return epr_get_last_err_code();
+    }
+    if (raster->source_width != epr_get_scene_width(product_id)
+            || raster->source_height != epr_get_scene_height(product_id)
+            || raster->source_step_x == 0 || raster->source_step_y == 0) {
+        epr_set_err(e_err_invalid_raster,
+                    "epr_read_product_sequentially: the raster must cover the scene");
+        return epr_get_last_err_code();
+    }
+    return e_err_none;
+}
+
+
+int epr_read_product_sequentially(EPR_SBandId** band_ids,
+                                  EPR_SRaster** rasters,
+                                  uint num_bands,
+                                  EPR_FLineConsumer consumer,
+                                  void* consumer_data)
+{
+    EPR_SProductId* product_id;
+    EPR_SSequentialBand* bands = NULL;
+    EPR_SSequentialBand** dataset_bands = NULL;
+    EPR_SDatasetId** datasets = NULL;
+    EPR_SDatasetId* dataset_id;
+    uint num_datasets = 0, num_dataset_bands, scene_width, scene_height;
+    uint i, j;
+    int result = e_err_none;
+
+    epr_clear_err();
+
+    if (band_ids == NULL || (rasters == NULL && consumer == NULL)) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_read_product_sequentially: band_ids or rasters must not be NULL");
+        return epr_get_last_err_code();
+    }
+    if (num_bands == 0) {
+        return e_err_none;
+    }
+    product_id = band_ids[0] != NULL ? band_ids[0]->product_id : NULL;
+    for (i = 0; i < num_bands; i++) {
+        if (epr_check_sequential_band(band_ids[i], rasters != NULL ? rasters[i] : NULL,
+                                      product_id, consumer) != e_err_none) {
+            return epr_get_last_err_code();
+        }
+    }
+    scene_width = epr_get_scene_width(product_id);
+    scene_height = epr_get_scene_height(product_id);
+
+    bands = (EPR_SSequentialBand*) calloc(num_bands, sizeof (EPR_SSequentialBand));
+    dataset_bands = (EPR_SSequentialBand**) calloc(num_bands, sizeof (EPR_SSequentialBand*));
+    datasets = (EPR_SDatasetId**) calloc(num_bands, sizeof (EPR_SDatasetId*));
+    if (bands == NULL || dataset_bands == NULL || datasets == NULL) {
+        free(bands);
+        free(dataset_bands);
+        free(datasets);
+        epr_set_err(e_err_out_of_memory,
+                    "epr_read_product_sequentially: out of memory");
+        return epr_get_last_err_code();
+    }
+
+    for (i = 0; i < num_bands && result == e_err_none; i++) {
+        bands[i].band_id = band_ids[i];
+        bands[i].raster = rasters != NULL ? rasters[i] : NULL;
+        if (bands[i].raster == NULL) {
+            bands[i].raster = epr_create_compatible_raster(band_ids[i], scene_width, 1, 1, 1);
+            if (bands[i].raster == NULL) {
+                result = epr_get_last_err_code();
+            }
+            bands[i].owns_raster = TRUE;
+        }
+        /* the datasets of the bands, sorted by their offset in the file */
+        dataset_id = band_ids[i]->dataset_ref.dataset_id;
+        j = 0;
+        while (j < num_datasets && datasets[j] != dataset_id) {
+            j++;
+        }
+        if (j == num_datasets) {
+            for (j = num_datasets; j > 0 && datasets[j - 1]->dsd->ds_offset > dataset_id->dsd->ds_offset; j--) {
+                datasets[j] = datasets[j - 1];
+            }
+            datasets[j] = dataset_id;
+            num_datasets++;
+        }
+    }
+    if (result == e_err_none && scene_height > 0) {
+        for (i = 0; i < num_datasets; i++) {
+            if (strcmp(datasets[i]->dsd->ds_type, "M") == 0 && scene_height > datasets[i]->dsd->num_dsr) {
+                epr_set_err(e_err_illegal_arg,
+                            "epr_read_product_sequentially: raster y coordinates out of bounds");
+                result = epr_get_last_err_code();
+            }
+        }
+    }
+
+    for (i = 0; i < num_datasets && result == e_err_none; i++) {
+        num_dataset_bands = 0;
+        for (j = 0; j < num_bands; j++) {
+            if (band_ids[j]->dataset_ref.dataset_id == datasets[i]) {
+                dataset_bands[num_dataset_bands++] = &bands[j];
+            }
+        }
+        if (strcmp(datasets[i]->dsd->ds_type, "M") == 0) {
+            result = epr_read_sequential_measurement(datasets[i], dataset_bands, num_dataset_bands,
+                                                     scene_height, consumer, consumer_data);
+        } else {
+            result = epr_read_sequential_annotation(datasets[i], dataset_bands, num_dataset_bands,
+                                                    scene_height, consumer, consumer_data);
+        }
+    }
+
+    for (i = 0; i < num_bands; i++) {
+        if (bands[i].owns_raster && bands[i].raster != NULL) {
+            /* epr_free_raster clears the error */
+            free(bands[i].raster->buffer);
+            free(bands[i].raster);
+        }
+    }
+    free(bands);
+    free(dataset_bands);
+    free(datasets);
+    return result;
+}
@@ -0,0 +1,1343 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/*
+ * SIMD variants of the line decoders in epr_band.c.
+ *
+ * The decoders are only compiled for 64-bit little endian targets
+ * (x86-64 and AArch64), where the scalar decoders evaluate
+ * 'offset + factor * sample' in single precision without excess precision.
+ * The vector kernels perform exactly the same operations (exact integer to
+ * float conversion, one multiplication, one addition), so their results are
+ * bit-identical to the scalar ones. The 16 bit kernels optionally swap the
+ * bytes of big endian samples in the registers, which lets the *_be_*
+ * decoders work straight on the raw bytes of the product file.
+ *
+ * Each kernel processes whole vectors only and returns the number of pixels
+ * it has decoded; the remaining pixels are passed to the scalar decoder.
+ * The kernels never touch bytes behind the sample of the last pixel, so the
+ * source may also be a line buffer which ends exactly with that sample.
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_band.h"
+#include "epr_simd.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define EPR_SIMD_X86
+#  include <emmintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#  if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#    define EPR_SIMD_AVX2
+#    define EPR_TARGET_AVX2 __attribute__((target("avx2")))
+#    include <immintrin.h>
+#  elif defined(_MSC_VER) && _MSC_VER >= 1700
+#    define EPR_SIMD_AVX2
+#    define EPR_TARGET_AVX2
+#    include <immintrin.h>
+#  endif
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#  define EPR_SIMD_NEON
+#  include <arm_neon.h>
+#endif
+
+
+uint epr_detect_cpu_features(void)
+{
+    uint features = 0;
+
+#if defined(EPR_SIMD_X86)
+    /* SSE2 is part of the x86-64 base line */
+    features |= EPR_CPU_SSE2;
+#  if defined(EPR_SIMD_AVX2) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        features |= EPR_CPU_AVX2;
+    }
+#  elif defined(EPR_SIMD_AVX2)
+    {
+        int info[4];
+        int avx2 = 0, osxsave = 0;
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+            __cpuid(info, 1);
+            osxsave = (info[2] & (1 << 27)) != 0;
+        }
+        /* the OS must also save the YMM registers */
+        if (avx2 && osxsave && (_xgetbv(0) & 6) == 6) {
+            features |= EPR_CPU_AVX2;
+        }
+    }
+#  endif
+#elif defined(EPR_SIMD_NEON)
+    /* NEON is mandatory on AArch64 */
+    features |= EPR_CPU_NEON;
+#endif
+
+    return features;
+}
+
+
+#if defined(EPR_SIMD_X86) || defined(EPR_SIMD_NEON)
+
+/**
+ * Gets a 16 bit sample from a byte sequence in host (little endian) or in
+ * big endian order.
+ */
+static int epr_get_sample_16(const uchar* p, int is_signed, int big_endian)
+{
+    int v = big_endian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+    return is_signed ? v - ((v & 0x8000) << 1) : v;
+}
+
+/**
+ * Gets an 8 bit sample.
+ */
+static int epr_get_sample_8(const uchar* p, int is_signed)
+{
+    int v = p[0];
+    return is_signed ? v - ((v & 0x80) << 1) : v;
+}
+
+/**
+ * Generates a line decoder for float bands which passes the linear scaled
+ * and unscaled pixels to a SIMD kernel and everything else to the given
+ * scalar decoder.
+ *
+ * @param name the name of the generated decoder
+ * @param scalar_decoder the scalar decoder it replaces
+ * @param kernel the SIMD kernel
+ * @param elem_size the size of a raw sample in bytes
+ * @param samples_per_pixel the number of raw samples per pixel
+ * @param phase the index of the sample within a pixel
+ * @param is_signed whether the raw samples are signed
+ * @param big_endian whether 16 bit samples are in big endian order
+ */
+#define EPR_DEFINE_FLOAT_DECODER(name, scalar_decoder, kernel, elem_size, samples_per_pixel, phase, is_signed, big_endian) \
+static void name(void* source_array,                                                        \
+                 EPR_SBandId* band_id,                                                      \
+                 int offset_x,                                                              \
+                 int raster_width,                                                          \
+                 int step_x,                                                                \
+                 void* raster_buffer,                                                       \
+                 int raster_pos)                                                            \
+{                                                                                           \
+    int n, m;                                                                               \
+    if (raster_width <= 0 || band_id->scaling_method == e_smid_log) {                       \
+        scalar_decoder(source_array, band_id, offset_x, raster_width, step_x,               \
+                       raster_buffer, raster_pos);                                          \
+        return;                                                                             \
+    }                                                                                       \
+    n = (raster_width - 1) / step_x + 1;                                                    \
+    m = kernel((const uchar*) source_array + (elem_size) * (samples_per_pixel) * offset_x,  \
+               (samples_per_pixel) * step_x, phase, is_signed, big_endian, n,               \
+               band_id->scaling_method == e_smid_lin,                                       \
+               band_id->scaling_offset, band_id->scaling_factor,                            \
+               (float*) raster_buffer + raster_pos);                                        \
+    if (m < n) {                                                                            \
+        scalar_decoder(source_array, band_id, offset_x + m * step_x,                        \
+                       raster_width - m * step_x, step_x, raster_buffer, raster_pos + m);   \
+    }                                                                                       \
+}
+
+/**
+ * Generates a line decoder for the 3TOI sample model.
+ */
+#define EPR_DEFINE_UINT_DECODER(name, kernel)                                               \
+static void name(void* source_array,                                                        \
+                 EPR_SBandId* band_id,                                                      \
+                 int offset_x,                                                              \
+                 int raster_width,                                                          \
+                 int step_x,                                                                \
+                 void* raster_buffer,                                                       \
+                 int raster_pos)                                                            \
+{                                                                                           \
+    int n, m = 0;                                                                           \
+    if (raster_width > 0) {                                                                 \
+        n = (raster_width - 1) / step_x + 1;                                                \
+        m = kernel((const uchar*) source_array + 3 * offset_x, step_x, n,                   \
+                   (uint*) raster_buffer + raster_pos);                                     \
+    }                                                                                       \
+    decode_line_uchar_3_to_i_to_uint(source_array, band_id, offset_x + m * step_x,          \
+                                     raster_width - m * step_x, step_x,                     \
+                                     raster_buffer, raster_pos + m);                        \
+}
+
+
+/* The integer copy decoders only profit from a SIMD memcpy() */
+
+static void copy_decode_line_uchar_1_of_1_to_uchar(void* source_array,
+                                                   EPR_SBandId* band_id,
+                                                   int offset_x,
+                                                   int raster_width,
+                                                   int step_x,
+                                                   void* raster_buffer,
+                                                   int raster_pos)
+{
+    if (step_x == 1 && raster_width > 0) {
+        memcpy((uchar*) raster_buffer + raster_pos,
+               (const uchar*) source_array + offset_x,
+               raster_width);
+    } else {
+        decode_line_uchar_1_of_1_to_uchar(source_array, band_id, offset_x, raster_width, step_x,
+                                          raster_buffer, raster_pos);
+    }
+}
+
+static void copy_decode_line_ushort_1_of_1_to_ushort(void* source_array,
+                                                     EPR_SBandId* band_id,
+                                                     int offset_x,
+                                                     int raster_width,
+                                                     int step_x,
+                                                     void* raster_buffer,
+                                                     int raster_pos)
+{
+    if (step_x == 1 && raster_width > 0) {
+        memcpy((ushort*) raster_buffer + raster_pos,
+               (const ushort*) source_array + offset_x,
+               raster_width * sizeof (ushort));
+    } else {
+        decode_line_ushort_1_of_1_to_ushort(source_array, band_id, offset_x, raster_width, step_x,
+                                            raster_buffer, raster_pos);
+    }
+}
+
+#endif /* EPR_SIMD_X86 || EPR_SIMD_NEON */
+
+
+/******************************************************************
+ * SSE2
+ */
+
+#if defined(EPR_SIMD_X86)
+
+static __m128 sse2_scale(__m128i v, int scaled, __m128 voff, __m128 vfac)
+{
+    __m128 f = _mm_cvtepi32_ps(v);
+    if (scaled) {
+        f = _mm_add_ps(voff, _mm_mul_ps(vfac, f));
+    }
+    return f;
+}
+
+/* swaps the bytes of all 16 bit lanes */
+static __m128i sse2_swap_16(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/* extracts one 16 bit sample out of each 32 bit lane */
+static __m128i sse2_select_16(__m128i v, int phase, int is_signed)
+{
+    if (phase == 0) {
+        return is_signed ? _mm_srai_epi32(_mm_slli_epi32(v, 16), 16)
+                         : _mm_and_si128(v, _mm_set1_epi32(0xffff));
+    }
+    return is_signed ? _mm_srai_epi32(v, 16) : _mm_srli_epi32(v, 16);
+}
+
+/* extends the lower/upper four 16 bit lanes to 32 bit */
+static __m128i sse2_extend_lo_16(__m128i v, int is_signed)
+{
+    return is_signed ? _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)
+                     : _mm_unpacklo_epi16(v, _mm_setzero_si128());
+}
+
+static __m128i sse2_extend_hi_16(__m128i v, int is_signed)
+{
+    return is_signed ? _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)
+                     : _mm_unpackhi_epi16(v, _mm_setzero_si128());
+}
+
+static __m128i sse2_gather_16(const uchar* src, int stride, int phase, int is_signed, int big_endian, int i)
+{
+    return _mm_set_epi32(epr_get_sample_16(src + 2 * ((i + 3) * stride + phase), is_signed, big_endian),
+                         epr_get_sample_16(src + 2 * ((i + 2) * stride + phase), is_signed, big_endian),
+                         epr_get_sample_16(src + 2 * ((i + 1) * stride + phase), is_signed, big_endian),
+                         epr_get_sample_16(src + 2 * (i * stride + phase), is_signed, big_endian));
+}
+
+static __m128i sse2_gather_8(const uchar* src, int stride, int phase, int is_signed, int i)
+{
+    return _mm_set_epi32(epr_get_sample_8(src + (i + 3) * stride + phase, is_signed),
+                         epr_get_sample_8(src + (i + 2) * stride + phase, is_signed),
+                         epr_get_sample_8(src + (i + 1) * stride + phase, is_signed),
+                         epr_get_sample_8(src + i * stride + phase, is_signed));
+}
+
+static int sse2_decode_16(const uchar* src, int stride, int phase, int is_signed, int big_endian, int n,
+                          int scaled, float off, float fac, float* dst)
+{
+    const __m128 voff = _mm_set1_ps(off);
+    const __m128 vfac = _mm_set1_ps(fac);
+    __m128i v, lo, hi;
+    int i = 0;
+
+    if (stride == 1) {
+        for (; i + 8 <= n; i += 8) {
+            v = _mm_loadu_si128((const __m128i*) (src + 2 * i));
+            if (big_endian) {
+                v = sse2_swap_16(v);
+            }
+            lo = sse2_extend_lo_16(v, is_signed);
+            hi = sse2_extend_hi_16(v, is_signed);
+            _mm_storeu_ps(dst + i, sse2_scale(lo, scaled, voff, vfac));
+            _mm_storeu_ps(dst + i + 4, sse2_scale(hi, scaled, voff, vfac));
+        }
+    } else if (stride == 2) {
+        /* the loads cover both samples of a pixel pair, keep one pixel in reserve */
+        for (; i + 9 <= n; i += 8) {
+            lo = _mm_loadu_si128((const __m128i*) (src + 4 * i));
+            hi = _mm_loadu_si128((const __m128i*) (src + 4 * i + 16));
+            if (big_endian) {
+                lo = sse2_swap_16(lo);
+                hi = sse2_swap_16(hi);
+            }
+            lo = sse2_select_16(lo, phase, is_signed);
+            hi = sse2_select_16(hi, phase, is_signed);
+            _mm_storeu_ps(dst + i, sse2_scale(lo, scaled, voff, vfac));
+            _mm_storeu_ps(dst + i + 4, sse2_scale(hi, scaled, voff, vfac));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            lo = sse2_gather_16(src, stride, phase, is_signed, big_endian, i);
+            hi = sse2_gather_16(src, stride, phase, is_signed, big_endian, i + 4);
+            _mm_storeu_ps(dst + i, sse2_scale(lo, scaled, voff, vfac));
+            _mm_storeu_ps(dst + i + 4, sse2_scale(hi, scaled, voff, vfac));
+        }
+    }
+    return i;
+}
+
+static int sse2_decode_8(const uchar* src, int stride, int phase, int is_signed, int big_endian, int n,
+                         int scaled, float off, float fac, float* dst)
+{
+    const __m128 voff = _mm_set1_ps(off);
+    const __m128 vfac = _mm_set1_ps(fac);
+    __m128i v, lo, hi;
+    int i = 0;
+
+    if (stride == 1) {
+        for (; i + 8 <= n; i += 8) {
+            v = _mm_loadl_epi64((const __m128i*) (src + i));
+            v = is_signed ? _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8)
+                          : _mm_unpacklo_epi8(v, _mm_setzero_si128());
+            lo = sse2_extend_lo_16(v, is_signed);
+            hi = sse2_extend_hi_16(v, is_signed);
+            _mm_storeu_ps(dst + i, sse2_scale(lo, scaled, voff, vfac));
+            _mm_storeu_ps(dst + i + 4, sse2_scale(hi, scaled, voff, vfac));
+        }
+    } else if (stride == 2) {
+        for (; i + 9 <= n; i += 8) {
+            v = _mm_loadu_si128((const __m128i*) (src + 2 * i));
+            if (phase == 0) {
+                v = is_signed ? _mm_srai_epi16(_mm_slli_epi16(v, 8), 8)
+                              : _mm_and_si128(v, _mm_set1_epi16(0xff));
+            } else {
+                v = is_signed ? _mm_srai_epi16(v, 8) : _mm_srli_epi16(v, 8);
+            }
+            lo = sse2_extend_lo_16(v, is_signed);
+            hi = sse2_extend_hi_16(v, is_signed);
+            _mm_storeu_ps(dst + i, sse2_scale(lo, scaled, voff, vfac));
+            _mm_storeu_ps(dst + i + 4, sse2_scale(hi, scaled, voff, vfac));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            lo = sse2_gather_8(src, stride, phase, is_signed, i);
+            hi = sse2_gather_8(src, stride, phase, is_signed, i + 4);
+            _mm_storeu_ps(dst + i, sse2_scale(lo, scaled, voff, vfac));
+            _mm_storeu_ps(dst + i + 4, sse2_scale(hi, scaled, voff, vfac));
+        }
+    }
+    return i;
+}
+
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_uchar_1_of_1_to_float,
+                         decode_line_uchar_1_of_1_to_float, sse2_decode_8, 1, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_char_1_of_1_to_float,
+                         decode_line_char_1_of_1_to_float, sse2_decode_8, 1, 1, 0, CHAR_MIN < 0, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_ushort_1_of_1_to_float,
+                         decode_line_ushort_1_of_1_to_float, sse2_decode_16, 2, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_short_1_of_1_to_float,
+                         decode_line_short_1_of_1_to_float, sse2_decode_16, 2, 1, 0, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_short_1_of_2_to_float,
+                         decode_line_short_1_of_2_to_float, sse2_decode_16, 2, 2, 0, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_short_2_of_2_to_float,
+                         decode_line_short_2_of_2_to_float, sse2_decode_16, 2, 2, 1, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_uchar_1_of_2_to_float,
+                         decode_line_uchar_1_of_2_to_float, sse2_decode_8, 1, 2, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_uchar_2_of_2_to_float,
+                         decode_line_uchar_2_of_2_to_float, sse2_decode_8, 1, 2, 1, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_uchar_2_to_f_to_float,
+                         decode_line_uchar_2_to_f_to_float, sse2_decode_16, 2, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_ushort_1_of_1_be_to_float,
+                         decode_line_ushort_1_of_1_be_to_float, sse2_decode_16, 2, 1, 0, 0, 1)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_short_1_of_1_be_to_float,
+                         decode_line_short_1_of_1_be_to_float, sse2_decode_16, 2, 1, 0, 1, 1)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_short_1_of_2_be_to_float,
+                         decode_line_short_1_of_2_be_to_float, sse2_decode_16, 2, 2, 0, 1, 1)
+EPR_DEFINE_FLOAT_DECODER(sse2_decode_line_short_2_of_2_be_to_float,
+                         decode_line_short_2_of_2_be_to_float, sse2_decode_16, 2, 2, 1, 1, 1)
+
+/* splits pairs of bytes, 16 pixels at once */
+static void sse2_decode_line_uchar_x_of_2_to_uchar(void* source_array,
+                                                   EPR_SBandId* band_id,
+                                                   int offset_x,
+                                                   int raster_width,
+                                                   int step_x,
+                                                   void* raster_buffer,
+                                                   int raster_pos,
+                                                   int phase)
+{
+    const uchar* src = (const uchar*) source_array + 2 * offset_x;
+    uchar* dst = (uchar*) raster_buffer + raster_pos;
+    __m128i lo, hi;
+    int i = 0;
+
+    if (step_x == 1) {
+        for (; i + 16 <= raster_width; i += 16) {
+            lo = _mm_loadu_si128((const __m128i*) (src + 2 * i));
+            hi = _mm_loadu_si128((const __m128i*) (src + 2 * i + 16));
+            if (phase == 0) {
+                lo = _mm_and_si128(lo, _mm_set1_epi16(0xff));
+                hi = _mm_and_si128(hi, _mm_set1_epi16(0xff));
+            } else {
+                lo = _mm_srli_epi16(lo, 8);
+                hi = _mm_srli_epi16(hi, 8);
+            }
+            _mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(lo, hi));
+        }
+    }
+    if (phase == 0) {
+        decode_line_uchar_1_of_2_to_uchar(source_array, band_id, offset_x + i, raster_width - i, step_x,
+                                          raster_buffer, raster_pos + i);
+    } else {
+        decode_line_uchar_2_of_2_to_uchar(source_array, band_id, offset_x + i, raster_width - i, step_x,
+                                          raster_buffer, raster_pos + i);
+    }
+}
+
+static void sse2_decode_line_uchar_1_of_2_to_uchar(void* source_array,
+                                                   EPR_SBandId* band_id,
+                                                   int offset_x,
+                                                   int raster_width,
+                                                   int step_x,
+                                                   void* raster_buffer,
+                                                   int raster_pos)
+{
+    sse2_decode_line_uchar_x_of_2_to_uchar(source_array, band_id, offset_x, raster_width, step_x,
+                                           raster_buffer, raster_pos, 0);
+}
+
+static void sse2_decode_line_uchar_2_of_2_to_uchar(void* source_array,
+                                                   EPR_SBandId* band_id,
+                                                   int offset_x,
+                                                   int raster_width,
+                                                   int step_x,
+                                                   void* raster_buffer,
+                                                   int raster_pos)
+{
+    sse2_decode_line_uchar_x_of_2_to_uchar(source_array, band_id, offset_x, raster_width, step_x,
+                                           raster_buffer, raster_pos, 1);
+}
+
+/* swaps big endian 16 bit samples, 8 pixels at once */
+static void sse2_decode_line_ushort_1_of_1_be_to_ushort(void* source_array,
+                                                        EPR_SBandId* band_id,
+                                                        int offset_x,
+                                                        int raster_width,
+                                                        int step_x,
+                                                        void* raster_buffer,
+                                                        int raster_pos)
+{
+    const uchar* src = (const uchar*) source_array + 2 * offset_x;
+    ushort* dst = (ushort*) raster_buffer + raster_pos;
+    int i = 0;
+
+    if (step_x == 1) {
+        for (; i + 8 <= raster_width; i += 8) {
+            _mm_storeu_si128((__m128i*) (dst + i),
+                             sse2_swap_16(_mm_loadu_si128((const __m128i*) (src + 2 * i))));
+        }
+    }
+    decode_line_ushort_1_of_1_be_to_ushort(source_array, band_id, offset_x + i, raster_width - i, step_x,
+                                           raster_buffer, raster_pos + i);
+}
+
+#endif /* EPR_SIMD_X86 */
+
+
+/******************************************************************
+ * AVX2
+ */
+
+#if defined(EPR_SIMD_AVX2)
+
+EPR_TARGET_AVX2
+static void avx2_store_f32(float* dst, __m256i v, int scaled, __m256 voff, __m256 vfac)
+{
+    __m256 f = _mm256_cvtepi32_ps(v);
+    if (scaled) {
+        f = _mm256_add_ps(voff, _mm256_mul_ps(vfac, f));
+    }
+    _mm256_storeu_ps(dst, f);
+}
+
+/* swaps the bytes of all 16 bit lanes */
+EPR_TARGET_AVX2
+static __m256i avx2_swap_16(__m256i v)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+}
+
+/* byte offsets of eight samples which are 'stride_bytes' apart */
+EPR_TARGET_AVX2
+static __m256i avx2_gather_index(int stride_bytes)
+{
+    return _mm256_mullo_epi32(_mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0),
+                              _mm256_set1_epi32(stride_bytes));
+}
+
+EPR_TARGET_AVX2
+static int avx2_decode_16(const uchar* src, int stride, int phase, int is_signed, int big_endian, int n,
+                          int scaled, float off, float fac, float* dst)
+{
+    const __m256 voff = _mm256_set1_ps(off);
+    const __m256 vfac = _mm256_set1_ps(fac);
+    __m256i v, index;
+    int i = 0;
+
+    if (stride == 1) {
+        for (; i + 8 <= n; i += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i*) (src + 2 * i));
+            if (big_endian) {
+                s = _mm_or_si128(_mm_slli_epi16(s, 8), _mm_srli_epi16(s, 8));
+            }
+            v = is_signed ? _mm256_cvtepi16_epi32(s) : _mm256_cvtepu16_epi32(s);
+            avx2_store_f32(dst + i, v, scaled, voff, vfac);
+        }
+    } else if (stride == 2) {
+        for (; i + 9 <= n; i += 8) {
+            v = _mm256_loadu_si256((const __m256i*) (src + 4 * i));
+            if (big_endian) {
+                v = avx2_swap_16(v);
+            }
+            if (phase == 0) {
+                v = is_signed ? _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16)
+                              : _mm256_and_si256(v, _mm256_set1_epi32(0xffff));
+            } else {
+                v = is_signed ? _mm256_srai_epi32(v, 16) : _mm256_srli_epi32(v, 16);
+            }
+            avx2_store_f32(dst + i, v, scaled, voff, vfac);
+        }
+    } else {
+        /* each gather reads 4 bytes, so keep two pixels in reserve */
+        index = avx2_gather_index(2 * stride);
+        for (; i + 10 <= n; i += 8) {
+            v = _mm256_i32gather_epi32((const int*) (src + 2 * (i * stride + phase)), index, 1);
+            if (big_endian) {
+                v = avx2_swap_16(v);
+            }
+            v = is_signed ? _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16)
+                          : _mm256_and_si256(v, _mm256_set1_epi32(0xffff));
+            avx2_store_f32(dst + i, v, scaled, voff, vfac);
+        }
+    }
+    return i;
+}
+
+EPR_TARGET_AVX2
+static int avx2_decode_8(const uchar* src, int stride, int phase, int is_signed, int big_endian, int n,
+                         int scaled, float off, float fac, float* dst)
+{
+    const __m256 voff = _mm256_set1_ps(off);
+    const __m256 vfac = _mm256_set1_ps(fac);
+    __m256i v, index;
+    int i = 0;
+
+    if (stride == 1) {
+        for (; i + 8 <= n; i += 8) {
+            __m128i s = _mm_loadl_epi64((const __m128i*) (src + i));
+            v = is_signed ? _mm256_cvtepi8_epi32(s) : _mm256_cvtepu8_epi32(s);
+            avx2_store_f32(dst + i, v, scaled, voff, vfac);
+        }
+    } else if (stride == 2) {
+        for (; i + 9 <= n; i += 8) {
+            v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (src + 2 * i)));
+            if (phase == 0) {
+                v = is_signed ? _mm256_srai_epi32(_mm256_slli_epi32(v, 24), 24)
+                              : _mm256_and_si256(v, _mm256_set1_epi32(0xff));
+            } else {
+                v = is_signed ? _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 24)
+                              : _mm256_srli_epi32(v, 8);
+            }
+            avx2_store_f32(dst + i, v, scaled, voff, vfac);
+        }
+    } else {
+        index = avx2_gather_index(stride);
+        for (; i + 10 <= n; i += 8) {
+            v = _mm256_i32gather_epi32((const int*) (src + i * stride + phase), index, 1);
+            v = is_signed ? _mm256_srai_epi32(_mm256_slli_epi32(v, 24), 24)
+                          : _mm256_and_si256(v, _mm256_set1_epi32(0xff));
+            avx2_store_f32(dst + i, v, scaled, voff, vfac);
+        }
+    }
+    return i;
+}
+
+/* assembles big endian 24 bit integers, 8 pixels at once */
+EPR_TARGET_AVX2
+static int avx2_decode_24(const uchar* src, int stride, int n, uint* dst)
+{
+    __m256i v, index, shuffle;
+    int i = 0;
+
+    if (stride == 1) {
+        shuffle = _mm256_setr_epi8(2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128,
+                                   2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128);
+        /* the upper load reads 4 bytes behind the 8th pixel */
+        for (; i + 10 <= n; i += 8) {
+            v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (src + 3 * i)));
+            v = _mm256_inserti128_si256(v, _mm_loadu_si128((const __m128i*) (src + 3 * i + 12)), 1);
+            _mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(v, shuffle));
+        }
+    } else {
+        shuffle = _mm256_setr_epi8(2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128,
+                                   2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128);
+        index = avx2_gather_index(3 * stride);
+        for (; i + 10 <= n; i += 8) {
+            v = _mm256_i32gather_epi32((const int*) (src + 3 * i * stride), index, 1);
+            _mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(v, shuffle));
+        }
+    }
+    return i;
+}
+
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_uchar_1_of_1_to_float,
+                         decode_line_uchar_1_of_1_to_float, avx2_decode_8, 1, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_char_1_of_1_to_float,
+                         decode_line_char_1_of_1_to_float, avx2_decode_8, 1, 1, 0, CHAR_MIN < 0, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_ushort_1_of_1_to_float,
+                         decode_line_ushort_1_of_1_to_float, avx2_decode_16, 2, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_short_1_of_1_to_float,
+                         decode_line_short_1_of_1_to_float, avx2_decode_16, 2, 1, 0, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_short_1_of_2_to_float,
+                         decode_line_short_1_of_2_to_float, avx2_decode_16, 2, 2, 0, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_short_2_of_2_to_float,
+                         decode_line_short_2_of_2_to_float, avx2_decode_16, 2, 2, 1, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_uchar_1_of_2_to_float,
+                         decode_line_uchar_1_of_2_to_float, avx2_decode_8, 1, 2, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_uchar_2_of_2_to_float,
+                         decode_line_uchar_2_of_2_to_float, avx2_decode_8, 1, 2, 1, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_uchar_2_to_f_to_float,
+                         decode_line_uchar_2_to_f_to_float, avx2_decode_16, 2, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_ushort_1_of_1_be_to_float,
+                         decode_line_ushort_1_of_1_be_to_float, avx2_decode_16, 2, 1, 0, 0, 1)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_short_1_of_1_be_to_float,
+                         decode_line_short_1_of_1_be_to_float, avx2_decode_16, 2, 1, 0, 1, 1)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_short_1_of_2_be_to_float,
+                         decode_line_short_1_of_2_be_to_float, avx2_decode_16, 2, 2, 0, 1, 1)
+EPR_DEFINE_FLOAT_DECODER(avx2_decode_line_short_2_of_2_be_to_float,
+                         decode_line_short_2_of_2_be_to_float, avx2_decode_16, 2, 2, 1, 1, 1)
+EPR_DEFINE_UINT_DECODER(avx2_decode_line_uchar_3_to_i_to_uint, avx2_decode_24)
+
+#endif /* EPR_SIMD_AVX2 */
+
+
+/******************************************************************
+ * NEON
+ */
+
+#if defined(EPR_SIMD_NEON)
+
+static void neon_store_f32(float* dst, int32x4_t v, int scaled, float32x4_t voff, float32x4_t vfac)
+{
+    float32x4_t f = vcvtq_f32_s32(v);
+    if (scaled) {
+        f = vaddq_f32(voff, vmulq_f32(vfac, f));
+    }
+    vst1q_f32(dst, f);
+}
+
+/* extends eight 16 bit lanes to 32 bit and stores them as float */
+static void neon_store_8x16(float* dst, uint16x8_t v, int is_signed, int scaled, float32x4_t voff, float32x4_t vfac)
+{
+    int32x4_t lo, hi;
+    if (is_signed) {
+        lo = vmovl_s16(vget_low_s16(vreinterpretq_s16_u16(v)));
+        hi = vmovl_s16(vget_high_s16(vreinterpretq_s16_u16(v)));
+    } else {
+        lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+        hi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v)));
+    }
+    neon_store_f32(dst, lo, scaled, voff, vfac);
+    neon_store_f32(dst + 4, hi, scaled, voff, vfac);
+}
+
+/* extends eight 8 bit lanes to 16 bit */
+static uint16x8_t neon_extend_8(uint8x8_t v, int is_signed)
+{
+    return is_signed ? vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(v))) : vmovl_u8(v);
+}
+
+static int neon_decode_16(const uchar* src, int stride, int phase, int is_signed, int big_endian, int n,
+                          int scaled, float off, float fac, float* dst)
+{
+    const float32x4_t voff = vdupq_n_f32(off);
+    const float32x4_t vfac = vdupq_n_f32(fac);
+    int32x4_t tmp[2];
+    int k, i = 0;
+
+    if (stride == 1) {
+        for (; i + 8 <= n; i += 8) {
+            uint8x16_t v = vld1q_u8(src + 2 * i);
+            if (big_endian) {
+                v = vrev16q_u8(v);
+            }
+            neon_store_8x16(dst + i, vreinterpretq_u16_u8(v), is_signed, scaled, voff, vfac);
+        }
+    } else if (stride == 2) {
+        for (; i + 9 <= n; i += 8) {
+            uint16x8x2_t v = vld2q_u16((const uint16_t*) (src + 4 * i));
+            uint16x8_t w = v.val[phase];
+            if (big_endian) {
+                w = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(w)));
+            }
+            neon_store_8x16(dst + i, w, is_signed, scaled, voff, vfac);
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            int32_t s[8];
+            for (k = 0; k < 8; k++) {
+                s[k] = epr_get_sample_16(src + 2 * ((i + k) * stride + phase), is_signed, big_endian);
+            }
+            tmp[0] = vld1q_s32(s);
+            tmp[1] = vld1q_s32(s + 4);
+            neon_store_f32(dst + i, tmp[0], scaled, voff, vfac);
+            neon_store_f32(dst + i + 4, tmp[1], scaled, voff, vfac);
+        }
+    }
+    return i;
+}
+
+static int neon_decode_8(const uchar* src, int stride, int phase, int is_signed, int big_endian, int n,
+                         int scaled, float off, float fac, float* dst)
+{
+    const float32x4_t voff = vdupq_n_f32(off);
+    const float32x4_t vfac = vdupq_n_f32(fac);
+    int32x4_t tmp[2];
+    int k, i = 0;
+
+    if (stride == 1) {
+        for (; i + 8 <= n; i += 8) {
+            neon_store_8x16(dst + i, neon_extend_8(vld1_u8(src + i), is_signed),
+                            is_signed, scaled, voff, vfac);
+        }
+    } else if (stride == 2) {
+        for (; i + 9 <= n; i += 8) {
+            uint8x8x2_t v = vld2_u8(src + 2 * i);
+            neon_store_8x16(dst + i, neon_extend_8(v.val[phase], is_signed),
+                            is_signed, scaled, voff, vfac);
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            int32_t s[8];
+            for (k = 0; k < 8; k++) {
+                s[k] = epr_get_sample_8(src + (i + k) * stride + phase, is_signed);
+            }
+            tmp[0] = vld1q_s32(s);
+            tmp[1] = vld1q_s32(s + 4);
+            neon_store_f32(dst + i, tmp[0], scaled, voff, vfac);
+            neon_store_f32(dst + i + 4, tmp[1], scaled, voff, vfac);
+        }
+    }
+    return i;
+}
+
+/* assembles big endian 24 bit integers, 8 pixels at once */
+static int neon_decode_24(const uchar* src, int stride, int n, uint* dst)
+{
+    int i = 0;
+
+    if (stride == 1) {
+        for (; i + 8 <= n; i += 8) {
+            uint8x8x3_t v = vld3_u8(src + 3 * i);
+            uint16x8_t b0 = vmovl_u8(v.val[0]);
+            uint16x8_t b1 = vmovl_u8(v.val[1]);
+            uint16x8_t b2 = vmovl_u8(v.val[2]);
+            uint32x4_t lo = vorrq_u32(vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(b0)), 16),
+                                                vshlq_n_u32(vmovl_u16(vget_low_u16(b1)), 8)),
+                                      vmovl_u16(vget_low_u16(b2)));
+            uint32x4_t hi = vorrq_u32(vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(b0)), 16),
+                                                vshlq_n_u32(vmovl_u16(vget_high_u16(b1)), 8)),
+                                      vmovl_u16(vget_high_u16(b2)));
+            vst1q_u32(dst + i, lo);
+            vst1q_u32(dst + i + 4, hi);
+        }
+    }
+    return i;
+}
+
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_uchar_1_of_1_to_float,
+                         decode_line_uchar_1_of_1_to_float, neon_decode_8, 1, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_char_1_of_1_to_float,
+                         decode_line_char_1_of_1_to_float, neon_decode_8, 1, 1, 0, CHAR_MIN < 0, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_ushort_1_of_1_to_float,
+                         decode_line_ushort_1_of_1_to_float, neon_decode_16, 2, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_short_1_of_1_to_float,
+                         decode_line_short_1_of_1_to_float, neon_decode_16, 2, 1, 0, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_short_1_of_2_to_float,
+                         decode_line_short_1_of_2_to_float, neon_decode_16, 2, 2, 0, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_short_2_of_2_to_float,
+                         decode_line_short_2_of_2_to_float, neon_decode_16, 2, 2, 1, 1, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_uchar_1_of_2_to_float,
+                         decode_line_uchar_1_of_2_to_float, neon_decode_8, 1, 2, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_uchar_2_of_2_to_float,
+                         decode_line_uchar_2_of_2_to_float, neon_decode_8, 1, 2, 1, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_uchar_2_to_f_to_float,
+                         decode_line_uchar_2_to_f_to_float, neon_decode_16, 2, 1, 0, 0, 0)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_ushort_1_of_1_be_to_float,
+                         decode_line_ushort_1_of_1_be_to_float, neon_decode_16, 2, 1, 0, 0, 1)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_short_1_of_1_be_to_float,
+                         decode_line_short_1_of_1_be_to_float, neon_decode_16, 2, 1, 0, 1, 1)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_short_1_of_2_be_to_float,
+                         decode_line_short_1_of_2_be_to_float, neon_decode_16, 2, 2, 0, 1, 1)
+EPR_DEFINE_FLOAT_DECODER(neon_decode_line_short_2_of_2_be_to_float,
+                         decode_line_short_2_of_2_be_to_float, neon_decode_16, 2, 2, 1, 1, 1)
+EPR_DEFINE_UINT_DECODER(neon_decode_line_uchar_3_to_i_to_uint, neon_decode_24)
+
+/* splits pairs of bytes, 16 pixels at once */
+static void neon_decode_line_uchar_x_of_2_to_uchar(void* source_array,
+                                                   EPR_SBandId* band_id,
+                                                   int offset_x,
+                                                   int raster_width,
+                                                   int step_x,
+                                                   void* raster_buffer,
+                                                   int raster_pos,
+                                                   int phase)
+{
+    const uchar* src = (const uchar*) source_array + 2 * offset_x;
+    uchar* dst = (uchar*) raster_buffer + raster_pos;
+    int i = 0;
+
+    if (step_x == 1) {
+        for (; i + 16 <= raster_width; i += 16) {
+            uint8x16x2_t v = vld2q_u8(src + 2 * i);
+            vst1q_u8(dst + i, v.val[phase]);
+        }
+    }
+    if (phase == 0) {
+        decode_line_uchar_1_of_2_to_uchar(source_array, band_id, offset_x + i, raster_width - i, step_x,
+                                          raster_buffer, raster_pos + i);
+    } else {
+        decode_line_uchar_2_of_2_to_uchar(source_array, band_id, offset_x + i, raster_width - i, step_x,
+                                          raster_buffer, raster_pos + i);
+    }
+}
+
+static void neon_decode_line_uchar_1_of_2_to_uchar(void* source_array,
+                                                   EPR_SBandId* band_id,
+                                                   int offset_x,
+                                                   int raster_width,
+                                                   int step_x,
+                                                   void* raster_buffer,
+                                                   int raster_pos)
+{
+    neon_decode_line_uchar_x_of_2_to_uchar(source_array, band_id, offset_x, raster_width, step_x,
+                                           raster_buffer, raster_pos, 0);
+}
+
+static void neon_decode_line_uchar_2_of_2_to_uchar(void* source_array,
+                                                   EPR_SBandId* band_id,
+                                                   int offset_x,
+                                                   int raster_width,
+                                                   int step_x,
+                                                   void* raster_buffer,
+                                                   int raster_pos)
+{
+    neon_decode_line_uchar_x_of_2_to_uchar(source_array, band_id, offset_x, raster_width, step_x,
+                                           raster_buffer, raster_pos, 1);
+}
+
+/* swaps big endian 16 bit samples, 8 pixels at once */
+static void neon_decode_line_ushort_1_of_1_be_to_ushort(void* source_array,
+                                                        EPR_SBandId* band_id,
+                                                        int offset_x,
+                                                        int raster_width,
+                                                        int step_x,
+                                                        void* raster_buffer,
+                                                        int raster_pos)
+{
+    const uchar* src = (const uchar*) source_array + 2 * offset_x;
+    ushort* dst = (ushort*) raster_buffer + raster_pos;
+    int i = 0;
+
+    if (step_x == 1) {
+        for (; i + 8 <= raster_width; i += 8) {
+            vst1q_u8((uint8_t*) (dst + i), vrev16q_u8(vld1q_u8(src + 2 * i)));
+        }
+    }
+    decode_line_ushort_1_of_1_be_to_ushort(source_array, band_id, offset_x + i, raster_width - i, step_x,
+                                           raster_buffer, raster_pos + i);
+}
+
+#endif /* EPR_SIMD_NEON */
+
+
+/******************************************************************
+ * Byte swapping
+ */
+
+static void scalar_byte_swap_16(uchar* p, uint n)
+{
+    ushort* w = (ushort*) p;
+    uint i;
+    for (i = 0; i < n; i++) {
+        w[i] = (ushort) ((w[i] << 8) | (w[i] >> 8));
+    }
+}
+
+static uint epr_swap_uint(uint v)
+{
+    return (v << 24) | ((v & 0x0000ff00) << 8) | ((v >> 8) & 0x0000ff00) | (v >> 24);
+}
+
+static void scalar_byte_swap_32(uchar* p, uint n)
+{
+    uint* w = (uint*) p;
+    uint i;
+    for (i = 0; i < n; i++) {
+        w[i] = epr_swap_uint(w[i]);
+    }
+}
+
+static void scalar_byte_swap_64(uchar* p, uint n)
+{
+    uint* w = (uint*) p;
+    uint i, t;
+    for (i = 0; i < n; i++, w += 2) {
+        t = epr_swap_uint(w[0]);
+        w[0] = epr_swap_uint(w[1]);
+        w[1] = t;
+    }
+}
+
+#if defined(EPR_SIMD_X86)
+
+static void sse2_byte_swap_16(uchar* p, uint n)
+{
+    uint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (p + 2 * i));
+        _mm_storeu_si128((__m128i*) (p + 2 * i), sse2_swap_16(v));
+    }
+    scalar_byte_swap_16(p + 2 * i, n - i);
+}
+
+static void sse2_byte_swap_32(uchar* p, uint n)
+{
+    uint i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = sse2_swap_16(_mm_loadu_si128((const __m128i*) (p + 4 * i)));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i*) (p + 4 * i), v);
+    }
+    scalar_byte_swap_32(p + 4 * i, n - i);
+}
+
+static void sse2_byte_swap_64(uchar* p, uint n)
+{
+    uint i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = sse2_swap_16(_mm_loadu_si128((const __m128i*) (p + 8 * i)));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i*) (p + 8 * i), v);
+    }
+    scalar_byte_swap_64(p + 8 * i, n - i);
+}
+
+#endif /* EPR_SIMD_X86 */
+
+#if defined(EPR_SIMD_AVX2)
+
+/* reverses the bytes of each group of 'size' bytes, 32 bytes at once */
+EPR_TARGET_AVX2
+static uint avx2_byte_swap(uchar* p, uint num_bytes, __m256i shuffle)
+{
+    uint i = 0;
+    for (; i + 32 <= num_bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (p + i));
+        _mm256_storeu_si256((__m256i*) (p + i), _mm256_shuffle_epi8(v, shuffle));
+    }
+    return i;
+}
+
+EPR_TARGET_AVX2
+static void avx2_byte_swap_16(uchar* p, uint n)
+{
+    uint done = avx2_byte_swap(p, 2 * n,
+                               _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+    scalar_byte_swap_16(p + done, n - done / 2);
+}
+
+EPR_TARGET_AVX2
+static void avx2_byte_swap_32(uchar* p, uint n)
+{
+    uint done = avx2_byte_swap(p, 4 * n,
+                               _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    scalar_byte_swap_32(p + done, n - done / 4);
+}
+
+EPR_TARGET_AVX2
+static void avx2_byte_swap_64(uchar* p, uint n)
+{
+    uint done = avx2_byte_swap(p, 8 * n,
+                               _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+    scalar_byte_swap_64(p + done, n - done / 8);
+}
+
+#endif /* EPR_SIMD_AVX2 */
+
+#if defined(EPR_SIMD_NEON)
+
+static void neon_byte_swap_16(uchar* p, uint n)
+{
+    uint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        vst1q_u8(p + 2 * i, vrev16q_u8(vld1q_u8(p + 2 * i)));
+    }
+    scalar_byte_swap_16(p + 2 * i, n - i);
+}
+
+static void neon_byte_swap_32(uchar* p, uint n)
+{
+    uint i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_u8(p + 4 * i, vrev32q_u8(vld1q_u8(p + 4 * i)));
+    }
+    scalar_byte_swap_32(p + 4 * i, n - i);
+}
+
+static void neon_byte_swap_64(uchar* p, uint n)
+{
+    uint i = 0;
+    for (; i + 2 <= n; i += 2) {
+        vst1q_u8(p + 8 * i, vrev64q_u8(vld1q_u8(p + 8 * i)));
+    }
+    scalar_byte_swap_64(p + 8 * i, n - i);
+}
+
+#endif /* EPR_SIMD_NEON */
+
+void epr_byte_swap_16(void* buffer, uint number_of_swaps)
+{
+#if defined(EPR_SIMD_AVX2)
+    if ((epr_api.cpu_features & EPR_CPU_AVX2) != 0) {
+        avx2_byte_swap_16((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+#if defined(EPR_SIMD_X86)
+    if ((epr_api.cpu_features & EPR_CPU_SSE2) != 0) {
+        sse2_byte_swap_16((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+#if defined(EPR_SIMD_NEON)
+    if ((epr_api.cpu_features & EPR_CPU_NEON) != 0) {
+        neon_byte_swap_16((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+    scalar_byte_swap_16((uchar*) buffer, number_of_swaps);
+}
+
+void epr_byte_swap_32(void* buffer, uint number_of_swaps)
+{
+#if defined(EPR_SIMD_AVX2)
+    if ((epr_api.cpu_features & EPR_CPU_AVX2) != 0) {
+        avx2_byte_swap_32((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+#if defined(EPR_SIMD_X86)
+    if ((epr_api.cpu_features & EPR_CPU_SSE2) != 0) {
+        sse2_byte_swap_32((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+#if defined(EPR_SIMD_NEON)
+    if ((epr_api.cpu_features & EPR_CPU_NEON) != 0) {
+        neon_byte_swap_32((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+    scalar_byte_swap_32((uchar*) buffer, number_of_swaps);
+}
+
+void epr_byte_swap_64(void* buffer, uint number_of_swaps)
+{
+#if defined(EPR_SIMD_AVX2)
+    if ((epr_api.cpu_features & EPR_CPU_AVX2) != 0) {
+        avx2_byte_swap_64((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+#if defined(EPR_SIMD_X86)
+    if ((epr_api.cpu_features & EPR_CPU_SSE2) != 0) {
+        sse2_byte_swap_64((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+#if defined(EPR_SIMD_NEON)
+    if ((epr_api.cpu_features & EPR_CPU_NEON) != 0) {
+        neon_byte_swap_64((uchar*) buffer, number_of_swaps);
+        return;
+    }
+#endif
+    scalar_byte_swap_64((uchar*) buffer, number_of_swaps);
+}
+
+
+
+/******************************************************************
+ * Tie point interpolation
+ */
+
+/* the additions and multiplications are done in the order of epr_interpolate2D() */
+static void scalar_interpolate_tie_point_line(const float* p0, const float* dy, const float* dxy,
+                                              const float* wx, float wy, uint n, float* dst)
+{
+    uint i;
+    for (i = 0; i < n; i++) {
+        dst[i] = p0[i] + wy * dy[i] + wx[i] * wy * dxy[i];
+    }
+}
+
+#if defined(EPR_SIMD_X86)
+
+static uint sse2_interpolate_tie_point_line(const float* p0, const float* dy, const float* dxy,
+                                            const float* wx, float wy, uint n, float* dst)
+{
+    __m128 vwy = _mm_set1_ps(wy);
+    uint i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_add_ps(_mm_loadu_ps(p0 + i), _mm_mul_ps(vwy, _mm_loadu_ps(dy + i)));
+        __m128 w = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(wx + i), vwy), _mm_loadu_ps(dxy + i));
+        _mm_storeu_ps(dst + i, _mm_add_ps(v, w));
+    }
+    return i;
+}
+
+#endif /* EPR_SIMD_X86 */
+
+#if defined(EPR_SIMD_AVX2)
+
+EPR_TARGET_AVX2
+static uint avx2_interpolate_tie_point_line(const float* p0, const float* dy, const float* dxy,
+                                            const float* wx, float wy, uint n, float* dst)
+{
+    __m256 vwy = _mm256_set1_ps(wy);
+    uint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_add_ps(_mm256_loadu_ps(p0 + i), _mm256_mul_ps(vwy, _mm256_loadu_ps(dy + i)));
+        __m256 w = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(wx + i), vwy), _mm256_loadu_ps(dxy + i));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(v, w));
+    }
+    return i;
+}
+
+#endif /* EPR_SIMD_AVX2 */
+
+#if defined(EPR_SIMD_NEON)
+
+/* no vmlaq_f32/vfmaq_f32, the products must be rounded like the scalar ones */
+static uint neon_interpolate_tie_point_line(const float* p0, const float* dy, const float* dxy,
+                                            const float* wx, float wy, uint n, float* dst)
+{
+    float32x4_t vwy = vdupq_n_f32(wy);
+    uint i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vaddq_f32(vld1q_f32(p0 + i), vmulq_f32(vwy, vld1q_f32(dy + i)));
+        float32x4_t w = vmulq_f32(vmulq_f32(vld1q_f32(wx + i), vwy), vld1q_f32(dxy + i));
+        vst1q_f32(dst + i, vaddq_f32(v, w));
+    }
+    return i;
+}
+
+#endif /* EPR_SIMD_NEON */
+
+void epr_interpolate_tie_point_line(const float* p0,
+                                    const float* dy,
+                                    const float* dxy,
+                                    const float* wx,
+                                    float wy,
+                                    uint n,
+                                    float* dst)
+{
+    uint i = 0;
+#if defined(EPR_SIMD_AVX2)
+    if ((epr_api.cpu_features & EPR_CPU_AVX2) != 0) {
+        i = avx2_interpolate_tie_point_line(p0, dy, dxy, wx, wy, n, dst);
+    }
+#endif
+#if defined(EPR_SIMD_X86)
+    if ((epr_api.cpu_features & EPR_CPU_SSE2) != 0) {
+        i += sse2_interpolate_tie_point_line(p0 + i, dy + i, dxy + i, wx + i, wy, n - i, dst + i);
+    }
+#endif
+#if defined(EPR_SIMD_NEON)
+    if ((epr_api.cpu_features & EPR_CPU_NEON) != 0) {
+        i = neon_interpolate_tie_point_line(p0, dy, dxy, wx, wy, n, dst);
+    }
+#endif
+    scalar_interpolate_tie_point_line(p0 + i, dy + i, dxy + i, wx + i, wy, n - i, dst + i);
+}
+
+EPR_FLineDecoder epr_select_simd_line_decoder(EPR_FLineDecoder decode_func, uint cpu_features)
+{
+#if defined(EPR_SIMD_X86) || defined(EPR_SIMD_NEON)
+    if (cpu_features != 0) {
+        if (decode_func == decode_line_uchar_1_of_1_to_uchar)
+            return copy_decode_line_uchar_1_of_1_to_uchar;
+        if (decode_func == decode_line_ushort_1_of_1_to_ushort)
+            return copy_decode_line_ushort_1_of_1_to_ushort;
+    }
+#endif
+
+#if defined(EPR_SIMD_AVX2)
+    if ((cpu_features & EPR_CPU_AVX2) != 0) {
+        if (decode_func == decode_line_uchar_1_of_1_to_float)
+            return avx2_decode_line_uchar_1_of_1_to_float;
+        if (decode_func == decode_line_char_1_of_1_to_float)
+            return avx2_decode_line_char_1_of_1_to_float;
+        if (decode_func == decode_line_ushort_1_of_1_to_float)
+            return avx2_decode_line_ushort_1_of_1_to_float;
+        if (decode_func == decode_line_short_1_of_1_to_float)
+            return avx2_decode_line_short_1_of_1_to_float;
+        if (decode_func == decode_line_short_1_of_2_to_float)
+            return avx2_decode_line_short_1_of_2_to_float;
+        if (decode_func == decode_line_short_2_of_2_to_float)
+            return avx2_decode_line_short_2_of_2_to_float;
+        if (decode_func == decode_line_uchar_1_of_2_to_float)
+            return avx2_decode_line_uchar_1_of_2_to_float;
+        if (decode_func == decode_line_uchar_2_of_2_to_float)
+            return avx2_decode_line_uchar_2_of_2_to_float;
+        if (decode_func == decode_line_uchar_2_to_f_to_float)
+            return avx2_decode_line_uchar_2_to_f_to_float;
+        if (decode_func == decode_line_uchar_3_to_i_to_uint)
+            return avx2_decode_line_uchar_3_to_i_to_uint;
+        if (decode_func == decode_line_ushort_1_of_1_be_to_float)
+            return avx2_decode_line_ushort_1_of_1_be_to_float;
+        if (decode_func == decode_line_short_1_of_1_be_to_float)
+            return avx2_decode_line_short_1_of_1_be_to_float;
+        if (decode_func == decode_line_short_1_of_2_be_to_float)
+            return avx2_decode_line_short_1_of_2_be_to_float;
+        if (decode_func == decode_line_short_2_of_2_be_to_float)
+            return avx2_decode_line_short_2_of_2_be_to_float;
+    }
+#endif
+
+#if defined(EPR_SIMD_X86)
+    if ((cpu_features & EPR_CPU_SSE2) != 0) {
+        if (decode_func == decode_line_uchar_1_of_1_to_float)
+            return sse2_decode_line_uchar_1_of_1_to_float;
+        if (decode_func == decode_line_char_1_of_1_to_float)
+            return sse2_decode_line_char_1_of_1_to_float;
+        if (decode_func == decode_line_ushort_1_of_1_to_float)
+            return sse2_decode_line_ushort_1_of_1_to_float;
+        if (decode_func == decode_line_short_1_of_1_to_float)
+            return sse2_decode_line_short_1_of_1_to_float;
+        if (decode_func == decode_line_short_1_of_2_to_float)
+            return sse2_decode_line_short_1_of_2_to_float;
+        if (decode_func == decode_line_short_2_of_2_to_float)
+            return sse2_decode_line_short_2_of_2_to_float;
+        if (decode_func == decode_line_uchar_1_of_2_to_float)
+            return sse2_decode_line_uchar_1_of_2_to_float;
+        if (decode_func == decode_line_uchar_2_of_2_to_float)
+            return sse2_decode_line_uchar_2_of_2_to_float;
+        if (decode_func == decode_line_uchar_2_to_f_to_float)
+            return sse2_decode_line_uchar_2_to_f_to_float;
+        if (decode_func == decode_line_uchar_1_of_2_to_uchar)
+            return sse2_decode_line_uchar_1_of_2_to_uchar;
+        if (decode_func == decode_line_uchar_2_of_2_to_uchar)
+            return sse2_decode_line_uchar_2_of_2_to_uchar;
+        if (decode_func == decode_line_ushort_1_of_1_be_to_float)
+            return sse2_decode_line_ushort_1_of_1_be_to_float;
+        if (decode_func == decode_line_short_1_of_1_be_to_float)
+            return sse2_decode_line_short_1_of_1_be_to_float;
+        if (decode_func == decode_line_short_1_of_2_be_to_float)
+            return sse2_decode_line_short_1_of_2_be_to_float;
+        if (decode_func == decode_line_short_2_of_2_be_to_float)
+            return sse2_decode_line_short_2_of_2_be_to_float;
+        if (decode_func == decode_line_ushort_1_of_1_be_to_ushort)
+            return sse2_decode_line_ushort_1_of_1_be_to_ushort;
+    }
+#endif
+
+#if defined(EPR_SIMD_NEON)
+    if ((cpu_features & EPR_CPU_NEON) != 0) {
+        if (decode_func == decode_line_uchar_1_of_1_to_float)
+            return neon_decode_line_uchar_1_of_1_to_float;
+        if (decode_func == decode_line_char_1_of_1_to_float)
+            return neon_decode_line_char_1_of_1_to_float;
+        if (decode_func == decode_line_ushort_1_of_1_to_float)
+            return neon_decode_line_ushort_1_of_1_to_float;
+        if (decode_func == decode_line_short_1_of_1_to_float)
+            return neon_decode_line_short_1_of_1_to_float;
+        if (decode_func == decode_line_short_1_of_2_to_float)
+            return neon_decode_line_short_1_of_2_to_float;
+        if (decode_func == decode_line_short_2_of_2_to_float)
+            return neon_decode_line_short_2_of_2_to_float;
+        if (decode_func == decode_line_uchar_1_of_2_to_float)
+            return neon_decode_line_uchar_1_of_2_to_float;
+        if (decode_func == decode_line_uchar_2_of_2_to_float)
+            return neon_decode_line_uchar_2_of_2_to_float;
+        if (decode_func == decode_line_uchar_2_to_f_to_float)
+            return neon_decode_line_uchar_2_to_f_to_float;
+        if (decode_func == decode_line_uchar_3_to_i_to_uint)
+            return neon_decode_line_uchar_3_to_i_to_uint;
+        if (decode_func == decode_line_uchar_1_of_2_to_uchar)
+            return neon_decode_line_uchar_1_of_2_to_uchar;
+        if (decode_func == decode_line_uchar_2_of_2_to_uchar)
+            return neon_decode_line_uchar_2_of_2_to_uchar;
+        if (decode_func == decode_line_ushort_1_of_1_be_to_float)
+            return neon_decode_line_ushort_1_of_1_be_to_float;
+        if (decode_func == decode_line_short_1_of_1_be_to_float)
+            return neon_decode_line_short_1_of_1_be_to_float;
+        if (decode_func == decode_line_short_1_of_2_be_to_float)
+            return neon_decode_line_short_1_of_2_be_to_float;
+        if (decode_func == decode_line_short_2_of_2_be_to_float)
+            return neon_decode_line_short_2_of_2_be_to_float;
+        if (decode_func == decode_line_ushort_1_of_1_be_to_ushort)
+            return neon_decode_line_ushort_1_of_1_be_to_ushort;
+    }
+#endif
+
+    return decode_func;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef EPR_SIMD_H_INCL
+#define EPR_SIMD_H_INCL
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "epr_api.h"
+#include "epr_band.h"
+
+
+/* CPU feature flags as returned by epr_detect_cpu_features() */
+#define EPR_CPU_SSE2    0x0001
+#define EPR_CPU_AVX2    0x0002
+#define EPR_CPU_NEON    0x0004
+
+
+/**
+ * Determines the SIMD instruction sets which can be used by the line
+ * decoders on the running CPU. Only instruction sets for which this
+ * library has been compiled with SIMD decoders are reported.
+ *
+ * @return a combination of the <code>EPR_CPU_</code> flags, zero if
+ *         only the scalar decoders can be used
+ */
+uint epr_detect_cpu_features(void);
+
+/**
+ * Gets the SIMD variant of the given scalar line decoder.
+ *
+ * <p>The SIMD decoders produce bit-identical results to the scalar ones.
+ * They fall back to the scalar decoder for log-scaled bands and for the
+ * pixels remaining after the last full vector.
+ *
+ * @param decode_func the scalar line decoder as selected by
+ *        <code>select_line_decode_function</code>
+ * @param cpu_features the usable instruction sets, see
+ *        <code>epr_detect_cpu_features</code>
+ * @return the fastest decoder for the given instruction sets, or
+ *         <code>decode_func</code> itself if there is no SIMD variant
+ */
+EPR_FLineDecoder epr_select_simd_line_decoder(EPR_FLineDecoder decode_func, uint cpu_features);
+
+/**
+ * Swaps the bytes within <code>number_of_swaps</code> two-, four- or
+ * eight-byte words starting at address <code>buffer</code>. The fastest
+ * kernel for the instruction sets found by <code>epr_init_api</code> is used.
+ *
+ * @param buffer the words to be converted
+ * @param number_of_swaps the number of words to convert
+ */
+/*@{*/
+void epr_byte_swap_16(void* buffer, uint number_of_swaps);
+void epr_byte_swap_32(void* buffer, uint number_of_swaps);
+void epr_byte_swap_64(void* buffer, uint number_of_swaps);
+/*@}*/
+
+/**
+ * Computes a line of bilinearly interpolated tie point values from the
+ * column terms of <code>epr_interpolate2D</code>, i.e.
+ * <code>dst[i] = p0[i] + wy * dy[i] + wx[i] * wy * dxy[i]</code>.
+ * The fastest kernel for the instruction sets found by
+ * <code>epr_init_api</code> is used, all kernels give bit-identical results.
+ *
+ * @param p0 the values interpolated along the row "before" the line
+ * @param dy the differences between the rows "after" and "before" the line
+ * @param dxy the mixed differences of the tie point cells
+ * @param wx the horizontal weights of the raster columns
+ * @param wy the vertical weight of the line
+ * @param n the number of raster columns
+ * @param dst the interpolated values
+ */
+void epr_interpolate_tie_point_line(const float* p0,
+                                    const float* dy,
+                                    const float* dxy,
+                                    const float* wx,
+                                    float wy,
+                                    uint n,
+                                    float* dst);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EPR_SIMD_H_INCL */
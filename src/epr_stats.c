@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_band.h"
+#include "epr_bitmask.h"
+
+
+/* the number of raster lines read at once while computing band statistics */
+#define EPR_STATS_CHUNK_HEIGHT 64
+
+/**
+ * The sums accumulated while computing band statistics. The values are
+ * shifted by the first valid value to keep the variance accurate.
+ */
+typedef struct EPR_StatsSums {
+    double shift;
+    double sum;
+    double sum_sq;
+} EPR_SStatsSums;
+
+
+static void epr_add_to_histogram(EPR_SBandStats* stats, double value)
+{
+    double range = stats->hist_max - stats->hist_min;
+    uint bin;
+
+    if (value < stats->hist_min || value > stats->hist_max) {
+        return;
+    }
+    bin = range > 0.0 ? (uint) ((value - stats->hist_min) / range * stats->num_bins) : 0;
+    if (bin >= stats->num_bins) {
+        bin = stats->num_bins - 1;
+    }
+    stats->histogram[bin]++;
+}
+
+
+/**
+ * Reads the band a chunk of lines at a time and adds its valid pixels to the
+ * statistics, to the histogram or to both.
+ */
+static int epr_scan_band_stats(EPR_SBandId* band_id,
+                               uint step,
+                               EPR_SBandStats* stats,
+                               EPR_SStatsSums* sums,
+                               epr_boolean with_histogram)
+{
+    EPR_SProductId* product_id = band_id->product_id;
+    uint scene_width = epr_get_scene_width(product_id);
+    uint scene_height = epr_get_scene_height(product_id);
+    uint chunk_height = EPR_STATS_CHUNK_HEIGHT * step;
+    EPR_SRaster* raster;
+    EPR_SRaster* bm_raster = NULL;
+    EPR_SRaster window;
+    EPR_SRaster bm_window;
+    uint chunk_y, x, y;
+    double value;
+    int errcode = e_err_none;
+
+    if (chunk_height > scene_height) {
+        chunk_height = scene_height;
+    }
+    raster = epr_create_compatible_raster(band_id, scene_width, chunk_height, step, step);
+    if (raster == NULL) {
+        return epr_get_last_err_code();
+    }
+    if (band_id->bm_expr != NULL) {
+        bm_raster = epr_create_raster(e_tid_uchar, scene_width, chunk_height, step, step);
+        if (bm_raster == NULL) {
+            epr_free_raster(raster);
+            return epr_get_last_err_code();
+        }
+    }
+
+    for (chunk_y = 0; chunk_y < scene_height; chunk_y += chunk_height) {
+        window = *raster;
+        if (scene_height - chunk_y < chunk_height) {
+            window.source_height = scene_height - chunk_y;
+            window.raster_height = (window.source_height - 1) / step + 1;
+        }
+        /* the band's bit-mask is evaluated once, below, and its invalid pixels are skipped */
+        if (epr_read_band_raster_unmasked(band_id, 0, (int) chunk_y, &window) != e_err_none) {
+            errcode = epr_get_last_err_code();
+            break;
+        }
+        if (bm_raster != NULL) {
+            bm_window = *bm_raster;
+            bm_window.source_height = window.source_height;
+            bm_window.raster_height = window.raster_height;
+            if (epr_read_bitmask_raster(product_id, band_id->bm_expr, 0, (int) chunk_y, &bm_window) != e_err_none) {
+                errcode = epr_get_last_err_code();
+                break;
+            }
+        }
+        for (y = 0; y < window.raster_height; y++) {
+            const uchar* mask = bm_raster != NULL ? (const uchar*) bm_raster->buffer + y * window.raster_width : NULL;
+            for (x = 0; x < window.raster_width; x++) {
+                value = epr_get_pixel_as_double(&window, (int) x, (int) y);
+                if ((mask != NULL && mask[x] == 0) || value != value) {
+                    continue;
+                }
+                if (sums != NULL) {
+                    if (stats->num_valid == 0) {
+                        stats->min = stats->max = sums->shift = value;
+                    } else if (value < stats->min) {
+                        stats->min = value;
+                    } else if (value > stats->max) {
+                        stats->max = value;
+                    }
+                    sums->sum += value - sums->shift;
+                    sums->sum_sq += (value - sums->shift) * (value - sums->shift);
+                    stats->num_valid++;
+                }
+                if (with_histogram) {
+                    epr_add_to_histogram(stats, value);
+                }
+            }
+        }
+        if (sums != NULL) {
+            stats->num_pixels += window.raster_width * window.raster_height;
+        }
+    }
+
+    epr_free_raster(bm_raster);
+    epr_free_raster(raster);
+    return errcode;
+}
+
+
+EPR_SBandStats* epr_compute_band_stats(EPR_SBandId* band_id,
+                                       uint step,
+                                       uint num_bins,
+                                       double hist_min,
+                                       double hist_max)
+{
+    EPR_SBandStats* stats;
+    EPR_SStatsSums sums;
+    epr_boolean range_given = hist_min < hist_max;
+    double variance;
+
+    epr_clear_err();
+
+    if (band_id == NULL) {
+        epr_set_err(e_err_invalid_band,
+                    "epr_compute_band_stats: band_id must not be NULL");
+        return NULL;
+    }
+    if (step == 0) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_compute_band_stats: step must not be zero");
+        return NULL;
+    }
+
+    stats = (EPR_SBandStats*) calloc(1, sizeof (EPR_SBandStats));
+    if (stats == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_compute_band_stats: out of memory");
+        return NULL;
+    }
+    if (num_bins > 0) {
+        stats->histogram = (uint*) calloc(num_bins, sizeof (uint));
+        if (stats->histogram == NULL) {
+            free(stats);
+            epr_set_err(e_err_out_of_memory, "epr_compute_band_stats: out of memory");
+            return NULL;
+        }
+        stats->num_bins = num_bins;
+        stats->hist_min = hist_min;
+        stats->hist_max = hist_max;
+    }
+
+    sums.shift = 0.0;
+    sums.sum = 0.0;
+    sums.sum_sq = 0.0;
+    if (epr_scan_band_stats(band_id, step, stats, &sums, num_bins > 0 && range_given) != e_err_none) {
+        epr_free_band_stats(stats);
+        return NULL;
+    }
+    if (stats->num_valid > 0) {
+        stats->mean = sums.shift + sums.sum / stats->num_valid;
+        variance = (sums.sum_sq - sums.sum * sums.sum / stats->num_valid) / stats->num_valid;
+        stats->stddev = variance > 0.0 ? sqrt(variance) : 0.0;
+    }
+
+    /* without a given range the histogram needs the range of the pixels first */
+    if (num_bins > 0 && !range_given && stats->num_valid > 0) {
+        stats->hist_min = stats->min;
+        stats->hist_max = stats->max;
+        if (epr_scan_band_stats(band_id, step, stats, NULL, TRUE) != e_err_none) {
+            epr_free_band_stats(stats);
+            return NULL;
+        }
+    }
+    return stats;
+}
+
+
+void epr_free_band_stats(EPR_SBandStats* stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    free(stats->histogram);
+    free(stats);
+}
+
+
+/**
+ * Counts the pixels of a line of flag values having the given flag set, a
+ * word of pixels at a time, and stores the packed flags in the given words
+ * unless they are <code>NULL</code>.
+ */
+static uint epr_count_flag_line(const uint* values, uint width, uint bit_mask, ulong* words)
+{
+    uint count = 0;
+    uint x, x0, n;
+    ulong word;
+
+    for (x0 = 0; x0 < width; x0 += EPR_BITMASK_WORD_BITS) {
+        n = width - x0 < EPR_BITMASK_WORD_BITS ? width - x0 : EPR_BITMASK_WORD_BITS;
+        word = 0;
+        for (x = 0; x < n; x++) {
+            word |= (ulong) ((values[x0 + x] & bit_mask) == bit_mask) << x;
+        }
+        count += epr_count_bits(word);
+        if (words != NULL) {
+            words[x0 / EPR_BITMASK_WORD_BITS] = word;
+        }
+    }
+    return count;
+}
+
+
+EPR_SFlagStats* epr_compute_flag_stats(EPR_SBandId* band_id, uint step, epr_boolean with_bitplanes)
+{
+    EPR_SFlagStats* stats;
+    EPR_SRaster* raster = NULL;
+    EPR_SRaster window;
+    epr_boolean raw;
+    uint scene_width, scene_height, chunk_height, chunk_y, y, f, row;
+    int errcode = e_err_none;
+
+    epr_clear_err();
+
+    if (band_id == NULL) {
+        epr_set_err(e_err_invalid_band,
+                    "epr_compute_flag_stats: band_id must not be NULL");
+        return NULL;
+    }
+    if (band_id->flag_coding == NULL || band_id->flag_coding->length == 0) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_compute_flag_stats: the band has no flag coding");
+        return NULL;
+    }
+    if (step == 0) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_compute_flag_stats: step must not be zero");
+        return NULL;
+    }
+
+    stats = (EPR_SFlagStats*) calloc(1, sizeof (EPR_SFlagStats));
+    if (stats == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_compute_flag_stats: out of memory");
+        return NULL;
+    }
+    stats->num_flags = band_id->flag_coding->length;
+    stats->flags = (const EPR_SFlagDef**) calloc(stats->num_flags, sizeof (EPR_SFlagDef*));
+    stats->counts = (uint*) calloc(stats->num_flags, sizeof (uint));
+    if (with_bitplanes) {
+        stats->bitplanes = (EPR_SRaster**) calloc(stats->num_flags, sizeof (EPR_SRaster*));
+    }
+    if (stats->flags == NULL || stats->counts == NULL || (with_bitplanes && stats->bitplanes == NULL)) {
+        epr_free_flag_stats(stats);
+        epr_set_err(e_err_out_of_memory, "epr_compute_flag_stats: out of memory");
+        return NULL;
+    }
+
+    scene_width = epr_get_scene_width(band_id->product_id);
+    scene_height = epr_get_scene_height(band_id->product_id);
+    for (f = 0; f < stats->num_flags; f++) {
+        stats->flags[f] = (const EPR_SFlagDef*) epr_get_ptr_array_elem_at(band_id->flag_coding, f);
+        if (with_bitplanes) {
+            stats->bitplanes[f] = epr_create_packed_bitmask_raster(scene_width, scene_height, step, step);
+            if (stats->bitplanes[f] == NULL) {
+                epr_free_flag_stats(stats);
+                return NULL;
+            }
+        }
+    }
+
+    chunk_height = EPR_STATS_CHUNK_HEIGHT * step;
+    if (chunk_height > scene_height) {
+        chunk_height = scene_height;
+    }
+    /* the flag words are decoded straight into uint, measurement bands without
+     * applying their bit-mask expression */
+    raster = epr_create_raster(e_tid_uint, scene_width, chunk_height, step, step);
+    if (raster == NULL) {
+        epr_free_flag_stats(stats);
+        return NULL;
+    }
+    raw = strcmp(band_id->dataset_ref.dataset_id->dsd->ds_type, "M") == 0;
+
+    row = 0;
+    for (chunk_y = 0; chunk_y < scene_height; chunk_y += chunk_height) {
+        window = *raster;
+        if (scene_height - chunk_y < chunk_height) {
+            window.source_height = scene_height - chunk_y;
+            window.raster_height = (window.source_height - 1) / step + 1;
+        }
+        if ((raw ? epr_read_band_raw_raster(band_id, 0, (int) chunk_y, &window)
+                 : epr_read_band_raster(band_id, 0, (int) chunk_y, &window)) != e_err_none) {
+            errcode = epr_get_last_err_code();
+            break;
+        }
+        for (y = 0; y < window.raster_height; y++, row++) {
+            for (f = 0; f < stats->num_flags; f++) {
+                ulong* words = NULL;
+                if (with_bitplanes) {
+                    words = (ulong*) stats->bitplanes[f]->buffer + row * EPR_BITMASK_LINE_WORDS(window.raster_width);
+                }
+                stats->counts[f] += epr_count_flag_line((const uint*) window.buffer + y * window.raster_width, window.raster_width,
+                                                        stats->flags[f]->bit_mask, words);
+            }
+        }
+        stats->num_pixels += window.raster_width * window.raster_height;
+    }
+
+    epr_free_raster(raster);
+    if (errcode != e_err_none) {
+        epr_free_flag_stats(stats);
+        return NULL;
+    }
+    return stats;
+}
+
+
+void epr_free_flag_stats(EPR_SFlagStats* stats)
+{
+    uint f;
+
+    if (stats == NULL) {
+        return;
+    }
+    for (f = 0; stats->bitplanes != NULL && f < stats->num_flags; f++) {
+        epr_free_raster(stats->bitplanes[f]);
+    }
+    free(stats->bitplanes);
+    free((void*) stats->flags);
+    free(stats->counts);
+    free(stats);
+}
@@ -24,6 +24,7 @@
 #include "epr_api.h"
 #include "epr_core.h"
 #include "epr_field.h"
+#include "epr_simd.h"
 
 
 /*
@@ -42,13 +43,7 @@
  */
 void byte_swap_short(short *buffer, uint number_of_swaps)
 {
-   short* temp = buffer;
-   uint swap_loop;
-
-   for (swap_loop = 0, temp = buffer; swap_loop < number_of_swaps; swap_loop++, temp++) {
-      *temp = (short)(((*temp & 0x00ff) << 8) |
-                      ((*temp & 0xff00) >> 8));
-   }
+   epr_byte_swap_16(buffer, number_of_swaps);
 }
 
 
@@ -64,15 +59,7 @@ void byte_swap_short(short *buffer, uint number_of_swaps)
  */
 void byte_swap_int(int *buffer, uint number_of_swaps)
 {
-   int *temp = buffer;
-   uint swap_loop;
-
-   for (swap_loop = 0, temp = buffer; swap_loop < number_of_swaps; swap_loop++, temp++) {
-      *temp = ((*temp & 0x000000ff) << 24) |
-              ((*temp & 0x0000ff00) << 8)  |
-              ((*temp & 0x00ff0000) >> 8)  |
-              ((*temp & 0xff000000) >> 24);
-   }
+   epr_byte_swap_32(buffer, number_of_swaps);
 }
 
 
@@ -133,6 +120,25 @@ void byte_swap_float(float* buffer, uint number_of_swaps)
    byte_swap_int((int*) buffer, number_of_swaps);
 }
 
+/*
+ *  Function: byte_swap_double.c
+ */
+/**
+ *
+ * Swaps bytes within NUMBER_OF_SWAPS eight-byte words,
+ *     starting at address BUFFER.
+ *
+ * @param buffer the one element typed buffer
+ * to convert for a little endian order machine
+ *
+ * @param number_of_swaps number of elements to convert
+ *
+ */
+void byte_swap_double(double* buffer, uint number_of_swaps)
+{
+   epr_byte_swap_64(buffer, number_of_swaps);
+}
+
 /**
  * A boolean value indicating whether this code run's on a
  * little endian order machine or not.
@@ -219,8 +225,7 @@ void epr_swap_endian_order(const EPR_SField* field)
             byte_swap_float((float*) field->elems, field->info->num_elems);
             break;
         case e_tid_double:
-            epr_set_err(e_err_invalid_data_format,
-                    "epr_swap_endian_order: DOUBLE type was not yet processed");
+            byte_swap_double((double*) field->elems, field->info->num_elems);
             break;
         default:
             epr_set_err(e_err_invalid_data_format,
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/* recursive pthread mutexes are XSI, not ANSI-C */
+#if !defined(WIN32) && !defined(EPR_NO_THREADS) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <stdlib.h>
+
+#if defined(EPR_NO_THREADS)
+/* no locking at all */
+#elif defined(WIN32)
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_thread.h"
+
+
+struct EPR_Mutex {
+#if defined(EPR_NO_THREADS)
+    int unused;
+#elif defined(WIN32)
+    /* critical sections are recursive */
+    CRITICAL_SECTION section;
+#else
+    pthread_mutex_t mutex;
+#endif
+};
+
+
+EPR_SMutex* epr_create_mutex(void)
+{
+    EPR_SMutex* mutex = (EPR_SMutex*) calloc(1, sizeof (EPR_SMutex));
+
+    if (mutex == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_create_mutex: out of memory");
+        return NULL;
+    }
+#if defined(EPR_NO_THREADS)
+    /* nothing to do */
+#elif defined(WIN32)
+    InitializeCriticalSection(&mutex->section);
+#else
+    {
+        pthread_mutexattr_t attr;
+        int failed = pthread_mutexattr_init(&attr) != 0;
+        if (!failed) {
+            failed = pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0
+                     || pthread_mutex_init(&mutex->mutex, &attr) != 0;
+            pthread_mutexattr_destroy(&attr);
+        }
+        if (failed) {
+            free(mutex);
+            epr_set_err(e_err_out_of_memory, "epr_create_mutex: failed to create mutex");
+            return NULL;
+        }
+    }
+#endif
+    return mutex;
+}
+
+
+void epr_free_mutex(EPR_SMutex* mutex)
+{
+    if (mutex == NULL) {
+        return;
+    }
+#if defined(EPR_NO_THREADS)
+    /* nothing to do */
+#elif defined(WIN32)
+    DeleteCriticalSection(&mutex->section);
+#else
+    pthread_mutex_destroy(&mutex->mutex);
+#endif
+    free(mutex);
+}
+
+
+void epr_lock_mutex(EPR_SMutex* mutex)
+{
+    if (mutex == NULL) {
+        return;
+    }
+#if defined(EPR_NO_THREADS)
+    /* nothing to do */
+#elif defined(WIN32)
+    EnterCriticalSection(&mutex->section);
+#else
+    pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+
+void epr_unlock_mutex(EPR_SMutex* mutex)
+{
+    if (mutex == NULL) {
+        return;
+    }
+#if defined(EPR_NO_THREADS)
+    /* nothing to do */
+#elif defined(WIN32)
+    LeaveCriticalSection(&mutex->section);
+#else
+    pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+
+struct EPR_Condition {
+#if defined(EPR_NO_THREADS)
+    int unused;
+#elif defined(WIN32)
+    CONDITION_VARIABLE variable;
+#else
+    pthread_cond_t variable;
+#endif
+};
+
+
+EPR_SCondition* epr_create_condition(void)
+{
+    EPR_SCondition* condition = (EPR_SCondition*) calloc(1, sizeof (EPR_SCondition));
+
+    if (condition == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_create_condition: out of memory");
+        return NULL;
+    }
+#if defined(EPR_NO_THREADS)
+    /* nothing to do */
+#elif defined(WIN32)
+    InitializeConditionVariable(&condition->variable);
+#else
+    if (pthread_cond_init(&condition->variable, NULL) != 0) {
+        free(condition);
+        epr_set_err(e_err_out_of_memory, "epr_create_condition: failed to create condition variable");
+        return NULL;
+    }
+#endif
+    return condition;
+}
+
+
+void epr_free_condition(EPR_SCondition* condition)
+{
+    if (condition == NULL) {
+        return;
+    }
+#if !defined(EPR_NO_THREADS) && !defined(WIN32)
+    pthread_cond_destroy(&condition->variable);
+#endif
+    free(condition);
+}
+
+
+void epr_wait_condition(EPR_SCondition* condition, EPR_SMutex* mutex)
+{
+#if defined(EPR_NO_THREADS)
+    /* there is no other thread to wait for */
+    (void) condition;
+    (void) mutex;
+#elif defined(WIN32)
+    SleepConditionVariableCS(&condition->variable, &mutex->section, INFINITE);
+#else
+    pthread_cond_wait(&condition->variable, &mutex->mutex);
+#endif
+}
+
+
+void epr_signal_condition(EPR_SCondition* condition)
+{
+#if defined(EPR_NO_THREADS)
+    (void) condition;
+#elif defined(WIN32)
+    WakeAllConditionVariable(&condition->variable);
+#else
+    pthread_cond_broadcast(&condition->variable);
+#endif
+}
+
+
+/* the tasks of an epr_run_tasks call shared by its threads */
+typedef struct EPR_TaskQueue {
+    EPR_FTask task;
+    void** task_data;
+    uint num_tasks;
+    uint next_task;
+    EPR_SMutex* mutex;
+} EPR_STaskQueue;
+
+
+/* runs the tasks of the queue until none is left */
+static void epr_work_on_tasks(EPR_STaskQueue* queue)
+{
+    uint task_index;
+
+    for (;;) {
+        epr_lock_mutex(queue->mutex);
+        task_index = queue->next_task;
+        if (task_index < queue->num_tasks) {
+            queue->next_task++;
+        }
+        epr_unlock_mutex(queue->mutex);
+        if (task_index >= queue->num_tasks) {
+            return;
+        }
+        queue->task(queue->task_data[task_index]);
+    }
+}
+
+
+#if defined(EPR_NO_THREADS)
+/* no threads at all */
+#elif defined(WIN32)
+static unsigned __stdcall epr_task_thread(void* arg)
+{
+    epr_work_on_tasks((EPR_STaskQueue*) arg);
+    return 0;
+}
+#else
+static void* epr_task_thread(void* arg)
+{
+    epr_work_on_tasks((EPR_STaskQueue*) arg);
+    return NULL;
+}
+#endif
+
+
+void epr_run_tasks(EPR_FTask task, void** task_data, uint num_tasks, uint num_threads)
+{
+    EPR_STaskQueue queue;
+#if defined(EPR_NO_THREADS)
+    /* no threads at all */
+#elif defined(WIN32)
+    HANDLE* threads = NULL;
+    uint num_started = 0;
+#else
+    pthread_t* threads = NULL;
+    uint num_started = 0;
+#endif
+
+    queue.task = task;
+    queue.task_data = task_data;
+    queue.num_tasks = num_tasks;
+    queue.next_task = 0;
+    queue.mutex = NULL;
+
+    if (num_threads > num_tasks) {
+        num_threads = num_tasks;
+    }
+#if !defined(EPR_NO_THREADS)
+    if (num_threads > 1) {
+        queue.mutex = epr_create_mutex();
+        threads = calloc(num_threads - 1, sizeof (*threads));
+    }
+    if (queue.mutex != NULL && threads != NULL) {
+        for (num_started = 0; num_started < num_threads - 1; num_started++) {
+#if defined(WIN32)
+            threads[num_started] = (HANDLE) _beginthreadex(NULL, 0, epr_task_thread, &queue, 0, NULL);
+            if (threads[num_started] == 0) {
+                break;
+            }
+#else
+            if (pthread_create(&threads[num_started], NULL, epr_task_thread, &queue) != 0) {
+                break;
+            }
+#endif
+        }
+    }
+#endif
+
+    /* the calling thread works on the tasks as well, it runs all of them
+     * if no thread could be started */
+    epr_work_on_tasks(&queue);
+
+#if !defined(EPR_NO_THREADS)
+    while (num_started > 0) {
+        num_started--;
+#if defined(WIN32)
+        WaitForSingleObject(threads[num_started], INFINITE);
+        CloseHandle(threads[num_started]);
+#else
+        pthread_join(threads[num_started], NULL);
+#endif
+    }
+    free(threads);
+    epr_free_mutex(queue.mutex);
+#endif
+}
+
+
+struct EPR_Thread {
+#if defined(EPR_NO_THREADS)
+    int unused;
+#elif defined(WIN32)
+    HANDLE handle;
+#else
+    pthread_t thread;
+#endif
+    EPR_FTask task;
+    void* task_data;
+};
+
+
+#if defined(EPR_NO_THREADS)
+/* no threads at all */
+#elif defined(WIN32)
+static unsigned __stdcall epr_run_thread(void* arg)
+{
+    EPR_SThread* thread = (EPR_SThread*) arg;
+    thread->task(thread->task_data);
+    return 0;
+}
+#else
+static void* epr_run_thread(void* arg)
+{
+    EPR_SThread* thread = (EPR_SThread*) arg;
+    thread->task(thread->task_data);
+    return NULL;
+}
+#endif
+
+
+EPR_SThread* epr_start_thread(EPR_FTask task, void* task_data)
+{
+#if defined(EPR_NO_THREADS)
+    (void) task;
+    (void) task_data;
+    return NULL;
+#else
+    EPR_SThread* thread = (EPR_SThread*) calloc(1, sizeof (EPR_SThread));
+
+    if (thread == NULL) {
+        return NULL;
+    }
+    thread->task = task;
+    thread->task_data = task_data;
+#if defined(WIN32)
+    thread->handle = (HANDLE) _beginthreadex(NULL, 0, epr_run_thread, thread, 0, NULL);
+    if (thread->handle == 0) {
+        free(thread);
+        return NULL;
+    }
+#else
+    if (pthread_create(&thread->thread, NULL, epr_run_thread, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+#endif
+    return thread;
+#endif
+}
+
+
+void epr_join_thread(EPR_SThread* thread)
+{
+    if (thread == NULL) {
+        return;
+    }
+#if defined(WIN32)
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#elif !defined(EPR_NO_THREADS)
+    pthread_join(thread->thread, NULL);
+#endif
+    free(thread);
+}
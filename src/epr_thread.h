@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef EPR_THREAD_H_INCL
+#define EPR_THREAD_H_INCL
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "epr_api.h"
+
+
+/**
+ * A recursive mutual exclusion lock. The same thread may lock it
+ * several times, it must unlock it as many times.
+ * <p>If the library is compiled with <code>EPR_NO_THREADS</code> defined,
+ * all mutex functions do nothing.
+ */
+typedef struct EPR_Mutex EPR_SMutex;
+
+/**
+ * A condition variable, which lets threads wait for a change of the state
+ * guarded by a mutex.
+ */
+typedef struct EPR_Condition EPR_SCondition;
+typedef struct EPR_Thread EPR_SThread;
+
+
+/**
+ * Creates a new, unlocked mutex.
+ *
+ * @return the mutex or <code>NULL</code> if an error occurred
+ */
+EPR_SMutex* epr_create_mutex(void);
+
+/**
+ * Releases a mutex created by <code>epr_create_mutex</code>.
+ *
+ * @param mutex the mutex, can be <code>NULL</code>
+ */
+void epr_free_mutex(EPR_SMutex* mutex);
+
+/**
+ * Locks the given mutex, waiting until no other thread holds it.
+ *
+ * @param mutex the mutex, if <code>NULL</code> the function does nothing
+ */
+void epr_lock_mutex(EPR_SMutex* mutex);
+
+/**
+ * Unlocks the given mutex.
+ *
+ * @param mutex the mutex, if <code>NULL</code> the function does nothing
+ */
+void epr_unlock_mutex(EPR_SMutex* mutex);
+
+/**
+ * Creates a new condition variable.
+ *
+ * @return the condition variable or <code>NULL</code> if an error occurred
+ */
+EPR_SCondition* epr_create_condition(void);
+
+/**
+ * Releases a condition variable created by <code>epr_create_condition</code>.
+ *
+ * @param condition the condition variable, can be <code>NULL</code>
+ */
+void epr_free_condition(EPR_SCondition* condition);
+
+/**
+ * Unlocks the given mutex, waits until the condition variable is signalled
+ * and locks the mutex again. The mutex must be locked exactly once by the
+ * calling thread. The function may also return without a signal, so the
+ * caller must check the state it waits for again.
+ *
+ * @param condition the condition variable
+ * @param mutex the mutex guarding the state the caller waits for
+ */
+void epr_wait_condition(EPR_SCondition* condition, EPR_SMutex* mutex);
+
+/**
+ * Wakes up all threads waiting for the given condition variable.
+ *
+ * @param condition the condition variable
+ */
+void epr_signal_condition(EPR_SCondition* condition);
+
+/**
+ * Calls <code>task</code> once for each of the <code>num_tasks</code>
+ * elements of <code>task_data</code> on up to <code>num_threads</code>
+ * threads, the calling thread included, and returns when all calls have
+ * completed. The tasks are handed out in order to the next idle thread.
+ * <p>If threads cannot be started, or if the library is compiled with
+ * <code>EPR_NO_THREADS</code> defined, the remaining tasks are run by
+ * the calling thread.
+ *
+ * @param task the function to be called
+ * @param task_data the argument of each call
+ * @param num_tasks the number of calls
+ * @param num_threads the maximum number of threads to be used
+ */
+void epr_run_tasks(EPR_FTask task, void** task_data, uint num_tasks, uint num_threads);
+
+/**
+ * Starts a thread calling <code>task(task_data)</code> concurrently with
+ * the calling thread.
+ *
+ * @param task the function to be called
+ * @param task_data the argument of the call
+ * @return the thread or <code>NULL</code> if it could not be started, or if
+ *         the library is compiled with <code>EPR_NO_THREADS</code> defined
+ */
+EPR_SThread* epr_start_thread(EPR_FTask task, void* task_data);
+
+/**
+ * Waits until the task of the given thread has returned and releases the thread.
+ *
+ * @param thread the thread started by <code>epr_start_thread</code>, can be <code>NULL</code>
+ */
+void epr_join_thread(EPR_SThread* thread);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EPR_THREAD_H_INCL */
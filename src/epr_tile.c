@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epr_api.h"
+#include "epr_core.h"
+#include "epr_ptrarray.h"
+#include "epr_tile.h"
+#include "epr_thread.h"
+
+
+/* gets the tile cache of the given product, creating it if necessary */
+static EPR_STileCache* epr_get_tile_cache(EPR_SProductId* product_id)
+{
+    EPR_STileCache* cache = product_id->tile_cache;
+
+    if (cache != NULL) {
+        return cache;
+    }
+    cache = (EPR_STileCache*) calloc(1, sizeof (EPR_STileCache));
+    if (cache == NULL) {
+        epr_set_err(e_err_out_of_memory, "epr_get_tile_cache: out of memory");
+        return NULL;
+    }
+    cache->tile_width = EPR_DEFAULT_TILE_SIZE;
+    cache->tile_height = EPR_DEFAULT_TILE_SIZE;
+    cache->max_bytes = EPR_DEFAULT_TILE_CACHE_SIZE;
+    cache->entries = epr_create_ptr_array(16);
+    if (cache->entries == NULL) {
+        free(cache);
+        epr_set_err(e_err_out_of_memory, "epr_get_tile_cache: out of memory");
+        return NULL;
+    }
+    product_id->tile_cache = cache;
+    return cache;
+}
+
+
+/* releases least recently used tiles until the cache fits into the given size */
+static void epr_shrink_tile_cache(EPR_STileCache* cache, uint max_bytes)
+{
+    EPR_STileCacheEntry* entry;
+    uint i, lru_index;
+
+    while (cache->num_bytes > max_bytes && cache->entries->length > 0) {
+        lru_index = 0;
+        for (i = 1; i < cache->entries->length; i++) {
+            entry = (EPR_STileCacheEntry*) cache->entries->elems[i];
+            if (entry->last_use < ((EPR_STileCacheEntry*) cache->entries->elems[lru_index])->last_use) {
+                lru_index = i;
+            }
+        }
+        entry = (EPR_STileCacheEntry*) cache->entries->elems[lru_index];
+        cache->entries->length--;
+        cache->entries->elems[lru_index] = cache->entries->elems[cache->entries->length];
+        cache->num_bytes -= entry->num_bytes;
+        epr_free_raster(entry->raster);
+        free(entry);
+    }
+}
+
+
+static EPR_STileCacheEntry* epr_find_tile(EPR_STileCache* cache, EPR_SBandId* band_id, uint tile_x, uint tile_y)
+{
+    EPR_STileCacheEntry* entry;
+    uint i;
+
+    for (i = 0; i < cache->entries->length; i++) {
+        entry = (EPR_STileCacheEntry*) cache->entries->elems[i];
+        if (entry->band_id == band_id && entry->tile_x == tile_x && entry->tile_y == tile_y) {
+            entry->last_use = ++cache->use_clock;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Gets the range of the raster's elements taken from the scene pixels
+ * <code>first</code> to <code>first + count - 1</code> along one axis.
+ *
+ * @return <code>FALSE</code> if none of the pixels is taken
+ */
+static epr_boolean epr_get_tile_span(uint first, uint count,
+                                     uint offset, uint step, uint raster_size,
+                                     uint* raster_first, uint* raster_last)
+{
+    uint last = first + count - 1;
+
+    if (raster_size == 0 || last < offset) {
+        return FALSE;
+    }
+    *raster_first = first > offset ? (first - offset + step - 1) / step : 0;
+    *raster_last = (last - offset) / step;
+    if (*raster_last > raster_size - 1) {
+        *raster_last = raster_size - 1;
+    }
+    return *raster_first <= *raster_last;
+}
+
+
+/* copies the pixels of a tile taken by the raster */
+static void epr_copy_tile(const EPR_SRaster* tile, uint tile_offset_x, uint tile_offset_y,
+                          uint offset_x, uint offset_y, EPR_SRaster* raster)
+{
+    uint x_first, x_last, y_first, y_last, x, y;
+    uint elem_size = raster->elem_size;
+    const uchar* src_line;
+    uchar* dst;
+
+    if (!epr_get_tile_span(tile_offset_x, tile->raster_width, offset_x,
+                           raster->source_step_x, raster->raster_width, &x_first, &x_last)
+            || !epr_get_tile_span(tile_offset_y, tile->raster_height, offset_y,
+                                  raster->source_step_y, raster->raster_height, &y_first, &y_last)) {
+        return;
+    }
+    for (y = y_first; y <= y_last; y++) {
+        src_line = (const uchar*) tile->buffer
+                   + ((offset_y + y * raster->source_step_y - tile_offset_y) * tile->raster_width
+                      + (offset_x + x_first * raster->source_step_x - tile_offset_x)) * elem_size;
+        dst = (uchar*) raster->buffer + (y * raster->raster_width + x_first) * elem_size;
+        if (raster->source_step_x == 1) {
+            memcpy(dst, src_line, (x_last - x_first + 1) * elem_size);
+        } else {
+            for (x = x_first; x <= x_last; x++) {
+                memcpy(dst, src_line, elem_size);
+                dst += elem_size;
+                src_line += raster->source_step_x * elem_size;
+            }
+        }
+    }
+}
+
+
+/**
+ * Copies the pixels of the given tile taken by the raster, reading and
+ * caching the tile if it is not cached yet. The tile is read without
+ * holding the product lock; if another thread read it meanwhile, its
+ * copy is used.
+ */
+static int epr_read_window_tile(EPR_SBandId* band_id,
+                                uint tile_x, uint tile_y,
+                                uint offset_x, uint offset_y,
+                                EPR_SRaster* raster)
+{
+    EPR_SProductId* product_id = band_id->product_id;
+    EPR_STileCache* cache;
+    EPR_STileCacheEntry* entry;
+    EPR_SRaster* tile;
+    uint tile_width, tile_height, tile_offset_x, tile_offset_y, width, height;
+
+    epr_lock_mutex(product_id->lock);
+    cache = epr_get_tile_cache(product_id);
+    if (cache == NULL) {
+        epr_unlock_mutex(product_id->lock);
+        return epr_get_last_err_code();
+    }
+    tile_width = cache->tile_width;
+    tile_height = cache->tile_height;
+    tile_offset_x = tile_x * tile_width;
+    tile_offset_y = tile_y * tile_height;
+    entry = epr_find_tile(cache, band_id, tile_x, tile_y);
+    if (entry != NULL) {
+        epr_copy_tile(entry->raster, tile_offset_x, tile_offset_y, offset_x, offset_y, raster);
+        epr_unlock_mutex(product_id->lock);
+        return e_err_none;
+    }
+    epr_unlock_mutex(product_id->lock);
+
+    width = epr_get_scene_width(product_id) - tile_offset_x;
+    height = epr_get_scene_height(product_id) - tile_offset_y;
+    tile = epr_create_compatible_raster(band_id,
+                                        width < tile_width ? width : tile_width,
+                                        height < tile_height ? height : tile_height,
+                                        1, 1);
+    if (tile == NULL) {
+        return epr_get_last_err_code();
+    }
+    if (epr_read_band_raster(band_id, (int) tile_offset_x, (int) tile_offset_y, tile) != e_err_none) {
+        epr_free_raster(tile);
+        return epr_get_last_err_code();
+    }
+
+    epr_lock_mutex(product_id->lock);
+    cache = product_id->tile_cache;
+    entry = NULL;
+    if (cache->tile_width == tile_width && cache->tile_height == tile_height) {
+        entry = epr_find_tile(cache, band_id, tile_x, tile_y);
+        if (entry == NULL && (entry = (EPR_STileCacheEntry*) calloc(1, sizeof (EPR_STileCacheEntry))) != NULL) {
+            entry->band_id = band_id;
+            entry->tile_x = tile_x;
+            entry->tile_y = tile_y;
+            entry->raster = tile;
+            entry->num_bytes = tile->raster_width * tile->raster_height * tile->elem_size;
+            entry->last_use = ++cache->use_clock;
+            epr_add_ptr_array_elem(cache->entries, entry);
+            cache->num_bytes += entry->num_bytes;
+            tile = NULL;
+        }
+    }
+    epr_copy_tile(entry != NULL ? entry->raster : tile, tile_offset_x, tile_offset_y, offset_x, offset_y, raster);
+    epr_shrink_tile_cache(cache, cache->max_bytes);
+    epr_unlock_mutex(product_id->lock);
+    epr_free_raster(tile);
+    return e_err_none;
+}
+
+
+static int epr_check_tile_raster_args(const char* func_name, EPR_SBandId* band_id, EPR_SRaster* raster)
+{
+    char message[128];
+
+    if (band_id == NULL) {
+        sprintf(message, "%s: band_id must not be NULL", func_name);
+        epr_set_err(e_err_invalid_band, message);
+        return epr_get_last_err_code();
+    }
+    if (raster == NULL) {
+        sprintf(message, "%s: raster must not be NULL", func_name);
+        epr_set_err(e_err_invalid_raster, message);
+        return epr_get_last_err_code();
+    }
+    if (band_id->data_type != raster->data_type) {
+        sprintf(message, "%s: illegal raster data type", func_name);
+        epr_set_err(e_err_illegal_data_type, message);
+        return epr_get_last_err_code();
+    }
+    if (raster->buffer == NULL) {
+        sprintf(message, "%s: raster->buffer must not be NULL", func_name);
+        epr_set_err(e_err_illegal_arg, message);
+        return epr_get_last_err_code();
+    }
+    return e_err_none;
+}
+
+
+int epr_read_band_window(EPR_SBandId* band_id,
+                         int offset_x,
+                         int offset_y,
+                         EPR_SRaster* raster)
+{
+    EPR_SProductId* product_id;
+    uint tile_width, tile_height, last_x, last_y, tile_x, tile_y, first, last;
+
+    epr_clear_err();
+
+    if (epr_check_tile_raster_args("epr_read_band_window", band_id, raster) != e_err_none) {
+        return epr_get_last_err_code();
+    }
+    if (raster->raster_width == 0 || raster->raster_height == 0) {
+        return e_err_none;
+    }
+    product_id = band_id->product_id;
+    last_x = (uint) offset_x + (raster->raster_width - 1) * raster->source_step_x;
+    last_y = (uint) offset_y + (raster->raster_height - 1) * raster->source_step_y;
+    if (offset_x < 0 || offset_y < 0
+            || raster->source_step_x == 0 || raster->source_step_y == 0
+            || last_x >= epr_get_scene_width(product_id)
+            || last_y >= epr_get_scene_height(product_id)) {
+        epr_set_err(e_err_invalid_value,
+                    "epr_read_band_window: the window must lie within the scene");
+        return epr_get_last_err_code();
+    }
+
+    epr_lock_mutex(product_id->lock);
+    if (epr_get_tile_cache(product_id) == NULL) {
+        epr_unlock_mutex(product_id->lock);
+        return epr_get_last_err_code();
+    }
+    tile_width = product_id->tile_cache->tile_width;
+    tile_height = product_id->tile_cache->tile_height;
+    epr_unlock_mutex(product_id->lock);
+
+    for (tile_y = (uint) offset_y / tile_height; tile_y <= last_y / tile_height; tile_y++) {
+        /* with large steps some tiles contain none of the pixels */
+        if (!epr_get_tile_span(tile_y * tile_height, tile_height, (uint) offset_y,
+                               raster->source_step_y, raster->raster_height, &first, &last)) {
+            continue;
+        }
+        for (tile_x = (uint) offset_x / tile_width; tile_x <= last_x / tile_width; tile_x++) {
+            if (!epr_get_tile_span(tile_x * tile_width, tile_width, (uint) offset_x,
+                                   raster->source_step_x, raster->raster_width, &first, &last)) {
+                continue;
+            }
+            if (epr_read_window_tile(band_id, tile_x, tile_y,
+                                     (uint) offset_x, (uint) offset_y, raster) != e_err_none) {
+                return epr_get_last_err_code();
+            }
+        }
+    }
+    return e_err_none;
+}
+
+
+int epr_read_band_tile(EPR_SBandId* band_id,
+                       uint tile_x,
+                       uint tile_y,
+                       EPR_SRaster* raster)
+{
+    EPR_SProductId* product_id;
+    uint tile_width, tile_height, scene_width, scene_height;
+    uint width, height, y;
+    EPR_SRaster window;
+
+    epr_clear_err();
+
+    if (epr_check_tile_raster_args("epr_read_band_tile", band_id, raster) != e_err_none) {
+        return epr_get_last_err_code();
+    }
+    product_id = band_id->product_id;
+    epr_lock_mutex(product_id->lock);
+    if (epr_get_tile_cache(product_id) == NULL) {
+        epr_unlock_mutex(product_id->lock);
+        return epr_get_last_err_code();
+    }
+    tile_width = product_id->tile_cache->tile_width;
+    tile_height = product_id->tile_cache->tile_height;
+    epr_unlock_mutex(product_id->lock);
+
+    scene_width = epr_get_scene_width(product_id);
+    scene_height = epr_get_scene_height(product_id);
+    if (raster->raster_width != tile_width || raster->raster_height != tile_height
+            || raster->source_step_x != 1 || raster->source_step_y != 1) {
+        epr_set_err(e_err_invalid_raster,
+                    "epr_read_band_tile: the raster must have the size of a tile");
+        return epr_get_last_err_code();
+    }
+    if (tile_x >= (scene_width + tile_width - 1) / tile_width
+            || tile_y >= (scene_height + tile_height - 1) / tile_height) {
+        epr_set_err(e_err_invalid_value,
+                    "epr_read_band_tile: the tile must lie within the scene");
+        return epr_get_last_err_code();
+    }
+
+    /* the tiles of the last column and row are clipped to the scene */
+    width = scene_width - tile_x * tile_width;
+    height = scene_height - tile_y * tile_height;
+    window = *raster;
+    window.raster_width = width < tile_width ? width : tile_width;
+    window.raster_height = height < tile_height ? height : tile_height;
+    if (epr_read_window_tile(band_id, tile_x, tile_y,
+                             tile_x * tile_width, tile_y * tile_height, &window) != e_err_none) {
+        return epr_get_last_err_code();
+    }
+    if (window.raster_width < tile_width || window.raster_height < tile_height) {
+        /* the window's lines are packed, spread them over the lines of the tile */
+        for (y = window.raster_height; y-- > 0;) {
+            uchar* line = (uchar*) raster->buffer + y * tile_width * raster->elem_size;
+            memmove(line, (uchar*) raster->buffer + y * window.raster_width * raster->elem_size,
+                    window.raster_width * raster->elem_size);
+            memset(line + window.raster_width * raster->elem_size, 0,
+                   (tile_width - window.raster_width) * raster->elem_size);
+        }
+        memset((uchar*) raster->buffer + window.raster_height * tile_width * raster->elem_size, 0,
+               (tile_height - window.raster_height) * tile_width * raster->elem_size);
+    }
+    return e_err_none;
+}
+
+
+int epr_set_tile_cache(EPR_SProductId* product_id, uint tile_width, uint tile_height, uint max_bytes)
+{
+    EPR_STileCache* cache;
+
+    epr_clear_err();
+    if (product_id == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_set_tile_cache: product_id must not be NULL");
+        return epr_get_last_err_code();
+    }
+    if (tile_width == 0 || tile_height == 0) {
+        epr_set_err(e_err_illegal_arg,
+                    "epr_set_tile_cache: the tile size must not be zero");
+        return epr_get_last_err_code();
+    }
+    epr_lock_mutex(product_id->lock);
+    cache = epr_get_tile_cache(product_id);
+    if (cache != NULL) {
+        if (cache->tile_width != tile_width || cache->tile_height != tile_height) {
+            epr_shrink_tile_cache(cache, 0);
+            cache->tile_width = tile_width;
+            cache->tile_height = tile_height;
+        }
+        cache->max_bytes = max_bytes;
+        epr_shrink_tile_cache(cache, max_bytes);
+    }
+    epr_unlock_mutex(product_id->lock);
+    return cache != NULL ? e_err_none : epr_get_last_err_code();
+}
+
+
+int epr_clear_tile_cache(EPR_SProductId* product_id)
+{
+    epr_clear_err();
+    if (product_id == NULL) {
+        epr_set_err(e_err_null_pointer,
+                    "epr_clear_tile_cache: product_id must not be NULL");
+        return epr_get_last_err_code();
+    }
+    epr_lock_mutex(product_id->lock);
+    if (product_id->tile_cache != NULL) {
+        epr_shrink_tile_cache(product_id->tile_cache, 0);
+    }
+    epr_unlock_mutex(product_id->lock);
+    return e_err_none;
+}
+
+
+void epr_free_tile_cache(EPR_STileCache* cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    epr_shrink_tile_cache(cache, 0);
+    epr_free_ptr_array(cache->entries);
+    free(cache);
+}
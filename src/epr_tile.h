@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2002 by Brockmann Consult (info@brockmann-consult.de)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation. This program is distributed in the hope it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef EPR_TILE_H_INCL
+#define EPR_TILE_H_INCL
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "epr_api.h"
+#include "epr_ptrarray.h"
+
+
+typedef struct EPR_TileCacheEntry       EPR_STileCacheEntry;
+typedef struct EPR_TileCache            EPR_STileCache;
+
+
+/**
+ * A decoded tile held in the tile cache of a product.
+ */
+struct EPR_TileCacheEntry {
+    /**
+     * The band the tile was read from.
+     */
+    EPR_SBandId* band_id;
+
+    /**
+     * The column and row of the tile in the tile grid of the scene.
+     */
+    uint tile_x;
+    uint tile_y;
+
+    /**
+     * The tile, with one raster element per scene pixel. The tiles in the
+     * last column and row of the grid are clipped to the scene.
+     */
+    EPR_SRaster* raster;
+
+    /**
+     * The size of the raster's buffer in bytes.
+     */
+    uint num_bytes;
+
+    /**
+     * The time stamp of the last use, for the LRU replacement.
+     */
+    uint last_use;
+};
+
+
+/**
+ * The <code>EPR_TileCache</code> structure holds the decoded band tiles of
+ * a product. It is used internally only.
+ */
+struct EPR_TileCache {
+    /**
+     * The size of the tiles in pixels.
+     */
+    uint tile_width;
+    uint tile_height;
+
+    /**
+     * The maximum size of the cached tiles in bytes.
+     */
+    uint max_bytes;
+
+    /**
+     * The current size of the cached tiles in bytes.
+     */
+    uint num_bytes;
+
+    /**
+     * The counter providing the time stamps of the entries.
+     */
+    uint use_clock;
+
+    /**
+     * The cached tiles, <code>EPR_STileCacheEntry</code> instances.
+     */
+    EPR_SPtrArray* entries;
+};
+
+
+/**
+ * Releases the given tile cache.
+ *
+ * @param cache the tile cache, may be <code>NULL</code>
+ */
+void epr_free_tile_cache(EPR_STileCache* cache);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EPR_TILE_H_INCL */
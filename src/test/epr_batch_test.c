@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../epr_api.h"
+
+/**
+ *
+ * Call: epr_batch_test [-threads <n>] [-open <n>] [-pending <n>] [-mmap] [-bands <name>,...]
+ *                      [-list <file>] [<ENVISAT-Product file path>, ...]
+ *
+ * Reads the bands of all given products with a batch of worker threads.
+ *
+ * The option -threads sets the number of worker threads (default 1), -open the
+ * maximum number of products open at the same time, -pending the maximum number
+ * of rasters read but not yet consumed. The option -mmap opens the products in
+ * memory-mapped I/O mode. The option -bands selects the bands to be read (default
+ * all bands). The option -list reads further product paths from the given file,
+ * one path per line.
+ *
+ * Example:
+ *    epr_batch_test -threads 4 -bands radiance_1,radiance_13 -list archive.txt
+ *
+ * Example output:
+ *    rasters: 240, failed products: 0, checksum: c0619946, duration: 11.000000
+ *
+ */
+
+typedef struct BatchSummary {
+    uint num_rasters;
+    uint checksum;
+} BatchSummary;
+
+static int consume_raster(void* consumer_data, const char* product_file_path, EPR_SBandId* band_id, const EPR_SRaster* raster)
+{
+    BatchSummary* summary = (BatchSummary*) consumer_data;
+    uint row, col;
+
+    /**
+     * Sum up all values in the raster. The sum does not depend on the order in
+     * which the rasters are delivered.
+     */
+    for (row = 0; row < raster->raster_height; row++) {
+        for (col = 0; col < raster->raster_width; col++) {
+            summary->checksum += epr_get_pixel_as_uint(raster, col, row);
+        }
+    }
+    summary->num_rasters++;
+    return 0;
+}
+
+static int add_product_list(EPR_SBatch* batch, const char* list_path, const char* band_names)
+{
+    char line[4096];
+    size_t length;
+    FILE* fp = fopen(list_path, "r");
+
+    if (fp == NULL) {
+        printf("Error opening product list %s\n", list_path);
+        return 1;
+    }
+    while (fgets(line, sizeof (line), fp) != NULL) {
+        length = strlen(line);
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' || line[length - 1] == ' ')) {
+            line[--length] = '\0';
+        }
+        if (length > 0 && line[0] != '#') {
+            epr_add_batch_product(batch, line, band_names);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    EPR_EIOMode io_mode = e_io_stdio;
+    uint num_threads = 1;
+    uint max_open_products = 0;
+    uint max_pending_rasters = 0;
+    const char* band_names = NULL;
+    const char* list_path = NULL;
+    EPR_SBatch* batch;
+    BatchSummary summary;
+    uint num_failed;
+    time_t start_time;
+    int arg_index;
+
+    for (arg_index = 1; arg_index < argc && argv[arg_index][0] == '-'; arg_index++) {
+        if (strcmp(argv[arg_index], "-mmap") == 0) {
+            io_mode = e_io_mmap;
+        } else if (arg_index + 1 < argc && strcmp(argv[arg_index], "-threads") == 0) {
+            num_threads = (uint) atoi(argv[++arg_index]);
+        } else if (arg_index + 1 < argc && strcmp(argv[arg_index], "-open") == 0) {
+            max_open_products = (uint) atoi(argv[++arg_index]);
+        } else if (arg_index + 1 < argc && strcmp(argv[arg_index], "-pending") == 0) {
+            max_pending_rasters = (uint) atoi(argv[++arg_index]);
+        } else if (arg_index + 1 < argc && strcmp(argv[arg_index], "-bands") == 0) {
+            band_names = argv[++arg_index];
+        } else if (arg_index + 1 < argc && strcmp(argv[arg_index], "-list") == 0) {
+            list_path = argv[++arg_index];
+        } else {
+            break;
+        }
+    }
+    if (arg_index >= argc && list_path == NULL) {
+        printf("usage: %s [-threads <n>] [-open <n>] [-pending <n>] [-mmap] [-bands <name>,...] [-list <file>] [<product>, ...]\n", argv[0]);
+        return 1;
+    }
+
+    /* Starting point for measuring the time */
+    start_time = time(NULL);
+
+    epr_init_api(e_log_warning, epr_log_message, NULL);
+
+    batch = epr_create_batch(num_threads, max_open_products, max_pending_rasters, io_mode);
+    if (batch == NULL) {
+        printf("Error creating batch: %s\n", epr_get_last_err_message());
+        return 1;
+    }
+    if (list_path != NULL && add_product_list(batch, list_path, band_names) != 0) {
+        return 1;
+    }
+    for (; arg_index < argc; arg_index++) {
+        epr_add_batch_product(batch, argv[arg_index], band_names);
+    }
+
+    summary.num_rasters = 0;
+    summary.checksum = 0;
+    epr_run_batch(batch, consume_raster, &summary);
+
+    num_failed = epr_get_batch_num_failed(batch);
+    epr_free_batch(batch);
+    epr_close_api();
+
+    /* Calculate and print the duration since the starting point */
+    printf("rasters: %u, failed products: %u, checksum: %x, duration: %f\n",
+           summary.num_rasters, num_failed, summary.checksum, difftime(time(NULL), start_time));
+
+    return num_failed > 0 ? 1 : 0;
+}
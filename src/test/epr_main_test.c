@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 /* #include <process.h> */
 #include <stdlib.h>
@@ -18,6 +19,8 @@
 #include "../epr_msph.h"
 #include "../epr_band.h"
 #include "../epr_bitmask.h"
+#include "../epr_thread.h"
+#include "../epr_tile.h"
 
 #include "../../bccunit/src/bccunit.h"
 
@@ -193,6 +196,98 @@ BC_BEGIN_TEST(test_epr_read_record)
     epr_close_api();
 BC_END_TEST()
 
+BC_BEGIN_TEST(test_epr_read_records)
+    EPR_SProductId* product_id;
+    EPR_SDatasetId* dataset_id = NULL;
+    EPR_SRecord** records = NULL;
+    EPR_SRecord* record = NULL;
+    uint num_records;
+    uint i;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+
+    dataset_id = epr_get_dataset_id(product_id, "Tie_points_ADS");
+    num_records = epr_get_num_records(dataset_id);
+
+    records = epr_read_records(NULL, 0, 1, NULL);
+    BC_ASSERT_NULL(records);
+
+    records = epr_read_records(dataset_id, 0, 0, NULL);
+    BC_ASSERT_NULL(records);
+
+    records = epr_read_records(dataset_id, 1, num_records, NULL);
+    BC_ASSERT_NULL(records);
+
+    records = epr_read_records(dataset_id, 0, num_records, NULL);
+    BC_ASSERT_NOT_NULL(records);
+
+    record = epr_create_record(dataset_id);
+    for (i = 0; i < num_records; i++) {
+        record = epr_read_record(dataset_id, i, record);
+        BC_ASSERT_NOT_NULL(records[i]);
+        BC_ASSERT_SAME(((uint*) record->fields[4]->elems)[3], ((uint*) records[i]->fields[4]->elems)[3]);
+    }
+    BC_ASSERT_SAME(93, ((uint*) records[2]->fields[4]->elems)[3]);
+
+    epr_free_record(record);
+    epr_free_records(records, num_records);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+static int count_batch_raster(void* consumer_data, const char* product_file_path, EPR_SBandId* band_id, const EPR_SRaster* raster)
+{
+    (*(uint*) consumer_data)++;
+    return 0;
+}
+
+BC_BEGIN_TEST(test_epr_run_batch_band_list)
+    EPR_SProductId* product_id;
+    EPR_SBatch* batch;
+    char band_names[4096];
+    uint num_bands;
+    uint num_rasters;
+    uint run, i;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+
+    /* the full band list, with blanks to be trimmed */
+    band_names[0] = '\0';
+    num_bands = epr_get_num_bands(product_id);
+    for (i = 0; i < num_bands; i++) {
+        const char* band_name = epr_get_band_name(epr_get_band_id_at(product_id, i));
+        BC_ASSERT_TRUE(strlen(band_names) + strlen(band_name) + 3 < sizeof (band_names));
+        if (i > 0) {
+            strcat(band_names, ", ");
+        }
+        strcat(band_names, band_name);
+    }
+    epr_close_product(product_id);
+
+    /* the workers split the band lists of their products at the same time */
+    for (run = 0; run < 8; run++) {
+        batch = epr_create_batch(8, 0, 0, e_io_stdio);
+        BC_ASSERT_NOT_NULL(batch);
+        for (i = 0; i < 16; i++) {
+            BC_ASSERT_SAME(e_err_none, epr_add_batch_product(batch, "testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1", band_names));
+        }
+        num_rasters = 0;
+        BC_ASSERT_SAME(e_err_none, epr_run_batch(batch, count_batch_raster, &num_rasters));
+        BC_ASSERT_SAME(0, epr_get_batch_num_failed(batch));
+        BC_ASSERT_SAME(16 * num_bands, num_rasters);
+        epr_free_batch(batch);
+    }
+    epr_close_api();
+BC_END_TEST()
+
 BC_BEGIN_TEST(test_epr_get_data_type_size)
     BC_ASSERT_SAME(1,epr_get_data_type_size(e_tid_uchar));
     BC_ASSERT_SAME(1,epr_get_data_type_size(e_tid_char));
@@ -207,6 +302,59 @@ BC_BEGIN_TEST(test_epr_get_data_type_size)
     BC_ASSERT_SAME(0,epr_get_data_type_size(e_tid_unknown));
 BC_END_TEST()
 
+BC_BEGIN_TEST(test_epr_half_float_conversion)
+    uint half;
+    float value;
+
+    /* exactly representable values */
+    BC_ASSERT_SAME(0x0000, epr_float_to_half(0.0F));
+    BC_ASSERT_SAME(0x8000, epr_float_to_half(-0.0F));
+    BC_ASSERT_SAME(0x3c00, epr_float_to_half(1.0F));
+    BC_ASSERT_SAME(0xc000, epr_float_to_half(-2.0F));
+    BC_ASSERT_SAME(0x7bff, epr_float_to_half(65504.0F));
+    BC_ASSERT_SAME(0x0400, epr_float_to_half((float) ldexp(1.0, -14)));
+    BC_ASSERT_SAME(0x0001, epr_float_to_half((float) ldexp(1.0, -24)));
+    BC_ASSERT_TRUE(epr_half_to_float(0x7bff) == 65504.0F);
+    BC_ASSERT_TRUE(epr_half_to_float(0x0001) == (float) ldexp(1.0, -24));
+    BC_ASSERT_TRUE(epr_half_to_float(0x03ff) == (float) ldexp(1023.0, -24));
+    BC_ASSERT_TRUE(epr_half_to_float(0xbc00) == -1.0F);
+
+    /* round to nearest even */
+    BC_ASSERT_SAME(0x3c00, epr_float_to_half((float) (1.0 + ldexp(1.0, -11))));
+    BC_ASSERT_SAME(0x3c02, epr_float_to_half((float) (1.0 + 3.0 * ldexp(1.0, -11))));
+    BC_ASSERT_SAME(0x3c01, epr_float_to_half((float) (1.0 + ldexp(1.0, -11) + ldexp(1.0, -20))));
+    BC_ASSERT_SAME(0x0000, epr_float_to_half((float) ldexp(1.0, -25)));
+    BC_ASSERT_SAME(0x0001, epr_float_to_half((float) (ldexp(1.0, -25) + ldexp(1.0, -35))));
+    BC_ASSERT_SAME(0x0002, epr_float_to_half((float) ldexp(3.0, -25)));
+    BC_ASSERT_SAME(0x0000, epr_float_to_half((float) ldexp(1.0, -26)));
+
+    /* overflow to infinity */
+    BC_ASSERT_SAME(0x7bff, epr_float_to_half(65519.0F));
+    BC_ASSERT_SAME(0x7c00, epr_float_to_half(65520.0F));
+    BC_ASSERT_SAME(0xfc00, epr_float_to_half(-1.0e10F));
+
+    /* infinity and quiet NaN */
+    value = epr_half_to_float(0x7c00);
+    BC_ASSERT_TRUE(value > 0.0F && value * 0.5F == value);
+    BC_ASSERT_SAME(0x7c00, epr_float_to_half(value));
+    BC_ASSERT_SAME(0xfc00, epr_float_to_half(-value));
+    value = epr_half_to_float(0x7e00);
+    BC_ASSERT_TRUE(value != value);
+    BC_ASSERT_SAME(0x7e00, epr_float_to_half(value));
+    value = epr_half_to_float(0x7c01);
+    BC_ASSERT_TRUE(value != value);
+    BC_ASSERT_SAME(0x7e01, epr_float_to_half(value));
+
+    /* every half survives the round trip, signalling NaNs become quiet */
+    for (half = 0; half <= 0xffff; half++) {
+        if ((half & 0x7c00) == 0x7c00 && (half & 0x03ff) != 0) {
+            BC_ASSERT_SAME(half | 0x0200, epr_float_to_half(epr_half_to_float((ushort) half)));
+        } else {
+            BC_ASSERT_SAME(half, epr_float_to_half(epr_half_to_float((ushort) half)));
+        }
+    }
+BC_END_TEST()
+
 BC_BEGIN_TEST(test_epr_str_to_data_type_id)
     BC_ASSERT_SAME(e_tid_uchar, epr_str_to_data_type_id("UChar"));
     BC_ASSERT_SAME(e_tid_char, epr_str_to_data_type_id("AChar"));
@@ -464,6 +612,849 @@ BC_BEGIN_TEST(test_epr_parse_band)
     epr_close_api();
 BC_END_TEST()
 
+static EPR_SRaster* read_band_math_reference(EPR_SProductId* product_id, const char* band_name,
+                                             int offset_x, int offset_y, uint width, uint height, uint step)
+{
+    EPR_SBandId* band_id = epr_get_band_id(product_id, band_name);
+    EPR_SRaster* raster = epr_create_compatible_raster(band_id, width, height, step, step);
+
+    if (raster != NULL && epr_read_band_raster(band_id, offset_x, offset_y, raster) != 0) {
+        epr_free_raster(raster);
+        return NULL;
+    }
+    return raster;
+}
+
+static int equal_band_math_values(double actual, double expected)
+{
+    if (expected != expected) {
+        return actual != actual;
+    }
+    return actual == expected || fabs(actual - expected) <= 1.0e-6 * (1.0 + fabs(expected));
+}
+
+BC_BEGIN_TEST(test_epr_band_math_ndvi)
+    EPR_SProductId* product_id;
+    EPR_SBandMath* band_math;
+    EPR_SRaster* raster;
+    EPR_SRaster* nir;
+    EPR_SRaster* red;
+    uint width, height, x, y;
+    uint num_bad = 0;
+    double a, b;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    width = epr_get_scene_width(product_id);
+    height = epr_get_scene_height(product_id);
+
+    band_math = epr_compile_band_math(product_id, "(reflec_13 - reflec_7) / (reflec_13 + reflec_7)");
+    BC_ASSERT_NOT_NULL(band_math);
+    raster = epr_create_raster(e_tid_double, width, height, 1, 1);
+    BC_ASSERT_SAME(0, epr_read_band_math_raster(band_math, 0, 0, raster));
+
+    nir = read_band_math_reference(product_id, "reflec_13", 0, 0, width, height, 1);
+    red = read_band_math_reference(product_id, "reflec_7", 0, 0, width, height, 1);
+    BC_ASSERT_NOT_NULL(nir);
+    BC_ASSERT_NOT_NULL(red);
+    for (y = 0; y < raster->raster_height; y++) {
+        for (x = 0; x < raster->raster_width; x++) {
+            a = epr_get_pixel_as_float(nir, x, y);
+            b = epr_get_pixel_as_float(red, x, y);
+            if (!equal_band_math_values(epr_get_pixel_as_double(raster, x, y), (a - b) / (a + b))) {
+                num_bad++;
+            }
+        }
+    }
+    BC_ASSERT_SAME(0, num_bad);
+
+    epr_free_raster(nir);
+    epr_free_raster(red);
+    epr_free_raster(raster);
+    epr_free_band_math(band_math);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+BC_BEGIN_TEST(test_epr_band_math_flag_conditional)
+    EPR_SProductId* product_id;
+    EPR_SBandMath* band_math;
+    EPR_SRaster* raster;
+    EPR_SRaster* land;
+    EPR_SRaster* reflec;
+    EPR_SRaster* sun_zenith;
+    uint width, height, x, y;
+    uint num_bad = 0;
+    uint num_land = 0;
+    double expected;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    /* a subsampled window, with a tie point band in the else branch */
+    width = epr_get_scene_width(product_id) - 5;
+    height = epr_get_scene_height(product_id) - 7;
+
+    band_math = epr_compile_band_math(product_id, "l2_flags.LAND ? reflec_13 : sun_zenith");
+    BC_ASSERT_NOT_NULL(band_math);
+    raster = epr_create_raster(e_tid_double, width, height, 3, 3);
+    BC_ASSERT_SAME(0, epr_read_band_math_raster(band_math, 5, 7, raster));
+
+    land = epr_create_bitmask_raster(width, height, 3, 3);
+    BC_ASSERT_SAME(0, epr_read_bitmask_raster(product_id, "l2_flags.LAND", 5, 7, land));
+    reflec = read_band_math_reference(product_id, "reflec_13", 5, 7, width, height, 3);
+    sun_zenith = read_band_math_reference(product_id, "sun_zenith", 5, 7, width, height, 3);
+    BC_ASSERT_NOT_NULL(reflec);
+    BC_ASSERT_NOT_NULL(sun_zenith);
+    for (y = 0; y < raster->raster_height; y++) {
+        for (x = 0; x < raster->raster_width; x++) {
+            if (epr_get_pixel_as_uint(land, x, y) != 0) {
+                expected = epr_get_pixel_as_float(reflec, x, y);
+                num_land++;
+            } else {
+                expected = epr_get_pixel_as_float(sun_zenith, x, y);
+            }
+            if (!equal_band_math_values(epr_get_pixel_as_double(raster, x, y), expected)) {
+                num_bad++;
+            }
+        }
+    }
+    BC_ASSERT_SAME(0, num_bad);
+    BC_ASSERT_TRUE(num_land > 0 && num_land < raster->raster_width * raster->raster_height);
+
+    epr_free_raster(land);
+    epr_free_raster(reflec);
+    epr_free_raster(sun_zenith);
+    epr_free_raster(raster);
+    epr_free_band_math(band_math);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+BC_BEGIN_TEST(test_epr_band_math_masked_nan)
+    EPR_SProductId* product_id;
+    EPR_SBandMath* band_math;
+    EPR_SRaster* raster;
+    EPR_SRaster* water;
+    EPR_SRaster* algal;
+    uint width, height, x, y;
+    uint num_bad = 0;
+    uint num_water = 0;
+    double expected;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    width = epr_get_scene_width(product_id) - 3;
+    height = epr_get_scene_height(product_id) - 11;
+
+    /* algal_1 is masked by l2_flags.WATER, the comparison is false for NaN */
+    band_math = epr_compile_band_math(product_id, "algal_1 + 1");
+    BC_ASSERT_NOT_NULL(band_math);
+    raster = epr_create_raster(e_tid_float, width, height, 2, 2);
+    BC_ASSERT_SAME(0, epr_read_band_math_raster(band_math, 3, 11, raster));
+    epr_free_band_math(band_math);
+
+    water = epr_create_bitmask_raster(width, height, 2, 2);
+    BC_ASSERT_SAME(0, epr_read_bitmask_raster(product_id, "l2_flags.WATER", 3, 11, water));
+    algal = read_band_math_reference(product_id, "algal_1", 3, 11, width, height, 2);
+    BC_ASSERT_NOT_NULL(algal);
+    for (y = 0; y < raster->raster_height; y++) {
+        for (x = 0; x < raster->raster_width; x++) {
+            if (epr_get_pixel_as_uint(water, x, y) != 0) {
+                expected = (float) (epr_get_pixel_as_float(algal, x, y) + 1.0);
+                num_water++;
+            } else {
+                expected = fabs(sqrt(-1.0));
+            }
+            if (!equal_band_math_values(epr_get_pixel_as_float(raster, x, y), expected)) {
+                num_bad++;
+            }
+        }
+    }
+    BC_ASSERT_SAME(0, num_bad);
+    BC_ASSERT_TRUE(num_water > 0 && num_water < raster->raster_width * raster->raster_height);
+
+    band_math = epr_compile_band_math(product_id, "algal_1 > -1000 ? 1 : 0");
+    BC_ASSERT_NOT_NULL(band_math);
+    BC_ASSERT_SAME(0, epr_read_band_math_raster(band_math, 3, 11, raster));
+    epr_free_band_math(band_math);
+    for (y = 0; y < raster->raster_height; y++) {
+        for (x = 0; x < raster->raster_width; x++) {
+            if (epr_get_pixel_as_float(raster, x, y) != (float) (epr_get_pixel_as_uint(water, x, y) != 0)) {
+                num_bad++;
+            }
+        }
+    }
+    BC_ASSERT_SAME(0, num_bad);
+
+    epr_free_raster(water);
+    epr_free_raster(algal);
+    epr_free_raster(raster);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+typedef struct {
+    EPR_SProductId* product_id;
+    const char* bm_expr;
+    EPR_SRaster* raster;
+    int status;
+} TBitmaskRead;
+
+static void read_bitmask_task(void* task_data)
+{
+    TBitmaskRead* read = (TBitmaskRead*) task_data;
+    read->status = epr_read_bitmask_raster(read->product_id, read->bm_expr, 5, 7, read->raster);
+}
+
+BC_BEGIN_TEST(test_epr_shared_flag_raster)
+    static const char* bm_exprs[] = {"l2_flags.LAND", "l2_flags.WATER", "l2_flags.CLOUD", "!l2_flags.LAND"};
+    EPR_SProductId* product_id;
+    EPR_SProductId* reference_id;
+    EPR_SRaster* reference;
+    TBitmaskRead reads[4];
+    void* task_data[4];
+    uint width, height, i, x, y;
+    uint num_bad = 0;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    reference_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL || reference_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    width = epr_get_scene_width(product_id) - 5;
+    height = epr_get_scene_height(product_id) - 7;
+
+    /* all reads use l2_flags in the same window at the same time */
+    for (i = 0; i < 4; i++) {
+        reads[i].product_id = product_id;
+        reads[i].bm_expr = bm_exprs[i];
+        reads[i].raster = epr_create_bitmask_raster(width, height, 2, 2);
+        reads[i].status = -1;
+        task_data[i] = &reads[i];
+    }
+    epr_run_tasks(read_bitmask_task, task_data, 4, 4);
+
+    /* the flag band has been read once */
+    BC_ASSERT_NOT_NULL(product_id->bm_cache);
+    BC_ASSERT_SAME(1, product_id->bm_cache->entries->length);
+
+    reference = epr_create_bitmask_raster(width, height, 2, 2);
+    for (i = 0; i < 4; i++) {
+        BC_ASSERT_SAME(0, reads[i].status);
+        BC_ASSERT_SAME(0, epr_read_bitmask_raster(reference_id, bm_exprs[i], 5, 7, reference));
+        for (y = 0; y < reference->raster_height; y++) {
+            for (x = 0; x < reference->raster_width; x++) {
+                if (epr_get_pixel_as_uint(reads[i].raster, x, y) != epr_get_pixel_as_uint(reference, x, y)) {
+                    num_bad++;
+                }
+            }
+        }
+        epr_free_raster(reads[i].raster);
+    }
+    BC_ASSERT_SAME(0, num_bad);
+
+    epr_free_raster(reference);
+    epr_close_product(reference_id);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+/* reads a window of a band, it is NULL if an error occurred */
+static EPR_SRaster* read_band_window(EPR_SProductId* product_id, const char* band_name,
+                                     int offset_x, int offset_y, uint width, uint height, uint step)
+{
+    EPR_SBandId* band_id = epr_get_band_id(product_id, band_name);
+    EPR_SRaster* raster;
+
+    if (band_id == NULL) {
+        return NULL;
+    }
+    raster = epr_create_compatible_raster(band_id, width, height, step, step);
+    if (raster != NULL && epr_read_band_raster(band_id, offset_x, offset_y, raster) != 0) {
+        epr_free_raster(raster);
+        raster = NULL;
+    }
+    return raster;
+}
+
+static epr_boolean equal_rasters(const EPR_SRaster* a, const EPR_SRaster* b)
+{
+    return a->raster_width == b->raster_width && a->raster_height == b->raster_height
+           && a->data_type == b->data_type
+           && memcmp(a->buffer, b->buffer, a->raster_width * a->raster_height * a->elem_size) == 0;
+}
+
+BC_BEGIN_TEST(test_epr_read_ahead_raster)
+    EPR_SProductId* product_id;
+    EPR_SRaster* full;
+    EPR_SRaster* window;
+    EPR_SRaster* raster;
+    uint width, height;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    width = epr_get_scene_width(product_id);
+    height = epr_get_scene_height(product_id);
+
+    /* whole lines, read in spans, and a narrow subsampled window, whose rows are read one by one */
+    full = read_band_window(product_id, "reflec_7", 0, 0, width, height, 1);
+    window = read_band_window(product_id, "reflec_7", 11, 5, 40, height - 5, 3);
+    BC_ASSERT_NOT_NULL(full);
+    BC_ASSERT_NOT_NULL(window);
+
+    /* small blocks, so that the ring of buffers is reused */
+    BC_ASSERT_SAME(0, epr_set_read_ahead(product_id, 4096, 3));
+    raster = read_band_window(product_id, "reflec_7", 0, 0, width, height, 1);
+    BC_ASSERT_NOT_NULL(raster);
+    BC_ASSERT_TRUE(equal_rasters(full, raster));
+    epr_free_raster(raster);
+    raster = read_band_window(product_id, "reflec_7", 11, 5, 40, height - 5, 3);
+    BC_ASSERT_NOT_NULL(raster);
+    BC_ASSERT_TRUE(equal_rasters(window, raster));
+    epr_free_raster(raster);
+
+    /* blocks read by the calling thread */
+    BC_ASSERT_SAME(0, epr_set_read_ahead(product_id, 4096, 1));
+    raster = read_band_window(product_id, "reflec_7", 11, 5, 40, height - 5, 3);
+    BC_ASSERT_NOT_NULL(raster);
+    BC_ASSERT_TRUE(equal_rasters(window, raster));
+    epr_free_raster(raster);
+
+    /* strips read by several threads */
+    BC_ASSERT_SAME(0, epr_set_read_ahead(product_id, 4096, 3));
+    BC_ASSERT_SAME(0, epr_set_read_threads(product_id, 4));
+    raster = read_band_window(product_id, "reflec_7", 0, 0, width, height, 1);
+    BC_ASSERT_NOT_NULL(raster);
+    BC_ASSERT_TRUE(equal_rasters(full, raster));
+    epr_free_raster(raster);
+
+    epr_free_raster(full);
+    epr_free_raster(window);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+BC_BEGIN_TEST(test_epr_read_band_rasters)
+    static const char* band_names[] = {"reflec_7", "reflec_13", "algal_1", "l2_flags", "sun_zenith"};
+    const uint num_bands = sizeof (band_names) / sizeof (band_names[0]);
+    EPR_SProductId* product_id;
+    EPR_SBandId* band_ids[sizeof (band_names) / sizeof (band_names[0])];
+    EPR_SRaster* rasters[sizeof (band_names) / sizeof (band_names[0])];
+    EPR_SRaster* expected;
+    uint width, height, i;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    width = 40;
+    height = epr_get_scene_height(product_id) - 5;
+
+    /* bands of one dataset read together, a masked band, a flag band and a tie point band */
+    for (i = 0; i < num_bands; i++) {
+        band_ids[i] = epr_get_band_id(product_id, band_names[i]);
+        BC_ASSERT_NOT_NULL(band_ids[i]);
+        rasters[i] = epr_create_compatible_raster(band_ids[i], width, height, 3, 3);
+    }
+    BC_ASSERT_SAME(0, epr_read_band_rasters(band_ids, rasters, num_bands, 11, 5));
+    for (i = 0; i < num_bands; i++) {
+        expected = read_band_window(product_id, band_names[i], 11, 5, width, height, 3);
+        BC_ASSERT_NOT_NULL(expected);
+        BC_ASSERT_TRUE(equal_rasters(expected, rasters[i]));
+        epr_free_raster(expected);
+        epr_free_raster(rasters[i]);
+    }
+
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+typedef struct {
+    epr_boolean reversed;
+    uint num_calls;
+    uint num_tasks;
+} TTestExecutor;
+
+/* runs the strips on threads of its own, or in reverse order in the calling thread */
+static void run_test_executor(EPR_FTask task, void** task_data, uint num_tasks, void* executor_data)
+{
+    TTestExecutor* executor = (TTestExecutor*) executor_data;
+    uint i;
+
+    executor->num_calls++;
+    executor->num_tasks += num_tasks;
+    if (executor->reversed) {
+        for (i = num_tasks; i > 0; i--) {
+            task(task_data[i - 1]);
+        }
+    } else {
+        epr_run_tasks(task, task_data, num_tasks, num_tasks);
+    }
+}
+
+BC_BEGIN_TEST(test_epr_read_executor)
+    EPR_SProductId* product_id;
+    TTestExecutor executor;
+    EPR_SRaster* expected[2];
+    EPR_SRaster* raster;
+    uint width, height, i;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    width = epr_get_scene_width(product_id) - 11;
+    height = epr_get_scene_height(product_id) - 5;
+
+    /* a measurement band with a bit-mask, and a tie point band */
+    expected[0] = read_band_window(product_id, "algal_1", 11, 5, width, height, 3);
+    expected[1] = read_band_window(product_id, "sun_zenith", 11, 5, width, height, 3);
+    BC_ASSERT_NOT_NULL(expected[0]);
+    BC_ASSERT_NOT_NULL(expected[1]);
+
+    BC_ASSERT_SAME(0, epr_set_read_threads(product_id, 4));
+    for (i = 0; i < 2; i++) {
+        executor.reversed = i == 1;
+        executor.num_calls = 0;
+        executor.num_tasks = 0;
+        BC_ASSERT_SAME(0, epr_set_read_executor(product_id, run_test_executor, &executor));
+        raster = read_band_window(product_id, "algal_1", 11, 5, width, height, 3);
+        BC_ASSERT_NOT_NULL(raster);
+        BC_ASSERT_TRUE(equal_rasters(expected[0], raster));
+        epr_free_raster(raster);
+        raster = read_band_window(product_id, "sun_zenith", 11, 5, width, height, 3);
+        BC_ASSERT_NOT_NULL(raster);
+        BC_ASSERT_TRUE(equal_rasters(expected[1], raster));
+        epr_free_raster(raster);
+        BC_ASSERT_TRUE(executor.num_calls > 0);
+        BC_ASSERT_TRUE(executor.num_tasks > executor.num_calls);
+    }
+
+    epr_free_raster(expected[0]);
+    epr_free_raster(expected[1]);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+static epr_boolean is_tile_cached(EPR_SProductId* product_id, EPR_SBandId* band_id, uint tile_x, uint tile_y)
+{
+    EPR_STileCacheEntry* entry;
+    uint i;
+
+    for (i = 0; i < product_id->tile_cache->entries->length; i++) {
+        entry = (EPR_STileCacheEntry*) product_id->tile_cache->entries->elems[i];
+        if (entry->band_id == band_id && entry->tile_x == tile_x && entry->tile_y == tile_y) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+BC_BEGIN_TEST(test_epr_tile_cache)
+    EPR_SProductId* product_id;
+    EPR_SBandId* band_id;
+    EPR_SRaster* expected;
+    EPR_SRaster* raster;
+    uint width, height;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    band_id = epr_get_band_id(product_id, "algal_1");
+    BC_ASSERT_NOT_NULL(band_id);
+    width = 70;
+    height = 50;
+
+    /* float tiles of 32x32 pixels, at most three of them are kept */
+    BC_ASSERT_SAME(0, epr_set_tile_cache(product_id, 32, 32, 3 * 32 * 32 * 4));
+
+    /* a subsampled window covering 3x2 tiles, some are evicted while it is assembled */
+    expected = read_band_window(product_id, "algal_1", 11, 5, width, height, 2);
+    BC_ASSERT_NOT_NULL(expected);
+    raster = epr_create_compatible_raster(band_id, width, height, 2, 2);
+    BC_ASSERT_SAME(0, epr_read_band_window(band_id, 11, 5, raster));
+    BC_ASSERT_TRUE(equal_rasters(expected, raster));
+    BC_ASSERT_TRUE(product_id->tile_cache->entries->length == 3);
+    BC_ASSERT_TRUE(product_id->tile_cache->num_bytes <= 3 * 32 * 32 * 4);
+
+    /* read again, from cached and re-read tiles */
+    memset(raster->buffer, 0, raster->raster_width * raster->raster_height * raster->elem_size);
+    BC_ASSERT_SAME(0, epr_read_band_window(band_id, 11, 5, raster));
+    BC_ASSERT_TRUE(equal_rasters(expected, raster));
+    epr_free_raster(expected);
+    epr_free_raster(raster);
+
+    /* the least recently used tile is evicted: (1,0) here, as (0,0) was used again */
+    BC_ASSERT_SAME(0, epr_clear_tile_cache(product_id));
+    raster = epr_create_compatible_raster(band_id, 32, 32, 1, 1);
+    BC_ASSERT_SAME(0, epr_read_band_tile(band_id, 0, 0, raster));
+    BC_ASSERT_SAME(0, epr_read_band_tile(band_id, 1, 0, raster));
+    BC_ASSERT_SAME(0, epr_read_band_tile(band_id, 2, 0, raster));
+    BC_ASSERT_SAME(0, epr_read_band_tile(band_id, 0, 0, raster));
+    BC_ASSERT_SAME(0, epr_read_band_tile(band_id, 3, 1, raster));
+    BC_ASSERT_TRUE(is_tile_cached(product_id, band_id, 0, 0));
+    BC_ASSERT_TRUE(!is_tile_cached(product_id, band_id, 1, 0));
+    BC_ASSERT_TRUE(is_tile_cached(product_id, band_id, 2, 0));
+    BC_ASSERT_TRUE(is_tile_cached(product_id, band_id, 3, 1));
+
+    expected = read_band_window(product_id, "algal_1", 3 * 32, 32, 32, 32, 1);
+    BC_ASSERT_NOT_NULL(expected);
+    BC_ASSERT_TRUE(equal_rasters(expected, raster));
+    epr_free_raster(expected);
+    epr_free_raster(raster);
+
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+BC_BEGIN_TEST(test_epr_flag_stats)
+    EPR_SProductId* product_id;
+    EPR_SBandId* band_id;
+    EPR_SFlagStats* stats;
+    EPR_SRaster* flags;
+    const ulong* bitplane_line;
+    uint width, height, x, y, i, count, value, bit;
+    uint num_bad = 0;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    width = epr_get_scene_width(product_id);
+    height = epr_get_scene_height(product_id);
+    band_id = epr_get_band_id(product_id, "l2_flags");
+    BC_ASSERT_NOT_NULL(band_id);
+
+    /* the statistics have no offset, so the whole scene is subsampled */
+    stats = epr_compute_flag_stats(band_id, 3, TRUE);
+    BC_ASSERT_NOT_NULL(stats);
+    flags = read_band_window(product_id, "l2_flags", 0, 0, width, height, 3);
+    BC_ASSERT_NOT_NULL(flags);
+    BC_ASSERT_SAME(flags->raster_width * flags->raster_height, stats->num_pixels);
+    BC_ASSERT_TRUE(stats->num_flags > 0);
+
+    for (i = 0; i < stats->num_flags; i++) {
+        BC_ASSERT_NOT_NULL(stats->bitplanes[i]);
+        BC_ASSERT_SAME(flags->raster_width, stats->bitplanes[i]->raster_width);
+        BC_ASSERT_SAME(flags->raster_height, stats->bitplanes[i]->raster_height);
+        count = 0;
+        for (y = 0; y < flags->raster_height; y++) {
+            bitplane_line = (const ulong*) stats->bitplanes[i]->buffer + y * EPR_BITMASK_LINE_WORDS(flags->raster_width);
+            for (x = 0; x < flags->raster_width; x++) {
+                value = (epr_get_pixel_as_uint(flags, x, y) & stats->flags[i]->bit_mask) == stats->flags[i]->bit_mask;
+                bit = (uint) ((bitplane_line[x / EPR_BITMASK_WORD_BITS] >> (x % EPR_BITMASK_WORD_BITS)) & 1);
+                count += value;
+                if (bit != value) {
+                    num_bad++;
+                }
+            }
+        }
+        if (count != stats->counts[i]) {
+            printf("flag %s: %u pixels instead of %u\n", stats->flags[i]->name, stats->counts[i], count);
+            num_bad++;
+        }
+    }
+    BC_ASSERT_SAME(0, num_bad);
+    epr_free_flag_stats(stats);
+
+    /* without bit-planes, at full resolution */
+    stats = epr_compute_flag_stats(band_id, 1, FALSE);
+    BC_ASSERT_NOT_NULL(stats);
+    BC_ASSERT_SAME(width * height, stats->num_pixels);
+    BC_ASSERT_NULL(stats->bitplanes);
+    epr_free_flag_stats(stats);
+
+    epr_free_raster(flags);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+#define NUM_SEQUENTIAL_BANDS 5
+
+typedef struct {
+    EPR_SBandId* band_ids[NUM_SEQUENTIAL_BANDS];
+    EPR_SRaster* expected[NUM_SEQUENTIAL_BANDS];
+    uint num_lines[NUM_SEQUENTIAL_BANDS];
+    uint num_bad;
+} TSequentialCheck;
+
+/* compares each line passed by the sequential read with the line of a plain read */
+static int check_sequential_line(void* consumer_data, EPR_SBandId* band_id, uint y, const EPR_SRaster* line)
+{
+    TSequentialCheck* check = (TSequentialCheck*) consumer_data;
+    const EPR_SRaster* expected;
+    uint i, row;
+
+    for (i = 0; i < NUM_SEQUENTIAL_BANDS && check->band_ids[i] != band_id; i++) {
+    }
+    if (i == NUM_SEQUENTIAL_BANDS) {
+        check->num_bad++;
+        return 0;
+    }
+    expected = check->expected[i];
+    row = y / expected->source_step_y;
+    if (y % expected->source_step_y != 0 || row >= expected->raster_height
+        || line->raster_width != expected->raster_width || line->data_type != expected->data_type
+        || memcmp(line->buffer, (const char*) expected->buffer + row * expected->raster_width * expected->elem_size,
+                  expected->raster_width * expected->elem_size) != 0) {
+        check->num_bad++;
+    }
+    check->num_lines[i]++;
+    return 0;
+}
+
+BC_BEGIN_TEST(test_epr_read_product_sequentially)
+    static const char* band_names[NUM_SEQUENTIAL_BANDS] = {"reflec_7", "reflec_13", "algal_1", "l2_flags", "sun_zenith"};
+    EPR_SProductId* product_id;
+    EPR_SRaster* rasters[NUM_SEQUENTIAL_BANDS];
+    EPR_SRaster* water;
+    EPR_SRaster* masked;
+    EPR_SRaster* reference;
+    TSequentialCheck check;
+    uint width, height, i;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    width = epr_get_scene_width(product_id);
+    height = epr_get_scene_height(product_id);
+
+    /*
+     * The rasters must cover the scene, so they are subsampled but not offset;
+     * reflec_13 is only passed to the consumer, at full resolution. The
+     * bit-mask of algal_1 is not applied by the sequential read.
+     */
+    memset(&check, 0, sizeof (check));
+    for (i = 0; i < NUM_SEQUENTIAL_BANDS; i++) {
+        check.band_ids[i] = epr_get_band_id(product_id, band_names[i]);
+        BC_ASSERT_NOT_NULL(check.band_ids[i]);
+        if (i == 1) {
+            rasters[i] = NULL;
+            check.expected[i] = read_band_window(product_id, band_names[i], 0, 0, width, height, 1);
+        } else if (i == 2) {
+            rasters[i] = epr_create_compatible_raster(check.band_ids[i], width, height, 3, 3);
+            check.expected[i] = epr_create_compatible_raster(check.band_ids[i], width, height, 3, 3);
+            BC_ASSERT_SAME(0, epr_read_band_raster_unmasked(check.band_ids[i], 0, 0, check.expected[i]));
+        } else {
+            rasters[i] = epr_create_compatible_raster(check.band_ids[i], width, height, 3, 3);
+            check.expected[i] = read_band_window(product_id, band_names[i], 0, 0, width, height, 3);
+        }
+        BC_ASSERT_NOT_NULL(check.expected[i]);
+    }
+    BC_ASSERT_SAME(0, epr_read_product_sequentially(check.band_ids, rasters, NUM_SEQUENTIAL_BANDS,
+                                                    check_sequential_line, &check));
+    BC_ASSERT_SAME(0, check.num_bad);
+
+    /* with its bit-mask applied afterwards, algal_1 is the one of a plain read */
+    water = epr_create_bitmask_raster(width, height, 3, 3);
+    BC_ASSERT_SAME(0, epr_read_bitmask_raster(product_id, "l2_flags.WATER", 0, 0, water));
+    masked = epr_create_compatible_raster(check.band_ids[2], width, height, 3, 3);
+    memcpy(masked->buffer, rasters[2]->buffer, masked->raster_width * masked->raster_height * masked->elem_size);
+    BC_ASSERT_SAME(0, epr_apply_bitmask(masked, water));
+    epr_free_raster(water);
+    reference = read_band_window(product_id, "algal_1", 0, 0, width, height, 3);
+    BC_ASSERT_NOT_NULL(reference);
+    BC_ASSERT_TRUE(equal_rasters(reference, masked));
+    epr_free_raster(reference);
+    epr_free_raster(masked);
+
+    for (i = 0; i < NUM_SEQUENTIAL_BANDS; i++) {
+        BC_ASSERT_SAME(check.expected[i]->raster_height, check.num_lines[i]);
+        if (rasters[i] != NULL) {
+            BC_ASSERT_TRUE(equal_rasters(check.expected[i], rasters[i]));
+            epr_free_raster(rasters[i]);
+        }
+        epr_free_raster(check.expected[i]);
+    }
+
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+BC_BEGIN_TEST(test_epr_mmap_io_mode)
+    static const char* band_names[] = {"reflec_7", "algal_1", "l2_flags", "sun_zenith"};
+    const char* product_path = "testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1";
+    EPR_SProductId* stdio_id;
+    EPR_SProductId* mmap_id;
+    EPR_SRaster* expected;
+    EPR_SRaster* raster;
+    uint width, height, i;
+
+    epr_init_api(ll, loghandler, NULL);
+    stdio_id = epr_open_product_ex(product_path, e_io_stdio);
+    mmap_id = epr_open_product_ex(product_path, e_io_mmap);
+    if (stdio_id == NULL || mmap_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    BC_ASSERT_SAME(e_io_stdio, epr_get_io_mode(stdio_id));
+    BC_ASSERT_SAME(e_io_mmap, epr_get_io_mode(mmap_id));
+    width = epr_get_scene_width(stdio_id) - 11;
+    height = epr_get_scene_height(stdio_id) - 5;
+
+    /* full scenes and offset, subsampled windows, of masked, flag and tie point bands */
+    for (i = 0; i < sizeof (band_names) / sizeof (band_names[0]); i++) {
+        expected = read_band_window(stdio_id, band_names[i], 0, 0, width + 11, height + 5, 1);
+        raster = read_band_window(mmap_id, band_names[i], 0, 0, width + 11, height + 5, 1);
+        BC_ASSERT_NOT_NULL(expected);
+        BC_ASSERT_NOT_NULL(raster);
+        BC_ASSERT_TRUE(equal_rasters(expected, raster));
+        epr_free_raster(expected);
+        epr_free_raster(raster);
+
+        expected = read_band_window(stdio_id, band_names[i], 11, 5, width, height, 3);
+        raster = read_band_window(mmap_id, band_names[i], 11, 5, width, height, 3);
+        BC_ASSERT_NOT_NULL(expected);
+        BC_ASSERT_NOT_NULL(raster);
+        BC_ASSERT_TRUE(equal_rasters(expected, raster));
+        epr_free_raster(expected);
+        epr_free_raster(raster);
+    }
+
+    epr_close_product(mmap_id);
+    epr_close_product(stdio_id);
+    epr_close_api();
+BC_END_TEST()
+
+BC_BEGIN_TEST(test_epr_band_stats_brute_force)
+    EPR_SProductId* product_id;
+    EPR_SBandId* band_id;
+    EPR_SBandStats* stats;
+    EPR_SRaster* raster;
+    EPR_SRaster* mask;
+    uint* histogram;
+    uint width, height, x, y, bin;
+    uint num_valid = 0;
+    uint num_bad_bins = 0;
+    double value, min = 0.0, max = 0.0, sum = 0.0, sum_sq = 0.0, mean;
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+    /* a band with a bit-mask expression, every second pixel of every second line */
+    band_id = epr_get_band_id(product_id, "algal_1");
+    BC_ASSERT_NOT_NULL(band_id);
+    BC_ASSERT_NOT_NULL(band_id->bm_expr);
+    stats = epr_compute_band_stats(band_id, 2, 16, 0.0, 0.0);
+    BC_ASSERT_NOT_NULL(stats);
+
+    width = epr_get_scene_width(product_id);
+    height = epr_get_scene_height(product_id);
+    raster = epr_create_compatible_raster(band_id, width, height, 2, 2);
+    mask = epr_create_bitmask_raster(width, height, 2, 2);
+    BC_ASSERT_SAME(0, epr_read_band_raster(band_id, 0, 0, raster));
+    BC_ASSERT_SAME(0, epr_read_bitmask_raster(product_id, band_id->bm_expr, 0, 0, mask));
+    histogram = (uint*) calloc(stats->num_bins, sizeof (uint));
+    for (y = 0; y < raster->raster_height; y++) {
+        for (x = 0; x < raster->raster_width; x++) {
+            value = epr_get_pixel_as_double(raster, x, y);
+            if (epr_get_pixel_as_uint(mask, x, y) == 0 || value != value) {
+                continue;
+            }
+            min = num_valid == 0 || value < min ? value : min;
+            max = num_valid == 0 || value > max ? value : max;
+            sum += value;
+            sum_sq += value * value;
+            num_valid++;
+            if (value >= stats->hist_min && value <= stats->hist_max) {
+                bin = (uint) ((value - stats->hist_min) / (stats->hist_max - stats->hist_min) * stats->num_bins);
+                histogram[bin < stats->num_bins ? bin : stats->num_bins - 1]++;
+            }
+        }
+    }
+    BC_ASSERT_TRUE(num_valid > 0 && num_valid < raster->raster_width * raster->raster_height);
+    BC_ASSERT_SAME(raster->raster_width * raster->raster_height, stats->num_pixels);
+    BC_ASSERT_SAME(num_valid, stats->num_valid);
+    BC_ASSERT_TRUE(stats->min == min && stats->max == max);
+    mean = sum / num_valid;
+    BC_ASSERT_TRUE(fabs(stats->mean - mean) <= 1e-9 * (fabs(mean) + 1.0));
+    BC_ASSERT_TRUE(fabs(stats->stddev - sqrt(sum_sq / num_valid - mean * mean)) <= 1e-6 * (stats->stddev + 1.0));
+    for (bin = 0; bin < stats->num_bins; bin++) {
+        if (histogram[bin] != stats->histogram[bin]) {
+            num_bad_bins++;
+        }
+    }
+    BC_ASSERT_SAME(0, num_bad_bins);
+
+    free(histogram);
+    epr_free_raster(mask);
+    epr_free_raster(raster);
+    epr_free_band_stats(stats);
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
+BC_BEGIN_TEST(test_epr_band_math_syntax_errors)
+    EPR_SProductId* product_id;
+    EPR_SBandMath* band_math;
+    char long_name[82];
+    char expr[128];
+
+    epr_init_api(ll, loghandler, NULL);
+    product_id = epr_open_product("testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1");
+    if (product_id == NULL) {
+        BC_FAIL("cannot open product");
+    }
+
+    band_math = epr_compile_band_math(product_id, "(1 + 2");
+    BC_ASSERT_NULL(band_math);
+    BC_ASSERT_NOT_SAME(e_err_none, epr_get_last_err_code());
+
+    band_math = epr_compile_band_math(product_id, "1 ? 2");
+    BC_ASSERT_NULL(band_math);
+    BC_ASSERT_NOT_SAME(e_err_none, epr_get_last_err_code());
+
+    band_math = epr_compile_band_math(product_id, "kapusta * 2");
+    BC_ASSERT_NULL(band_math);
+    BC_ASSERT_NOT_SAME(e_err_none, epr_get_last_err_code());
+
+    band_math = epr_compile_band_math(product_id, "l2_flags.KAPUSTA");
+    BC_ASSERT_NULL(band_math);
+    BC_ASSERT_NOT_SAME(e_err_none, epr_get_last_err_code());
+
+    /* names longer than 80 characters are not cut but rejected, in full */
+    memset(long_name, 'a', sizeof (long_name) - 1);
+    long_name[sizeof (long_name) - 1] = '\0';
+    sprintf(expr, "reflec_13 + %s", long_name);
+    band_math = epr_compile_band_math(product_id, expr);
+    BC_ASSERT_NULL(band_math);
+    BC_ASSERT_SAME(e_err_invalid_value, epr_get_last_err_code());
+    BC_ASSERT_NOT_NULL(strstr(epr_get_last_err_message(), long_name));
+    sprintf(expr, "l2_flags.%s", long_name);
+    band_math = epr_compile_band_math(product_id, expr);
+    BC_ASSERT_NULL(band_math);
+    BC_ASSERT_SAME(e_err_invalid_value, epr_get_last_err_code());
+
+    band_math = epr_compile_band_math(product_id, "(1 + 2) ? 3 : 4");
+    BC_ASSERT_NOT_NULL(band_math);
+    BC_ASSERT_SAME(e_err_none, epr_get_last_err_code());
+    epr_free_band_math(band_math);
+
+    epr_close_product(product_id);
+    epr_close_api();
+BC_END_TEST()
+
 BC_BEGIN_TEST(test_tie_points_ADS_4_4)
 
     epr_init_api(ll, loghandler, NULL);
@@ -501,10 +1492,13 @@ int main(int argc, char** argv) {
         bc_add_test_case(test_suite_epr_api,"test_epr_open_product",test_epr_open_product);
         bc_add_test_case(test_suite_epr_api,"test_epr_get_dataset_id",test_epr_get_dataset_id);
         bc_add_test_case(test_suite_epr_api,"test_epr_read_record",test_epr_read_record);
+        bc_add_test_case(test_suite_epr_api,"test_epr_read_records",test_epr_read_records);
+        bc_add_test_case(test_suite_epr_api,"test_epr_run_batch_band_list",test_epr_run_batch_band_list);
         bc_add_test_case(test_suite_epr_api,"test_tie_points_ADS_4_4",test_tie_points_ADS_4_4);
 
     test_suite_epr_core = bc_create_test_suite("test_suite_epr_core");
         bc_add_test_case(test_suite_epr_core,"test_epr_get_data_type_size",test_epr_get_data_type_size);
+        bc_add_test_case(test_suite_epr_core,"test_epr_half_float_conversion",test_epr_half_float_conversion);
         bc_add_test_case(test_suite_epr_core,"test_epr_str_to_data_type_id", test_epr_str_to_data_type_id);
 
     test_suite_epr_header = bc_create_test_suite("test_suite_epr_header");
@@ -512,6 +1506,19 @@ int main(int argc, char** argv) {
 
     test_suite_epr_band = bc_create_test_suite("test_suite_epr_band");
         bc_add_test_case(test_suite_epr_band,"test_epr_parse_band", test_epr_parse_band);
+        bc_add_test_case(test_suite_epr_band,"test_epr_band_math_ndvi", test_epr_band_math_ndvi);
+        bc_add_test_case(test_suite_epr_band,"test_epr_band_math_flag_conditional", test_epr_band_math_flag_conditional);
+        bc_add_test_case(test_suite_epr_band,"test_epr_band_math_syntax_errors", test_epr_band_math_syntax_errors);
+        bc_add_test_case(test_suite_epr_band,"test_epr_shared_flag_raster", test_epr_shared_flag_raster);
+        bc_add_test_case(test_suite_epr_band,"test_epr_read_ahead_raster", test_epr_read_ahead_raster);
+        bc_add_test_case(test_suite_epr_band,"test_epr_band_stats_brute_force", test_epr_band_stats_brute_force);
+        bc_add_test_case(test_suite_epr_band,"test_epr_band_math_masked_nan", test_epr_band_math_masked_nan);
+        bc_add_test_case(test_suite_epr_band,"test_epr_read_band_rasters", test_epr_read_band_rasters);
+        bc_add_test_case(test_suite_epr_band,"test_epr_read_executor", test_epr_read_executor);
+        bc_add_test_case(test_suite_epr_band,"test_epr_tile_cache", test_epr_tile_cache);
+        bc_add_test_case(test_suite_epr_band,"test_epr_flag_stats", test_epr_flag_stats);
+        bc_add_test_case(test_suite_epr_band,"test_epr_read_product_sequentially", test_epr_read_product_sequentially);
+        bc_add_test_case(test_suite_epr_band,"test_epr_mmap_io_mode", test_epr_mmap_io_mode);
 
     bc_add_test(main_test_suite,test_suite_epr_api);
     bc_add_test(main_test_suite,test_suite_epr_core);
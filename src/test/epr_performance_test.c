@@ -1,11 +1,14 @@
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include "../epr_api.h"
 
 /**
  *
- * Call: epr_performance_test <ENVISAT-Product file path> [<ENVISAT-Product file path>, ...]
+ * Call: epr_performance_test [-mmap] <ENVISAT-Product file path> [<ENVISAT-Product file path>, ...]
+ *
+ * The option -mmap opens the products in memory-mapped I/O mode.
  *
  * Example:
  *    epr_performance_test testdata/MER_RR__2PNRAL20100429_160201_000003102089_00040_42679_0001.N1
@@ -16,8 +19,15 @@
  */
 int main(int argc, char *argv[])
 {
-    if (argc < 2) {
-        printf("usage: %s <product> [<product>, ...]\n", argv[0]);
+    EPR_EIOMode io_mode = e_io_stdio;
+    int first_product_index = 1;
+
+    if (argc > 1 && strcmp(argv[1], "-mmap") == 0) {
+        io_mode = e_io_mmap;
+        first_product_index = 2;
+    }
+    if (argc <= first_product_index) {
+        printf("usage: %s [-mmap] <product> [<product>, ...]\n", argv[0]);
         return 1;
     }
 
@@ -28,9 +38,9 @@ int main(int argc, char *argv[])
 
     uint checksum = 0;
     int product_index;
-    for (product_index = 1; product_index < argc; product_index++) {
+    for (product_index = first_product_index; product_index < argc; product_index++) {
         const char *product_name = argv[product_index];
-        EPR_SProductId *product_id = epr_open_product(product_name);
+        EPR_SProductId *product_id = epr_open_product_ex(product_name, io_mode);
         if (product_id == NULL) {
             printf("Error opening product %s: %s\n", product_name, epr_get_last_err_message());
             return 1;
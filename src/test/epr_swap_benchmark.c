@@ -0,0 +1,96 @@
+/*
+ * Micro-benchmark for the byte swap kernels used by epr_swap_endian_order().
+ * Reports the throughput in GB/s for each element width and each
+ * instruction set supported by the CPU.
+ *
+ * usage: epr_swap_benchmark [<buffer size in KiB> [<repetitions>]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../epr_api.h"
+#include "../epr_core.h"
+#include "../epr_band.h"
+#include "../epr_simd.h"
+
+typedef void (*ByteSwapFunc)(void* buffer, uint number_of_swaps);
+
+static const struct
+{
+    const char* name;
+    uint cpu_features;
+} tiers[] = {
+    {"scalar", 0},
+    {"SSE2",   EPR_CPU_SSE2},
+    {"AVX2",   EPR_CPU_SSE2 | EPR_CPU_AVX2},
+    {"NEON",   EPR_CPU_NEON}
+};
+
+static const struct
+{
+    int elem_size;
+    ByteSwapFunc swap_func;
+} widths[] = {
+    {2, epr_byte_swap_16},
+    {4, epr_byte_swap_32},
+    {8, epr_byte_swap_64}
+};
+
+
+int main(int argc, char** argv)
+{
+    uint cpu_features = epr_detect_cpu_features();
+    uint num_bytes = 256 * 1024;
+    int num_reps = 4000;
+    uchar* buffer;
+    clock_t start;
+    double secs;
+    int t, w, r;
+
+    if (argc > 1) {
+        num_bytes = (uint) atoi(argv[1]) * 1024;
+    }
+    if (argc > 2) {
+        num_reps = atoi(argv[2]);
+    }
+    if (num_bytes == 0 || num_reps <= 0) {
+        fprintf(stderr, "usage: %s [<buffer size in KiB> [<repetitions>]]\n", argv[0]);
+        return 1;
+    }
+
+    buffer = (uchar*) malloc(num_bytes);
+    if (buffer == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    memset(buffer, 0x5a, num_bytes);
+
+    printf("buffer size %u KiB, %d repetitions\n", num_bytes / 1024, num_reps);
+    printf("%-8s %10s %10s %10s\n", "kernel", "16 bit", "32 bit", "64 bit");
+    for (t = 0; t < (int) (sizeof (tiers) / sizeof (tiers[0])); t++) {
+        if ((cpu_features & tiers[t].cpu_features) != tiers[t].cpu_features) {
+            continue;
+        }
+        epr_api.cpu_features = tiers[t].cpu_features;
+        printf("%-8s", tiers[t].name);
+        for (w = 0; w < (int) (sizeof (widths) / sizeof (widths[0])); w++) {
+            start = clock();
+            for (r = 0; r < num_reps; r++) {
+                widths[w].swap_func(buffer, num_bytes / widths[w].elem_size);
+            }
+            secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+            if (secs > 0.0) {
+                printf(" %5.2f GB/s", (double) num_bytes * num_reps / secs / 1.0e9);
+            } else {
+                printf(" %10s", "n/a");
+            }
+        }
+        printf("\n");
+    }
+
+    free(buffer);
+    return 0;
+}
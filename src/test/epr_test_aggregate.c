@@ -0,0 +1,229 @@
+/*
+ * Checks the aggregation of epr_read_band_pyramid on small hand-built
+ * regions: the size of the levels, the mean, minimum, maximum and mode of
+ * full and clipped blocks, and that invalid pixels are left out of their
+ * blocks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../epr_api.h"
+#include "../epr_core.h"
+#include "../epr_band.h"
+
+#define SOURCE_WIDTH  13
+#define SOURCE_HEIGHT 9
+
+static const char* method_names[] = {"mean", "min", "max", "mode"};
+
+static uint random_state = 815;
+
+static uint next_random(void)
+{
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 16) & 0x7fff;
+}
+
+
+static int compare_values(const void* value1, const void* value2)
+{
+    double v1 = *(const double*) value1;
+    double v2 = *(const double*) value2;
+    return v1 < v2 ? -1 : (v1 > v2 ? 1 : 0);
+}
+
+
+/* aggregates one block pixel by pixel, 0 if it has no valid pixels */
+static double aggregate_block(const double* source, const uchar* valid,
+                              uint x0, uint y0, uint step_x, uint step_y, EPR_EAggregationMethod method)
+{
+    double values[SOURCE_WIDTH * SOURCE_HEIGHT];
+    double result = 0.0;
+    uint count = 0;
+    uint x, y, i, run, max_run;
+
+    for (y = y0; y < y0 + step_y && y < SOURCE_HEIGHT; y++) {
+        for (x = x0; x < x0 + step_x && x < SOURCE_WIDTH; x++) {
+            if (valid == NULL || valid[y * SOURCE_WIDTH + x] != 0) {
+                values[count++] = source[y * SOURCE_WIDTH + x];
+            }
+        }
+    }
+    if (count == 0) {
+        return 0.0;
+    }
+    qsort(values, count, sizeof (double), compare_values);
+    switch (method) {
+    case e_agg_mean:
+        for (i = 0; i < count; i++) {
+            result += values[i];
+        }
+        return result / count;
+    case e_agg_min:
+        return values[0];
+    case e_agg_max:
+        return values[count - 1];
+    case e_agg_mode:
+        result = values[0];
+        run = max_run = 1;
+        for (i = 1; i < count; i++) {
+            run = values[i] == values[i - 1] ? run + 1 : 1;
+            if (run > max_run) {
+                max_run = run;
+                result = values[i];
+            }
+        }
+        return result;
+    }
+    return 0.0;
+}
+
+
+static void aggregate(EPR_SRaster** levels, uint num_levels, EPR_EAggregationMethod method,
+                      const double* source, const uchar* valid)
+{
+    EPR_SAggregator* aggregator = epr_create_aggregator(levels, num_levels, method);
+    uint y;
+
+    for (y = 0; y < SOURCE_HEIGHT; y++) {
+        epr_aggregate_line(aggregator, source + y * SOURCE_WIDTH, valid != NULL ? valid + y * SOURCE_WIDTH : NULL);
+    }
+    epr_free_aggregator(aggregator);
+}
+
+
+/* aggregates a random region into the levels of a pyramid, all at once */
+static int check_pyramid(EPR_EAggregationMethod method, epr_boolean masked)
+{
+    static const uint steps[][2] = {{1, 1}, {2, 2}, {3, 2}, {4, 4}, {5, 3}, {16, 16}};
+    const uint num_levels = sizeof (steps) / sizeof (steps[0]);
+    EPR_SRaster* levels[sizeof (steps) / sizeof (steps[0])];
+    double source[SOURCE_WIDTH * SOURCE_HEIGHT];
+    uchar valid[SOURCE_WIDTH * SOURCE_HEIGHT];
+    double expected;
+    uint i, x, y;
+    int failures = 0;
+
+    for (i = 0; i < SOURCE_WIDTH * SOURCE_HEIGHT; i++) {
+        /* few distinct values, so that the modes are meaningful */
+        source[i] = (double) (next_random() % 5) - 1.5;
+        valid[i] = (uchar) (next_random() % 4 != 0);
+    }
+    for (i = 0; i < num_levels; i++) {
+        levels[i] = epr_create_raster(e_tid_double, SOURCE_WIDTH, SOURCE_HEIGHT, steps[i][0], steps[i][1]);
+    }
+
+    aggregate(levels, num_levels, method, source, masked ? valid : NULL);
+
+    for (i = 0; i < num_levels; i++) {
+        for (y = 0; y < levels[i]->raster_height; y++) {
+            for (x = 0; x < levels[i]->raster_width; x++) {
+                expected = aggregate_block(source, masked ? valid : NULL,
+                                           x * steps[i][0], y * steps[i][1], steps[i][0], steps[i][1], method);
+                if (((double*) levels[i]->buffer)[y * levels[i]->raster_width + x] != expected) {
+                    printf("%s%s, step %ux%u: block %u,%u differs\n", method_names[method],
+                           masked ? " masked" : "", steps[i][0], steps[i][1], x, y);
+                    failures++;
+                    y = levels[i]->raster_height;
+                    break;
+                }
+            }
+        }
+        epr_free_raster(levels[i]);
+    }
+    return failures;
+}
+
+
+/* the level sizes cover the clipped blocks of the last column and row */
+static int check_level_sizes(void)
+{
+    static const uint cases[][4] = {
+        /* step x, step y, raster width, raster height */
+        {1, 1, 13, 9}, {2, 2, 7, 5}, {3, 2, 5, 5}, {4, 4, 4, 3}, {8, 8, 2, 2}, {13, 9, 1, 1}, {16, 16, 1, 1}
+    };
+    EPR_SRaster* raster;
+    uint i;
+    int failures = 0;
+
+    for (i = 0; i < sizeof (cases) / sizeof (cases[0]); i++) {
+        raster = epr_create_raster(e_tid_float, SOURCE_WIDTH, SOURCE_HEIGHT, cases[i][0], cases[i][1]);
+        if (raster->raster_width != cases[i][2] || raster->raster_height != cases[i][3]) {
+            printf("step %ux%u: level of %ux%u pixels instead of %ux%u\n", cases[i][0], cases[i][1],
+                   raster->raster_width, raster->raster_height, cases[i][2], cases[i][3]);
+            failures++;
+        }
+        epr_free_raster(raster);
+    }
+    return failures;
+}
+
+
+/*
+ * A 3x2 region in 2x2 blocks, the second block is clipped:
+ *   1 2 9
+ *   4 4 9
+ */
+static int check_hand_built(void)
+{
+    static const double source[] = {1, 2, 9, 4, 4, 9};
+    /* the second 4 and both 9s are invalid */
+    static const uchar valid[] = {1, 1, 0, 1, 0, 0};
+    static const ushort expected[4][2] = {{3, 9}, {1, 9}, {4, 9}, {4, 9}};
+    static const ushort expected_masked[4][2] = {{2, 0}, {1, 0}, {4, 0}, {1, 0}};
+    EPR_SRaster* raster;
+    EPR_SAggregator* aggregator;
+    uint m;
+    int failures = 0;
+
+    for (m = e_agg_mean; m <= e_agg_mode; m++) {
+        raster = epr_create_raster(e_tid_ushort, 3, 2, 2, 2);
+
+        /* the mean 2.75 is rounded to 3 */
+        aggregator = epr_create_aggregator(&raster, 1, (EPR_EAggregationMethod) m);
+        epr_aggregate_line(aggregator, source, NULL);
+        epr_aggregate_line(aggregator, source + 3, NULL);
+        epr_free_aggregator(aggregator);
+        if (((ushort*) raster->buffer)[0] != expected[m][0] || ((ushort*) raster->buffer)[1] != expected[m][1]) {
+            printf("%s: %u %u instead of %u %u\n", method_names[m],
+                   ((ushort*) raster->buffer)[0], ((ushort*) raster->buffer)[1], expected[m][0], expected[m][1]);
+            failures++;
+        }
+
+        /* the masked mean is 7 / 3, the mode of 1, 2, 4 is the smallest value */
+        aggregator = epr_create_aggregator(&raster, 1, (EPR_EAggregationMethod) m);
+        epr_aggregate_line(aggregator, source, valid);
+        epr_aggregate_line(aggregator, source + 3, valid + 3);
+        epr_free_aggregator(aggregator);
+        if (((ushort*) raster->buffer)[0] != expected_masked[m][0] || ((ushort*) raster->buffer)[1] != expected_masked[m][1]) {
+            printf("%s masked: %u %u instead of %u %u\n", method_names[m],
+                   ((ushort*) raster->buffer)[0], ((ushort*) raster->buffer)[1], expected_masked[m][0], expected_masked[m][1]);
+            failures++;
+        }
+        epr_free_raster(raster);
+    }
+    return failures;
+}
+
+
+int main(int argc, char** argv)
+{
+    uint m;
+    int failures = 0;
+
+    failures += check_level_sizes();
+    failures += check_hand_built();
+    for (m = e_agg_mean; m <= e_agg_mode; m++) {
+        failures += check_pyramid((EPR_EAggregationMethod) m, FALSE);
+        failures += check_pyramid((EPR_EAggregationMethod) m, TRUE);
+    }
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Checks that compiled bitmask programs produce the same bit-masks as the
+ * pixel interpreter epr_eval_bm_term for and, or, not, constant terms and
+ * lines on which the short-circuit skip instructions are taken.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../epr_api.h"
+#include "../epr_core.h"
+#include "../epr_ptrarray.h"
+#include "../epr_bitmask.h"
+
+#define TEST_WIDTH  37
+#define TEST_HEIGHT 8
+
+/* the flags of the test rasters, Z is a constant (always true) term */
+static const char* flag_names[] = {"A", "B", "C", "AB", "Z"};
+static const uint flag_masks[] = {1, 2, 4, 3, 0};
+
+static const char* exprs[] = {
+    "f.A",
+    "not f.A",
+    "f.AB",
+    "f.A and g.B",
+    "f.A or g.B",
+    "not f.A and g.C",
+    "f.A and not (g.B or f.C)",
+    "(f.A or f.B) and (g.A or not g.C)",
+    "f.A and g.A and f.B or g.C or not f.C",
+    "f.Z and g.A",
+    "not f.Z or g.B",
+    "g.Z or f.C"
+};
+
+static uint random_state = 12345;
+
+static uint next_random(void)
+{
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 16) & 0x7fff;
+}
+
+
+/* resolves the references of the term to the test rasters */
+static void resolve_refs(EPR_SBmTerm* term, EPR_SRaster* f, EPR_SRaster* g)
+{
+    uint i;
+
+    switch (term->op_code) {
+    case BMT_REF:
+        term->op.ref.flag_raster = strcmp(term->op.ref.band_name, "f") == 0 ? f : g;
+        term->op.ref.flag_mask = FLAG_MASK_NOT_COMPUTED;
+        for (i = 0; i < sizeof (flag_names) / sizeof (flag_names[0]); i++) {
+            if (strcmp(term->op.ref.flag_name, flag_names[i]) == 0) {
+                term->op.ref.flag_mask = flag_masks[i];
+            }
+        }
+        break;
+    case BMT_AND:
+    case BMT_OR:
+        resolve_refs(term->op.binary.arg1, f, g);
+        resolve_refs(term->op.binary.arg2, f, g);
+        break;
+    case BMT_NOT:
+        resolve_refs(term->op.unary.arg, f, g);
+        break;
+    default:
+        break;
+    }
+}
+
+
+static int check_expr(EPR_SBmEvalContext* context, const char* expr, EPR_SRaster* f, EPR_SRaster* g)
+{
+    EPR_SBmTerm* term;
+    EPR_SBmProgram* program;
+    uchar line[TEST_WIDTH];
+    uint x, y;
+    int failures = 0;
+
+    term = epr_parse_bm_expr_str(expr);
+    if (term == NULL) {
+        printf("%s: cannot parse\n", expr);
+        return 1;
+    }
+    resolve_refs(term, f, g);
+    program = epr_compile_bm_term(context, term);
+    if (program == NULL) {
+        printf("%s: cannot compile\n", expr);
+        epr_free_bm_term(term);
+        return 1;
+    }
+    for (y = 0; y < TEST_HEIGHT; y++) {
+        epr_eval_bm_program(context, program, y, line);
+        for (x = 0; x < TEST_WIDTH; x++) {
+            if (line[x] != (uchar) epr_eval_bm_term(context, term, (int) x, (int) y)) {
+                printf("%s: line %u differs at pixel %u\n", expr, y, x);
+                failures++;
+                break;
+            }
+        }
+    }
+    epr_free_bm_program(program);
+    epr_free_bm_term(term);
+    return failures;
+}
+
+
+/* checks that the second operand is not read on lines the first one decides */
+static int check_skip(EPR_SBmEvalContext* context, const char* expr, uint y, EPR_SRaster* f, EPR_SRaster* g)
+{
+    EPR_SBmTerm* term;
+    EPR_SBmProgram* program;
+    uchar line[TEST_WIDTH];
+    int failures = 0;
+
+    term = epr_parse_bm_expr_str(expr);
+    resolve_refs(term, f, g);
+    program = epr_compile_bm_term(context, term);
+    if (program == NULL) {
+        printf("%s: cannot compile\n", expr);
+        epr_free_bm_term(term);
+        return 1;
+    }
+    epr_eval_bm_program(context, program, y, line);
+    /* g is the second flag raster of the context */
+    if (program->flag_words[1] != NULL) {
+        printf("%s: second operand evaluated on line %u\n", expr, y);
+        failures++;
+    }
+    epr_free_bm_program(program);
+    epr_free_bm_term(term);
+    return failures;
+}
+
+
+int main(int argc, char** argv)
+{
+    EPR_SBmEvalContext* context;
+    EPR_SRaster* bm_raster;
+    EPR_SRaster* f;
+    EPR_SRaster* g;
+    uint x, y, e;
+    int failures = 0;
+
+    bm_raster = epr_create_bitmask_raster(TEST_WIDTH, TEST_HEIGHT, 1, 1);
+    f = epr_create_raster(e_tid_uchar, TEST_WIDTH, TEST_HEIGHT, 1, 1);
+    g = epr_create_raster(e_tid_ushort, TEST_WIDTH, TEST_HEIGHT, 1, 1);
+
+    /* f is constant on the first lines, so that the skip instructions are taken */
+    for (y = 0; y < TEST_HEIGHT; y++) {
+        for (x = 0; x < TEST_WIDTH; x++) {
+            ((uchar*) f->buffer)[y * TEST_WIDTH + x] = (uchar) (y == 0 ? 0 : y == 1 ? 0xff : next_random());
+            ((ushort*) g->buffer)[y * TEST_WIDTH + x] = (ushort) (y == 3 ? 0 : next_random());
+        }
+    }
+
+    context = epr_create_bm_eval_context(NULL, 0, 0, bm_raster);
+    epr_add_ptr_array_elem(context->flag_band_ids, NULL);
+    epr_add_ptr_array_elem(context->flag_rasters, f);
+    epr_add_ptr_array_elem(context->flag_band_ids, NULL);
+    epr_add_ptr_array_elem(context->flag_rasters, g);
+
+    for (e = 0; e < sizeof (exprs) / sizeof (exprs[0]); e++) {
+        failures += check_expr(context, exprs[e], f, g);
+    }
+    failures += check_skip(context, "f.A and g.B", 0, f, g);
+    failures += check_skip(context, "f.A or g.B", 1, f, g);
+    failures += check_skip(context, "not f.A or g.B", 0, f, g);
+
+    /* the rasters belong to the test, not to a product's bitmask cache */
+    epr_free_ptr_array(context->flag_band_ids);
+    epr_free_ptr_array(context->flag_rasters);
+    free(context);
+    epr_free_raster(f);
+    epr_free_raster(g);
+    epr_free_raster(bm_raster);
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
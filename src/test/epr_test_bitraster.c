@@ -0,0 +1,263 @@
+/*
+ * Checks the operations on packed bit-mask rasters (and, or, not, the valid
+ * pixel count and applying a bit-mask) against byte-per-pixel references,
+ * for widths around multiples of the word size, so that lines end within,
+ * at and just after a word.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../epr_api.h"
+
+#define TEST_HEIGHT 3
+
+static uint random_state = 4711;
+
+static uint next_random(void)
+{
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 16) & 0x7fff;
+}
+
+
+static ulong* get_line(const EPR_SRaster* raster, uint y)
+{
+    return (ulong*) raster->buffer + y * EPR_BITMASK_LINE_WORDS(raster->raster_width);
+}
+
+
+static uint get_bit(const EPR_SRaster* raster, uint x, uint y)
+{
+    return (uint) ((get_line(raster, y)[x / EPR_BITMASK_WORD_BITS] >> (x % EPR_BITMASK_WORD_BITS)) & 1);
+}
+
+
+/* creates a packed raster having the bits of the given byte-per-pixel mask */
+static EPR_SRaster* create_packed(const uchar* mask, uint width)
+{
+    EPR_SRaster* raster = epr_create_packed_bitmask_raster(width, TEST_HEIGHT, 1, 1);
+    uint x, y;
+
+    for (y = 0; y < TEST_HEIGHT; y++) {
+        for (x = 0; x < width; x++) {
+            if (mask[y * width + x] != 0) {
+                get_line(raster, y)[x / EPR_BITMASK_WORD_BITS] |= 1UL << (x % EPR_BITMASK_WORD_BITS);
+            }
+        }
+    }
+    return raster;
+}
+
+
+static uint count_mask(const uchar* mask, uint width)
+{
+    uint count = 0;
+    uint i;
+
+    for (i = 0; i < width * TEST_HEIGHT; i++) {
+        count += mask[i] != 0;
+    }
+    return count;
+}
+
+
+/* compares a packed raster with its expected byte-per-pixel mask, including the padding bits */
+static int check_bits(const char* what, const EPR_SRaster* raster, const uchar* expected, uint width)
+{
+    uint num_words = EPR_BITMASK_LINE_WORDS(width);
+    uint num_bits = width % EPR_BITMASK_WORD_BITS;
+    uint x, y;
+
+    for (y = 0; y < TEST_HEIGHT; y++) {
+        for (x = 0; x < width; x++) {
+            if (get_bit(raster, x, y) != (uint) (expected[y * width + x] != 0)) {
+                printf("%s, width %u: pixel %u of line %u differs\n", what, width, x, y);
+                return 1;
+            }
+        }
+        if (num_bits != 0 && (get_line(raster, y)[num_words - 1] >> num_bits) != 0) {
+            printf("%s, width %u: padding bits of line %u are set\n", what, width, y);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+static int check_width(uint width)
+{
+    uint size = width * TEST_HEIGHT;
+    uchar* a = (uchar*) malloc(size);
+    uchar* b = (uchar*) malloc(size);
+    uchar* expected = (uchar*) malloc(size);
+    EPR_SRaster* packed_a;
+    EPR_SRaster* packed_b;
+    EPR_SRaster* raster;
+    EPR_SRaster* byte_mask;
+    uint i;
+    int failures = 0;
+
+    for (i = 0; i < size; i++) {
+        a[i] = (uchar) (next_random() % 3 != 0);
+        b[i] = (uchar) (next_random() % 2);
+    }
+    packed_a = create_packed(a, width);
+    packed_b = create_packed(b, width);
+
+    if (epr_count_valid_pixels(packed_a) != count_mask(a, width)) {
+        printf("count, width %u: %u instead of %u\n", width, epr_count_valid_pixels(packed_a), count_mask(a, width));
+        failures++;
+    }
+
+    raster = create_packed(a, width);
+    for (i = 0; i < size; i++) {
+        expected[i] = (uchar) (a[i] && b[i]);
+    }
+    if (epr_and_bitmask_rasters(raster, packed_b) != e_err_none) {
+        printf("and, width %u: error\n", width);
+        failures++;
+    }
+    failures += check_bits("and", raster, expected, width);
+    epr_free_raster(raster);
+
+    raster = create_packed(a, width);
+    for (i = 0; i < size; i++) {
+        expected[i] = (uchar) (a[i] || b[i]);
+    }
+    if (epr_or_bitmask_rasters(raster, packed_b) != e_err_none) {
+        printf("or, width %u: error\n", width);
+        failures++;
+    }
+    failures += check_bits("or", raster, expected, width);
+    epr_free_raster(raster);
+
+    /* not clears the padding bits again, so that the count stays right */
+    raster = create_packed(a, width);
+    for (i = 0; i < size; i++) {
+        expected[i] = (uchar) !a[i];
+    }
+    if (epr_not_bitmask_raster(raster) != e_err_none) {
+        printf("not, width %u: error\n", width);
+        failures++;
+    }
+    failures += check_bits("not", raster, expected, width);
+    if (epr_count_valid_pixels(raster) != size - count_mask(a, width)) {
+        printf("not, width %u: %u valid pixels instead of %u\n", width, epr_count_valid_pixels(raster), size - count_mask(a, width));
+        failures++;
+    }
+    epr_free_raster(raster);
+
+    /* a packed and a byte-per-pixel bit-mask zero the same pixels */
+    raster = epr_create_raster(e_tid_float, width, TEST_HEIGHT, 1, 1);
+    for (i = 0; i < size; i++) {
+        ((float*) raster->buffer)[i] = (float) i + 1.0F;
+    }
+    if (epr_apply_bitmask(raster, packed_a) != e_err_none) {
+        printf("apply, width %u: error\n", width);
+        failures++;
+    }
+    for (i = 0; i < size; i++) {
+        if (((float*) raster->buffer)[i] != (a[i] ? (float) i + 1.0F : 0.0F)) {
+            printf("apply, width %u: pixel %u differs\n", width, i);
+            failures++;
+            break;
+        }
+    }
+    epr_free_raster(raster);
+
+    raster = epr_create_raster(e_tid_ushort, width, TEST_HEIGHT, 1, 1);
+    byte_mask = epr_create_raster(e_tid_uchar, width, TEST_HEIGHT, 1, 1);
+    memcpy(byte_mask->buffer, b, size);
+    for (i = 0; i < size; i++) {
+        ((ushort*) raster->buffer)[i] = (ushort) (i + 1);
+    }
+    if (epr_apply_bitmask(raster, byte_mask) != e_err_none) {
+        printf("apply bytes, width %u: error\n", width);
+        failures++;
+    }
+    for (i = 0; i < size; i++) {
+        if (((ushort*) raster->buffer)[i] != (b[i] ? (ushort) (i + 1) : 0)) {
+            printf("apply bytes, width %u: pixel %u differs\n", width, i);
+            failures++;
+            break;
+        }
+    }
+    if (epr_count_valid_pixels(byte_mask) != count_mask(b, width)) {
+        printf("count bytes, width %u: %u instead of %u\n", width, epr_count_valid_pixels(byte_mask), count_mask(b, width));
+        failures++;
+    }
+    epr_free_raster(byte_mask);
+    epr_free_raster(raster);
+
+    epr_free_raster(packed_a);
+    epr_free_raster(packed_b);
+    free(a);
+    free(b);
+    free(expected);
+    return failures;
+}
+
+
+/* rasters of different sizes or types cannot be combined */
+static int check_errors(void)
+{
+    EPR_SRaster* narrow = epr_create_packed_bitmask_raster(10, TEST_HEIGHT, 1, 1);
+    EPR_SRaster* wide = epr_create_packed_bitmask_raster(11, TEST_HEIGHT, 1, 1);
+    EPR_SRaster* bytes = epr_create_raster(e_tid_uchar, 10, TEST_HEIGHT, 1, 1);
+    int failures = 0;
+
+    if (epr_and_bitmask_rasters(narrow, wide) == e_err_none) {
+        printf("and: rasters of different sizes accepted\n");
+        failures++;
+    }
+    if (epr_or_bitmask_rasters(narrow, bytes) == e_err_none) {
+        printf("or: byte-per-pixel raster accepted\n");
+        failures++;
+    }
+    if (epr_not_bitmask_raster(bytes) == e_err_none) {
+        printf("not: byte-per-pixel raster accepted\n");
+        failures++;
+    }
+    if (epr_apply_bitmask(bytes, wide) == e_err_none) {
+        printf("apply: rasters of different sizes accepted\n");
+        failures++;
+    }
+    epr_free_raster(narrow);
+    epr_free_raster(wide);
+    epr_free_raster(bytes);
+    return failures;
+}
+
+
+int main(int argc, char** argv)
+{
+    const uint w = EPR_BITMASK_WORD_BITS;
+    uint widths[8];
+    uint i;
+    int failures = 0;
+
+    widths[0] = 1;
+    widths[1] = 7;
+    widths[2] = w - 1;
+    widths[3] = w;
+    widths[4] = w + 1;
+    widths[5] = 2 * w;
+    widths[6] = 2 * w + 3;
+    widths[7] = 3 * w - 1;
+
+    epr_init_api(e_log_warning, NULL, NULL);
+    for (i = 0; i < sizeof (widths) / sizeof (widths[0]); i++) {
+        failures += check_width(widths[i]);
+    }
+    failures += check_errors();
+    epr_close_api();
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ * Checks that the SIMD line decoders produce bit-identical results to the
+ * scalar decoders for all supported instruction sets, and that the big
+ * endian decoders match the host order decoders applied to swapped samples.
+ * Also checks the byte swap kernels, the log scaling lookup tables and the
+ * tie point interpolation kernels.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "../epr_api.h"
+#include "../epr_core.h"
+#include "../epr_band.h"
+#include "../epr_swap.h"
+#include "../epr_simd.h"
+
+typedef struct
+{
+    const char* name;
+    EPR_FLineDecoder decode_func;
+    int pixel_size;
+    int raster_elem_size;
+    EPR_FLineDecoder host_order_func;
+} TestDecoder;
+
+static const TestDecoder decoders[] = {
+    {"uchar_1_of_1_to_float",      decode_line_uchar_1_of_1_to_float,      1, 4, NULL},
+    {"char_1_of_1_to_float",       decode_line_char_1_of_1_to_float,       1, 4, NULL},
+    {"ushort_1_of_1_to_float",     decode_line_ushort_1_of_1_to_float,     2, 4, NULL},
+    {"short_1_of_1_to_float",      decode_line_short_1_of_1_to_float,      2, 4, NULL},
+    {"short_1_of_2_to_float",      decode_line_short_1_of_2_to_float,      4, 4, NULL},
+    {"short_2_of_2_to_float",      decode_line_short_2_of_2_to_float,      4, 4, NULL},
+    {"uchar_1_of_2_to_float",      decode_line_uchar_1_of_2_to_float,      2, 4, NULL},
+    {"uchar_2_of_2_to_float",      decode_line_uchar_2_of_2_to_float,      2, 4, NULL},
+    {"uchar_2_to_f_to_float",      decode_line_uchar_2_to_f_to_float,      2, 4, NULL},
+    {"uchar_3_to_i_to_uint",       decode_line_uchar_3_to_i_to_uint,       3, 4, NULL},
+    {"uchar_1_of_1_to_uchar",      decode_line_uchar_1_of_1_to_uchar,      1, 1, NULL},
+    {"uchar_1_of_2_to_uchar",      decode_line_uchar_1_of_2_to_uchar,      2, 1, NULL},
+    {"uchar_2_of_2_to_uchar",      decode_line_uchar_2_of_2_to_uchar,      2, 1, NULL},
+    {"ushort_1_of_1_to_ushort",    decode_line_ushort_1_of_1_to_ushort,    2, 2, NULL},
+    {"ushort_1_of_1_be_to_float",  decode_line_ushort_1_of_1_be_to_float,  2, 4, decode_line_ushort_1_of_1_to_float},
+    {"short_1_of_1_be_to_float",   decode_line_short_1_of_1_be_to_float,   2, 4, decode_line_short_1_of_1_to_float},
+    {"short_1_of_2_be_to_float",   decode_line_short_1_of_2_be_to_float,   4, 4, decode_line_short_1_of_2_to_float},
+    {"short_2_of_2_be_to_float",   decode_line_short_2_of_2_be_to_float,   4, 4, decode_line_short_2_of_2_to_float},
+    {"ushort_1_of_1_be_to_ushort", decode_line_ushort_1_of_1_be_to_ushort, 2, 2, decode_line_ushort_1_of_1_to_ushort}
+};
+
+static const EPR_EScalingMethod scalings[] = {e_smid_non, e_smid_lin, e_smid_log};
+
+
+/* compares the decoder with one applied to an equivalent source */
+static int compare_decoders(const char* name,
+                            EPR_FLineDecoder expected_func,
+                            EPR_FLineDecoder actual_func,
+                            int swap_source,
+                            int pixel_size,
+                            int raster_elem_size)
+{
+    EPR_SProductId product_id;
+    EPR_SBandId band_id;
+    uchar* source;
+    uchar* swapped;
+    uchar* expected;
+    uchar* actual;
+    int s, offset_x, raster_width, step_x, num_pixels, num_bytes, i;
+    int failures = 0;
+
+    memset(&product_id, 0, sizeof (product_id));
+    memset(&band_id, 0, sizeof (band_id));
+    band_id.product_id = &product_id;
+    band_id.scaling_offset = -3.25F;
+    band_id.scaling_factor = 0.0123F;
+
+    for (s = 0; s < (int) (sizeof (scalings) / sizeof (scalings[0])); s++) {
+        band_id.scaling_method = scalings[s];
+        for (step_x = 1; step_x <= 5; step_x++) {
+            for (offset_x = 0; offset_x <= 3; offset_x++) {
+                for (raster_width = 0; raster_width <= 90; raster_width++) {
+                    /* the source ends exactly with the last pixel to detect over-reads */
+                    num_bytes = (offset_x + raster_width) * pixel_size;
+                    num_pixels = raster_width > 0 ? (raster_width - 1) / step_x + 1 : 0;
+                    source = (uchar*) malloc(num_bytes + 1);
+                    swapped = (uchar*) malloc(num_bytes + 1);
+                    expected = (uchar*) calloc(num_pixels + 2, raster_elem_size);
+                    actual = (uchar*) calloc(num_pixels + 2, raster_elem_size);
+                    for (i = 0; i < num_bytes; i++) {
+                        source[i] = (uchar) rand();
+                    }
+                    for (i = 0; i < num_bytes; i++) {
+                        swapped[i] = swap_source ? source[i ^ 1] : source[i];
+                    }
+                    expected_func(swapped, &band_id, offset_x, raster_width, step_x, expected, 1);
+                    actual_func(source, &band_id, offset_x, raster_width, step_x, actual, 1);
+                    if (memcmp(expected, actual, (num_pixels + 2) * raster_elem_size) != 0) {
+                        printf("%s: mismatch for scaling %d, offset %d, width %d, step %d\n",
+                               name, (int) scalings[s], offset_x, raster_width, step_x);
+                        failures++;
+                    }
+                    free(source);
+                    free(swapped);
+                    free(expected);
+                    free(actual);
+                }
+            }
+        }
+    }
+    epr_free_log_scaling_lut(&band_id);
+    return failures;
+}
+
+
+static int check_decoder(const TestDecoder* decoder, uint cpu_features)
+{
+    EPR_FLineDecoder simd_func = epr_select_simd_line_decoder(decoder->decode_func, cpu_features);
+
+    if (simd_func == decoder->decode_func) {
+        return 0;
+    }
+    return compare_decoders(decoder->name, decoder->decode_func, simd_func, 0,
+                            decoder->pixel_size, decoder->raster_elem_size);
+}
+
+
+/* compares the byte swap kernels with a plain reversal of the bytes */
+static int check_byte_swaps(uint cpu_features)
+{
+    static void (*const swap_funcs[])(void*, uint) = {epr_byte_swap_16, epr_byte_swap_32, epr_byte_swap_64};
+    uchar source[8 * 70], expected[8 * 70], actual[8 * 70];
+    int w, n, i, elem_size;
+    int failures = 0;
+
+    epr_api.cpu_features = cpu_features;
+    for (w = 0; w < 3; w++) {
+        elem_size = 2 << w;
+        for (n = 0; n < 70; n++) {
+            for (i = 0; i < (int) sizeof (source); i++) {
+                source[i] = (uchar) rand();
+            }
+            memcpy(expected, source, sizeof (source));
+            for (i = 0; i < n * elem_size; i++) {
+                expected[i] = source[i - i % elem_size + elem_size - 1 - i % elem_size];
+            }
+            memcpy(actual, source, sizeof (source));
+            swap_funcs[w](actual, n);
+            if (memcmp(expected, actual, sizeof (source)) != 0) {
+                printf("byte_swap_%d: mismatch for features 0x%x, %d words\n", 8 * elem_size, cpu_features, n);
+                failures++;
+            }
+        }
+    }
+    epr_api.cpu_features = 0;
+    return failures;
+}
+
+
+/* compares the tie point interpolation kernels with epr_interpolate2D() */
+static int check_tie_point_interpolation(uint cpu_features)
+{
+    float x00[40], x10[40], x01[40], x11[40], wx[40];
+    float p0[40], dy[40], dxy[40], expected[40], actual[40];
+    float wy;
+    int n, i;
+    int failures = 0;
+
+    epr_api.cpu_features = cpu_features;
+    for (n = 0; n <= 40; n++) {
+        wy = (float) rand() / RAND_MAX;
+        for (i = 0; i < n; i++) {
+            x00[i] = (float) (rand() % 36000) / 100.0F - 180.0F;
+            x10[i] = (float) (rand() % 36000) / 100.0F - 180.0F;
+            x01[i] = (float) (rand() % 36000) / 100.0F - 180.0F;
+            x11[i] = (float) (rand() % 36000) / 100.0F - 180.0F;
+            wx[i] = (float) rand() / RAND_MAX;
+            p0[i] = x00[i] + wx[i] * (x10[i] - x00[i]);
+            dy[i] = x01[i] - x00[i];
+            dxy[i] = x11[i] + x00[i] - x01[i] - x10[i];
+            expected[i] = epr_interpolate2D(wx[i], wy, x00[i], x10[i], x01[i], x11[i]);
+        }
+        epr_interpolate_tie_point_line(p0, dy, dxy, wx, wy, (uint) n, actual);
+        if (n > 0 && memcmp(expected, actual, n * sizeof (float)) != 0) {
+            printf("interpolate_tie_point_line: mismatch for features 0x%x, %d columns\n", cpu_features, n);
+            failures++;
+        }
+    }
+    epr_api.cpu_features = 0;
+    return failures;
+}
+
+
+/* compares the log scaling lookup tables with a direct pow() of each raw value */
+static int check_log_scaling_luts(void)
+{
+    static const EPR_EDataTypeId raw_types[] = {e_tid_uchar, e_tid_char, e_tid_ushort, e_tid_short};
+    EPR_SProductId product_id;
+    EPR_SBandId band_id;
+    const float* lut;
+    float expected;
+    int t, v, v_min, v_max;
+    int failures = 0;
+
+    memset(&product_id, 0, sizeof (product_id));
+    memset(&band_id, 0, sizeof (band_id));
+    band_id.product_id = &product_id;
+    band_id.scaling_method = e_smid_log;
+    band_id.scaling_offset = -3.25F;
+    band_id.scaling_factor = 0.0123F;
+
+    for (t = 0; t < (int) (sizeof (raw_types) / sizeof (raw_types[0])); t++) {
+        switch (raw_types[t]) {
+            case e_tid_uchar:  v_min = 0;         v_max = UCHAR_MAX; break;
+            case e_tid_char:   v_min = CHAR_MIN;  v_max = CHAR_MAX;  break;
+            case e_tid_ushort: v_min = 0;         v_max = USHRT_MAX; break;
+            default:           v_min = SHRT_MIN;  v_max = SHRT_MAX;  break;
+        }
+        lut = epr_get_log_scaling_lut(&band_id, raw_types[t]);
+        if (lut == NULL) {
+            printf("log_scaling_lut: no table for type %d\n", (int) raw_types[t]);
+            failures++;
+            continue;
+        }
+        for (v = v_min; v <= v_max; v++) {
+            expected = (float)pow(10, band_id.scaling_offset + band_id.scaling_factor * v);
+            if (memcmp(&expected, &lut[v & (v_max - v_min)], sizeof (float)) != 0) {
+                printf("log_scaling_lut: mismatch for type %d, value %d\n", (int) raw_types[t], v);
+                failures++;
+                break;
+            }
+        }
+    }
+    if (epr_get_log_scaling_lut(&band_id, e_tid_float) != NULL) {
+        printf("log_scaling_lut: unexpected table for type float\n");
+        failures++;
+    }
+    epr_free_log_scaling_lut(&band_id);
+    return failures;
+}
+
+
+int main(int argc, char** argv)
+{
+    uint cpu_features = epr_detect_cpu_features();
+    uint tiers[] = {EPR_CPU_SSE2, EPR_CPU_SSE2 | EPR_CPU_AVX2, EPR_CPU_NEON};
+    int t, d, failures = 0;
+
+    /* the big endian decoders are checked on little endian hosts only */
+    if (epr_is_little_endian_order()) {
+        for (d = 0; d < (int) (sizeof (decoders) / sizeof (decoders[0])); d++) {
+            if (decoders[d].host_order_func != NULL) {
+                failures += compare_decoders(decoders[d].name, decoders[d].host_order_func,
+                                             decoders[d].decode_func, 1,
+                                             decoders[d].pixel_size, decoders[d].raster_elem_size);
+            }
+        }
+    }
+
+    failures += check_log_scaling_luts();
+    failures += check_byte_swaps(0);
+    failures += check_tie_point_interpolation(0);
+    for (t = 0; t < (int) (sizeof (tiers) / sizeof (tiers[0])); t++) {
+        if ((cpu_features & tiers[t]) != tiers[t]) {
+            continue;
+        }
+        printf("testing CPU features 0x%x\n", tiers[t]);
+        failures += check_byte_swaps(tiers[t]);
+        failures += check_tie_point_interpolation(tiers[t]);
+        for (d = 0; d < (int) (sizeof (decoders) / sizeof (decoders[0])); d++) {
+            failures += check_decoder(&decoders[d], tiers[t]);
+        }
+    }
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}